@@ -0,0 +1,248 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "CommandLineArguments.hpp"
+#include "SmartPointers.hpp"
+#include "CellSimulation.hpp"
+#include "VesselSimulation.hpp"
+#include "MetabolicSimulation.hpp"
+#include "InProcessCoupling.hpp"
+#include "ExecutableSupport.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+#include "PetscException.hpp"
+
+/**
+ * Runs the cell, vessel and metabolic hypermodel of test/muscle_config.cxa.rb in a
+ * single process, without MUSCLE. The components are wired with the same conduits.
+ */
+int main(int argc, char *argv[])
+{
+    ExecutableSupport::StandardStartup(&argc, &argv);
+
+    int exit_code = ExecutableSupport::EXIT_OK;
+
+    try
+    {
+        // The defaults match test/muscle_config.cxa.rb
+        unsigned max_timesteps = 20;
+        if(CommandLineArguments::Instance()->OptionExists("-max_timesteps"))
+        {
+            max_timesteps = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-max_timesteps");
+        }
+
+        double end_time = 20.0;
+        if(CommandLineArguments::Instance()->OptionExists("-end_time"))
+        {
+            end_time = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-end_time");
+        }
+
+        double time_increment = 1.0;
+        if(CommandLineArguments::Instance()->OptionExists("-time_increment"))
+        {
+            time_increment = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-time_increment");
+        }
+
+        double GC_spacing = 5.0;
+        if(CommandLineArguments::Instance()->OptionExists("-GC_spacing"))
+        {
+            GC_spacing = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-GC_spacing");
+        }
+
+        unsigned GC_size_x = 20;
+        if(CommandLineArguments::Instance()->OptionExists("-GC_size_x"))
+        {
+            GC_size_x = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-GC_size_x");
+        }
+
+        unsigned GC_size_y = 20;
+        if(CommandLineArguments::Instance()->OptionExists("-GC_size_y"))
+        {
+            GC_size_y = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-GC_size_y");
+        }
+
+        unsigned GC_size_z = 20;
+        if(CommandLineArguments::Instance()->OptionExists("-GC_size_z"))
+        {
+            GC_size_z = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-GC_size_z");
+        }
+
+        double proliferation_rate = 150.0;
+        if(CommandLineArguments::Instance()->OptionExists("-proliferation_rate"))
+        {
+            proliferation_rate = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-proliferation_rate");
+        }
+
+        double initial_volume = 144000.0;
+        if(CommandLineArguments::Instance()->OptionExists("-initial_volume"))
+        {
+            initial_volume = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-initial_volume");
+        }
+
+        c_vector<double, 3> centre = scalar_vector<double>(3, 50.0);
+        if(CommandLineArguments::Instance()->OptionExists("-centre"))
+        {
+            std::vector<double> values = CommandLineArguments::Instance()->GetDoublesCorrespondingToOption("-centre");
+            if(values.size() != 3)
+            {
+                EXCEPTION("-centre needs three coordinates");
+            }
+            for(unsigned idx=0; idx<3; idx++)
+            {
+                centre[idx] = values[idx];
+            }
+        }
+
+        bool batched_coupling = false;
+        if(CommandLineArguments::Instance()->OptionExists("-batched_coupling"))
+        {
+            batched_coupling = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-batched_coupling");
+        }
+
+        // The vessel and metabolic components step once per time increment, the cell component
+        // coupling_period times, interpolating the fields it receives in between
+        unsigned coupling_period = 1;
+        if(CommandLineArguments::Instance()->OptionExists("-coupling_period"))
+        {
+            coupling_period = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-coupling_period");
+        }
+
+        unsigned interpolation_order = 0;
+        if(CommandLineArguments::Instance()->OptionExists("-interpolation_order"))
+        {
+            interpolation_order = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-interpolation_order");
+        }
+
+        // The vessel component can solve on a grid coarser by a whole factor, with
+        // voxels made of whole cell component voxels
+        unsigned vessel_coarsening = 1;
+        if(CommandLineArguments::Instance()->OptionExists("-vessel_coarsening"))
+        {
+            vessel_coarsening = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-vessel_coarsening");
+            if(vessel_coarsening == 0 || GC_size_x % vessel_coarsening != 0 ||
+                    GC_size_y % vessel_coarsening != 0 || GC_size_z % vessel_coarsening != 0)
+            {
+                EXCEPTION("-vessel_coarsening must divide the grid size in each direction");
+            }
+        }
+
+        bool statistics_output = false;
+        if(CommandLineArguments::Instance()->OptionExists("-statistics_output"))
+        {
+            statistics_output = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-statistics_output");
+        }
+
+        // The cell component reads its initial proliferation rate factors from the input
+        std::string input_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-input"))
+        {
+            input_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-input");
+        }
+
+        std::string output_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-output"))
+        {
+            output_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-output");
+        }
+
+        if(output_file_path.empty())
+        {
+            EXCEPTION("Output file name required. Use -output");
+        }
+
+        boost::shared_ptr<CellSimulation> p_cell(new CellSimulation);
+        p_cell->SetInputFile(input_file_path);
+        p_cell->SetParameters(proliferation_rate, initial_volume, centre);
+        boost::shared_ptr<VesselSimulation> p_vessel(new VesselSimulation);
+        p_vessel->SetEndTime(end_time);
+        boost::shared_ptr<MetabolicSimulation> p_metabolic(new MetabolicSimulation);
+
+        std::vector<boost::shared_ptr<Simulation> > components;
+        components.push_back(p_cell);
+        components.push_back(p_vessel);
+        components.push_back(p_metabolic);
+        for(unsigned idx=0; idx<components.size(); idx++)
+        {
+            components[idx]->SetOutputFile(output_file_path);
+            components[idx]->SetMaxIncrements(max_timesteps);
+            components[idx]->SetTargetTimeIncrement(time_increment);
+            components[idx]->SetGridSpacing(GC_spacing);
+            components[idx]->SetGridSize(GC_size_x, GC_size_y, GC_size_z);
+            components[idx]->SetBatchedCoupling(batched_coupling);
+            components[idx]->SetStatisticsOutput(statistics_output);
+        }
+        if(vessel_coarsening > 1)
+        {
+            c_vector<unsigned, 3> fine_size;
+            fine_size[0] = GC_size_x;
+            fine_size[1] = GC_size_y;
+            fine_size[2] = GC_size_z;
+            c_vector<unsigned, 3> coarse_size;
+            for(unsigned idx=0; idx<3; idx++)
+            {
+                coarse_size[idx] = fine_size[idx] / vessel_coarsening;
+            }
+            c_vector<double, 3> coarse_origin = scalar_vector<double>(3, 0.5 * (vessel_coarsening - 1) * GC_spacing);
+            p_vessel->SetGridSize(coarse_size[0], coarse_size[1], coarse_size[2]);
+            p_vessel->SetGridSpacing(GC_spacing * vessel_coarsening);
+            p_vessel->SetGridOrigin(coarse_origin[0], coarse_origin[1], coarse_origin[2]);
+            p_vessel->SetPeerGrid(fine_size, GC_spacing, zero_vector<double>(3));
+            p_metabolic->SetPeerGrid(coarse_size, GC_spacing * vessel_coarsening, coarse_origin);
+        }
+        p_cell->SetCouplingPeriod(coupling_period, interpolation_order);
+        p_cell->SetMaxIncrements(max_timesteps * coupling_period);
+        p_cell->SetTargetTimeIncrement(time_increment / double(coupling_period));
+
+        InProcessCoupling coupling;
+        coupling.AddComponent("CellSimulator", p_cell);
+        coupling.AddComponent("VesselSimulator", p_vessel);
+        coupling.AddComponent("MetabolicSimulator", p_metabolic);
+        coupling.Couple(CouplingScheme::Hypermodel(batched_coupling));
+
+        coupling.Run();
+    }
+
+    catch (const Exception& e)
+    {
+        ExecutableSupport::PrintError(e.GetMessage());
+        exit_code = ExecutableSupport::EXIT_ERROR;
+    }
+
+    ExecutableSupport::FinalizePetsc();
+    return exit_code;
+}
@@ -0,0 +1,94 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "CommandLineArguments.hpp"
+#include "ExecutableSupport.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+#include "PetscException.hpp"
+#include "InputFileConverter.hpp"
+
+int main(int argc, char *argv[])
+{
+    ExecutableSupport::StandardStartup(&argc, &argv);
+
+    int exit_code = ExecutableSupport::EXIT_OK;
+
+    try
+    {
+        // Convert a VTK image input into a binary field file which the simulators can map
+        std::string input_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-input"))
+        {
+            input_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-input");
+        }
+        else
+        {
+            EXCEPTION("An input VTK image file is required, use -input");
+        }
+
+        std::string output_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-output"))
+        {
+            output_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-output");
+        }
+        else
+        {
+            EXCEPTION("An output file is required, use -output");
+        }
+
+        // Restrict the file to the named arrays, otherwise all point arrays are kept
+        std::vector<std::string> array_names;
+        if(CommandLineArguments::Instance()->OptionExists("-arrays"))
+        {
+            array_names = CommandLineArguments::Instance()->GetStringsCorrespondingToOption("-arrays");
+        }
+
+        InputFileConverter::Convert(input_file_path, output_file_path, array_names);
+        std::cout << "Converted " << input_file_path << " to " << output_file_path << std::endl;
+    }
+
+    catch (const Exception& e)
+    {
+        ExecutableSupport::PrintError(e.GetMessage());
+        exit_code = ExecutableSupport::EXIT_ERROR;
+    }
+
+    ExecutableSupport::FinalizePetsc();
+    return exit_code;
+}
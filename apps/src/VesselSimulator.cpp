@@ -41,6 +41,9 @@
 #include <stdlib.h>
 #include <muscle2/cppmuscle.hpp>
 #include "VesselSimulation.hpp"
+#include "SharedMemoryCouplingTransport.hpp"
+#include "MpiCouplingTransport.hpp"
+#include "CouplingScheme.hpp"
 #include "ExecutableSupport.hpp"
 #include "Exception.hpp"
 #include "CommandLineArguments.hpp"
@@ -51,6 +54,17 @@ using namespace muscle;
 
 int main(int argc, char *argv[])
 {
+    // The MPI coupling transport gives each component its own part of MPI_COMM_WORLD,
+    // so it is set up before PETSc, which then works within the component
+    boost::shared_ptr<MpiCouplingTransport> p_mpi_transport;
+    if(MpiCouplingTransport::IsSelected(argc, argv))
+    {
+        MpiCouplingTransport::InitialiseMpi(&argc, &argv);
+        p_mpi_transport.reset(new MpiCouplingTransport("VesselSimulator",
+                MpiCouplingTransport::AreFieldsDistributed(argc, argv)));
+        PETSC_COMM_WORLD = p_mpi_transport->GetComponentCommunicator();
+    }
+
     ExecutableSupport::StandardStartup(&argc, &argv);
 
     int exit_code = ExecutableSupport::EXIT_OK;
@@ -94,6 +108,237 @@ int main(int argc, char *argv[])
             run_standalone_vessel = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-standalone");
         }
 
+        bool async_output = false;
+        if(CommandLineArguments::Instance()->OptionExists("-async_output"))
+        {
+            async_output = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-async_output");
+        }
+
+        bool batched_coupling = false;
+        if(CommandLineArguments::Instance()->OptionExists("-batched_coupling"))
+        {
+            batched_coupling = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-batched_coupling");
+        }
+
+        // Encodings of outgoing fields, given as name:encoding or name:fixed:error_bound
+        std::vector<std::string> coupling_encodings;
+        if(CommandLineArguments::Instance()->OptionExists("-coupling_encodings"))
+        {
+            coupling_encodings = CommandLineArguments::Instance()->GetStringsCorrespondingToOption("-coupling_encodings");
+            if(!batched_coupling)
+            {
+                EXCEPTION("-coupling_encodings needs -batched_coupling 1");
+            }
+        }
+
+        bool delta_coupling = false;
+        if(CommandLineArguments::Instance()->OptionExists("-delta_coupling"))
+        {
+            delta_coupling = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-delta_coupling");
+            if(delta_coupling && !batched_coupling)
+            {
+                EXCEPTION("-delta_coupling needs -batched_coupling 1");
+            }
+        }
+
+        double delta_tolerance = 0.0;
+        if(CommandLineArguments::Instance()->OptionExists("-delta_tolerance"))
+        {
+            delta_tolerance = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-delta_tolerance");
+        }
+
+        bool async_coupling = false;
+        if(CommandLineArguments::Instance()->OptionExists("-async_coupling"))
+        {
+            async_coupling = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-async_coupling");
+            if(async_coupling && !batched_coupling)
+            {
+                EXCEPTION("-async_coupling needs -batched_coupling 1");
+            }
+        }
+
+        // Exchange fields every coupling_period increments, interpolating the inputs in between
+        unsigned coupling_period = 1;
+        if(CommandLineArguments::Instance()->OptionExists("-coupling_period"))
+        {
+            coupling_period = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-coupling_period");
+        }
+
+        unsigned interpolation_order = 0;
+        if(CommandLineArguments::Instance()->OptionExists("-interpolation_order"))
+        {
+            interpolation_order = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-interpolation_order");
+        }
+
+        // The grid the other components send their fields on, if it isn't this component's grid
+        std::vector<unsigned> peer_grid_size;
+        if(CommandLineArguments::Instance()->OptionExists("-peer_grid_size"))
+        {
+            peer_grid_size = CommandLineArguments::Instance()->GetUnsignedsCorrespondingToOption("-peer_grid_size");
+            if(peer_grid_size.size() != 3)
+            {
+                EXCEPTION("-peer_grid_size needs three sizes: x y z");
+            }
+            if(!CommandLineArguments::Instance()->OptionExists("-peer_grid_spacing"))
+            {
+                EXCEPTION("-peer_grid_size needs -peer_grid_spacing");
+            }
+        }
+
+        double peer_grid_spacing = 1.0;
+        if(CommandLineArguments::Instance()->OptionExists("-peer_grid_spacing"))
+        {
+            peer_grid_spacing = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-peer_grid_spacing");
+        }
+
+        std::vector<double> peer_grid_origin(3, 0.0);
+        if(CommandLineArguments::Instance()->OptionExists("-peer_grid_origin"))
+        {
+            peer_grid_origin = CommandLineArguments::Instance()->GetDoublesCorrespondingToOption("-peer_grid_origin");
+            if(peer_grid_origin.size() != 3)
+            {
+                EXCEPTION("-peer_grid_origin needs three coordinates: x y z");
+            }
+        }
+
+        // Coupled components talk through MUSCLE, through shared memory when on the same machine,
+        // or through MPI when they are launched as one MPI job
+        std::string coupling_transport = "muscle";
+        if(CommandLineArguments::Instance()->OptionExists("-coupling_transport"))
+        {
+            coupling_transport = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-coupling_transport");
+            if(coupling_transport != "muscle" && coupling_transport != "shm" && coupling_transport != "mpi")
+            {
+                EXCEPTION("Unknown coupling transport " + coupling_transport + ". Use muscle, shm or mpi");
+            }
+            if(coupling_transport == "mpi" && async_coupling && !MpiCouplingTransport::IsThreadSafe())
+            {
+                EXCEPTION("-async_coupling with the mpi coupling transport needs an MPI with MPI_THREAD_MULTIPLE support");
+            }
+        }
+
+        std::string shm_session = "chic";
+        if(CommandLineArguments::Instance()->OptionExists("-shm_session"))
+        {
+            shm_session = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-shm_session");
+        }
+
+        // Shared memory channels of conduits, given as conduit:channel
+        std::vector<std::string> shm_channels;
+        if(CommandLineArguments::Instance()->OptionExists("-shm_channels"))
+        {
+            shm_channels = CommandLineArguments::Instance()->GetStringsCorrespondingToOption("-shm_channels");
+        }
+
+        bool coupling_compression = false;
+        if(CommandLineArguments::Instance()->OptionExists("-coupling_compression"))
+        {
+            coupling_compression = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-coupling_compression");
+        }
+
+        bool field_output = true;
+        if(CommandLineArguments::Instance()->OptionExists("-field_output"))
+        {
+            field_output = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-field_output");
+        }
+
+        bool statistics_output = false;
+        if(CommandLineArguments::Instance()->OptionExists("-statistics_output"))
+        {
+            statistics_output = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-statistics_output");
+        }
+
+        OutputFormat output_format = VTI_OUTPUT;
+        if(CommandLineArguments::Instance()->OptionExists("-output_format"))
+        {
+            std::string format = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-output_format");
+            if(format == "hdf5")
+            {
+                output_format = HDF5_OUTPUT;
+            }
+            else if(format != "vti")
+            {
+                EXCEPTION("Unknown output format " + format + ". Use vti or hdf5");
+            }
+        }
+
+        VtkCodec vtk_codec = ZLIB_BASE64_CODEC;
+        if(CommandLineArguments::Instance()->OptionExists("-vtk_codec"))
+        {
+            vtk_codec = VtkImageWriter::GetCodec(CommandLineArguments::Instance()->GetStringCorrespondingToOption("-vtk_codec"));
+        }
+
+        int compression_level = -1;
+        if(CommandLineArguments::Instance()->OptionExists("-compression_level"))
+        {
+            compression_level = CommandLineArguments::Instance()->GetIntCorrespondingToOption("-compression_level");
+        }
+
+        // Output regions: a subvolume given as lower and upper point indices, orthogonal
+        // slices through a point, and a downsampling stride applied to each region
+        std::vector<unsigned> output_roi;
+        if(CommandLineArguments::Instance()->OptionExists("-output_roi"))
+        {
+            output_roi = CommandLineArguments::Instance()->GetUnsignedsCorrespondingToOption("-output_roi");
+            if(output_roi.size() != 6)
+            {
+                EXCEPTION("-output_roi needs six indices: x0 y0 z0 x1 y1 z1");
+            }
+        }
+
+        std::vector<unsigned> output_slices;
+        if(CommandLineArguments::Instance()->OptionExists("-output_slices"))
+        {
+            output_slices = CommandLineArguments::Instance()->GetUnsignedsCorrespondingToOption("-output_slices");
+            if(output_slices.size() != 3)
+            {
+                EXCEPTION("-output_slices needs the three indices of the point the slices pass through");
+            }
+        }
+
+        unsigned output_stride = 1;
+        if(CommandLineArguments::Instance()->OptionExists("-output_stride"))
+        {
+            output_stride = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-output_stride");
+        }
+
+        std::string checkpoint_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-checkpoint"))
+        {
+            checkpoint_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-checkpoint");
+        }
+
+        unsigned checkpoint_frequency = 1;
+        if(CommandLineArguments::Instance()->OptionExists("-checkpoint_frequency"))
+        {
+            checkpoint_frequency = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-checkpoint_frequency");
+        }
+
+        std::string restart_file_path;
+        if(CommandLineArguments::Instance()->OptionExists("-restart"))
+        {
+            restart_file_path = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-restart");
+        }
+
+        // Each process keeps only its block of the grid up to date and exchanges only that
+        // block with the other components. Statistics and checkpoints need the whole grid.
+        if(CommandLineArguments::Instance()->OptionExists("-distributed_fields") &&
+                CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-distributed_fields"))
+        {
+            if(coupling_transport != "mpi" || batched_coupling)
+            {
+                EXCEPTION("-distributed_fields needs -coupling_transport mpi and per-field coupling");
+            }
+            if(statistics_output || !checkpoint_file_path.empty() || !restart_file_path.empty())
+            {
+                EXCEPTION("-distributed_fields can't be used with -statistics_output, -checkpoint or -restart");
+            }
+            if(!peer_grid_size.empty())
+            {
+                EXCEPTION("-distributed_fields can't be used with -peer_grid_size");
+            }
+        }
+
         std::string input_file_path;
         if(CommandLineArguments::Instance()->OptionExists("-input"))
         {
@@ -238,8 +483,69 @@ int main(int argc, char *argv[])
             vessel_growth_timestep = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-vessel_growth_timestep");
         }
 
+        LinearSolverType linear_solver = ASSEMBLED_SOLVER;
+        if(CommandLineArguments::Instance()->OptionExists("-linear_solver"))
+        {
+            std::string solver = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-linear_solver");
+            if(solver == "matrix_free")
+            {
+                linear_solver = MATRIX_FREE_SOLVER;
+            }
+            else if(solver != "assembled")
+            {
+                EXCEPTION("Unknown linear solver " + solver + ". Use assembled or matrix_free");
+            }
+            if(linear_solver == MATRIX_FREE_SOLVER && CommandLineArguments::Instance()->OptionExists("-distributed_fields") &&
+                    CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-distributed_fields"))
+            {
+                EXCEPTION("-linear_solver matrix_free can't be used with -distributed_fields");
+            }
+        }
+
+        StencilPreconditioner stencil_preconditioner = MULTIGRID_PRECONDITIONER;
+        if(CommandLineArguments::Instance()->OptionExists("-stencil_preconditioner"))
+        {
+            std::string preconditioner = CommandLineArguments::Instance()->GetStringCorrespondingToOption("-stencil_preconditioner");
+            if(preconditioner == "jacobi")
+            {
+                stencil_preconditioner = JACOBI_PRECONDITIONER;
+            }
+            else if(preconditioner == "chebyshev")
+            {
+                stencil_preconditioner = CHEBYSHEV_PRECONDITIONER;
+            }
+            else if(preconditioner != "multigrid")
+            {
+                EXCEPTION("Unknown stencil preconditioner " + preconditioner + ". Use jacobi, chebyshev or multigrid");
+            }
+        }
+
+        bool warm_start = false;
+        if(CommandLineArguments::Instance()->OptionExists("-warm_start"))
+        {
+            warm_start = CommandLineArguments::Instance()->GetBoolCorrespondingToOption("-warm_start");
+        }
+
+        double change_tolerance = 1.e-3;
+        if(CommandLineArguments::Instance()->OptionExists("-change_tolerance"))
+        {
+            change_tolerance = CommandLineArguments::Instance()->GetDoubleCorrespondingToOption("-change_tolerance");
+        }
+
+        unsigned preconditioner_lag = 0;
+        if(CommandLineArguments::Instance()->OptionExists("-preconditioner_lag"))
+        {
+            preconditioner_lag = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-preconditioner_lag");
+        }
+
+        unsigned preconditioner_rebuild_iterations = 0;
+        if(CommandLineArguments::Instance()->OptionExists("-preconditioner_rebuild_iterations"))
+        {
+            preconditioner_rebuild_iterations = CommandLineArguments::Instance()->GetUnsignedCorrespondingToOption("-preconditioner_rebuild_iterations");
+        }
+
         // if using muscle set parameters from muscle environment
-        if(!run_standalone_vessel)
+        if(!run_standalone_vessel && coupling_transport == "muscle")
         {
             // Initialise MUSCLE2 environment
             env::init(&argc, &argv);
@@ -255,6 +561,10 @@ int main(int argc, char *argv[])
             GC_origin_y = atof(cxa::get_property("GC_origin_y").c_str());
             GC_origin_z = atof(cxa::get_property("GC_origin_z").c_str());
 
+            // The interval is between exchanges, with a coupling period the component steps that many times in each
+            time_increment /= double(coupling_period);
+            max_timesteps *= coupling_period;
+
             // Print identity of running instance
             std::cout << "Using Muscle. Kernel Name: " << muscle::cxa::kernel_name() << std::endl;
 
@@ -297,11 +607,88 @@ int main(int argc, char *argv[])
                                  rate_of_vessel_regression,
                                  vessel_growth_timestep);
 
+        simulation.SetAsynchronousOutput(async_output);
+        simulation.SetBatchedCoupling(batched_coupling);
+        simulation.SetCouplingCompression(coupling_compression);
+        simulation.SetDeltaCoupling(delta_coupling, delta_tolerance);
+        simulation.SetAsynchronousCoupling(async_coupling);
+        simulation.SetCouplingPeriod(coupling_period, interpolation_order);
+
+        if(!peer_grid_size.empty())
+        {
+            c_vector<unsigned, 3> size;
+            c_vector<double, 3> origin;
+            for(unsigned idx=0; idx<3; idx++)
+            {
+                size[idx] = peer_grid_size[idx];
+                origin[idx] = peer_grid_origin[idx];
+            }
+            simulation.SetPeerGrid(size, peer_grid_spacing, origin);
+        }
+
+        if(coupling_transport == "shm")
+        {
+            boost::shared_ptr<SharedMemoryCouplingTransport> p_transport(new SharedMemoryCouplingTransport(shm_session));
+            for(unsigned idx=0; idx<shm_channels.size(); idx++)
+            {
+                std::string conduit;
+                std::string channel;
+                SharedMemoryCouplingTransport::ParseChannel(shm_channels[idx], conduit, channel);
+                p_transport->SetChannel(conduit, channel);
+            }
+            simulation.SetCouplingTransport(p_transport);
+        }
+        else if(coupling_transport == "mpi")
+        {
+            p_mpi_transport->SetCouplingScheme(CouplingScheme::Hypermodel(batched_coupling));
+            simulation.SetCouplingTransport(p_mpi_transport);
+        }
+
+        simulation.SetFieldEncodings(coupling_encodings);
+        simulation.SetLinearSolver(linear_solver, stencil_preconditioner);
+        simulation.SetWarmStart(warm_start, change_tolerance);
+        simulation.SetPreconditionerLag(preconditioner_lag, preconditioner_rebuild_iterations);
+        simulation.SetOutputFormat(output_format);
+        simulation.SetFieldOutput(field_output);
+        simulation.SetStatisticsOutput(statistics_output);
+        simulation.SetVtkCodec(vtk_codec, compression_level);
+        if(!output_roi.empty())
+        {
+            c_vector<unsigned, 3> lower;
+            c_vector<unsigned, 3> upper;
+            for(unsigned idx=0; idx<3; idx++)
+            {
+                lower[idx] = output_roi[idx];
+                upper[idx] = output_roi[idx + 3];
+            }
+            simulation.AddOutputRegion("roi", OutputRegion::SubVolume(lower, upper).SetStride(output_stride));
+        }
+        if(!output_slices.empty())
+        {
+            const char* slice_names[3] = {"slice_yz", "slice_xz", "slice_xy"};
+            for(unsigned axis=0; axis<3; axis++)
+            {
+                simulation.AddOutputRegion(slice_names[axis], OutputRegion::Slice(axis, output_slices[axis]).SetStride(output_stride));
+            }
+        }
+        if(output_roi.empty() && output_slices.empty() && output_stride > 1)
+        {
+            simulation.AddOutputRegion("downsampled", OutputRegion::Downsample(output_stride));
+        }
+        if(!checkpoint_file_path.empty())
+        {
+            simulation.SetCheckpointFile(checkpoint_file_path, checkpoint_frequency);
+        }
+        if(!restart_file_path.empty())
+        {
+            simulation.SetRestartFile(restart_file_path);
+        }
+
         // Run the simulation
         simulation.Run();
 
         // Finalise Muscle environment and cleanup
-        if(!run_standalone_vessel)
+        if(!run_standalone_vessel && coupling_transport == "muscle")
         {
             env::finalize();
         }
@@ -313,5 +700,11 @@ int main(int argc, char *argv[])
     }
 
     ExecutableSupport::FinalizePetsc();
+    if(p_mpi_transport)
+    {
+        // Ends the streams to the other components
+        p_mpi_transport.reset();
+        MPI_Finalize();
+    }
     return exit_code;
 }
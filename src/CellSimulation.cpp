@@ -53,7 +53,9 @@ CellSimulation::CellSimulation() : Simulation(),
         mProliferationRate(100.0),
         mInitialVolume(100000.0),
         mCurrentVolume(100000.0),
-        mCentre(zero_vector<double>(3))
+        mCentre(zero_vector<double>(3)),
+        mProliferatingHandle(0),
+        mTumourHandle(0)
 {
     mFileInputSpatialParameters.push_back("proliferation_rate_factor");
 
@@ -73,7 +75,6 @@ CellSimulation::CellSimulation() : Simulation(),
     mMuscleOutputSpatialParameters.push_back("quiescent");
     mMuscleOutputSpatialParameters.push_back("apoptotic");
     mMuscleOutputSpatialParameters.push_back("necrotic");
-    mMuscleOutputSpatialParameters.push_back("proliferating");
     mMuscleOutputSpatialParameters.push_back("tumour");
 }
 
@@ -93,8 +94,19 @@ void CellSimulation::Initialize()
 {
     Simulation::Initialize();
 
+    mProliferatingHandle = mFields.Register("proliferating");
+    mTumourHandle = mFields.Register("tumour");
+
+    // On restart the cell populations and rates all come from the checkpoint
+    if(IsRestart())
+    {
+        return;
+    }
+
     // Set up the initial cell populations
     unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    double* p_proliferating = mFields.GetField(mProliferatingHandle);
+    double* p_tumour = mFields.GetField(mTumourHandle);
     for(unsigned idx=0; idx<mGridSize[2]; idx++)
     {
         for(unsigned jdx=0; jdx<mGridSize[1]; jdx++)
@@ -110,31 +122,44 @@ void CellSimulation::Initialize()
                 location[2] = idx*mGridSpacing + mGridOrigin[2];
                 if(norm_2(location - mCentre) < cbrt(3.0*mInitialVolume/(4.0*M_PI)))
                 {
-                    mSolutionVectors["proliferating"][index] = 1.0;
-                    mSolutionVectors["tumour"][index] = 1.0;
+                    p_proliferating[index] = 1.0;
+                    p_tumour[index] = 1.0;
                 }
             }
         }
     }
 
-    // If there is an input file use it to calculate the proliferation rates
+    // If there is an input file use it to calculate the proliferation rates. In standalone
+    // mode the base class has already loaded it, otherwise read it into a scratch buffer.
     if(mCurrentTime==0.0)
     {
-        vtkSmartPointer<vtkImageData> p_input_data = vtkSmartPointer<vtkImageData>::New();
-        p_input_data = ReadVtk(mInputFile);
+        std::vector<double> input_factors;
+        const double* p_factor = NULL;
+        if(mStandalone)
+        {
+            p_factor = mFields.GetField(mFields.GetHandle("proliferation_rate_factor"));
+        }
+        else
+        {
+            input_factors.resize(num_points);
+            ReadInputArray("proliferation_rate_factor", &input_factors[0]);
+            p_factor = &input_factors[0];
+        }
+
         double average_prolif_rate_factor = 0.0;
         unsigned num_tumour = 0;
         for(unsigned jdx = 0; jdx<num_points; jdx++)
         {
-            if(mSolutionVectors["tumour"][jdx]==1)
+            if(p_tumour[jdx]==1)
             {
-                average_prolif_rate_factor += p_input_data->GetPointData()->GetArray("proliferation_rate_factor")->GetTuple1(jdx);
+                average_prolif_rate_factor += p_factor[jdx];
                 num_tumour++;
             }
         }
         average_prolif_rate_factor /= double(num_tumour);
         mProliferationRate *=average_prolif_rate_factor;
     }
+    ReleaseInputData();
 }
 
 void CellSimulation::Run()
@@ -147,18 +172,27 @@ void CellSimulation::Run()
         EXCEPTION("Output file name required.");
     }
     MARK;
-    std::ofstream output_file((this->mOutputFile + "_t_"+boost::lexical_cast<std::string>(mCurrentTime)+ ".dat").c_str());
-    output_file << "time, volume \n";
+    std::string volume_file = this->mOutputFile + "_t_"+boost::lexical_cast<std::string>(mCurrentTime)+ ".dat";
+    std::ofstream output_file;
+    if(IsRestart())
+    {
+        output_file.open(volume_file.c_str(), std::ios::app);
+    }
+    else
+    {
+        output_file.open(volume_file.c_str());
+        output_file << "time, volume \n";
+    }
 
     MARK;
     // Update the tumour radius
-    unsigned counter = 0;
+    unsigned counter = mCurrentIncrement;
     while(counter <= this->mMaxIncrements)
     {
         // Communicate with the other simulators
         if(!mStandalone && counter>0)
         {
-            Receive();
+            UpdateCoupledInputs(counter);
         }
 
         if (output_file.is_open())
@@ -173,6 +207,8 @@ void CellSimulation::Run()
         mCurrentVolume = (4.0/3.0)*M_PI*current_radius*current_radius*current_radius;
 
         // Update the solution data
+        double* p_proliferating = mFields.GetField(mProliferatingHandle);
+        double* p_tumour = mFields.GetField(mTumourHandle);
         for(unsigned idx=0; idx<mGridSize[2]; idx++)
         {
             for(unsigned jdx=0; jdx<mGridSize[1]; jdx++)
@@ -188,37 +224,59 @@ void CellSimulation::Run()
                     location[2] = idx*mGridSpacing + mGridOrigin[2];
                     if(norm_2(location - mCentre) < cbrt(3.0*mCurrentVolume/(4.0*M_PI)))
                     {
-                        mSolutionVectors["proliferating"][index] = 1.e6;
-                        mSolutionVectors["tumour"][index] = 1.0;
+                        p_proliferating[index] = 1.e6;
+                        p_tumour[index] = 1.0;
                     }
                 }
             }
         }
 
-        // Write the output at the specified frequency
-        if(counter % mOutputFrequency == 0)
+        // Send first, with asynchronous coupling the output is written while the fields are in flight
+        if(!mStandalone && IsCouplingIncrement(counter))
         {
-            if(!mOutputFile.empty() && mStandalone)
-            {
-                std::string output_file = mOutputFile + "_cell_t_" + boost::lexical_cast<std::string>(mCurrentTime)+".vti";
-                WriteVtk(output_file);
-            }
-            else if(!mOutputFile.empty())
-            {
-                std::string output_file = mOutputFile + "_cell_t_" + boost::lexical_cast<std::string>(counter)+".vti";
-                WriteVtk(output_file);
-            }
-            else
+            Send();
+            if(counter + mCouplingPeriod <= this->mMaxIncrements)
             {
-                EXCEPTION("Output file not specified.");
+                PrefetchMessage();
             }
         }
-        if(!mStandalone)
+
+        // Write the output at the specified frequency. Standalone files are labelled by
+        // the start time and coupled ones by increment.
+        if(counter % mOutputFrequency == 0)
         {
-            Send();
+            std::string step_label = mStandalone ? boost::lexical_cast<std::string>(mCurrentTime) :
+                    boost::lexical_cast<std::string>(counter);
+            WriteOutput("cell", step_label, double(counter + 1) * this->mTargetTimeIncrement);
         }
+        RecordStatistics("cell", double(counter + 1) * this->mTargetTimeIncrement);
         counter ++;
+        mCurrentIncrement = counter;
+        CheckpointIfRequired();
     }
+    FlushOutput();
     MARK;
     output_file.close();
 }
+
+void CellSimulation::AddCheckpointParameters(std::map<std::string, double>& rParameters)
+{
+    rParameters["proliferation_rate"] = mProliferationRate;
+    rParameters["initial_volume"] = mInitialVolume;
+    rParameters["current_volume"] = mCurrentVolume;
+    rParameters["centre_x"] = mCentre[0];
+    rParameters["centre_y"] = mCentre[1];
+    rParameters["centre_z"] = mCentre[2];
+    Simulation::AddCheckpointParameters(rParameters);
+}
+
+void CellSimulation::LoadCheckpointParameters(const std::map<std::string, double>& rParameters)
+{
+    mProliferationRate = GetParameter(rParameters, "proliferation_rate");
+    mInitialVolume = GetParameter(rParameters, "initial_volume");
+    mCurrentVolume = GetParameter(rParameters, "current_volume");
+    mCentre[0] = GetParameter(rParameters, "centre_x");
+    mCentre[1] = GetParameter(rParameters, "centre_y");
+    mCentre[2] = GetParameter(rParameters, "centre_z");
+    Simulation::LoadCheckpointParameters(rParameters);
+}
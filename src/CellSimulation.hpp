@@ -64,6 +64,16 @@ class CellSimulation : public Simulation
      */
     c_vector<double, 3> mCentre;
 
+    /**
+     * Proliferating cell field handle, resolved in Initialize()
+     */
+    unsigned mProliferatingHandle;
+
+    /**
+     * Tumour mask field handle
+     */
+    unsigned mTumourHandle;
+
 public:
 
     /**
@@ -95,6 +105,20 @@ public:
      * Run the simulation
      */
     void Run();
+
+protected:
+
+    /**
+     * Over-ridden to store the tumour state and parameters
+     * @param rParameters named values to be stored
+     */
+    void AddCheckpointParameters(std::map<std::string, double>& rParameters);
+
+    /**
+     * Over-ridden to restore the tumour state and parameters
+     * @param rParameters the stored named values
+     */
+    void LoadCheckpointParameters(const std::map<std::string, double>& rParameters);
 };
 
 #endif /*CELLSIMULATION_HPP_*/
@@ -0,0 +1,171 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "FieldRegistry.hpp"
+
+FieldRegistry::FieldRegistry()
+    : mNumberOfPoints(0),
+      mNames(),
+      mHandles(),
+      mFields(),
+      mOwners()
+{
+
+}
+
+FieldRegistry::~FieldRegistry()
+{
+    Reset(0);
+}
+
+void FieldRegistry::Reset(unsigned numberOfPoints)
+{
+    for(unsigned idx=0; idx<mFields.size(); idx++)
+    {
+        if(!mOwners[idx])
+        {
+            free(mFields[idx]);
+        }
+    }
+    mFields.clear();
+    mOwners.clear();
+    mNames.clear();
+    mHandles.clear();
+    mNumberOfPoints = numberOfPoints;
+}
+
+unsigned FieldRegistry::Register(const std::string& rName)
+{
+    std::map<std::string, unsigned>::const_iterator it = mHandles.find(rName);
+    if(it != mHandles.end())
+    {
+        return it->second;
+    }
+
+    // Round up to a whole number of alignment blocks so that kernels can safely
+    // run vector loads up to the end of the buffer.
+    std::size_t num_bytes = std::max(mNumberOfPoints, 1u) * sizeof(double);
+    num_bytes = ((num_bytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+    void* p_buffer = NULL;
+    if(posix_memalign(&p_buffer, ALIGNMENT, num_bytes) != 0)
+    {
+        EXCEPTION("Could not allocate storage for field " + rName);
+    }
+    memset(p_buffer, 0, num_bytes);
+
+    unsigned handle = mFields.size();
+    mFields.push_back(static_cast<double*>(p_buffer));
+    mOwners.push_back(boost::shared_ptr<void>());
+    mNames.push_back(rName);
+    mHandles[rName] = handle;
+    return handle;
+}
+
+void FieldRegistry::Adopt(unsigned handle, double* pData, boost::shared_ptr<void> pOwner)
+{
+    if(!IsAligned(pData))
+    {
+        EXCEPTION("Buffer adopted for field " + mNames[handle] + " is not suitably aligned");
+    }
+    if(!pOwner)
+    {
+        EXCEPTION("Buffer adopted for field " + mNames[handle] + " needs an owner");
+    }
+    if(!mOwners[handle])
+    {
+        free(mFields[handle]);
+    }
+    mFields[handle] = pData;
+    mOwners[handle] = pOwner;
+}
+
+bool FieldRegistry::IsAligned(const void* pData)
+{
+    return reinterpret_cast<std::size_t>(pData) % ALIGNMENT == 0;
+}
+
+bool FieldRegistry::HasField(const std::string& rName) const
+{
+    return mHandles.find(rName) != mHandles.end();
+}
+
+unsigned FieldRegistry::GetHandle(const std::string& rName) const
+{
+    std::map<std::string, unsigned>::const_iterator it = mHandles.find(rName);
+    if(it == mHandles.end())
+    {
+        EXCEPTION("Requested field " + rName + " has not been registered");
+    }
+    return it->second;
+}
+
+const std::string& FieldRegistry::rGetName(unsigned handle) const
+{
+    return mNames[handle];
+}
+
+const std::vector<std::string>& FieldRegistry::rGetNames() const
+{
+    return mNames;
+}
+
+unsigned FieldRegistry::GetNumberOfFields() const
+{
+    return mFields.size();
+}
+
+unsigned FieldRegistry::GetNumberOfPoints() const
+{
+    return mNumberOfPoints;
+}
+
+void FieldRegistry::SetField(unsigned handle, const std::vector<double>& rValues)
+{
+    if(rValues.size() != mNumberOfPoints)
+    {
+        EXCEPTION("Number of values does not match the number of points in field " + mNames[handle]);
+    }
+    std::copy(rValues.begin(), rValues.end(), mFields[handle]);
+}
+
+std::vector<double> FieldRegistry::GetFieldVector(unsigned handle) const
+{
+    return std::vector<double>(mFields[handle], mFields[handle] + mNumberOfPoints);
+}
@@ -0,0 +1,201 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef FIELDREGISTRY_HPP_
+#define FIELDREGISTRY_HPP_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * A collection of named solution fields on a regular grid. Each field is stored
+ * in its own contiguous, 64-byte aligned buffer. Names are resolved to integer
+ * handles once, so that compute kernels can work on raw pointers rather than
+ * doing a string lookup for every grid point. The name based methods are
+ * intended for configuration and I/O only.
+ */
+class FieldRegistry
+{
+    /**
+     * The number of grid points in each field
+     */
+    unsigned mNumberOfPoints;
+
+    /**
+     * The field names, indexed by handle
+     */
+    std::vector<std::string> mNames;
+
+    /**
+     * Map from field name to handle
+     */
+    std::map<std::string, unsigned> mHandles;
+
+    /**
+     * The field buffers, indexed by handle
+     */
+    std::vector<double*> mFields;
+
+    /**
+     * Owners of adopted buffers, indexed by handle. Empty for buffers the registry allocated.
+     */
+    std::vector<boost::shared_ptr<void> > mOwners;
+
+    /**
+     * Copy constructor, not implemented. The registry owns its buffers.
+     */
+    FieldRegistry(const FieldRegistry&);
+
+    /**
+     * Assignment, not implemented. The registry owns its buffers.
+     */
+    FieldRegistry& operator=(const FieldRegistry&);
+
+public:
+
+    /**
+     * The alignment of each field buffer in bytes
+     */
+    static const unsigned ALIGNMENT = 64;
+
+    /**
+     * Constructor.
+     */
+    FieldRegistry();
+
+    /**
+     * Destructor
+     */
+    ~FieldRegistry();
+
+    /**
+     * Remove all fields and set the number of points for fields registered from now on
+     * @param numberOfPoints the number of grid points in each field
+     */
+    void Reset(unsigned numberOfPoints);
+
+    /**
+     * Add a zero initialized field, or return the handle of an existing field with this name.
+     * Buffers of previously registered fields are not moved.
+     * @param rName the field name
+     * @return the field handle
+     */
+    unsigned Register(const std::string& rName);
+
+    /**
+     * Replace the storage of a field with an existing buffer, without copying. The
+     * registry keeps a reference to the buffer's owner until the field is reset.
+     * The buffer must hold GetNumberOfPoints() values and be ALIGNMENT aligned.
+     * @param handle the field handle
+     * @param pData the buffer to adopt
+     * @param pOwner the object that keeps the buffer alive
+     */
+    void Adopt(unsigned handle, double* pData, boost::shared_ptr<void> pOwner);
+
+    /**
+     * @param pData a buffer
+     * @return whether the buffer satisfies the registry alignment
+     */
+    static bool IsAligned(const void* pData);
+
+    /**
+     * @param rName the field name
+     * @return whether a field with this name is registered
+     */
+    bool HasField(const std::string& rName) const;
+
+    /**
+     * @param rName the field name
+     * @return the handle for the named field
+     */
+    unsigned GetHandle(const std::string& rName) const;
+
+    /**
+     * @param handle the field handle
+     * @return the field name
+     */
+    const std::string& rGetName(unsigned handle) const;
+
+    /**
+     * @return the field names, indexed by handle
+     */
+    const std::vector<std::string>& rGetNames() const;
+
+    /**
+     * @return the number of registered fields
+     */
+    unsigned GetNumberOfFields() const;
+
+    /**
+     * @return the number of grid points in each field
+     */
+    unsigned GetNumberOfPoints() const;
+
+    /**
+     * @param handle the field handle
+     * @return the aligned field buffer, of length GetNumberOfPoints()
+     */
+    double* GetField(unsigned handle)
+    {
+        return mFields[handle];
+    }
+
+    /**
+     * @param handle the field handle
+     * @return the aligned field buffer, of length GetNumberOfPoints()
+     */
+    const double* GetField(unsigned handle) const
+    {
+        return mFields[handle];
+    }
+
+    /**
+     * Copy values into a field
+     * @param handle the field handle
+     * @param rValues the values, one per grid point
+     */
+    void SetField(unsigned handle, const std::vector<double>& rValues);
+
+    /**
+     * Copy a field into a new vector, for interfaces that need one
+     * @param handle the field handle
+     * @return a copy of the field values
+     */
+    std::vector<double> GetFieldVector(unsigned handle) const;
+};
+
+#endif /*FIELDREGISTRY_HPP_*/
@@ -38,20 +38,18 @@
 #include <vtkPointData.h>
 #include <vtkDoubleArray.h>
 #include <boost/lexical_cast.hpp>
-#include <muscle2/cppmuscle.hpp>
 #include "Exception.hpp"
 
 #include "MetabolicSimulation.hpp"
 
-using namespace muscle;
-
 MetabolicSimulation::MetabolicSimulation() : Simulation(),
         mMaxNutrient(40.0),
-        mMinNutrient(3.0)
+        mMinNutrient(3.0),
+        mNutrientHandle(0),
+        mProliferationRateFactorHandle(0)
 {
-    mMuscleInputSpatialParameters.push_back("proliferation_rate_factor");
-
-    //mMuscleOutputSpatialParameters.push_back("nutrient");
+    // The nutrient is received on its own conduit, see Receive()
+    mMuscleOutputSpatialParameters.push_back("proliferation_rate_factor");
 
     mFileInputSpatialParameters.push_back("proliferation_rate_factor");
 
@@ -63,11 +61,41 @@ MetabolicSimulation::~MetabolicSimulation()
 {
 }
 
+void MetabolicSimulation::Initialize()
+{
+    Simulation::Initialize();
+
+    mNutrientHandle = mFields.Register("nutrient");
+    mProliferationRateFactorHandle = mFields.Register("proliferation_rate_factor");
+    AddCoupledInput(mNutrientHandle);
+    ReleaseInputData();
+}
+
+void MetabolicSimulation::AddCheckpointParameters(std::map<std::string, double>& rParameters)
+{
+    rParameters["max_nutrient"] = mMaxNutrient;
+    rParameters["min_nutrient"] = mMinNutrient;
+    Simulation::AddCheckpointParameters(rParameters);
+}
+
+void MetabolicSimulation::LoadCheckpointParameters(const std::map<std::string, double>& rParameters)
+{
+    mMaxNutrient = GetParameter(rParameters, "max_nutrient");
+    mMinNutrient = GetParameter(rParameters, "min_nutrient");
+    Simulation::LoadCheckpointParameters(rParameters);
+}
+
 void MetabolicSimulation::Receive()
 {
-	Simulation::Receive();
+    if(mBatchedCoupling)
+    {
+        ReceiveMessage();
+        UnpackField(mNutrientHandle, "Nutrient");
+        return;
+    }
 
-    mSolutionVectors["nutrient"]= env::receiveDoubleVector("Nutrient_in");
+	Simulation::Receive();
+    ReceiveField(mNutrientHandle, "Nutrient");
 }
 
 void MetabolicSimulation::SetParameters(double maxNutrient, double minNutrient)
@@ -88,9 +116,12 @@ void MetabolicSimulation::Run()
     {
         if(!mStandalone)
         {
-            Receive();
+            UpdateCoupledInputs(mCurrentIncrement);
         }
 
+        const double* p_nutrient = mFields.GetField(mNutrientHandle);
+        double* p_proliferation_rate_factor = mFields.GetField(mProliferationRateFactorHandle);
+
         for(unsigned idx=0; idx<mGridSize[2]; idx++)
         {
             for(unsigned jdx=0; jdx<mGridSize[1]; jdx++)
@@ -100,7 +131,7 @@ void MetabolicSimulation::Run()
                     unsigned index = kdx + jdx * mGridSize[0] + idx * mGridSize[0] * mGridSize[1];
 
                     // If the point is in the tumour set the tumour flag
-                    double nutrient = mSolutionVectors["nutrient"][index];
+                    double nutrient = p_nutrient[index];
                     double proliferation_rate_factor = 1.0;
                     if(nutrient<mMaxNutrient)
                     {
@@ -113,7 +144,7 @@ void MetabolicSimulation::Run()
                             proliferation_rate_factor = (nutrient-mMinNutrient)/(mMaxNutrient-mMinNutrient);
                         }
                     }
-                    mSolutionVectors["proliferation_rate_factor"][index] = proliferation_rate_factor;
+                    p_proliferation_rate_factor[index] = proliferation_rate_factor;
                 }
             }
         }
@@ -121,29 +152,29 @@ void MetabolicSimulation::Run()
         // Write the output at the specified frequency
         if(mStandalone)
         {
-            if(!mOutputFile.empty())
-            {
-                std::string output_file = mOutputFile + "_metabolic_t_" + boost::lexical_cast<std::string>(mCurrentTime)+".vti";
-                WriteVtk(output_file);
-            }
-            else
-            {
-                EXCEPTION("Output file not specified.");
-            }
+            WriteOutput("metabolic", boost::lexical_cast<std::string>(mCurrentTime),
+                    double(mCurrentIncrement + 1) * mTargetTimeIncrement);
         }
 
-        if(!mStandalone)
+        if(!mStandalone && IsCouplingIncrement(mCurrentIncrement))
         {
             Send();
         }
 
+        RecordStatistics("metabolic", double(mCurrentIncrement + 1) * mTargetTimeIncrement);
+        mCurrentIncrement++;
+        CheckpointIfRequired();
+
         if(mStandalone)
         {
             end_comms = true;
         }
         else
         {
-            end_comms = env::has_next("Nutrient_in");
+            // Stop once the vessel component has sent its last nutrient field
+            end_comms = IsCouplingIncrement(mCurrentIncrement) &&
+                    !HasNextMessage(mBatchedCoupling ? "fields_in" : "Nutrient_in");
         }
     }
+    FlushOutput();
 }
@@ -53,6 +53,16 @@ class MetabolicSimulation : public Simulation
      */
     double mMinNutrient;
 
+    /**
+     * Nutrient field handle, resolved in Initialize()
+     */
+    unsigned mNutrientHandle;
+
+    /**
+     * Proliferation rate factor field handle
+     */
+    unsigned mProliferationRateFactorHandle;
+
 public:
 
     /**
@@ -79,6 +89,27 @@ public:
      * Run the simulation
      */
     void Run();
+
+protected:
+
+    /**
+     * Over-ridden to store the model parameters
+     * @param rParameters named values to be stored
+     */
+    void AddCheckpointParameters(std::map<std::string, double>& rParameters);
+
+    /**
+     * Over-ridden to restore the model parameters
+     * @param rParameters the stored named values
+     */
+    void LoadCheckpointParameters(const std::map<std::string, double>& rParameters);
+
+private:
+
+    /**
+     * Over-ridden initialize method
+     */
+    void Initialize();
 };
 
 #endif /*METABOLICSIMULATION_HPP_*/
@@ -33,18 +33,63 @@
 
  */
 
+#include <algorithm>
 #define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
 #include <vtkXMLImageDataReader.h>
-#include <vtkXMLImageDataWriter.h>
 #include <vtkPointData.h>
 #include <vtkCellData.h>
 #include <vtkDataArray.h>
 #include <vtkDoubleArray.h>
-#include <muscle2/cppmuscle.hpp>
+#include <vtkSetGet.h>
+#include <boost/bind.hpp>
 #include "Exception.hpp"
+#include "PetscTools.hpp"
+#include "MuscleCouplingTransport.hpp"
 
 #include "Simulation.hpp"
 
+namespace
+{
+    /**
+     * Copy a typed array into a double buffer
+     * @param pSource the source values
+     * @param numValues the number of values
+     * @param pDestination the destination buffer
+     */
+    template<typename TYPE>
+    void CopyValues(const TYPE* pSource, unsigned numValues, double* pDestination)
+    {
+        std::copy(pSource, pSource + numValues, pDestination);
+    }
+
+    /**
+     * Check whether a conduit has another message coming
+     * @param pTransport the transport
+     * @param rConduit the conduit
+     * @param rHasNext set to the result
+     */
+    void CheckHasNext(boost::shared_ptr<AbstractCouplingTransport> pTransport, const std::string& rConduit,
+                      bool& rHasNext)
+    {
+        rHasNext = pTransport->HasNext(rConduit);
+    }
+
+    /**
+     * Deleter for shared pointers holding a reference to a vtk object
+     */
+    struct VtkObjectReleaser
+    {
+        /**
+         * Release the reference
+         * @param pObject the vtk object
+         */
+        void operator()(vtkObjectBase* pObject) const
+        {
+            pObject->UnRegister(NULL);
+        }
+    };
+}
+
 Simulation::Simulation()
     : mInputFile(),
       mOutputFile(),
@@ -52,24 +97,63 @@ Simulation::Simulation()
       mEndTime(100.0),
       mTargetTimeIncrement(1.0),
       mCurrentTime(0.0),
+      mCurrentIncrement(0),
       mOutputFrequency(1),
       mGridSize(scalar_vector<unsigned>(3, 10)),
       mGridSpacing(1.0),
       mGridOrigin(zero_vector<double>(3)),
-      mpVtkSolution(),
-      mSolutionVectors(),
+      mpInputData(),
+      mpBinaryInput(),
+      mFields(),
       mStandalone(true),
       mNeighbours(),
       mFileInputSpatialParameters(),
       mFileOutputSpatialParameters(),
       mMuscleInputSpatialParameters(),
-      mMuscleOutputSpatialParameters()
+      mMuscleOutputSpatialParameters(),
+      mAsynchronousOutput(false),
+      mOutputViews(),
+      mBoundOutputViews(),
+      mOutputWriters(),
+      mOutputFormat(VTI_OUTPUT),
+      mTimeSeriesWriters(),
+      mTimeSeriesMutex(),
+      mImageWriter(),
+      mFieldOutput(true),
+      mStatisticsOutput(false),
+      mStatistics(),
+      mpStatisticsLog(),
+      mCheckpointFile(),
+      mCheckpointFrequency(1),
+      mRestartFile(),
+      mRestartTime(0.0),
+      mpCouplingTransport(new MuscleCouplingTransport),
+      mBatchedCoupling(false),
+      mOutgoingMessage(),
+      mIncomingMessage(),
+      mIncomingFields(),
+      mAsynchronousCoupling(false),
+      mpAsyncCoupling(),
+      mCouplingPeriod(1),
+      mInterpolationOrder(0),
+      mCoupledInputHandles(),
+      mInputHistories(),
+      mHeldInputs(),
+      mRegridInputs(false),
+      mPeerGridSize(scalar_vector<unsigned>(3, 10)),
+      mPeerGridSpacing(1.0),
+      mPeerGridOrigin(zero_vector<double>(3)),
+      mRegriddingMethods(),
+      mInputOperators(),
+      mPeerValues()
 {
 
 }
 
 Simulation::~Simulation()
 {
+    // The writer threads call back into this object, so stop them first
+    mOutputWriters.clear();
 }
 
 void Simulation::SetCurrentTime(double time)
@@ -146,6 +230,181 @@ void Simulation::SetOutputFrequency(unsigned outputFrequency)
     mOutputFrequency = outputFrequency;
 }
 
+void Simulation::SetAsynchronousOutput(bool asynchronousOutput)
+{
+    mAsynchronousOutput = asynchronousOutput;
+}
+
+void Simulation::SetOutputFormat(OutputFormat outputFormat)
+{
+    mOutputFormat = outputFormat;
+}
+
+void Simulation::SetVtkCodec(VtkCodec codec, int compressionLevel)
+{
+    mImageWriter = VtkImageWriter(codec, compressionLevel);
+}
+
+void Simulation::SetFieldOutput(bool fieldOutput)
+{
+    mFieldOutput = fieldOutput;
+}
+
+void Simulation::SetStatisticsOutput(bool statisticsOutput)
+{
+    mStatisticsOutput = statisticsOutput;
+}
+
+void Simulation::AddOutputRegion(const std::string& rName, const OutputRegion& rRegion,
+                                 const std::vector<std::string>& rFieldNames)
+{
+    for(unsigned idx=0; idx<mOutputViews.size(); idx++)
+    {
+        if(mOutputViews[idx]->rGetName() == rName)
+        {
+            EXCEPTION("An output region named " + rName + " has already been added");
+        }
+    }
+    const std::vector<std::string>& r_field_names = rFieldNames.empty() ? mFileOutputSpatialParameters : rFieldNames;
+    mOutputViews.push_back(boost::shared_ptr<OutputView>(new OutputView(rName, rRegion, r_field_names)));
+}
+
+void Simulation::SetCheckpointFile(const std::string& rCheckpointFile, unsigned checkpointFrequency)
+{
+    if(checkpointFrequency == 0)
+    {
+        EXCEPTION("Checkpoint frequency must be at least one increment");
+    }
+    mCheckpointFile = rCheckpointFile;
+    mCheckpointFrequency = checkpointFrequency;
+}
+
+void Simulation::SetRestartFile(const std::string& rRestartFile)
+{
+    mRestartFile = rRestartFile;
+}
+
+void Simulation::SetCouplingTransport(boost::shared_ptr<AbstractCouplingTransport> pTransport)
+{
+    mpCouplingTransport = pTransport;
+}
+
+void Simulation::SetBatchedCoupling(bool batchedCoupling)
+{
+    mBatchedCoupling = batchedCoupling;
+}
+
+void Simulation::SetFieldEncoding(const std::string& rName, FieldEncoding encoding, double errorBound)
+{
+    mOutgoingMessage.SetEncoding(rName, encoding, errorBound);
+}
+
+void Simulation::SetFieldEncodings(const std::vector<std::string>& rSpecifications)
+{
+    mOutgoingMessage.SetEncodings(rSpecifications);
+}
+
+void Simulation::SetCouplingCompression(bool compression)
+{
+    mOutgoingMessage.SetCompression(compression);
+}
+
+void Simulation::SetDeltaCoupling(bool delta, double tolerance)
+{
+    mOutgoingMessage.SetDeltaEncoding(delta, tolerance);
+}
+
+void Simulation::SetAsynchronousCoupling(bool asynchronousCoupling)
+{
+    mAsynchronousCoupling = asynchronousCoupling;
+}
+
+void Simulation::SetCouplingPeriod(unsigned period, unsigned interpolationOrder)
+{
+    if(period == 0)
+    {
+        EXCEPTION("Coupling period must be at least one increment");
+    }
+    if(interpolationOrder > 2)
+    {
+        EXCEPTION("Coupled fields can only be interpolated with order 0, 1 or 2");
+    }
+    mCouplingPeriod = period;
+    mInterpolationOrder = interpolationOrder;
+}
+
+void Simulation::SetHeldInput(const std::string& rName)
+{
+    mHeldInputs.insert(rName);
+}
+
+void Simulation::SetPeerGrid(const c_vector<unsigned, 3>& rSize, double spacing, const c_vector<double, 3>& rOrigin)
+{
+    mRegridInputs = true;
+    mPeerGridSize = rSize;
+    mPeerGridSpacing = spacing;
+    mPeerGridOrigin = rOrigin;
+    mInputOperators.clear();
+}
+
+void Simulation::SetRegridding(const std::string& rName, RegriddingMethod method)
+{
+    mRegriddingMethods[rName] = method;
+    mInputOperators.erase(rName);
+}
+
+bool Simulation::IsRestart() const
+{
+    return !mRestartFile.empty();
+}
+
+void Simulation::AddCheckpointParameters(std::map<std::string, double>& rParameters)
+{
+    rParameters["current_time"] = mCurrentTime;
+    rParameters["current_increment"] = mCurrentIncrement;
+    rParameters["target_time_increment"] = mTargetTimeIncrement;
+}
+
+void Simulation::LoadCheckpointParameters(const std::map<std::string, double>& rParameters)
+{
+    // End time and increment limits are left alone so that a restart can extend a run
+    mCurrentTime = GetParameter(rParameters, "current_time");
+    mCurrentIncrement = unsigned(GetParameter(rParameters, "current_increment"));
+    mTargetTimeIncrement = GetParameter(rParameters, "target_time_increment");
+}
+
+double Simulation::GetParameter(const std::map<std::string, double>& rParameters, const std::string& rName)
+{
+    std::map<std::string, double>::const_iterator it = rParameters.find(rName);
+    if(it == rParameters.end())
+    {
+        EXCEPTION("Checkpoint does not contain the parameter " + rName);
+    }
+    return it->second;
+}
+
+void Simulation::CheckpointIfRequired()
+{
+    if(!mCheckpointFile.empty() && mCurrentIncrement % mCheckpointFrequency == 0)
+    {
+        WriteCheckpoint();
+    }
+}
+
+void Simulation::WriteCheckpoint()
+{
+    std::map<std::string, double> parameters;
+    AddCheckpointParameters(parameters);
+
+    std::vector<const double*> arrays;
+    for(unsigned handle=0; handle<mFields.GetNumberOfFields(); handle++)
+    {
+        arrays.push_back(mFields.GetField(handle));
+    }
+    BinaryFieldFile::Write(mCheckpointFile, mGridSize, mGridSpacing, mGridOrigin,
+            parameters, mFields.rGetNames(), arrays);
+}
+
 vtkSmartPointer<vtkImageData> Simulation::ReadVtk(const std::string& rFilename)
 {
     if(rFilename.empty())
@@ -170,36 +429,297 @@ vtkSmartPointer<vtkImageData> Simulation::ReadVtk(const std::string& rFilename)
 
 void Simulation::Send()
 {
-    // Send data with muscle
+    if(mBatchedCoupling)
+    {
+        rPackOutputFields();
+        SendMessage();
+        return;
+    }
+
+    // Send each field on its own conduit
+    unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
     for(unsigned idx=0;idx<mMuscleOutputSpatialParameters.size();idx++)
     {
-        muscle::env::sendDoubleVector(mMuscleOutputSpatialParameters[idx] + "_out",
-                mSolutionVectors[mMuscleOutputSpatialParameters[idx]]);
+        unsigned handle = mFields.GetHandle(mMuscleOutputSpatialParameters[idx]);
+        mpCouplingTransport->SendField(mMuscleOutputSpatialParameters[idx] + "_out",
+                mFields.GetField(handle), num_points);
     }
 }
 
 void Simulation::Receive()
 {
-    // Take in any data from muscle
+    if(mBatchedCoupling)
+    {
+        ReceiveMessage();
+        return;
+    }
+
+    // Take in each field from its own conduit
+    for(unsigned idx=0; idx<mMuscleInputSpatialParameters.size(); idx++)
+    {
+        ReceiveField(mFields.GetHandle(mMuscleInputSpatialParameters[idx]), mMuscleInputSpatialParameters[idx]);
+    }
+}
+
+void Simulation::ReceiveField(unsigned handle, const std::string& rName)
+{
+    if(mpCouplingTransport->HandsOverFields())
+    {
+        unsigned num_values = mRegridInputs ? rGetInputOperator(rName).GetNumberOfSourcePoints() :
+                mGridSize[0] * mGridSize[1] *mGridSize[2];
+        AdoptReceivedField(handle, rName, mpCouplingTransport->ReceiveFieldBuffer(rName + "_in", num_values));
+        return;
+    }
+
+    if(!mRegridInputs)
+    {
+        unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+        mpCouplingTransport->ReceiveField(rName + "_in", mFields.GetField(handle), num_points);
+        return;
+    }
+
+    const RegriddingOperator& r_operator = rGetInputOperator(rName);
+    mPeerValues.resize(r_operator.GetNumberOfSourcePoints());
+    mpCouplingTransport->ReceiveField(rName + "_in", mPeerValues.empty() ? NULL : &mPeerValues[0], mPeerValues.size());
+    r_operator.Apply(mPeerValues.empty() ? NULL : &mPeerValues[0], mFields.GetField(handle));
+}
+
+const RegriddingOperator& Simulation::rGetInputOperator(const std::string& rName)
+{
+    std::map<std::string, RegriddingOperator>::iterator it = mInputOperators.find(rName);
+    if(it == mInputOperators.end())
+    {
+        std::map<std::string, RegriddingMethod>::const_iterator method_it = mRegriddingMethods.find(rName);
+        RegriddingMethod method = method_it == mRegriddingMethods.end() ? TRILINEAR_REGRIDDING : method_it->second;
+        it = mInputOperators.insert(std::make_pair(rName, RegriddingOperator(method,
+                mPeerGridSize, mPeerGridSpacing, mPeerGridOrigin, mGridSize, mGridSpacing, mGridOrigin))).first;
+    }
+    return it->second;
+}
+
+bool Simulation::IsCouplingIncrement(unsigned increment) const
+{
+    return increment % mCouplingPeriod == 0;
+}
+
+void Simulation::UpdateCoupledInputs(unsigned increment)
+{
+    double time = double(increment) * mTargetTimeIncrement;
+    if(IsCouplingIncrement(increment))
+    {
+        Receive();
+
+        // Only kept if there are increments to interpolate
+        if(mCouplingPeriod > 1)
+        {
+            unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+            for(unsigned idx=mInputHistories.size(); idx<mCoupledInputHandles.size(); idx++)
+            {
+                bool held = mHeldInputs.count(mFields.rGetName(mCoupledInputHandles[idx])) > 0;
+                mInputHistories.push_back(TemporalInterpolator(held ? 0 : mInterpolationOrder));
+            }
+            for(unsigned idx=0; idx<mCoupledInputHandles.size(); idx++)
+            {
+                mInputHistories[idx].AddSnapshot(time, mFields.GetField(mCoupledInputHandles[idx]), num_points);
+            }
+        }
+    }
+    else
+    {
+        for(unsigned idx=0; idx<mInputHistories.size(); idx++)
+        {
+            mInputHistories[idx].Interpolate(time, mFields.GetField(mCoupledInputHandles[idx]));
+        }
+    }
+}
+
+void Simulation::AddCoupledInput(unsigned handle)
+{
+    mCoupledInputHandles.push_back(handle);
+}
+
+CouplingMessage& Simulation::rPackOutputFields()
+{
+    // Fields listed twice are only sent once
     unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    mOutgoingMessage.Clear();
+    for(unsigned idx=0; idx<mMuscleOutputSpatialParameters.size(); idx++)
+    {
+        const std::string& r_name = mMuscleOutputSpatialParameters[idx];
+        mOutgoingMessage.AddField(r_name, mFields.GetField(mFields.GetHandle(r_name)), num_points);
+    }
+    return mOutgoingMessage;
+}
+
+void Simulation::SendMessage()
+{
+    // Encodings only apply to packed messages, handed over fields are sent exactly
+    if(mpCouplingTransport->HandsOverFields())
+    {
+        mpCouplingTransport->SendFields("fields_out", mOutgoingMessage.rGetAddedFieldNames(),
+                mOutgoingMessage.rGetAddedFieldValues(), mOutgoingMessage.GetNumberOfValues());
+        return;
+    }
+
+    const std::vector<char>& r_buffer = mOutgoingMessage.rPack();
+    if(mpAsyncCoupling)
+    {
+        mpAsyncCoupling->PostSend(r_buffer);
+    }
+    else
+    {
+        mpCouplingTransport->SendMessage("fields_out", r_buffer);
+    }
+}
+
+void Simulation::ReceiveMessage()
+{
+    if(mpCouplingTransport->HandsOverFields())
+    {
+        mpCouplingTransport->ReceiveFields("fields_in", mIncomingFields);
+    }
+    else
+    {
+        std::vector<char> buffer;
+        if(mpAsyncCoupling)
+        {
+            PrefetchMessage();
+            mpAsyncCoupling->WaitForReceive(buffer);
+        }
+        else
+        {
+            mpCouplingTransport->ReceiveMessage("fields_in", buffer);
+        }
+        mIncomingMessage.Unpack(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    }
+
     for(unsigned idx=0; idx<mMuscleInputSpatialParameters.size(); idx++)
     {
-        std::vector<double> incoming_vector = muscle::env::receiveDoubleVector(mMuscleInputSpatialParameters[idx] + "_in");
-        if(incoming_vector.size() != num_points)
+        const std::string& r_name = mMuscleInputSpatialParameters[idx];
+        UnpackField(mFields.GetHandle(r_name), r_name);
+    }
+}
+
+void Simulation::PrefetchMessage()
+{
+    if(mpAsyncCoupling && mpAsyncCoupling->GetNumberOfPendingReceives() == 0)
+    {
+        mpAsyncCoupling->PostReceive();
+    }
+}
+
+bool Simulation::HasNextMessage(const std::string& rConduit)
+{
+    // With a communication thread the transport must only be used from that thread
+    bool has_next = false;
+    if(mpAsyncCoupling)
+    {
+        mpAsyncCoupling->Call(boost::bind(&CheckHasNext, mpCouplingTransport, rConduit, boost::ref(has_next)));
+    }
+    else
+    {
+        has_next = mpCouplingTransport->HasNext(rConduit);
+    }
+    return has_next;
+}
+
+void Simulation::UnpackField(unsigned handle, const std::string& rName)
+{
+    if(mpCouplingTransport->HandsOverFields())
+    {
+        std::map<std::string, boost::shared_ptr<FieldBuffer> >::const_iterator it = mIncomingFields.find(rName);
+        if(it == mIncomingFields.end())
         {
-            EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+            EXCEPTION("Coupling message does not contain the field " + rName);
         }
-        mSolutionVectors[mMuscleInputSpatialParameters[idx]]=incoming_vector;
+        AdoptReceivedField(handle, rName, it->second);
+        return;
+    }
+
+    unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    const RegriddingOperator* p_operator = mRegridInputs ? &rGetInputOperator(rName) : NULL;
+    if(mIncomingMessage.GetNumberOfValues() != (p_operator ? p_operator->GetNumberOfSourcePoints() : num_points))
+    {
+        EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+    }
+    if(!p_operator)
+    {
+        mIncomingMessage.CopyField(rName, mFields.GetField(handle));
+        return;
+    }
+
+    mPeerValues.resize(p_operator->GetNumberOfSourcePoints());
+    mIncomingMessage.CopyField(rName, mPeerValues.empty() ? NULL : &mPeerValues[0]);
+    p_operator->Apply(mPeerValues.empty() ? NULL : &mPeerValues[0], mFields.GetField(handle));
+}
+
+void Simulation::AdoptReceivedField(unsigned handle, const std::string& rName, boost::shared_ptr<FieldBuffer> pBuffer)
+{
+    unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    const RegriddingOperator* p_operator = mRegridInputs ? &rGetInputOperator(rName) : NULL;
+    if(pBuffer->GetNumberOfValues() != (p_operator ? p_operator->GetNumberOfSourcePoints() : num_points))
+    {
+        EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+    }
+
+    // The previous buffer goes back to the sender's pool once nothing else refers to it
+    if(!p_operator)
+    {
+        mFields.Adopt(handle, pBuffer->GetData(), pBuffer);
+        return;
+    }
+    p_operator->Apply(pBuffer->GetData(), mFields.GetField(handle));
+}
+
+void Simulation::GetLocalPoints(unsigned& rStart, unsigned& rEnd) const
+{
+    unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    rStart = 0;
+    rEnd = num_points;
+    if(!mStandalone)
+    {
+        GridDecomposition decomposition = mpCouplingTransport->GetDecomposition(num_points);
+        rStart = decomposition.GetStart(PetscTools::GetMyRank());
+        rEnd = decomposition.GetEnd(PetscTools::GetMyRank());
     }
 }
 
 void Simulation::Initialize()
 {
-    vtkSmartPointer<vtkImageData> p_input_data;
-    if(mStandalone)
+    // Any pending output refers to the old fields
+    mOutputWriters.clear();
+    mTimeSeriesWriters.clear();
+    mpStatisticsLog.reset();
+    mCurrentIncrement = 0;
+    mpAsyncCoupling.reset();
+    // Handing fields over is only a queue operation, so it isn't worth a thread
+    if(!mStandalone && mAsynchronousCoupling && !mpCouplingTransport->HandsOverFields())
     {
-        // Read any spatial input data from file
-        p_input_data = ReadVtk(mInputFile);
+        mpAsyncCoupling.reset(new AsyncCoupling(
+                boost::bind(&AbstractCouplingTransport::SendMessage, mpCouplingTransport, std::string("fields_out"), _1),
+                boost::bind(&AbstractCouplingTransport::ReceiveMessage, mpCouplingTransport, std::string("fields_in"), _1)));
+    }
+
+    // A checkpoint defines the grid and replaces any input file
+    boost::shared_ptr<BinaryFieldFile> p_restart_data;
+    if(IsRestart())
+    {
+        p_restart_data.reset(new BinaryFieldFile(mRestartFile));
+        mGridSize = p_restart_data->GetGridSize();
+        mGridSpacing = p_restart_data->GetGridSpacing();
+        mGridOrigin = p_restart_data->GetGridOrigin();
+    }
+    else if(mStandalone && GetBinaryInput())
+    {
+        // Only the tables are read here, array pages are loaded when fields first touch them
+        mGridSize = mpBinaryInput->GetGridSize();
+        mGridSpacing = mpBinaryInput->GetGridSpacing();
+        mGridOrigin = mpBinaryInput->GetGridOrigin();
+    }
+    else if(mStandalone)
+    {
+        // Read any spatial input data from file. The image is kept for subclasses.
+        vtkSmartPointer<vtkImageData> p_input_data = GetInputData();
 
         // Set up the grid
         for(unsigned idx=0;idx<3;idx++)
@@ -210,46 +730,166 @@ void Simulation::Initialize()
         mGridSpacing = p_input_data->GetSpacing()[0];
     }
 
-    // Set up the vtk solution data
-    mpVtkSolution = vtkSmartPointer<vtkImageData>::New();
-    mpVtkSolution->SetOrigin(mGridOrigin[0], mGridOrigin[1], mGridOrigin[2]);
-    mpVtkSolution->SetSpacing(mGridSpacing, mGridSpacing, mGridSpacing);
-    mpVtkSolution->SetDimensions(mGridSize[0], mGridSize[1], mGridSize[2]);
-
-    // Populate the solution vectors
+    // Register the solution fields. Everything named in the configuration gets
+    // storage here, so later lookups can be done by handle.
     unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    mFields.Reset(num_points);
     for(unsigned idx=0; idx < mFileOutputSpatialParameters.size(); idx++)
     {
-        vtkSmartPointer<vtkDoubleArray> p_point_data = vtkSmartPointer<vtkDoubleArray>::New();
-        p_point_data->SetNumberOfComponents(1);
-        p_point_data->SetNumberOfTuples(num_points);
-        p_point_data->SetName(mFileOutputSpatialParameters[idx].c_str());
-        mpVtkSolution->GetPointData()->AddArray(p_point_data);
-        mSolutionVectors[mFileOutputSpatialParameters[idx]] = std::vector<double>(num_points, 0.0);
+        mFields.Register(mFileOutputSpatialParameters[idx]);
+    }
+    for(unsigned idx=0; idx < mFileInputSpatialParameters.size(); idx++)
+    {
+        mFields.Register(mFileInputSpatialParameters[idx]);
+    }
+    mCoupledInputHandles.clear();
+    mInputHistories.clear();
+    mInputOperators.clear();
+    for(unsigned idx=0; idx < mMuscleInputSpatialParameters.size(); idx++)
+    {
+        mCoupledInputHandles.push_back(mFields.Register(mMuscleInputSpatialParameters[idx]));
+    }
+    for(unsigned idx=0; idx < mMuscleOutputSpatialParameters.size(); idx++)
+    {
+        mFields.Register(mMuscleOutputSpatialParameters[idx]);
     }
 
-    if(mStandalone)
+    if(p_restart_data)
     {
-        // Set all required data based on VTK file values
+        // Fields adopt the mapped arrays, pages are only read when first touched
+        for(unsigned idx=0; idx<p_restart_data->rGetArrayNames().size(); idx++)
+        {
+            const std::string& r_name = p_restart_data->rGetArrayNames()[idx];
+            mFields.Adopt(mFields.Register(r_name), p_restart_data->GetArray(r_name), p_restart_data);
+        }
+        LoadCheckpointParameters(p_restart_data->rGetScalars());
+
+        // Output steps are timed at the end of their increment
+        mRestartTime = double(mCurrentIncrement) * mTargetTimeIncrement;
+    }
+    else if(mStandalone)
+    {
+        // Set all required data based on input file values, fields missing from the file stay at zero
         for(unsigned idx=0; idx<mFileInputSpatialParameters.size(); idx++)
         {
-            if(p_input_data->GetPointData()->HasArray(mFileInputSpatialParameters[idx].c_str()))
+            const char* p_name = mFileInputSpatialParameters[idx].c_str();
+            if(mpBinaryInput ? mpBinaryInput->HasArray(p_name) : mpInputData->GetPointData()->HasArray(p_name))
             {
-                std::vector<double> point_values(num_points);
-                vtkSmartPointer<vtkDataArray> p_point_data =
-                        p_input_data->GetPointData()->GetArray(mFileInputSpatialParameters[idx].c_str());
-                for(unsigned jdx=0; jdx<num_points; jdx++)
-                {
-                    point_values[jdx] = p_point_data->GetTuple1(jdx);
-                }
-                mSolutionVectors[mFileInputSpatialParameters[idx]] = point_values;
+                LoadInputField(mFields.GetHandle(mFileInputSpatialParameters[idx]));
             }
-            else
+        }
+    }
+
+    // Bind the output last, loading input may have replaced field buffers
+    BindVtkSolution();
+}
+
+vtkSmartPointer<vtkImageData> Simulation::GetInputData()
+{
+    if(!mpInputData)
+    {
+        mpInputData = ReadVtk(mInputFile);
+    }
+    return mpInputData;
+}
+
+boost::shared_ptr<BinaryFieldFile> Simulation::GetBinaryInput()
+{
+    if(!mpBinaryInput && !mInputFile.empty() && BinaryFieldFile::IsBinaryFieldFile(mInputFile))
+    {
+        mpBinaryInput.reset(new BinaryFieldFile(mInputFile));
+    }
+    return mpBinaryInput;
+}
+
+void Simulation::ReleaseInputData()
+{
+    mpInputData = NULL;
+    mpBinaryInput.reset();
+}
+
+vtkSmartPointer<vtkDataArray> Simulation::GetInputArray(const std::string& rName)
+{
+    vtkSmartPointer<vtkDataArray> p_array = GetInputData()->GetPointData()->GetArray(rName.c_str());
+    if(!p_array)
+    {
+        EXCEPTION("Input file does not contain the array " + rName);
+    }
+    if(p_array->GetNumberOfComponents() != 1)
+    {
+        EXCEPTION("Input array " + rName + " should have a single component");
+    }
+    if(p_array->GetNumberOfTuples() != vtkIdType(mGridSize[0] * mGridSize[1] * mGridSize[2]))
+    {
+        EXCEPTION("Number of points in input array " + rName + " does not match number of points in grid");
+    }
+    return p_array;
+}
+
+void Simulation::ReadInputArray(const std::string& rName, double* pDestination)
+{
+    if(GetBinaryInput())
+    {
+        if(mpBinaryInput->GetNumberOfValues() != mGridSize[0] * mGridSize[1] * mGridSize[2])
+        {
+            EXCEPTION("Number of points in input array " + rName + " does not match number of points in grid");
+        }
+        const double* p_values = mpBinaryInput->GetArray(rName);
+        std::copy(p_values, p_values + mpBinaryInput->GetNumberOfValues(), pDestination);
+        return;
+    }
+
+    vtkSmartPointer<vtkDataArray> p_array = GetInputArray(rName);
+    unsigned num_values = p_array->GetNumberOfTuples();
+
+    // One typed bulk copy rather than a virtual GetTuple1 per point
+    switch(p_array->GetDataType())
+    {
+        vtkTemplateMacro(CopyValues(static_cast<const VTK_TT*>(p_array->GetVoidPointer(0)), num_values, pDestination));
+        default:
+            for(unsigned idx=0; idx<num_values; idx++)
             {
-                std::vector<double> point_values(num_points, 0.0);
-                mSolutionVectors[mFileInputSpatialParameters[idx]] = point_values;
+                pDestination[idx] = p_array->GetTuple1(idx);
             }
-        }
+    }
+}
+
+void Simulation::LoadInputField(unsigned handle)
+{
+    if(GetBinaryInput())
+    {
+        // The mapping is private so the field can be updated in place. The registry keeps it alive.
+        mFields.Adopt(handle, mpBinaryInput->GetArray(mFields.rGetName(handle)), mpBinaryInput);
+        return;
+    }
+
+    vtkSmartPointer<vtkDataArray> p_array = GetInputArray(mFields.rGetName(handle));
+    void* p_values = p_array->GetVoidPointer(0);
+    if(p_array->GetDataType() == VTK_DOUBLE && FieldRegistry::IsAligned(p_values))
+    {
+        // Adopt the decoded buffer. The registry holds a reference to the array.
+        p_array->Register(NULL);
+        mFields.Adopt(handle, static_cast<double*>(p_values),
+                boost::shared_ptr<void>(p_array.GetPointer(), VtkObjectReleaser()));
+    }
+    else
+    {
+        ReadInputArray(mFields.rGetName(handle), mFields.GetField(handle));
+    }
+}
+
+void Simulation::BindVtkSolution()
+{
+    // Without any regions the whole grid is written, in a view that wraps the field buffers
+    mBoundOutputViews = mOutputViews;
+    if(mBoundOutputViews.empty())
+    {
+        mBoundOutputViews.push_back(boost::shared_ptr<OutputView>(
+                new OutputView("", OutputRegion(), mFileOutputSpatialParameters)));
+    }
+    for(unsigned idx=0; idx < mBoundOutputViews.size(); idx++)
+    {
+        mBoundOutputViews[idx]->Bind(mFields, mGridSize, mGridSpacing, mGridOrigin);
     }
 }
 
@@ -258,7 +898,81 @@ void Simulation::SetIsStandalone(bool standalone)
     mStandalone = standalone;
 }
 
-void Simulation::WriteVtk(const std::string& rFilename)
+void Simulation::AddStatistics(FieldStatistics& rStatistics)
+{
+    for(unsigned idx=0; idx<mFileOutputSpatialParameters.size(); idx++)
+    {
+        rStatistics.AddSummary(mFileOutputSpatialParameters[idx]);
+    }
+    if(mFields.HasField("stimulus"))
+    {
+        rStatistics.AddHistogram("stimulus", 0.0, 1.0, 10);
+    }
+    if(mFields.HasField("vessel") && mFields.HasField("tumour"))
+    {
+        rStatistics.AddMaskedMean("vessel", "tumour");
+    }
+    if(mFields.HasField("necrotic") && mFields.HasField("tumour"))
+    {
+        rStatistics.AddFraction("necrotic_fraction", "necrotic", "tumour");
+    }
+}
+
+void Simulation::RecordStatistics(const std::string& rComponentName, double time)
+{
+    if(!mStatisticsOutput)
+    {
+        return;
+    }
+    if(mOutputFile.empty())
+    {
+        EXCEPTION("Output file not specified.");
+    }
+
+    // Set up on the first step, once subclasses have registered their fields
+    if(!mpStatisticsLog)
+    {
+        mStatistics = FieldStatistics();
+        AddStatistics(mStatistics);
+        mStatistics.Bind(mFields, mGridSpacing * mGridSpacing * mGridSpacing);
+    }
+    std::vector<double> row(1, time);
+    std::vector<double> values = mStatistics.Compute();
+    row.insert(row.end(), values.begin(), values.end());
+
+    // ColumnarLog takes the HDF5 lock itself, as output threads may be writing HDF5 files
+    if(!mpStatisticsLog)
+    {
+        std::vector<std::string> column_names(1, "time");
+        column_names.insert(column_names.end(), mStatistics.rGetColumnNames().begin(), mStatistics.rGetColumnNames().end());
+        mpStatisticsLog.reset(new ColumnarLog(mOutputFile + "_" + rComponentName + "_statistics.h5",
+                column_names, IsRestart()));
+    }
+    mpStatisticsLog->AppendRow(row);
+}
+
+void Simulation::WriteOutput(const std::string& rComponentName, const std::string& rStepLabel, double time)
+{
+    if(mOutputFile.empty())
+    {
+        EXCEPTION("Output file not specified.");
+    }
+    if(!mFieldOutput)
+    {
+        return;
+    }
+
+    if(mOutputFormat == HDF5_OUTPUT)
+    {
+        WriteVtk(mOutputFile + "_" + rComponentName + ".h5", time);
+    }
+    else
+    {
+        WriteVtk(mOutputFile + "_" + rComponentName + "_t_" + rStepLabel + ".vti", time);
+    }
+}
+
+void Simulation::WriteVtk(const std::string& rFilename, double time)
 {
     if(rFilename.empty())
     {
@@ -267,39 +981,97 @@ void Simulation::WriteVtk(const std::string& rFilename)
 
     double num_grid_points = mGridSize[0]*mGridSize[1]*mGridSize[2];
 
-    // Update the vtk solution
-    for(unsigned idx=0; idx< mFileOutputSpatialParameters.size(); idx++)
+    if(mFields.GetNumberOfPoints()!= num_grid_points)
+    {
+        EXCEPTION("Number of grid points differs from the size of the solution vector");
+    }
+
+    if(mAsynchronousOutput && mOutputWriters.empty())
+    {
+        for(unsigned idx=0; idx< mBoundOutputViews.size(); idx++)
+        {
+            mOutputWriters.push_back(boost::shared_ptr<AsyncOutputWriter>(
+                    new AsyncOutputWriter(mBoundOutputViews[idx]->GetImage(), mBoundOutputViews[idx]->rGetFieldNames(),
+                            boost::bind(&Simulation::WriteImage, this, _1, _2, _3))));
+        }
+    }
+
+    for(unsigned idx=0; idx< mBoundOutputViews.size(); idx++)
     {
-        if(mSolutionVectors[mFileOutputSpatialParameters[idx]].size()!= num_grid_points)
+        OutputView& r_view = *mBoundOutputViews[idx];
+        r_view.Update();
+        if(mAsynchronousOutput)
+        {
+            mOutputWriters[idx]->Post(r_view.GetFilename(rFilename), time, r_view.GetValues());
+        }
+        else
         {
-            EXCEPTION("Number of grid points differs from the size of the solution vector");
+            WriteImage(r_view.GetImage(), r_view.GetFilename(rFilename), time);
         }
+    }
+}
 
-        if(mpVtkSolution->GetPointData()->GetArray(mFileOutputSpatialParameters[idx].c_str())->GetNumberOfTuples()!=num_grid_points)
+void Simulation::WriteImage(vtkImageData* pImage, const std::string& rFilename, double time)
+{
+    if(mOutputFormat == HDF5_OUTPUT)
+    {
+        // The file layout comes from the image, as views of the grid differ
+        std::vector<std::string> names;
+        std::vector<const double*> fields;
+        vtkPointData* p_point_data = pImage->GetPointData();
+        for(int idx=0; idx< p_point_data->GetNumberOfArrays(); idx++)
         {
-            EXCEPTION("Number of grid points differs from the size of the vtk solution vector");
+            names.push_back(p_point_data->GetArrayName(idx));
+            fields.push_back(vtkDoubleArray::SafeDownCast(p_point_data->GetArray(idx))->GetPointer(0));
         }
 
-        for(unsigned jdx=0; jdx<num_grid_points; jdx++)
+        std::lock_guard<std::mutex> lock(mTimeSeriesMutex);
+        boost::shared_ptr<Hdf5TimeSeriesWriter>& rp_writer = mTimeSeriesWriters[rFilename];
+        if(!rp_writer)
         {
-            double solution = mSolutionVectors[mFileOutputSpatialParameters[idx]][jdx];
-            mpVtkSolution->GetPointData()->GetArray(mFileOutputSpatialParameters[idx].c_str())->SetTuple1(jdx, solution);
+            // A restarted run adds to the file written up to the checkpoint
+            c_vector<unsigned, 3> size;
+            c_vector<double, 3> origin;
+            for(unsigned idx=0; idx<3; idx++)
+            {
+                size[idx] = pImage->GetDimensions()[idx];
+                origin[idx] = pImage->GetOrigin()[idx];
+            }
+            rp_writer.reset(new Hdf5TimeSeriesWriter(rFilename, size, pImage->GetSpacing()[0], origin,
+                    names, IsRestart(), 1, mRestartTime));
         }
+        rp_writer->WriteStep(time, fields);
+        return;
     }
 
-    vtkSmartPointer<vtkXMLImageDataWriter> p_image_data_writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
-    p_image_data_writer->SetFileName(rFilename.c_str());
-    p_image_data_writer->SetInputData(mpVtkSolution);
-    //p_image_data_writer->SetInput(mpVtkSolution);
-    p_image_data_writer->Update();
+    mImageWriter.Write(pImage, rFilename);
+}
 
-    try
+void Simulation::FlushOutput()
+{
+    // Outgoing coupling messages are output too
+    if(mpAsyncCoupling)
     {
-        p_image_data_writer->Write();
+        mpAsyncCoupling->Flush();
     }
-    catch(...)
+
+    for(unsigned idx=0; idx<mOutputWriters.size(); idx++)
     {
-        EXCEPTION("Error writing to VTK file.");
+        mOutputWriters[idx]->Flush();
     }
-}
 
+    if(mpStatisticsLog)
+    {
+        mpStatisticsLog->Close();
+        mpStatisticsLog.reset();
+    }
+
+    // Closing writes the XDMF sidecars
+    std::lock_guard<std::mutex> lock(mTimeSeriesMutex);
+    std::map<std::string, boost::shared_ptr<Hdf5TimeSeriesWriter> >::iterator it;
+    for(it = mTimeSeriesWriters.begin(); it != mTimeSeriesWriters.end(); ++it)
+    {
+        it->second->Close();
+    }
+    mTimeSeriesWriters.clear();
+}
@@ -39,11 +39,28 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
+#include <mutex>
 #define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
 #include <vtkSmartPointer.h>
 #include <vtkImageData.h>
+#include <vtkDataArray.h>
 #include "SmartPointers.hpp"
 #include "UblasVectorInclude.hpp"
+#include "FieldRegistry.hpp"
+#include "AsyncOutputWriter.hpp"
+#include "BinaryFieldFile.hpp"
+#include "Hdf5TimeSeriesWriter.hpp"
+#include "OutputFormat.hpp"
+#include "VtkImageWriter.hpp"
+#include "OutputView.hpp"
+#include "FieldStatistics.hpp"
+#include "ColumnarLog.hpp"
+#include "CouplingMessage.hpp"
+#include "AsyncCoupling.hpp"
+#include "AbstractCouplingTransport.hpp"
+#include "TemporalInterpolator.hpp"
+#include "RegriddingOperator.hpp"
 
 /**
  * Base simulation class with common functionality for vessel and
@@ -84,6 +101,11 @@ protected:
 	 */
     double mCurrentTime;
 
+	/**
+	 * The number of time increments completed
+	 */
+    unsigned mCurrentIncrement;
+
 	/**
 	 * The frequency of simulaion output
 	 */
@@ -105,14 +127,19 @@ protected:
     c_vector<double, 3> mGridOrigin;
 
 	/**
-	 * The solution in vtk form for output
+	 * The input image, read once and shared between base and subclass initialization
 	 */
-    vtkSmartPointer<vtkImageData> mpVtkSolution;
+    vtkSmartPointer<vtkImageData> mpInputData;
 
 	/**
-	 * The solutions keyed with a Field name
+	 * The input file when it is a pre-processed binary field file, mapped on first use
 	 */
-    std::map<std::string, std::vector<double> > mSolutionVectors;
+    boost::shared_ptr<BinaryFieldFile> mpBinaryInput;
+
+	/**
+	 * The solution fields. Kernels should resolve handles once and work on the raw buffers.
+	 */
+    FieldRegistry mFields;
 
 	/**
 	 * Should be run in standalone mode, or with Muscle
@@ -144,6 +171,184 @@ protected:
      */
     std::vector<std::string> mMuscleOutputSpatialParameters;
 
+    /**
+     * Whether to write output on a background thread
+     */
+    bool mAsynchronousOutput;
+
+    /**
+     * Output views added with AddOutputRegion(). The whole grid is written if there are none.
+     */
+    std::vector<boost::shared_ptr<OutputView> > mOutputViews;
+
+    /**
+     * The views written, bound to the solution fields in Initialize()
+     */
+    std::vector<boost::shared_ptr<OutputView> > mBoundOutputViews;
+
+    /**
+     * Background output writers, one per bound view, created on the first asynchronous write
+     */
+    std::vector<boost::shared_ptr<AsyncOutputWriter> > mOutputWriters;
+
+    /**
+     * The output format
+     */
+    OutputFormat mOutputFormat;
+
+    /**
+     * HDF5 output files keyed by path, each created on its first write
+     */
+    std::map<std::string, boost::shared_ptr<Hdf5TimeSeriesWriter> > mTimeSeriesWriters;
+
+    /**
+     * Guards the HDF5 output files, which may be written from several writer threads.
+     * Calls into HDF5 itself are serialised by Hdf5Lock.
+     */
+    std::mutex mTimeSeriesMutex;
+
+    /**
+     * Writes VTK image output with the selected codec
+     */
+    VtkImageWriter mImageWriter;
+
+    /**
+     * Whether to write fields at output steps
+     */
+    bool mFieldOutput;
+
+    /**
+     * Whether to log statistics of the fields every step
+     */
+    bool mStatisticsOutput;
+
+    /**
+     * The statistics logged each step, set up on the first step
+     */
+    FieldStatistics mStatistics;
+
+    /**
+     * The statistics log, created on the first step
+     */
+    boost::shared_ptr<ColumnarLog> mpStatisticsLog;
+
+    /**
+     * The path to write checkpoints to, no checkpoints are written if empty
+     */
+    std::string mCheckpointFile;
+
+    /**
+     * The number of increments between checkpoints
+     */
+    unsigned mCheckpointFrequency;
+
+    /**
+     * The path to a checkpoint to restart from, if not empty
+     */
+    std::string mRestartFile;
+
+    /**
+     * The time of the last output step before the checkpoint restarted from
+     */
+    double mRestartTime;
+
+    /**
+     * Carries coupling data to the other components, through MUSCLE unless another transport is set
+     */
+    boost::shared_ptr<AbstractCouplingTransport> mpCouplingTransport;
+
+    /**
+     * Whether coupled fields are exchanged in one message per step rather than one per field
+     */
+    bool mBatchedCoupling;
+
+    /**
+     * The outgoing coupling message, kept between steps to reuse its buffer and hold
+     * the fields as last sent
+     */
+    CouplingMessage mOutgoingMessage;
+
+    /**
+     * The incoming coupling message, kept between steps to hold the fields as last received
+     */
+    CouplingMessage mIncomingMessage;
+
+    /**
+     * The fields handed over in the last coupling message, by name, if the transport hands over fields
+     */
+    std::map<std::string, boost::shared_ptr<FieldBuffer> > mIncomingFields;
+
+    /**
+     * Whether coupling messages are sent and received on a communication thread
+     */
+    bool mAsynchronousCoupling;
+
+    /**
+     * The communication thread, set up in Initialize() for coupled runs
+     */
+    boost::shared_ptr<AsyncCoupling> mpAsyncCoupling;
+
+    /**
+     * The number of increments between exchanges with the other components
+     */
+    unsigned mCouplingPeriod;
+
+    /**
+     * The order of the interpolation of coupled inputs between exchanges
+     */
+    unsigned mInterpolationOrder;
+
+    /**
+     * The fields received from the other components, set up in Initialize()
+     */
+    std::vector<unsigned> mCoupledInputHandles;
+
+    /**
+     * The recently received values of each coupled input, kept when exchanges are less
+     * frequent than increments
+     */
+    std::vector<TemporalInterpolator> mInputHistories;
+
+    /**
+     * The coupled inputs, by name, that are held between exchanges whatever the interpolation order
+     */
+    std::set<std::string> mHeldInputs;
+
+    /**
+     * Whether coupled inputs arrive on the grid of the other components rather than this one
+     */
+    bool mRegridInputs;
+
+    /**
+     * The number of grid points in each direction of the other components' grid
+     */
+    c_vector<unsigned, 3> mPeerGridSize;
+
+    /**
+     * The grid spacing of the other components' grid
+     */
+    double mPeerGridSpacing;
+
+    /**
+     * The grid origin of the other components' grid
+     */
+    c_vector<double, 3> mPeerGridOrigin;
+
+    /**
+     * How received fields are regridded, by name as received. Other fields are interpolated trilinearly.
+     */
+    std::map<std::string, RegriddingMethod> mRegriddingMethods;
+
+    /**
+     * The operators onto this component's grid, by name as received, built on first use
+     */
+    std::map<std::string, RegriddingOperator> mInputOperators;
+
+    /**
+     * Holds a received field on the other components' grid
+     */
+    std::vector<double> mPeerValues;
+
 public:
 
     /**
@@ -255,6 +460,153 @@ public:
      */
     void SetOutputFrequency(unsigned outputFrequency);
 
+    /**
+     * Set whether output is written on a background thread. Fields are copied into
+     * a spare buffer at each write and the simulation carries on while they are written.
+     * @param asynchronousOutput write output asynchronously
+     */
+    void SetAsynchronousOutput(bool asynchronousOutput);
+
+    /**
+     * Set the output format. VTI output writes a file per output step, HDF5 output
+     * appends every step to a single <output>_<component>.h5 file with an XDMF sidecar.
+     * @param outputFormat the output format
+     */
+    void SetOutputFormat(OutputFormat outputFormat);
+
+    /**
+     * Set the codec for VTK image output. The default is VTK's own zlib and base64 encoding.
+     * @param codec the codec
+     * @param compressionLevel the compression level from 1 to 9, or -1 for the compressor's default
+     */
+    void SetVtkCodec(VtkCodec codec, int compressionLevel = -1);
+
+    /**
+     * Write some output fields over a region of the grid, such as the tumour bounding box,
+     * a slice or a downsampled volume. Each region is written to its own file, named from
+     * the usual output file with the region name appended. Once any region is added only
+     * the added regions are written, so add OutputRegion() to keep whole grid output.
+     * @param rName the region name, appended to output file names
+     * @param rRegion the region
+     * @param rFieldNames the fields to write over the region, all output fields if empty
+     */
+    void AddOutputRegion(const std::string& rName, const OutputRegion& rRegion,
+                         const std::vector<std::string>& rFieldNames = std::vector<std::string>());
+
+    /**
+     * Set whether fields are written at output steps. Statistics can be logged instead.
+     * @param fieldOutput write fields
+     */
+    void SetFieldOutput(bool fieldOutput);
+
+    /**
+     * Set whether statistics of the fields are computed every step and logged to
+     * <output>_<component>_statistics.h5
+     * @param statisticsOutput log statistics
+     */
+    void SetStatisticsOutput(bool statisticsOutput);
+
+    /**
+     * Write a checkpoint of all fields, counters and parameters at a fixed increment frequency.
+     * Each checkpoint replaces the previous one.
+     * @param rCheckpointFile the checkpoint path
+     * @param checkpointFrequency the number of increments between checkpoints
+     */
+    void SetCheckpointFile(const std::string& rCheckpointFile, unsigned checkpointFrequency = 1);
+
+    /**
+     * Restart from a checkpoint instead of from the input file. The grid, fields, counters and
+     * component parameters all come from the checkpoint.
+     * @param rRestartFile the checkpoint path
+     */
+    void SetRestartFile(const std::string& rRestartFile);
+
+    /**
+     * Set how coupling data reaches the other components. The default is MUSCLE.
+     * @param pTransport the transport
+     */
+    void SetCouplingTransport(boost::shared_ptr<AbstractCouplingTransport> pTransport);
+
+    /**
+     * Set whether coupled fields are exchanged in one message per step, on the fields_out
+     * and fields_in conduits, rather than on one conduit per field
+     * @param batchedCoupling use a single message
+     */
+    void SetBatchedCoupling(bool batchedCoupling);
+
+    /**
+     * Set how an outgoing field is encoded in batched coupling messages. Messages carry
+     * their encodings, so only the sender needs to be configured.
+     * @param rName the field name, as sent
+     * @param encoding the encoding
+     * @param errorBound the largest absolute error allowed by fixed point encoding
+     */
+    void SetFieldEncoding(const std::string& rName, FieldEncoding encoding, double errorBound = 0.0);
+
+    /**
+     * Set how several outgoing fields are encoded in batched coupling messages
+     * @param rSpecifications the encodings, as name:encoding or name:fixed:error_bound
+     */
+    void SetFieldEncodings(const std::vector<std::string>& rSpecifications);
+
+    /**
+     * Set whether batched coupling messages are compressed
+     * @param compression compress messages
+     */
+    void SetCouplingCompression(bool compression);
+
+    /**
+     * Set whether batched coupling messages carry only the points of each field that changed
+     * since the last step. Receivers detect this from the messages and apply the changes.
+     * @param delta send changed points only
+     * @param tolerance changes no larger than this are held back until they grow beyond it
+     */
+    void SetDeltaCoupling(bool delta, double tolerance = 0.0);
+
+    /**
+     * Set whether batched coupling messages are sent and received on a communication
+     * thread. Send() then returns once the message is queued, and components post the
+     * next receive early, so transfers overlap with output, statistics and checkpoints.
+     * @param asynchronousCoupling use a communication thread
+     */
+    void SetAsynchronousCoupling(bool asynchronousCoupling);
+
+    /**
+     * Set how often this component exchanges fields with the other components. Between
+     * exchanges the coupled inputs are interpolated in time from the last ones received,
+     * so a component can step more often than a slower peer, whose time increment should
+     * then be the period times this one. Inputs are held until the first exchange, and
+     * after a restart until the next one. Higher orders extrapolate past the last exchange,
+     * clamped to the range of the inputs they use.
+     * @param period the number of increments between exchanges
+     * @param interpolationOrder 0 to hold the last inputs, 1 for linear or 2 for quadratic interpolation
+     */
+    void SetCouplingPeriod(unsigned period, unsigned interpolationOrder = 0);
+
+    /**
+     * Hold a coupled input between exchanges whatever the interpolation order, for masks
+     * whose values must stay 0 or 1.
+     * @param rName the field name
+     */
+    void SetHeldInput(const std::string& rName);
+
+    /**
+     * Set the grid that the other components send their fields on, when it differs from
+     * this component's grid. Received fields are then carried onto this grid, conservatively
+     * or by trilinear interpolation, see SetRegridding().
+     * @param rSize the number of grid points in each direction
+     * @param spacing the grid spacing
+     * @param rOrigin the grid origin
+     */
+    void SetPeerGrid(const c_vector<unsigned, 3>& rSize, double spacing, const c_vector<double, 3>& rOrigin);
+
+    /**
+     * Set how a received field is carried onto this component's grid. Population fields
+     * should be regridded conservatively, the default is trilinear interpolation.
+     * @param rName the field name, as received
+     * @param method the regridding method
+     */
+    void SetRegridding(const std::string& rName, RegriddingMethod method);
 
 protected:
 
@@ -263,6 +615,42 @@ protected:
      */
     virtual void Initialize();
 
+    /**
+     * @return whether the simulation is restarting from a checkpoint
+     */
+    bool IsRestart() const;
+
+    /**
+     * Add parameters and state to be stored in a checkpoint. Subclasses should add theirs
+     * and call the base class method.
+     * @param rParameters named values to be stored
+     */
+    virtual void AddCheckpointParameters(std::map<std::string, double>& rParameters);
+
+    /**
+     * Restore parameters and state from a checkpoint. Subclasses should restore theirs
+     * and call the base class method.
+     * @param rParameters the stored named values
+     */
+    virtual void LoadCheckpointParameters(const std::map<std::string, double>& rParameters);
+
+    /**
+     * @param rParameters named values
+     * @param rName the name of the value to find
+     * @return the value
+     */
+    static double GetParameter(const std::map<std::string, double>& rParameters, const std::string& rName);
+
+    /**
+     * Write a checkpoint if one is due after the current increment
+     */
+    void CheckpointIfRequired();
+
+    /**
+     * Write a checkpoint of all registered fields
+     */
+    void WriteCheckpoint();
+
     /**
      * Do a muscle send
      */
@@ -271,7 +659,134 @@ protected:
     /**
      * Do a muscle receive
      */
-    void Receive();
+    virtual void Receive();
+
+    /**
+     * Receive a field on its own conduit, carrying it onto this component's grid if needed
+     * @param handle the field handle
+     * @param rName the name of the field, the conduit is the name followed by _in
+     */
+    void ReceiveField(unsigned handle, const std::string& rName);
+
+    /**
+     * @param rName the name of a received field
+     * @return the operator carrying the field from the other components' grid onto this one
+     */
+    const RegriddingOperator& rGetInputOperator(const std::string& rName);
+
+    /**
+     * @param increment the increment
+     * @return whether fields are exchanged with the other components at the increment
+     */
+    bool IsCouplingIncrement(unsigned increment) const;
+
+    /**
+     * Bring the coupled inputs up to an increment. They are received at coupling
+     * increments and interpolated from those received at the others.
+     * @param increment the increment
+     */
+    void UpdateCoupledInputs(unsigned increment);
+
+    /**
+     * Add a field received outside the muscle input fields, so that it is interpolated between exchanges
+     * @param handle the field handle
+     */
+    void AddCoupledInput(unsigned handle);
+
+    /**
+     * Clear the coupling message and add the muscle output fields to it
+     * @return the message, subclasses can add further fields before sending it
+     */
+    CouplingMessage& rPackOutputFields();
+
+    /**
+     * Send the coupling message on the fields_out conduit, or queue it on the communication thread
+     */
+    void SendMessage();
+
+    /**
+     * Receive the coupling message on the fields_in conduit and unpack the muscle input
+     * fields from it. Subclasses can unpack further fields with UnpackField().
+     */
+    void ReceiveMessage();
+
+    /**
+     * Start receiving the next coupling message on the communication thread, if there is
+     * one and it isn't already being received. Only call this when another message will arrive.
+     */
+    void PrefetchMessage();
+
+    /**
+     * @param rConduit the conduit
+     * @return whether the conduit has another message coming, checked on the communication thread if there is one
+     */
+    bool HasNextMessage(const std::string& rConduit);
+
+    /**
+     * Copy a field out of the received coupling message, or adopt it if it was handed over
+     * @param handle the field handle
+     * @param rName the name of the field in the message
+     */
+    void UnpackField(unsigned handle, const std::string& rName);
+
+    /**
+     * Take a field handed over by the coupling transport. The buffer is adopted as the
+     * field's storage, or regridded into it if inputs are regridded.
+     * @param handle the field handle
+     * @param rName the name of the field as received
+     * @param pBuffer the received field
+     */
+    void AdoptReceivedField(unsigned handle, const std::string& rName, boost::shared_ptr<FieldBuffer> pBuffer);
+
+    /**
+     * Get the points of the fields this process keeps up to date. That is the whole grid
+     * unless the coupling transport divides fields between the processes of the component.
+     * @param rStart set to the first point
+     * @param rEnd set to one past the last point
+     */
+    void GetLocalPoints(unsigned& rStart, unsigned& rEnd) const;
+
+    /**
+     * Bind the output views to the solution fields. Views of the whole grid wrap the
+     * field buffers without copying. Called from Initialize() once fields are registered.
+     */
+    void BindVtkSolution();
+
+    /**
+     * @return the input image, reading mInputFile on first use
+     */
+    vtkSmartPointer<vtkImageData> GetInputData();
+
+    /**
+     * @return the mapped input file if mInputFile is a pre-processed binary field file,
+     * otherwise an empty pointer and the input should be read with GetInputData()
+     */
+    boost::shared_ptr<BinaryFieldFile> GetBinaryInput();
+
+    /**
+     * Drop the cached input image or mapping. Buffers adopted by fields stay alive.
+     */
+    void ReleaseInputData();
+
+    /**
+     * @param rName the array name
+     * @return the named point data array of the input image, checked against the grid
+     */
+    vtkSmartPointer<vtkDataArray> GetInputArray(const std::string& rName);
+
+    /**
+     * Convert an input array of any type into a double buffer with a single bulk copy
+     * @param rName the array name
+     * @param pDestination a buffer with one value per grid point
+     */
+    void ReadInputArray(const std::string& rName, double* pDestination);
+
+    /**
+     * Load a field from the input of the same name. Arrays of a binary input file and aligned
+     * double arrays of an input image are adopted without copying, other arrays are converted in bulk.
+     * @param handle the field handle
+     */
+    void LoadInputField(unsigned handle);
 
     /**
      * Read a VTK file
@@ -280,11 +795,49 @@ protected:
     vtkSmartPointer<vtkImageData> ReadVtk(const std::string& rFilename);
 
     /**
-     * Write a VTK file
+     * Choose the statistics logged each step. By default every output field is
+     * summarised, with a stimulus histogram, vessel fraction inside and outside the
+     * tumour and the necrotic fraction of the tumour where those fields exist.
+     * @param rStatistics the statistics to add to
+     */
+    virtual void AddStatistics(FieldStatistics& rStatistics);
+
+    /**
+     * Compute and log the statistics of the fields, if enabled
+     * @param rComponentName the component name used in the file name
+     * @param time the time of the step
+     */
+    void RecordStatistics(const std::string& rComponentName, double time);
+
+    /**
+     * Write an output step in the selected format, named from the output file
+     * @param rComponentName the component name used in the file name
+     * @param rStepLabel the label used to name per-step files
+     * @param time the time of the step
+     */
+    void WriteOutput(const std::string& rComponentName, const std::string& rStepLabel, double time);
+
+    /**
+     * Write a VTK file, or append a step to a HDF5 file
+     * @param rFilename the path to the file
+     * @param time the time of the step
+     */
+    void WriteVtk(const std::string& rFilename, double time = 0.0);
+
+    /**
+     * Write an image in the selected format. May be called from the output writer thread.
+     * @param pImage the image
      * @param rFilename the path to the file
-     * @param outputArrayNames the array names for vtk output
+     * @param time the time of the step
+     */
+    void WriteImage(vtkImageData* pImage, const std::string& rFilename, double time);
+
+    /**
+     * Wait for any asynchronous output to be written and coupling messages to be sent, and close
+     * any HDF5 output and the statistics log.
+     * Call at the end of Run().
      */
-    void WriteVtk(const std::string& rFilename);
+    void FlushOutput();
 };
 
 #endif /*SIMULATION_HPP_*/
@@ -34,16 +34,17 @@
  */
 
 #include <math.h>
+#include <algorithm>
+#include <chrono>
 #define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
 #include <vtkPointData.h>
 #include <vtkDoubleArray.h>
 #include <vtkCellData.h>
 #include <vtkDataArray.h>
 #include <boost/lexical_cast.hpp>
-#include <muscle2/cppmuscle.hpp>
 #include "Exception.hpp"
-#include "LinearSystem.hpp"
 #include "ReplicatableVector.hpp"
+#include "PetscTools.hpp"
 #include "OdeSolution.hpp"
 #include "VesselGrowthOde.hpp"
 #include "EulerIvpOdeSolver.hpp"
@@ -65,7 +66,32 @@ VesselSimulation::VesselSimulation() : Simulation(),
         mEquilibriumVesselFraction(0.25),
         mRateOfVesselGrowth(0.1),
         mRateOfVesselRegression(0.01),
-        mVesselGrowthTimstep(1.0)
+        mVesselGrowthTimstep(1.0),
+        mProliferatingHandle(0),
+        mQuiescentHandle(0),
+        mDifferentiatedHandle(0),
+        mApoptoticHandle(0),
+        mVesselHandle(0),
+        mStimulusHandle(0),
+        mNutrientHandle(0),
+        mSpeciesSystems(),
+        mReactionTerms(),
+        mSourceTerms(),
+        mHealthyPoints(),
+        mLinearSolverType(ASSEMBLED_SOLVER),
+        mStencilPreconditioner(MULTIGRID_PRECONDITIONER),
+        mMatrixFreeSolvers(),
+        mWarmStart(false),
+        mChangeTolerance(1.e-3),
+        mColdIterations(2, -1),
+        mSolverIterations(2, 0),
+        mIterationsSaved(2, 0),
+        mPreconditionerLag(0),
+        mRebuildIterations(0),
+        mSetupTimes(2, 0.0),
+        mSolveTimes(2, 0.0),
+        mPreconditionersRebuilt(2, false),
+        mpSolverLog()
 {
       // Set default parameter array names
       this->mFileInputSpatialParameters.push_back("proliferating");
@@ -92,6 +118,16 @@ VesselSimulation::VesselSimulation() : Simulation(),
       this->mMuscleInputSpatialParameters.push_back("differentiated");
       this->mMuscleInputSpatialParameters.push_back("tumour");
 
+      // Cell populations keep their totals when the cell component runs on another grid
+      for(unsigned idx=0; idx<this->mMuscleInputSpatialParameters.size(); idx++)
+      {
+          SetRegridding(this->mMuscleInputSpatialParameters[idx], CONSERVATIVE_REGRIDDING);
+      }
+
+      // The masks set the Dirichlet points, so they are never interpolated in time
+      SetHeldInput("necrotic");
+      SetHeldInput("tumour");
+
 	  //mMuscleOutputSpatialParameters.push_back("nutrient");
 }
 
@@ -132,27 +168,123 @@ void VesselSimulation::SetParameters(double initialVolumeFraction,
     mVesselGrowthTimstep = vesselGrowthTimstep;
 }
 
+void VesselSimulation::SetWarmStart(bool warmStart, double changeTolerance)
+{
+    mWarmStart = warmStart;
+    mChangeTolerance = changeTolerance;
+}
+
+void VesselSimulation::SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold)
+{
+    mPreconditionerLag = maxLag;
+    mRebuildIterations = iterationThreshold;
+}
+
+void VesselSimulation::SetLinearSolver(LinearSolverType solverType, StencilPreconditioner preconditioner)
+{
+    mLinearSolverType = solverType;
+    mStencilPreconditioner = preconditioner;
+}
+
 void VesselSimulation::Initialize()
 {
     // Do the base class initialization
     Simulation::Initialize();
 
+    mProliferatingHandle = mFields.Register("proliferating");
+    mQuiescentHandle = mFields.Register("quiescent");
+    mDifferentiatedHandle = mFields.Register("differentiated");
+    mApoptoticHandle = mFields.Register("apoptotic");
+    mVesselHandle = mFields.Register("vessel");
+    mStimulusHandle = mFields.Register("stimulus");
+    mNutrientHandle = mFields.Register("nutrient");
+
     unsigned num_points = mGridSize[0] * mGridSize[1] * mGridSize[2];
 
-    // Over-ride to set initial vessel volume fraction
-    for (unsigned jdx = 0; jdx < num_points; jdx++)
+    // The grid may have changed, so the linear systems are set up again on the first step
+    mSpeciesSystems.clear();
+    mSpeciesSystems.resize(2);
+    mMatrixFreeSolvers.clear();
+    mMatrixFreeSolvers.resize(2);
+    mColdIterations.assign(2, -1);
+    mSolverIterations.assign(2, 0);
+    mIterationsSaved.assign(2, 0);
+    mSetupTimes.assign(2, 0.0);
+    mSolveTimes.assign(2, 0.0);
+    mPreconditionersRebuilt.assign(2, false);
+    mReactionTerms.assign(num_points, 0.0);
+    mSourceTerms.assign(num_points, 0.0);
+    mHealthyPoints.assign(num_points, false);
+
+    // Over-ride to set initial vessel volume fraction, unless it comes from a checkpoint
+    if(!IsRestart())
     {
-        this->mSolutionVectors["vessel"][jdx] = mInitialVolumeFraction;
+        double* p_vessel = mFields.GetField(mVesselHandle);
+        for (unsigned jdx = 0; jdx < num_points; jdx++)
+        {
+            p_vessel[jdx] = mInitialVolumeFraction;
+        }
     }
+    ReleaseInputData();
+}
+
+void VesselSimulation::AddCheckpointParameters(std::map<std::string, double>& rParameters)
+{
+    rParameters["initial_volume_fraction"] = mInitialVolumeFraction;
+    rParameters["nutrient_diffusivity"] = mNutrientDiffusivity;
+    rParameters["stimulus_diffusivity"] = mStimulusDiffusivity;
+    rParameters["stimulus_decay_rate"] = mStimulusDecayRate;
+    rParameters["stimulus_release_rate"] = mStimulusReleaseRate;
+    rParameters["nutrient_consumption_rate"] = mNutrientConsumptionRate;
+    rParameters["nutrient_delivery_rate"] = mNutrientDeliveryRate;
+    rParameters["vessel_nutrient_concentration"] = mVesselNutrientConcentration;
+    rParameters["stimulus_concentration_in_healthy"] = mStimulusConcentrationInHealthy;
+    rParameters["nutrient_concentration_in_healthy"] = mNutrientConcentrationInHealthy;
+    rParameters["max_vessel_fraction"] = mMaxVesselFraction;
+    rParameters["equilibrium_vessel_fraction"] = mEquilibriumVesselFraction;
+    rParameters["rate_of_vessel_growth"] = mRateOfVesselGrowth;
+    rParameters["rate_of_vessel_regression"] = mRateOfVesselRegression;
+    rParameters["vessel_growth_timestep"] = mVesselGrowthTimstep;
+    Simulation::AddCheckpointParameters(rParameters);
+}
+
+void VesselSimulation::LoadCheckpointParameters(const std::map<std::string, double>& rParameters)
+{
+    mInitialVolumeFraction = GetParameter(rParameters, "initial_volume_fraction");
+    mNutrientDiffusivity = GetParameter(rParameters, "nutrient_diffusivity");
+    mStimulusDiffusivity = GetParameter(rParameters, "stimulus_diffusivity");
+    mStimulusDecayRate = GetParameter(rParameters, "stimulus_decay_rate");
+    mStimulusReleaseRate = GetParameter(rParameters, "stimulus_release_rate");
+    mNutrientConsumptionRate = GetParameter(rParameters, "nutrient_consumption_rate");
+    mNutrientDeliveryRate = GetParameter(rParameters, "nutrient_delivery_rate");
+    mVesselNutrientConcentration = GetParameter(rParameters, "vessel_nutrient_concentration");
+    mStimulusConcentrationInHealthy = GetParameter(rParameters, "stimulus_concentration_in_healthy");
+    mNutrientConcentrationInHealthy = GetParameter(rParameters, "nutrient_concentration_in_healthy");
+    mMaxVesselFraction = GetParameter(rParameters, "max_vessel_fraction");
+    mEquilibriumVesselFraction = GetParameter(rParameters, "equilibrium_vessel_fraction");
+    mRateOfVesselGrowth = GetParameter(rParameters, "rate_of_vessel_growth");
+    mRateOfVesselRegression = GetParameter(rParameters, "rate_of_vessel_regression");
+    mVesselGrowthTimstep = GetParameter(rParameters, "vessel_growth_timestep");
+    Simulation::LoadCheckpointParameters(rParameters);
 }
 
 void VesselSimulation::Send()
 {
+    if(mBatchedCoupling)
+    {
+        // The nutrient goes in the same message as the other fields
+        unsigned num_points = mGridSize[0] * mGridSize[1] * mGridSize[2];
+        rPackOutputFields().AddField("Nutrient", mFields.GetField(mNutrientHandle), num_points);
+        SendMessage();
+        return;
+    }
+
     // Send the nutrient solution with muscle
     Simulation::Send();
 
     // Special case for nutrients
-    muscle::env::sendDoubleVector("Nutrient_out", this->mSolutionVectors["nutrient"]);
+    unsigned num_points = mGridSize[0] * mGridSize[1] * mGridSize[2];
+    mpCouplingTransport->SendField("Nutrient_out", mFields.GetField(mNutrientHandle), num_points);
 }
 
 void VesselSimulation::UpdateFields(unsigned speciesIndex)
@@ -168,161 +300,174 @@ void VesselSimulation::UpdateFields(unsigned speciesIndex)
     }
 
     unsigned number_of_points = mGridSize[0] * mGridSize[1] * mGridSize[2];
-
-    // Set up the system
-    LinearSystem linear_system(number_of_points, 7);
-    unsigned grid_index;
-    unsigned grid_index2;
-    double diff_term = diffusivity / (mGridSpacing * mGridSpacing);
-
-    for (unsigned i = 0; i < mGridSize[2]; i++) // Z
+    const double* p_proliferating = mFields.GetField(mProliferatingHandle);
+    const double* p_quiescent = mFields.GetField(mQuiescentHandle);
+    const double* p_differentiated = mFields.GetField(mDifferentiatedHandle);
+    const double* p_apoptotic = mFields.GetField(mApoptoticHandle);
+    const double* p_vessel = mFields.GetField(mVesselHandle);
+
+    // The assembled system works on the rows this process owns, the matrix-free solver
+    // on the whole grid
+    unsigned local_start;
+    unsigned local_end;
+    GetLocalPoints(local_start, local_end);
+    PetscInt lo = 0;
+    PetscInt hi = number_of_points;
+    if(mLinearSolverType == ASSEMBLED_SOLVER)
     {
-        for (unsigned j = 0; j < mGridSize[1]; j++) // Y
+        // The matrix pattern is the same every step, so each species keeps its system
+        // and only the coefficients are updated
+        if(!mSpeciesSystems[speciesIndex])
         {
-            for (unsigned k = 0; k < mGridSize[0]; k++) // X
-            {
-                grid_index = k + mGridSize[0] * j + mGridSize[0] * mGridSize[1] * i;
-
-                if(speciesIndex == 0)
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index,
-                            -mStimulusDecayRate - 6.0 * diff_term);
-                }
-                else
-                {
-                    double cell_numbers = mSolutionVectors["proliferating"][grid_index] +
-                            mSolutionVectors["quiescent"][grid_index] +
-                            mSolutionVectors["differentiated"][grid_index];
-                    double linear_term = -(mSolutionVectors["vessel"][grid_index] +
-                            mNutrientConsumptionRate * (cell_numbers));
-                    linear_system.AddToMatrixElement(grid_index, grid_index,
-                            linear_term - 6.0 * diff_term);
-                }
-
-                // Apply boundary conditions
-                // No flux at x bottom
-                if (k > 0)
-                {
-                    grid_index2 = grid_index - 1;
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-
-                // No flux at x top
-                if (k < mGridSize[0] - 1)
-                {
-                    grid_index2 = grid_index + 1;
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-
-                // No flux at y bottom
-                if (j > 0)
-                {
-                    grid_index2 = grid_index - mGridSize[0];
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-
-                // No flux at y top
-                if (j < mGridSize[1] - 1)
-                {
-                    grid_index2 = grid_index + mGridSize[0];
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-
-                // No flux at z bottom
-                if (i > 0)
-                {
-                    grid_index2 = grid_index - mGridSize[0] * mGridSize[1];
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-
-                // No flux at z top
-                if (i < mGridSize[2] - 1)
-                {
-                    grid_index2 = grid_index + mGridSize[0] * mGridSize[1];
-                    linear_system.AddToMatrixElement(grid_index, grid_index2, diff_term);
-                }
-                else
-                {
-                    linear_system.AddToMatrixElement(grid_index, grid_index, diff_term);
-                }
-                double constant_term;
-                if(speciesIndex==0)
-                {
-                    constant_term = mStimulusReleaseRate * (mSolutionVectors["quiescent"][grid_index] +
-                            mSolutionVectors["apoptotic"][grid_index]);
-                }
-                else
-                {
-                    constant_term = mVesselNutrientConcentration * mSolutionVectors["vessel"][grid_index];
-                }
-
-                linear_system.SetRhsVectorElement(grid_index, -constant_term);
-            }
+            mSpeciesSystems[speciesIndex].reset(new DiffusionReactionSystem(mGridSize, mGridSpacing, diffusivity));
+            mSpeciesSystems[speciesIndex]->SetPreconditionerLag(mPreconditionerLag, mRebuildIterations);
         }
+        mSpeciesSystems[speciesIndex]->GetOwnershipRange(lo, hi);
+    }
+    else if(local_end - local_start < number_of_points)
+    {
+        EXCEPTION("The matrix-free solver needs the whole grid on each process, so it can't be used with distributed fields");
     }
 
-    // Dirichlet for non-tumour regions
-    std::vector<unsigned> bc_indices;
-    for (unsigned row = 0; row < number_of_points; row++)
+    for (unsigned row = unsigned(lo); row < unsigned(hi); row++)
     {
-        if(mSolutionVectors["proliferating"][row] +
-                mSolutionVectors["quiescent"][row] +
-                mSolutionVectors["apoptotic"][row] +
-                mSolutionVectors["differentiated"][row]<   1.e-3)
+        if(speciesIndex == 0)
         {
-            bc_indices.push_back(row);
-            if(speciesIndex == 0)
-            {
-                linear_system.SetRhsVectorElement(row, mStimulusConcentrationInHealthy);
-            }
-            else
-            {
-                linear_system.SetRhsVectorElement(row, mNutrientConcentrationInHealthy);
-            }
+            mReactionTerms[row] = -mStimulusDecayRate;
+            mSourceTerms[row] = mStimulusReleaseRate * (p_quiescent[row] + p_apoptotic[row]);
+        }
+        else
+        {
+            double cell_numbers = p_proliferating[row] + p_quiescent[row] + p_differentiated[row];
+            mReactionTerms[row] = -(p_vessel[row] + mNutrientConsumptionRate * cell_numbers);
+            mSourceTerms[row] = mVesselNutrientConcentration * p_vessel[row];
         }
+
+        // Dirichlet for non-tumour regions
+        mHealthyPoints[row] = p_proliferating[row] + p_quiescent[row] + p_apoptotic[row] +
+                p_differentiated[row] < 1.e-3;
     }
 
-    linear_system.ZeroMatrixRowsWithValueOnDiagonal(bc_indices, 1.0);
+    double healthy_concentration = speciesIndex == 0 ? mStimulusConcentrationInHealthy : mNutrientConcentrationInHealthy;
+    double* p_solution = mFields.GetField(speciesIndex == 0 ? mStimulusHandle : mNutrientHandle);
 
-    // Solve the linear system
-    linear_system.AssembleFinalLinearSystem();
-    ReplicatableVector soln_repl(linear_system.Solve());
+    // The first solve of a run starts from zero, to give the iterations warm starts are measured against
+    bool warm_start = mWarmStart && mColdIterations[speciesIndex] >= 0;
+    if(mLinearSolverType == MATRIX_FREE_SOLVER)
+    {
+        if(!mMatrixFreeSolvers[speciesIndex])
+        {
+            mMatrixFreeSolvers[speciesIndex].reset(new MatrixFreeSolver(mGridSize, mGridSpacing, diffusivity,
+                    mStencilPreconditioner));
+        }
+        MatrixFreeSolver& r_solver = *mMatrixFreeSolvers[speciesIndex];
+        r_solver.SetChangeTolerance(warm_start ? mChangeTolerance : 0.0);
+        std::chrono::steady_clock::time_point setup_start = std::chrono::steady_clock::now();
+        r_solver.Update(&mReactionTerms[0], &mSourceTerms[0], mHealthyPoints, healthy_concentration);
+        std::chrono::steady_clock::time_point solve_start = std::chrono::steady_clock::now();
+        if(!warm_start)
+        {
+            std::fill(p_solution, p_solution + number_of_points, 0.0);
+        }
+        r_solver.Solve(p_solution);
+        std::chrono::steady_clock::time_point solve_end = std::chrono::steady_clock::now();
+        RecordIterations(speciesIndex, r_solver.GetNumIterations(), warm_start);
+        mSetupTimes[speciesIndex] = std::chrono::duration<double>(solve_start - setup_start).count();
+        mSolveTimes[speciesIndex] = std::chrono::duration<double>(solve_end - solve_start).count();
+        mPreconditionersRebuilt[speciesIndex] = r_solver.WasPreconditionerRebuilt();
+        return;
+    }
 
-    // Update the solution
-    if(speciesIndex == 0)
+    // Solve the linear system. The preconditioner is built in the update on the steps it
+    // is rebuilt, so that time is part of the setup time.
+    DiffusionReactionSystem& r_system = *mSpeciesSystems[speciesIndex];
+    r_system.SetChangeTolerance(warm_start ? mChangeTolerance : 0.0);
+    std::chrono::steady_clock::time_point setup_start = std::chrono::steady_clock::now();
+    r_system.Update(&mReactionTerms[0], &mSourceTerms[0], mHealthyPoints, healthy_concentration);
+    std::chrono::steady_clock::time_point solve_start = std::chrono::steady_clock::now();
+    Vec solution = r_system.Solve(warm_start ? p_solution : NULL);
+    std::chrono::steady_clock::time_point solve_end = std::chrono::steady_clock::now();
+    RecordIterations(speciesIndex, r_system.GetNumIterations(), warm_start);
+    mSetupTimes[speciesIndex] = std::chrono::duration<double>(solve_start - setup_start).count();
+    mSolveTimes[speciesIndex] = std::chrono::duration<double>(solve_end - solve_start).count();
+    mPreconditionersRebuilt[speciesIndex] = r_system.WasPreconditionerRebuilt();
+
+    // Update the solution. With distributed fields each process keeps the rows it owns,
+    // otherwise every process gathers the whole solution.
+    if(local_end - local_start < number_of_points)
     {
-        for (unsigned row = 0; row < number_of_points; row++)
+        if(local_start != unsigned(lo) || local_end != unsigned(hi))
         {
-            mSolutionVectors["stimulus"][row] = soln_repl[row];
+            EXCEPTION("The rows of the linear system do not match the distributed fields");
         }
+        double* p_local_solution;
+        VecGetArray(solution, &p_local_solution);
+        std::copy(p_local_solution, p_local_solution + (hi - lo), p_solution + lo);
+        VecRestoreArray(solution, &p_local_solution);
     }
     else
     {
+        ReplicatableVector soln_repl(solution);
         for (unsigned row = 0; row < number_of_points; row++)
         {
-            mSolutionVectors["nutrient"][row] = soln_repl[row];
+            p_solution[row] = soln_repl[row];
         }
     }
+    PetscTools::Destroy(solution);
+}
+
+void VesselSimulation::RecordIterations(unsigned speciesIndex, unsigned iterations, bool warmStart)
+{
+    mSolverIterations[speciesIndex] = iterations;
+    if(warmStart)
+    {
+        mIterationsSaved[speciesIndex] = mColdIterations[speciesIndex] - int(iterations);
+    }
+    else
+    {
+        mColdIterations[speciesIndex] = iterations;
+        mIterationsSaved[speciesIndex] = 0;
+    }
+}
+
+void VesselSimulation::RecordSolverStatistics(double time)
+{
+    if(!mStatisticsOutput)
+    {
+        return;
+    }
+    if(mOutputFile.empty())
+    {
+        EXCEPTION("Output file not specified.");
+    }
+
+    if(!mpSolverLog)
+    {
+        std::vector<std::string> column_names;
+        column_names.push_back("time");
+        const char* species_names[2] = {"stimulus", "nutrient"};
+        for(unsigned species=0; species<2; species++)
+        {
+            std::string name(species_names[species]);
+            column_names.push_back(name + "_iterations");
+            column_names.push_back(name + "_iterations_saved");
+            column_names.push_back(name + "_setup_time");
+            column_names.push_back(name + "_solve_time");
+            column_names.push_back(name + "_preconditioner_rebuilt");
+        }
+        mpSolverLog.reset(new ColumnarLog(mOutputFile + "_vessel_solver.h5", column_names, IsRestart()));
+    }
+
+    std::vector<double> row(1, time);
+    for(unsigned species=0; species<2; species++)
+    {
+        row.push_back(mSolverIterations[species]);
+        row.push_back(mIterationsSaved[species]);
+        row.push_back(mSetupTimes[species]);
+        row.push_back(mSolveTimes[species]);
+        row.push_back(mPreconditionersRebuilt[species] ? 1.0 : 0.0);
+    }
+    mpSolverLog->AppendRow(row);
 }
 
 void VesselSimulation::Run()
@@ -330,19 +475,21 @@ void VesselSimulation::Run()
     // Simulation main loop
     Initialize();
 
-    // Set up the ODE
-    unsigned num_points = mGridSize[0] * mGridSize[1] *mGridSize[2];
+    // Set up the ODE, on the points this process keeps up to date
+    unsigned local_start;
+    unsigned local_end;
+    GetLocalPoints(local_start, local_end);
     VesselGrowthOde vessel_growth_ode;
     EulerIvpOdeSolver euler_solver;
     double r0;
-    double total_time = 0.0;
+    double total_time = double(mCurrentIncrement) * mTargetTimeIncrement;
 
-    for(unsigned idx = 0; idx<mMaxIncrements; idx++)
+    for(unsigned idx = mCurrentIncrement; idx<mMaxIncrements; idx++)
     {
         // Communicate with the other simulators
         if(!mStandalone)
         {
-            Receive();
+            UpdateCoupledInputs(idx);
         }
 
         // Update the nutrient and factor fields
@@ -350,12 +497,15 @@ void VesselSimulation::Run()
         UpdateFields(1);
 
         // Update the vessel volume fractions
-        for(unsigned jdx = 0; jdx<num_points; jdx++)
+        const double* p_stimulus = mFields.GetField(mStimulusHandle);
+        const double* p_nutrient = mFields.GetField(mNutrientHandle);
+        double* p_vessel = mFields.GetField(mVesselHandle);
+        for(unsigned jdx = local_start; jdx<local_end; jdx++)
         {
-            double growth_stimulus =  this->mSolutionVectors["stimulus"][jdx];
+            double growth_stimulus =  p_stimulus[jdx];
             if(growth_stimulus > 0.5)
             {
-                r0 = mRateOfVesselGrowth*mSolutionVectors["nutrient"][jdx];
+                r0 = mRateOfVesselGrowth*p_nutrient[jdx];
             }
             else
             {
@@ -365,7 +515,7 @@ void VesselSimulation::Run()
             		mEquilibriumVesselFraction, r0, mRateOfVesselRegression);
 
             std::vector<double> initial_condition;
-            initial_condition.push_back(mSolutionVectors["vessel"][jdx]);
+            initial_condition.push_back(p_vessel[jdx]);
             OdeSolution solutions = euler_solver.Solve(&vessel_growth_ode,
                                                        initial_condition,
                                                        0.0,
@@ -374,26 +524,40 @@ void VesselSimulation::Run()
                                                        mTargetTimeIncrement);
 
             unsigned num_steps = solutions.rGetTimes().size();
-            mSolutionVectors["vessel"][jdx] = solutions.rGetSolutions()[num_steps-1][0];
+            p_vessel[jdx] = solutions.rGetSolutions()[num_steps-1][0];
         }
 
         // Write the output at the specified frequency
         if(idx % mOutputFrequency == 0 && mStandalone)
         {
-            std::string output_file = mOutputFile + "_vessel_t_" + boost::lexical_cast<std::string>(mCurrentTime)+".vti";
-            WriteVtk(output_file);
+            WriteOutput("vessel", boost::lexical_cast<std::string>(mCurrentTime), total_time + mTargetTimeIncrement);
         }
 
-        if(!mStandalone)
+        if(!mStandalone && IsCouplingIncrement(idx))
         {
             Send();
+            if(idx + mCouplingPeriod < mMaxIncrements && total_time + mCouplingPeriod * mTargetTimeIncrement < mEndTime)
+            {
+                PrefetchMessage();
+            }
         }
 
+        RecordStatistics("vessel", total_time + mTargetTimeIncrement);
+        RecordSolverStatistics(total_time + mTargetTimeIncrement);
+
         // Update the total time
         total_time += mTargetTimeIncrement;
+        mCurrentIncrement = idx + 1;
+        CheckpointIfRequired();
         if(total_time >= mEndTime)
         {
             break;
         }
     }
+    FlushOutput();
+    if(mpSolverLog)
+    {
+        mpSolverLog->Close();
+        mpSolverLog.reset();
+    }
 }
@@ -37,6 +37,9 @@
 #define VESSELSIMULATION_HPP_
 
 #include "Simulation.hpp"
+#include "DiffusionReactionSystem.hpp"
+#include "MatrixFreeSolver.hpp"
+#include "LinearSolverType.hpp"
 
 /**
  * Vessel component for Chic Updates nutrient and growth factor fields and
@@ -119,6 +122,132 @@ class VesselSimulation : public Simulation
      */
     double mVesselGrowthTimstep;
 
+    /**
+     * Proliferating cell field handle, resolved in Initialize()
+     */
+    unsigned mProliferatingHandle;
+
+    /**
+     * Quiescent cell field handle
+     */
+    unsigned mQuiescentHandle;
+
+    /**
+     * Differentiated cell field handle
+     */
+    unsigned mDifferentiatedHandle;
+
+    /**
+     * Apoptotic cell field handle
+     */
+    unsigned mApoptoticHandle;
+
+    /**
+     * Vessel volume fraction field handle
+     */
+    unsigned mVesselHandle;
+
+    /**
+     * Stimulus field handle
+     */
+    unsigned mStimulusHandle;
+
+    /**
+     * Nutrient field handle
+     */
+    unsigned mNutrientHandle;
+
+    /**
+     * The stimulus and nutrient linear systems, kept between steps
+     */
+    std::vector<boost::shared_ptr<DiffusionReactionSystem> > mSpeciesSystems;
+
+    /**
+     * Scratch space for the reaction coefficient at each point
+     */
+    std::vector<double> mReactionTerms;
+
+    /**
+     * Scratch space for the source at each point
+     */
+    std::vector<double> mSourceTerms;
+
+    /**
+     * Scratch space for whether each point is outside the tumour
+     */
+    std::vector<bool> mHealthyPoints;
+
+    /**
+     * How the stimulus and nutrient fields are solved
+     */
+    LinearSolverType mLinearSolverType;
+
+    /**
+     * The preconditioner for the matrix-free solver
+     */
+    StencilPreconditioner mStencilPreconditioner;
+
+    /**
+     * The stimulus and nutrient matrix-free solvers, kept between steps
+     */
+    std::vector<boost::shared_ptr<MatrixFreeSolver> > mMatrixFreeSolvers;
+
+    /**
+     * Whether the solves start from the previous step's fields
+     */
+    bool mWarmStart;
+
+    /**
+     * The fraction of the change in the right-hand side that warm started solves converge to
+     */
+    double mChangeTolerance;
+
+    /**
+     * The iterations of each species' last solve from zero, negative before there is one
+     */
+    std::vector<int> mColdIterations;
+
+    /**
+     * The iterations of each species' last solve
+     */
+    std::vector<unsigned> mSolverIterations;
+
+    /**
+     * The iterations each species' last solve saved against its last solve from zero
+     */
+    std::vector<int> mIterationsSaved;
+
+    /**
+     * The most updates a preconditioner is reused for, zero to rebuild it every step
+     */
+    unsigned mPreconditionerLag;
+
+    /**
+     * Solves needing more iterations than this rebuild the preconditioner, zero for no limit
+     */
+    unsigned mRebuildIterations;
+
+    /**
+     * The time in seconds each species' last update of its solver took, including
+     * rebuilding the matrix-free preconditioner
+     */
+    std::vector<double> mSetupTimes;
+
+    /**
+     * The time in seconds each species' last solve took
+     */
+    std::vector<double> mSolveTimes;
+
+    /**
+     * Whether each species' last solve used a rebuilt preconditioner
+     */
+    std::vector<bool> mPreconditionersRebuilt;
+
+    /**
+     * Per-step solver iterations and times, written with the statistics
+     */
+    boost::shared_ptr<ColumnarLog> mpSolverLog;
+
 public:
 
     /**
@@ -150,11 +279,51 @@ public:
                        double rateOfVesselRegression,
                        double vesselGrowthTimstep);
 
+    /**
+     * Set how the stimulus and nutrient fields are solved. The matrix-free solver holds
+     * the whole grid on each process, so it can't be used with distributed fields.
+     * @param solverType the solver
+     * @param preconditioner the preconditioner for the matrix-free solver
+     */
+    void SetLinearSolver(LinearSolverType solverType, StencilPreconditioner preconditioner = MULTIGRID_PRECONDITIONER);
+
+    /**
+     * Start each stimulus and nutrient solve from the previous step's field. The solves then
+     * stop once the residual is within a fraction of the change in the right-hand side since
+     * the previous step, and never go beyond the usual relative tolerance.
+     * @param warmStart whether to start from the previous fields
+     * @param changeTolerance the fraction of the right-hand side's change to converge to
+     */
+    void SetWarmStart(bool warmStart, double changeTolerance = 1.e-3);
+
+    /**
+     * Reuse each species' preconditioner across steps. The matrix-free solver keeps its
+     * multigrid levels, and the assembled solver keeps its PETSc preconditioner.
+     * @param maxLag the most steps a preconditioner is reused for after the one it was built at
+     * @param iterationThreshold solves needing more iterations than this rebuild the
+     *     preconditioner at the next step, zero for no limit
+     */
+    void SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold = 0);
+
     /**
      * Over-ridden model run methods
      */
     void Run();
 
+protected:
+
+    /**
+     * Over-ridden to store the model parameters
+     * @param rParameters named values to be stored
+     */
+    void AddCheckpointParameters(std::map<std::string, double>& rParameters);
+
+    /**
+     * Over-ridden to restore the model parameters
+     * @param rParameters the stored named values
+     */
+    void LoadCheckpointParameters(const std::map<std::string, double>& rParameters);
+
 private:
 
     /**
@@ -167,6 +336,21 @@ private:
      */
     void Initialize();
 
+    /**
+     * Note the iterations of a solve
+     * @param speciesIndex the index of the species
+     * @param iterations the number of iterations
+     * @param warmStart whether the solve started from the previous field
+     */
+    void RecordIterations(unsigned speciesIndex, unsigned iterations, bool warmStart);
+
+    /**
+     * Log the iterations and times of this step's solves, and the iterations saved by warm
+     * starts, when statistics are output
+     * @param time the time at the end of the step
+     */
+    void RecordSolverStatistics(double time);
+
     /**
      * Update the solution fields
 	*
@@ -0,0 +1,152 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef ABSTRACTCOUPLINGTRANSPORT_HPP_
+#define ABSTRACTCOUPLINGTRANSPORT_HPP_
+
+#include <vector>
+#include <string>
+#include <map>
+#include "SmartPointers.hpp"
+#include "GridDecomposition.hpp"
+#include "FieldBuffer.hpp"
+
+/**
+ * Moves coupling data between components over named conduits, such as
+ * "proliferating_out" or "fields_in". Conduit names are those used by the component,
+ * which end in _out for sending and _in for receiving, and the transport decides
+ * where each one leads. Fields are arrays of doubles, messages are raw bytes as
+ * packed by CouplingMessage. Transports between components in the same process can
+ * also hand whole field buffers over, so that receivers adopt them without a copy.
+ */
+class AbstractCouplingTransport
+{
+
+public:
+
+    /**
+     * Destructor
+     */
+    virtual ~AbstractCouplingTransport();
+
+    /**
+     * Send a field. The values can be changed as soon as this returns.
+     * @param rConduit the conduit
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    virtual void SendField(const std::string& rConduit, const double* pValues, unsigned numValues)=0;
+
+    /**
+     * Receive a field, waiting for it to arrive
+     * @param rConduit the conduit
+     * @param pValues filled with the received values
+     * @param numValues the number of values expected
+     */
+    virtual void ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues)=0;
+
+    /**
+     * Send a raw message. The message can be changed as soon as this returns.
+     * @param rConduit the conduit
+     * @param rMessage the message
+     */
+    virtual void SendMessage(const std::string& rConduit, const std::vector<char>& rMessage)=0;
+
+    /**
+     * Receive a raw message, waiting for it to arrive
+     * @param rConduit the conduit
+     * @param rMessage set to the message, its previous contents may be recycled
+     */
+    virtual void ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage)=0;
+
+    /**
+     * @param rConduit the conduit
+     * @return whether another message will arrive on the conduit, may wait until that is known
+     */
+    virtual bool HasNext(const std::string& rConduit)=0;
+
+    /**
+     * @return whether the transport hands field buffers over, in which case the
+     *     buffer based methods can be used. By default it doesn't.
+     */
+    virtual bool HandsOverFields() const;
+
+    /**
+     * Receive a field as a buffer that the caller can adopt, waiting for it to arrive
+     * @param rConduit the conduit
+     * @param numValues the number of values expected
+     * @return the field, no longer used by the transport or the sender
+     */
+    virtual boost::shared_ptr<FieldBuffer> ReceiveFieldBuffer(const std::string& rConduit, unsigned numValues);
+
+    /**
+     * Send several fields together, as the batched counterpart of SendField(). The
+     * values can be changed as soon as this returns.
+     * @param rConduit the conduit
+     * @param rNames the field names
+     * @param rValues the values of each field, in the order of rNames
+     * @param numValues the number of values in each field
+     */
+    virtual void SendFields(const std::string& rConduit, const std::vector<std::string>& rNames,
+                            const std::vector<const double*>& rValues, unsigned numValues);
+
+    /**
+     * Receive fields sent together by SendFields(), waiting for them to arrive
+     * @param rConduit the conduit
+     * @param rFields set to the fields by name, no longer used by the transport or the sender
+     */
+    virtual void ReceiveFields(const std::string& rConduit, std::map<std::string, boost::shared_ptr<FieldBuffer> >& rFields);
+
+    /**
+     * Sent and received fields are always indexed over the whole grid, but a process
+     * need only hold part of them. Only the points it holds are read when sending and
+     * filled in when receiving.
+     * @param numPoints the number of points in the grid
+     * @return how the component divides fields between its processes, by default every
+     *     process holds whole fields
+     */
+    virtual GridDecomposition GetDecomposition(unsigned numPoints) const;
+
+protected:
+
+    /**
+     * Check the size of a received field
+     * @param numReceived the number of values received
+     * @param numExpected the number of values expected
+     */
+    static void CheckNumberOfValues(unsigned numReceived, unsigned numExpected);
+};
+
+#endif /*ABSTRACTCOUPLINGTRANSPORT_HPP_*/
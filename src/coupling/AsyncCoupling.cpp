@@ -0,0 +1,238 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <exception>
+#include "Exception.hpp"
+
+#include "AsyncCoupling.hpp"
+
+AsyncCoupling::AsyncCoupling(SendFunction send, ReceiveFunction receive, unsigned numberOfSlots)
+    : mpState(new State),
+      mThread()
+{
+    if(numberOfSlots == 0)
+    {
+        EXCEPTION("At least one coupling slot is required");
+    }
+    mpState->mSend = send;
+    mpState->mReceive = receive;
+    mpState->mNumberOfSlots = numberOfSlots;
+    mpState->mSendsInFlight = 0;
+    mpState->mStop = false;
+    mThread = std::thread(&AsyncCoupling::CommunicationLoop, mpState);
+}
+
+AsyncCoupling::~AsyncCoupling()
+{
+    bool blocked;
+    {
+        std::lock_guard<std::mutex> lock(mpState->mMutex);
+        mpState->mStop = true;
+        blocked = mpState->mpRunning && mpState->mpRunning->mType == RECEIVE_OPERATION;
+    }
+    mpState->mCondition.notify_all();
+    if(blocked)
+    {
+        mThread.detach();
+    }
+    else
+    {
+        mThread.join();
+    }
+}
+
+void AsyncCoupling::PostSend(const std::vector<char>& rMessage)
+{
+    std::unique_lock<std::mutex> lock(mpState->mMutex);
+    ThrowIfFailed(lock);
+
+    // Wait for a free buffer
+    mpState->mCondition.wait(lock, [this]{ return mpState->mSendsInFlight < mpState->mNumberOfSlots; });
+
+    boost::shared_ptr<Operation> p_operation(new Operation);
+    p_operation->mType = SEND_OPERATION;
+    p_operation->mDone = false;
+    if(!mpState->mFreeBuffers.empty())
+    {
+        p_operation->mBuffer.swap(mpState->mFreeBuffers.back());
+        mpState->mFreeBuffers.pop_back();
+    }
+    p_operation->mBuffer.assign(rMessage.begin(), rMessage.end());
+    mpState->mSendsInFlight++;
+    mpState->mQueue.push_back(p_operation);
+    lock.unlock();
+    mpState->mCondition.notify_all();
+}
+
+void AsyncCoupling::PostReceive()
+{
+    std::unique_lock<std::mutex> lock(mpState->mMutex);
+    if(mpState->mReceives.size() >= mpState->mNumberOfSlots)
+    {
+        EXCEPTION("Too many coupling receives posted without being collected");
+    }
+    boost::shared_ptr<Operation> p_operation(new Operation);
+    p_operation->mType = RECEIVE_OPERATION;
+    p_operation->mDone = false;
+    mpState->mReceives.push_back(p_operation);
+    mpState->mQueue.push_back(p_operation);
+    lock.unlock();
+    mpState->mCondition.notify_all();
+}
+
+unsigned AsyncCoupling::GetNumberOfPendingReceives()
+{
+    std::lock_guard<std::mutex> lock(mpState->mMutex);
+    return mpState->mReceives.size();
+}
+
+void AsyncCoupling::WaitForReceive(std::vector<char>& rMessage)
+{
+    std::unique_lock<std::mutex> lock(mpState->mMutex);
+    if(mpState->mReceives.empty())
+    {
+        EXCEPTION("No coupling receive has been posted");
+    }
+    boost::shared_ptr<Operation> p_operation = mpState->mReceives.front();
+    mpState->mCondition.wait(lock, [p_operation]{ return p_operation->mDone; });
+    mpState->mReceives.pop_front();
+    if(!p_operation->mErrorMessage.empty())
+    {
+        EXCEPTION("Asynchronous coupling receive failed: " + p_operation->mErrorMessage);
+    }
+    rMessage.swap(p_operation->mBuffer);
+}
+
+void AsyncCoupling::Call(boost::function<void ()> function)
+{
+    boost::shared_ptr<Operation> p_operation(new Operation);
+    p_operation->mType = CALL_OPERATION;
+    p_operation->mFunction = function;
+    p_operation->mDone = false;
+
+    std::unique_lock<std::mutex> lock(mpState->mMutex);
+    mpState->mQueue.push_back(p_operation);
+    mpState->mCondition.notify_all();
+    mpState->mCondition.wait(lock, [p_operation]{ return p_operation->mDone; });
+    if(!p_operation->mErrorMessage.empty())
+    {
+        EXCEPTION("Asynchronous coupling call failed: " + p_operation->mErrorMessage);
+    }
+}
+
+void AsyncCoupling::Flush()
+{
+    std::unique_lock<std::mutex> lock(mpState->mMutex);
+    mpState->mCondition.wait(lock, [this]{ return mpState->mSendsInFlight == 0; });
+    ThrowIfFailed(lock);
+}
+
+void AsyncCoupling::CommunicationLoop(boost::shared_ptr<State> pState)
+{
+    while(true)
+    {
+        boost::shared_ptr<Operation> p_operation;
+        {
+            std::unique_lock<std::mutex> lock(pState->mMutex);
+            pState->mCondition.wait(lock, [pState]{ return pState->mStop || !pState->mQueue.empty(); });
+            if(pState->mStop)
+            {
+                return;
+            }
+            p_operation = pState->mQueue.front();
+            pState->mQueue.pop_front();
+            pState->mpRunning = p_operation;
+        }
+
+        // The transport is only used from here, outside the lock
+        std::string error_message;
+        try
+        {
+            switch(p_operation->mType)
+            {
+                case SEND_OPERATION:
+                    pState->mSend(p_operation->mBuffer);
+                    break;
+                case RECEIVE_OPERATION:
+                    pState->mReceive(p_operation->mBuffer);
+                    break;
+                case CALL_OPERATION:
+                    p_operation->mFunction();
+                    break;
+            }
+        }
+        catch(const Exception& e)
+        {
+            error_message = e.GetShortMessage();
+        }
+        catch(const std::exception& e)
+        {
+            error_message = e.what();
+        }
+        catch(...)
+        {
+            error_message = "unknown error";
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pState->mMutex);
+            pState->mpRunning.reset();
+            p_operation->mErrorMessage = error_message;
+            p_operation->mDone = true;
+            if(p_operation->mType == SEND_OPERATION)
+            {
+                if(!error_message.empty() && pState->mErrorMessage.empty())
+                {
+                    pState->mErrorMessage = error_message;
+                }
+                pState->mFreeBuffers.push_back(std::vector<char>());
+                pState->mFreeBuffers.back().swap(p_operation->mBuffer);
+                pState->mSendsInFlight--;
+            }
+        }
+        pState->mCondition.notify_all();
+    }
+}
+
+void AsyncCoupling::ThrowIfFailed(std::unique_lock<std::mutex>& rLock)
+{
+    std::string message;
+    message.swap(mpState->mErrorMessage);
+    if(!message.empty())
+    {
+        rLock.unlock();
+        EXCEPTION("Asynchronous coupling send failed: " + message);
+    }
+}
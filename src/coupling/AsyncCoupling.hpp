@@ -0,0 +1,261 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef ASYNCCOUPLING_HPP_
+#define ASYNCCOUPLING_HPP_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <boost/function.hpp>
+#include "SmartPointers.hpp"
+
+/**
+ * Runs coupling sends and receives on a dedicated communication thread, so that a
+ * component can post its outgoing message and carry on with work that doesn't need
+ * the incoming one, such as writing output and statistics, while transfers are in
+ * flight. Operations run one at a time in the order they are posted, so the
+ * transport is only ever used from one thread and sees the same sequence of calls
+ * as a synchronous component would make.
+ *
+ * Outgoing messages are copied into a small ring of reusable buffers, two by
+ * default, which gives double buffering: posting only blocks when every buffer is
+ * still waiting to be sent.
+ */
+class AsyncCoupling
+{
+public:
+
+    /**
+     * Function that sends a message, called on the communication thread
+     */
+    typedef boost::function<void (const std::vector<char>&)> SendFunction;
+
+    /**
+     * Function that receives a message into a buffer, called on the communication thread
+     */
+    typedef boost::function<void (std::vector<char>&)> ReceiveFunction;
+
+private:
+
+    /**
+     * Kinds of operation
+     */
+    enum OperationType
+    {
+        SEND_OPERATION,
+        RECEIVE_OPERATION,
+        CALL_OPERATION
+    };
+
+    /**
+     * A posted operation
+     */
+    struct Operation
+    {
+        /**
+         * The kind of operation
+         */
+        OperationType mType;
+
+        /**
+         * The message sent or received
+         */
+        std::vector<char> mBuffer;
+
+        /**
+         * The function run by a call operation
+         */
+        boost::function<void ()> mFunction;
+
+        /**
+         * Set once the operation has run
+         */
+        bool mDone;
+
+        /**
+         * Any error raised by the operation
+         */
+        std::string mErrorMessage;
+    };
+
+    /**
+     * State shared with the communication thread. The thread holds a reference so it
+     * can be left behind, blocked in a receive, if the owner is destroyed early.
+     */
+    struct State
+    {
+        /**
+         * Sends a message
+         */
+        SendFunction mSend;
+
+        /**
+         * Receives a message
+         */
+        ReceiveFunction mReceive;
+
+        /**
+         * The number of buffers for outgoing messages, and the limit on posted receives
+         */
+        unsigned mNumberOfSlots;
+
+        /**
+         * Operations waiting for the communication thread
+         */
+        std::deque<boost::shared_ptr<Operation> > mQueue;
+
+        /**
+         * The operation being run, if any
+         */
+        boost::shared_ptr<Operation> mpRunning;
+
+        /**
+         * Posted receives in order, until they are collected
+         */
+        std::deque<boost::shared_ptr<Operation> > mReceives;
+
+        /**
+         * Number of sends posted and not yet completed
+         */
+        unsigned mSendsInFlight;
+
+        /**
+         * Buffers of completed sends, reused for later ones
+         */
+        std::vector<std::vector<char> > mFreeBuffers;
+
+        /**
+         * The first error raised by a send
+         */
+        std::string mErrorMessage;
+
+        /**
+         * Set to stop the communication thread
+         */
+        bool mStop;
+
+        /**
+         * Protects everything above
+         */
+        std::mutex mMutex;
+
+        /**
+         * Signalled whenever an operation is posted or completed
+         */
+        std::condition_variable mCondition;
+    };
+
+    /**
+     * The shared state
+     */
+    boost::shared_ptr<State> mpState;
+
+    /**
+     * The communication thread
+     */
+    std::thread mThread;
+
+    /**
+     * The communication thread main loop
+     * @param pState the shared state
+     */
+    static void CommunicationLoop(boost::shared_ptr<State> pState);
+
+    /**
+     * Raise any error reported by a send
+     * @param rLock a lock held on the state
+     */
+    void ThrowIfFailed(std::unique_lock<std::mutex>& rLock);
+
+public:
+
+    /**
+     * Constructor. Starts the communication thread.
+     * @param send the function used to send each message
+     * @param receive the function used to receive each message
+     * @param numberOfSlots the number of outgoing messages that can be queued
+     */
+    AsyncCoupling(SendFunction send, ReceiveFunction receive, unsigned numberOfSlots = 2);
+
+    /**
+     * Destructor. Stops the communication thread once the current operation is done,
+     * dropping any queued ones. Call Flush() first to be sure sends have completed.
+     * A receive that is already waiting for a message can't be interrupted, so the
+     * thread is then left to finish on its own.
+     */
+    ~AsyncCoupling();
+
+    /**
+     * Copy a message into a free buffer and queue it for sending. Blocks only if
+     * all buffers are still waiting to be sent.
+     * @param rMessage the message
+     */
+    void PostSend(const std::vector<char>& rMessage);
+
+    /**
+     * Queue a receive. Only post a receive when a message is sure to arrive, the
+     * communication thread will wait for it and operations behind it are held up.
+     */
+    void PostReceive();
+
+    /**
+     * @return the number of receives posted and not yet collected
+     */
+    unsigned GetNumberOfPendingReceives();
+
+    /**
+     * Wait for the oldest posted receive to complete and collect its message
+     * @param rMessage set to the message
+     */
+    void WaitForReceive(std::vector<char>& rMessage);
+
+    /**
+     * Run a function on the communication thread, after everything already posted,
+     * and wait for it. Use this for any other calls to the transport.
+     * @param function the function
+     */
+    void Call(boost::function<void ()> function);
+
+    /**
+     * Wait until every posted send has completed
+     */
+    void Flush();
+};
+
+#endif /*ASYNCCOUPLING_HPP_*/
@@ -0,0 +1,695 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <zlib.h>
+#include <boost/lexical_cast.hpp>
+#include "Exception.hpp"
+
+#include "CouplingMessage.hpp"
+
+namespace
+{
+    /**
+     * Identifies the message type
+     */
+    const char MAGIC[8] = {'C', 'H', 'I', 'C', 'M', 'S', 'G', '\0'};
+
+    /**
+     * Current format version
+     */
+    const uint32_t VERSION = 3;
+
+    /**
+     * zlib level for compressed messages, favouring speed
+     */
+    const int COMPRESSION_LEVEL = 1;
+
+    /**
+     * @param offset an offset in bytes
+     * @return the offset rounded up to a multiple of 8
+     */
+    uint64_t RoundUp(uint64_t offset)
+    {
+        return ((offset + 7) / 8) * 8;
+    }
+
+    /**
+     * @param numChanged the number of changed points
+     * @return the size of a delta entry in bytes: a count, the indices and the values
+     */
+    uint64_t GetDeltaSize(uint64_t numChanged)
+    {
+        return RoundUp(sizeof(uint64_t) + numChanged * sizeof(uint32_t)) + numChanged * sizeof(double);
+    }
+
+    /**
+     * @param encoding the encoding
+     * @param bits the bits per value of fixed point values
+     * @param numValues the number of values
+     * @return the size of the encoded values in bytes
+     */
+    uint64_t GetEncodedSize(uint32_t encoding, uint32_t bits, uint64_t numValues)
+    {
+        switch(encoding)
+        {
+            case DOUBLE_ENCODING:
+                return numValues * sizeof(double);
+            case FLOAT_ENCODING:
+                return numValues * sizeof(float);
+            case FIXED_POINT_ENCODING:
+                return numValues * (bits / 8);
+            case BITSET_ENCODING:
+                return (numValues + 7) / 8;
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * Quantise values onto evenly spaced levels
+     * @param pValues the values
+     * @param numValues the number of values
+     * @param minimum the lowest level
+     * @param step the level spacing
+     * @param maxLevel the highest level index
+     * @param pDestination the level indices
+     */
+    template<typename TYPE>
+    void Quantise(const double* pValues, unsigned numValues, double minimum, double step, double maxLevel, TYPE* pDestination)
+    {
+        for(unsigned idx=0; idx<numValues; idx++)
+        {
+            double level = std::floor((pValues[idx] - minimum) / step + 0.5);
+            pDestination[idx] = TYPE(std::min(std::max(level, 0.0), maxLevel));
+        }
+    }
+
+    /**
+     * Convert level indices back to values
+     * @param pSource the level indices
+     * @param numValues the number of values
+     * @param minimum the lowest level
+     * @param step the level spacing
+     * @param pDestination the values
+     */
+    template<typename TYPE>
+    void Dequantise(const TYPE* pSource, unsigned numValues, double minimum, double step, double* pDestination)
+    {
+        for(unsigned idx=0; idx<numValues; idx++)
+        {
+            pDestination[idx] = minimum + double(pSource[idx]) * step;
+        }
+    }
+}
+
+CouplingMessage::CouplingMessage()
+    : mNames(),
+      mSources(),
+      mNumberOfValues(0),
+      mEncodings(),
+      mCompression(false),
+      mBuffer(),
+      mCompressedBuffer(),
+      mIndices(),
+      mDelta(false),
+      mDeltaTolerance(0.0),
+      mLastExchanged(),
+      mChangedIndices()
+{
+}
+
+void CouplingMessage::Clear()
+{
+    mNames.clear();
+    mSources.clear();
+    mNumberOfValues = 0;
+    mBuffer.clear();
+    mCompressedBuffer.clear();
+    mIndices.clear();
+}
+
+void CouplingMessage::SetEncoding(const std::string& rName, FieldEncoding encoding, double errorBound)
+{
+    if(encoding == DELTA_ENCODING)
+    {
+        EXCEPTION("Delta encoding is set for the whole message with SetDeltaEncoding");
+    }
+    if(encoding == FIXED_POINT_ENCODING && !(errorBound > 0.0))
+    {
+        EXCEPTION("Fixed point encoding of " + rName + " needs a positive error bound");
+    }
+    mEncodings[rName] = std::make_pair(encoding, errorBound);
+}
+
+void CouplingMessage::SetEncodings(const std::vector<std::string>& rSpecifications)
+{
+    for(unsigned idx=0; idx<rSpecifications.size(); idx++)
+    {
+        std::string name;
+        FieldEncoding encoding;
+        double error_bound;
+        ParseEncoding(rSpecifications[idx], name, encoding, error_bound);
+        SetEncoding(name, encoding, error_bound);
+    }
+}
+
+void CouplingMessage::SetCompression(bool compression)
+{
+    mCompression = compression;
+}
+
+void CouplingMessage::SetDeltaEncoding(bool delta, double tolerance)
+{
+    if(tolerance < 0.0)
+    {
+        EXCEPTION("The delta encoding tolerance can't be negative");
+    }
+    mDelta = delta;
+    mDeltaTolerance = tolerance;
+    mLastExchanged.clear();
+}
+
+void CouplingMessage::AddField(const std::string& rName, const double* pValues, unsigned numValues)
+{
+    if(rName.size() >= NAME_LENGTH)
+    {
+        EXCEPTION("Field name " + rName + " is too long for a coupling message");
+    }
+    if(!mNames.empty() && numValues != mNumberOfValues)
+    {
+        EXCEPTION("Field " + rName + " has a different number of values to the other fields in the coupling message");
+    }
+    mNumberOfValues = numValues;
+
+    std::vector<std::string>::iterator it = std::find(mNames.begin(), mNames.end(), rName);
+    if(it != mNames.end())
+    {
+        mSources[it - mNames.begin()] = pValues;
+    }
+    else
+    {
+        mNames.push_back(rName);
+        mSources.push_back(pValues);
+    }
+}
+
+const std::vector<std::string>& CouplingMessage::rGetAddedFieldNames() const
+{
+    return mNames;
+}
+
+const std::vector<const double*>& CouplingMessage::rGetAddedFieldValues() const
+{
+    return mSources;
+}
+
+const std::vector<char>& CouplingMessage::rPack()
+{
+    // Work out the encoding and size of each field
+    std::vector<DirectoryEntry> directory(mNames.size());
+    mChangedIndices.resize(mNames.size());
+    uint64_t offset = RoundUp(sizeof(Header) + mNames.size() * sizeof(DirectoryEntry));
+    for(unsigned idx=0; idx<mNames.size(); idx++)
+    {
+        DirectoryEntry& r_entry = directory[idx];
+        memset(&r_entry, 0, sizeof(DirectoryEntry));
+        memcpy(r_entry.mName, mNames[idx].c_str(), mNames[idx].size());
+        r_entry.mEncoding = DOUBLE_ENCODING;
+
+        std::map<std::string, std::pair<FieldEncoding, double> >::const_iterator it = mEncodings.find(mNames[idx]);
+        if(it != mEncodings.end())
+        {
+            r_entry.mEncoding = it->second.first;
+        }
+        if(r_entry.mEncoding == FIXED_POINT_ENCODING && mNumberOfValues > 0)
+        {
+            // Levels 2e apart keep every value within e of its level. Use the narrowest
+            // integers that hold all the levels, doubles if nothing does.
+            const double* p_values = mSources[idx];
+            double minimum = *std::min_element(p_values, p_values + mNumberOfValues);
+            double maximum = *std::max_element(p_values, p_values + mNumberOfValues);
+            if(!std::isfinite(minimum) || !std::isfinite(maximum))
+            {
+                EXCEPTION("Field " + mNames[idx] + " has values that can't be sent in fixed point");
+            }
+            r_entry.mMinimum = minimum;
+            r_entry.mStep = 2.0 * it->second.second;
+            double num_levels = std::floor((maximum - minimum) / r_entry.mStep + 0.5) + 1.0;
+            if(num_levels <= 256.0)
+            {
+                r_entry.mBits = 8;
+            }
+            else if(num_levels <= 65536.0)
+            {
+                r_entry.mBits = 16;
+            }
+            else if(num_levels <= 4294967296.0)
+            {
+                r_entry.mBits = 32;
+            }
+            else
+            {
+                r_entry.mEncoding = DOUBLE_ENCODING;
+            }
+        }
+        else if(r_entry.mEncoding == FIXED_POINT_ENCODING)
+        {
+            r_entry.mBits = 8;
+            r_entry.mStep = 1.0;
+        }
+        r_entry.mOffset = offset;
+        r_entry.mSize = GetEncodedSize(r_entry.mEncoding, r_entry.mBits, mNumberOfValues);
+
+        // Send the changed points instead if the other end has a copy and that is smaller
+        mChangedIndices[idx].clear();
+        std::map<std::string, std::vector<double> >::const_iterator last_it = mLastExchanged.find(mNames[idx]);
+        if(mDelta && last_it != mLastExchanged.end() && last_it->second.size() == mNumberOfValues)
+        {
+            const double* p_values = mSources[idx];
+            const double* p_last = &last_it->second[0];
+            std::vector<uint32_t>& r_changed = mChangedIndices[idx];
+            uint64_t max_changed = r_entry.mSize / (sizeof(uint32_t) + sizeof(double));
+            for(unsigned jdx=0; jdx<mNumberOfValues && r_changed.size() <= max_changed; jdx++)
+            {
+                if(!(std::abs(p_values[jdx] - p_last[jdx]) <= mDeltaTolerance))
+                {
+                    r_changed.push_back(jdx);
+                }
+            }
+            if(GetDeltaSize(r_changed.size()) < r_entry.mSize)
+            {
+                r_entry.mEncoding = DELTA_ENCODING;
+                r_entry.mSize = GetDeltaSize(r_changed.size());
+            }
+        }
+        offset = RoundUp(offset + r_entry.mSize);
+    }
+
+    mBuffer.resize(offset);
+    Header* p_header = reinterpret_cast<Header*>(&mBuffer[0]);
+    memset(p_header, 0, sizeof(Header));
+    memcpy(p_header->mMagic, MAGIC, sizeof(MAGIC));
+    p_header->mVersion = VERSION;
+    p_header->mNumberOfFields = mNames.size();
+    p_header->mNumberOfValues = mNumberOfValues;
+    p_header->mDelta = mDelta ? 1 : 0;
+    p_header->mBodySize = offset - sizeof(Header);
+
+    mIndices.clear();
+    for(unsigned idx=0; idx<mNames.size(); idx++)
+    {
+        Encode(directory[idx], mSources[idx], mChangedIndices[idx]);
+        mIndices[mNames[idx]] = idx;
+
+        // Keep what the other end will decode, which for lossy encodings isn't the source
+        if(mDelta)
+        {
+            std::vector<double>& r_last = mLastExchanged[mNames[idx]];
+            r_last.resize(mNumberOfValues);
+            if(mNumberOfValues > 0)
+            {
+                Decode(directory[idx], &r_last[0]);
+            }
+        }
+    }
+    if(!directory.empty())
+    {
+        memcpy(&mBuffer[sizeof(Header)], &directory[0], directory.size() * sizeof(DirectoryEntry));
+    }
+
+    if(!mCompression)
+    {
+        return mBuffer;
+    }
+
+    // The header stays readable, the rest is compressed
+    uLongf compressed_size = compressBound(p_header->mBodySize);
+    mCompressedBuffer.resize(sizeof(Header) + compressed_size);
+    if(compress2(reinterpret_cast<Bytef*>(&mCompressedBuffer[sizeof(Header)]), &compressed_size,
+            reinterpret_cast<const Bytef*>(&mBuffer[sizeof(Header)]), p_header->mBodySize, COMPRESSION_LEVEL) != Z_OK)
+    {
+        EXCEPTION("Could not compress the coupling message");
+    }
+    mCompressedBuffer.resize(sizeof(Header) + compressed_size);
+    p_header->mCompressed = 1;
+    memcpy(&mCompressedBuffer[0], p_header, sizeof(Header));
+    p_header->mCompressed = 0;
+    return mCompressedBuffer;
+}
+
+void CouplingMessage::Encode(DirectoryEntry& rEntry, const double* pValues, const std::vector<uint32_t>& rChangedIndices)
+{
+    char* p_destination = &mBuffer[rEntry.mOffset];
+    unsigned num_values = mNumberOfValues;
+    switch(rEntry.mEncoding)
+    {
+        case DOUBLE_ENCODING:
+            memcpy(p_destination, pValues, rEntry.mSize);
+            break;
+        case FLOAT_ENCODING:
+            std::copy(pValues, pValues + num_values, reinterpret_cast<float*>(p_destination));
+            break;
+        case FIXED_POINT_ENCODING:
+        {
+            double max_level = std::ldexp(1.0, rEntry.mBits) - 1.0;
+            if(rEntry.mBits == 8)
+            {
+                Quantise(pValues, num_values, rEntry.mMinimum, rEntry.mStep, max_level, reinterpret_cast<uint8_t*>(p_destination));
+            }
+            else if(rEntry.mBits == 16)
+            {
+                Quantise(pValues, num_values, rEntry.mMinimum, rEntry.mStep, max_level, reinterpret_cast<uint16_t*>(p_destination));
+            }
+            else
+            {
+                Quantise(pValues, num_values, rEntry.mMinimum, rEntry.mStep, max_level, reinterpret_cast<uint32_t*>(p_destination));
+            }
+            break;
+        }
+        case BITSET_ENCODING:
+        {
+            uint8_t* p_bytes = reinterpret_cast<uint8_t*>(p_destination);
+            memset(p_bytes, 0, rEntry.mSize);
+            for(unsigned idx=0; idx<num_values; idx++)
+            {
+                if(pValues[idx] == 1.0)
+                {
+                    p_bytes[idx / 8] |= uint8_t(1u << (idx % 8));
+                }
+                else if(pValues[idx] != 0.0)
+                {
+                    EXCEPTION("Field " + std::string(rEntry.mName) + " has values other than 0 and 1 and can't be sent as a bitset");
+                }
+            }
+            break;
+        }
+        case DELTA_ENCODING:
+        {
+            uint64_t num_changed = rChangedIndices.size();
+            memcpy(p_destination, &num_changed, sizeof(uint64_t));
+            if(num_changed > 0)
+            {
+                memcpy(p_destination + sizeof(uint64_t), &rChangedIndices[0], num_changed * sizeof(uint32_t));
+            }
+            double* p_changed_values = reinterpret_cast<double*>(p_destination + GetDeltaSize(num_changed) - num_changed * sizeof(double));
+            for(unsigned idx=0; idx<num_changed; idx++)
+            {
+                p_changed_values[idx] = pValues[rChangedIndices[idx]];
+            }
+            break;
+        }
+    }
+}
+
+void CouplingMessage::Decode(const DirectoryEntry& rEntry, double* pDestination) const
+{
+    const char* p_source = &mBuffer[rEntry.mOffset];
+    unsigned num_values = mNumberOfValues;
+    switch(rEntry.mEncoding)
+    {
+        case DOUBLE_ENCODING:
+            memcpy(pDestination, p_source, rEntry.mSize);
+            break;
+        case FLOAT_ENCODING:
+        {
+            const float* p_floats = reinterpret_cast<const float*>(p_source);
+            std::copy(p_floats, p_floats + num_values, pDestination);
+            break;
+        }
+        case FIXED_POINT_ENCODING:
+            if(rEntry.mBits == 8)
+            {
+                Dequantise(reinterpret_cast<const uint8_t*>(p_source), num_values, rEntry.mMinimum, rEntry.mStep, pDestination);
+            }
+            else if(rEntry.mBits == 16)
+            {
+                Dequantise(reinterpret_cast<const uint16_t*>(p_source), num_values, rEntry.mMinimum, rEntry.mStep, pDestination);
+            }
+            else
+            {
+                Dequantise(reinterpret_cast<const uint32_t*>(p_source), num_values, rEntry.mMinimum, rEntry.mStep, pDestination);
+            }
+            break;
+        case BITSET_ENCODING:
+        {
+            const uint8_t* p_bytes = reinterpret_cast<const uint8_t*>(p_source);
+            for(unsigned idx=0; idx<num_values; idx++)
+            {
+                pDestination[idx] = (p_bytes[idx / 8] >> (idx % 8)) & 1u ? 1.0 : 0.0;
+            }
+            break;
+        }
+        case DELTA_ENCODING:
+        {
+            uint64_t num_changed;
+            memcpy(&num_changed, p_source, sizeof(uint64_t));
+            const uint32_t* p_indices = reinterpret_cast<const uint32_t*>(p_source + sizeof(uint64_t));
+            const double* p_changed_values = reinterpret_cast<const double*>(p_source + GetDeltaSize(num_changed) - num_changed * sizeof(double));
+            for(unsigned idx=0; idx<num_changed; idx++)
+            {
+                pDestination[p_indices[idx]] = p_changed_values[idx];
+            }
+            break;
+        }
+    }
+}
+
+void CouplingMessage::Unpack(const void* pData, std::size_t numBytes)
+{
+    Clear();
+    if(numBytes < sizeof(Header))
+    {
+        EXCEPTION("Coupling message is too small");
+    }
+    const char* p_bytes = static_cast<const char*>(pData);
+    Header header;
+    memcpy(&header, p_bytes, sizeof(Header));
+    if(memcmp(header.mMagic, MAGIC, sizeof(MAGIC)) != 0 || header.mVersion != VERSION)
+    {
+        EXCEPTION("Received data is not a supported coupling message");
+    }
+
+    if(header.mCompressed)
+    {
+        mBuffer.resize(sizeof(Header) + header.mBodySize);
+        uLongf body_size = header.mBodySize;
+        if(uncompress(reinterpret_cast<Bytef*>(&mBuffer[sizeof(Header)]), &body_size,
+                reinterpret_cast<const Bytef*>(p_bytes + sizeof(Header)), numBytes - sizeof(Header)) != Z_OK ||
+                body_size != header.mBodySize)
+        {
+            EXCEPTION("Could not decompress the coupling message");
+        }
+        header.mCompressed = 0;
+        memcpy(&mBuffer[0], &header, sizeof(Header));
+    }
+    else
+    {
+        mBuffer.assign(p_bytes, p_bytes + numBytes);
+    }
+    mNumberOfValues = header.mNumberOfValues;
+
+    uint64_t data_start = sizeof(Header) + uint64_t(header.mNumberOfFields) * sizeof(DirectoryEntry);
+    if(data_start > mBuffer.size())
+    {
+        EXCEPTION("Coupling message is truncated");
+    }
+    const DirectoryEntry* p_directory = reinterpret_cast<const DirectoryEntry*>(&mBuffer[sizeof(Header)]);
+    for(unsigned idx=0; idx<header.mNumberOfFields; idx++)
+    {
+        const DirectoryEntry& r_entry = p_directory[idx];
+        std::string name(r_entry.mName, strnlen(r_entry.mName, NAME_LENGTH));
+        bool good_bits = r_entry.mEncoding != FIXED_POINT_ENCODING ||
+                r_entry.mBits == 8 || r_entry.mBits == 16 || r_entry.mBits == 32;
+        bool good_location = r_entry.mOffset >= data_start && r_entry.mOffset % 8 == 0 &&
+                r_entry.mOffset <= mBuffer.size() && r_entry.mSize <= mBuffer.size() - r_entry.mOffset;
+        if(r_entry.mEncoding > DELTA_ENCODING || !good_bits || !good_location)
+        {
+            EXCEPTION("Coupling message has a bad entry for field " + name);
+        }
+        if(r_entry.mEncoding == DELTA_ENCODING)
+        {
+            // The indices have to be in range for the changes to be applied
+            uint64_t num_changed = 0;
+            if(r_entry.mSize >= sizeof(uint64_t))
+            {
+                memcpy(&num_changed, &mBuffer[r_entry.mOffset], sizeof(uint64_t));
+            }
+            if(r_entry.mSize < sizeof(uint64_t) || num_changed > mNumberOfValues || r_entry.mSize != GetDeltaSize(num_changed))
+            {
+                EXCEPTION("Coupling message has a bad entry for field " + name);
+            }
+            const uint32_t* p_indices = reinterpret_cast<const uint32_t*>(&mBuffer[r_entry.mOffset + sizeof(uint64_t)]);
+            for(unsigned jdx=0; jdx<num_changed; jdx++)
+            {
+                if(p_indices[jdx] >= mNumberOfValues)
+                {
+                    EXCEPTION("Coupling message has a bad entry for field " + name);
+                }
+            }
+        }
+        else if(r_entry.mSize != GetEncodedSize(r_entry.mEncoding, r_entry.mBits, mNumberOfValues))
+        {
+            EXCEPTION("Coupling message has a bad entry for field " + name);
+        }
+        mIndices[name] = idx;
+    }
+
+    // In delta mode bring the copies of the fields up to date
+    if(header.mDelta)
+    {
+        for(unsigned idx=0; idx<header.mNumberOfFields; idx++)
+        {
+            const DirectoryEntry& r_entry = p_directory[idx];
+            std::string name(r_entry.mName, strnlen(r_entry.mName, NAME_LENGTH));
+            std::vector<double>& r_last = mLastExchanged[name];
+            if(r_entry.mEncoding == DELTA_ENCODING && r_last.size() != mNumberOfValues)
+            {
+                mLastExchanged.erase(name);
+                EXCEPTION("Received changes to field " + name + " without a full copy to apply them to");
+            }
+            r_last.resize(mNumberOfValues);
+            if(mNumberOfValues > 0)
+            {
+                Decode(r_entry, &r_last[0]);
+            }
+        }
+    }
+    else
+    {
+        mLastExchanged.clear();
+    }
+}
+
+unsigned CouplingMessage::GetNumberOfValues() const
+{
+    return mNumberOfValues;
+}
+
+std::vector<std::string> CouplingMessage::GetFieldNames() const
+{
+    std::vector<std::string> names;
+    if(mBuffer.size() >= sizeof(Header))
+    {
+        const Header* p_header = reinterpret_cast<const Header*>(&mBuffer[0]);
+        const DirectoryEntry* p_directory = reinterpret_cast<const DirectoryEntry*>(&mBuffer[sizeof(Header)]);
+        for(unsigned idx=0; idx<p_header->mNumberOfFields; idx++)
+        {
+            names.push_back(std::string(p_directory[idx].mName, strnlen(p_directory[idx].mName, NAME_LENGTH)));
+        }
+    }
+    return names;
+}
+
+bool CouplingMessage::HasField(const std::string& rName) const
+{
+    return mIndices.find(rName) != mIndices.end();
+}
+
+FieldEncoding CouplingMessage::GetFieldEncoding(const std::string& rName) const
+{
+    std::map<std::string, unsigned>::const_iterator it = mIndices.find(rName);
+    if(it == mIndices.end())
+    {
+        EXCEPTION("Coupling message does not contain the field " + rName);
+    }
+    const DirectoryEntry* p_directory = reinterpret_cast<const DirectoryEntry*>(&mBuffer[sizeof(Header)]);
+    return FieldEncoding(p_directory[it->second].mEncoding);
+}
+
+void CouplingMessage::CopyField(const std::string& rName, double* pDestination) const
+{
+    std::map<std::string, unsigned>::const_iterator it = mIndices.find(rName);
+    if(it == mIndices.end())
+    {
+        EXCEPTION("Coupling message does not contain the field " + rName);
+    }
+
+    // Received delta messages have already been applied to the copies
+    std::map<std::string, std::vector<double> >::const_iterator last_it = mLastExchanged.find(rName);
+    if(reinterpret_cast<const Header*>(&mBuffer[0])->mDelta && last_it != mLastExchanged.end())
+    {
+        std::copy(last_it->second.begin(), last_it->second.end(), pDestination);
+        return;
+    }
+    Decode(reinterpret_cast<const DirectoryEntry*>(&mBuffer[sizeof(Header)])[it->second], pDestination);
+}
+
+FieldEncoding CouplingMessage::GetEncoding(const std::string& rName)
+{
+    const char* names[4] = {"double", "float", "fixed", "bitset"};
+    FieldEncoding encodings[4] = {DOUBLE_ENCODING, FLOAT_ENCODING, FIXED_POINT_ENCODING, BITSET_ENCODING};
+    for(unsigned idx=0; idx<4; idx++)
+    {
+        if(rName == names[idx])
+        {
+            return encodings[idx];
+        }
+    }
+    EXCEPTION("Unknown field encoding " + rName + ". Use double, float, fixed or bitset");
+}
+
+void CouplingMessage::ParseEncoding(const std::string& rSpecification, std::string& rName,
+                                    FieldEncoding& rEncoding, double& rErrorBound)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(rSpecification);
+    std::string part;
+    while(std::getline(stream, part, ':'))
+    {
+        parts.push_back(part);
+    }
+    if(parts.size() < 2 || parts.size() > 3 || parts[0].empty())
+    {
+        EXCEPTION("Field encoding " + rSpecification + " should be name:encoding or name:fixed:error_bound");
+    }
+    rName = parts[0];
+    rEncoding = GetEncoding(parts[1]);
+    rErrorBound = 0.0;
+    if(parts.size() == 3)
+    {
+        try
+        {
+            rErrorBound = boost::lexical_cast<double>(parts[2]);
+        }
+        catch(boost::bad_lexical_cast&)
+        {
+            EXCEPTION("Field encoding " + rSpecification + " has a bad error bound");
+        }
+    }
+}
@@ -0,0 +1,362 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef COUPLINGMESSAGE_HPP_
+#define COUPLINGMESSAGE_HPP_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * How a field's values are stored in a coupling message
+ */
+typedef enum FieldEncoding_
+{
+    DOUBLE_ENCODING,     /**< Doubles, lossless */
+    FLOAT_ENCODING,      /**< Single precision floats */
+    FIXED_POINT_ENCODING,/**< Integers on a uniform grid over the field's range, within a given absolute error */
+    BITSET_ENCODING,     /**< One bit per value, for masks holding only 0 and 1 */
+    DELTA_ENCODING       /**< Indices and values of the points changed since the last message, chosen in delta mode */
+} FieldEncoding;
+
+/**
+ * A batch of named fields exchanged between components in a single message.
+ *
+ * The message is one contiguous buffer: a fixed header, a directory with the name,
+ * encoding and offset of each field and then the encoded field values, each on an
+ * 8 byte boundary. Sending one message per step rather than one per field saves the
+ * per-message latency and conduit overhead, which dominates for small grids, and
+ * compact encodings cut the traffic on large grids. Messages describe their own
+ * encodings, so the receiver always decodes what the sender chose.
+ *
+ * In delta mode both ends keep a copy of each field as last exchanged, and a field
+ * is sent as the points that changed by more than a tolerance, unless so many changed
+ * that a full copy is smaller. A message object is used for one direction of one
+ * conduit, so its copies stay in step with the other end.
+ */
+class CouplingMessage
+{
+public:
+
+    /**
+     * Length of the fixed size name fields, including the terminating null
+     */
+    static const unsigned NAME_LENGTH = 48;
+
+    /**
+     * Message header
+     */
+    struct Header
+    {
+        /**
+         * Identifies the message type
+         */
+        char mMagic[8];
+
+        /**
+         * Format version
+         */
+        uint32_t mVersion;
+
+        /**
+         * Number of fields in the message
+         */
+        uint32_t mNumberOfFields;
+
+        /**
+         * Number of values in each field
+         */
+        uint64_t mNumberOfValues;
+
+        /**
+         * Whether everything after the header is zlib compressed
+         */
+        uint32_t mCompressed;
+
+        /**
+         * Whether the sender is in delta mode, so the receiver must keep copies of the fields
+         */
+        uint32_t mDelta;
+
+        /**
+         * Size of the message after the header once uncompressed, in bytes
+         */
+        uint64_t mBodySize;
+    };
+
+    /**
+     * Directory entry
+     */
+    struct DirectoryEntry
+    {
+        /**
+         * Field name
+         */
+        char mName[NAME_LENGTH];
+
+        /**
+         * Offset of the encoded values from the start of the uncompressed message, in bytes
+         */
+        uint64_t mOffset;
+
+        /**
+         * Size of the encoded values, in bytes
+         */
+        uint64_t mSize;
+
+        /**
+         * The FieldEncoding
+         */
+        uint32_t mEncoding;
+
+        /**
+         * Bits per value of fixed point values
+         */
+        uint32_t mBits;
+
+        /**
+         * Value of the lowest fixed point level
+         */
+        double mMinimum;
+
+        /**
+         * Spacing of the fixed point levels
+         */
+        double mStep;
+    };
+
+private:
+
+    /**
+     * Names of the fields added for sending, in order
+     */
+    std::vector<std::string> mNames;
+
+    /**
+     * Values of the fields added for sending, packed by rPack()
+     */
+    std::vector<const double*> mSources;
+
+    /**
+     * Number of values in each field
+     */
+    unsigned mNumberOfValues;
+
+    /**
+     * Encodings and fixed point error bounds for fields that are not sent as doubles
+     */
+    std::map<std::string, std::pair<FieldEncoding, double> > mEncodings;
+
+    /**
+     * Whether packed messages are compressed
+     */
+    bool mCompression;
+
+    /**
+     * The packed or received message, uncompressed
+     */
+    std::vector<char> mBuffer;
+
+    /**
+     * The compressed message, sent or received
+     */
+    std::vector<char> mCompressedBuffer;
+
+    /**
+     * Directory indices of the fields in the buffer, keyed by name
+     */
+    std::map<std::string, unsigned> mIndices;
+
+    /**
+     * Whether changed points are sent rather than full fields
+     */
+    bool mDelta;
+
+    /**
+     * Changes no larger than this are not sent in delta mode
+     */
+    double mDeltaTolerance;
+
+    /**
+     * Fields as last exchanged with the other end, in delta mode
+     */
+    std::map<std::string, std::vector<double> > mLastExchanged;
+
+    /**
+     * Indices of the changed points of each field being packed, in delta mode
+     */
+    std::vector<std::vector<uint32_t> > mChangedIndices;
+
+    /**
+     * Encode a field into the buffer
+     * @param rEntry the field's directory entry, with the encoding, offset and size filled in
+     * @param pValues the values
+     * @param rChangedIndices the changed points, for delta entries
+     */
+    void Encode(DirectoryEntry& rEntry, const double* pValues, const std::vector<uint32_t>& rChangedIndices);
+
+    /**
+     * Decode a field from the buffer. Delta entries are applied to the existing values.
+     * @param rEntry the field's directory entry
+     * @param pDestination the values
+     */
+    void Decode(const DirectoryEntry& rEntry, double* pDestination) const;
+
+public:
+
+    /**
+     * Constructor. An empty message.
+     */
+    CouplingMessage();
+
+    /**
+     * Remove all fields. Encodings are kept, and the buffer keeps its capacity, so a
+     * message can be reused each step.
+     */
+    void Clear();
+
+    /**
+     * Set how a field is encoded when packed. Fields are sent as doubles by default.
+     * @param rName the field name
+     * @param encoding the encoding
+     * @param errorBound the largest absolute error allowed by fixed point encoding
+     */
+    void SetEncoding(const std::string& rName, FieldEncoding encoding, double errorBound = 0.0);
+
+    /**
+     * Set how several fields are encoded, each given as for ParseEncoding()
+     * @param rSpecifications the encodings, for example nutrient:fixed:0.001
+     */
+    void SetEncodings(const std::vector<std::string>& rSpecifications);
+
+    /**
+     * Set whether packed messages are compressed with a fast zlib level. Worthwhile
+     * for fields with large uniform regions.
+     * @param compression compress messages
+     */
+    void SetCompression(bool compression);
+
+    /**
+     * Set whether only the points that changed since the last message are sent. Changes
+     * within the tolerance are held back until they grow beyond it, so the receiver's
+     * copy is always within the tolerance of the sender's fields.
+     * @param delta send changed points only
+     * @param tolerance changes no larger than this are not sent
+     */
+    void SetDeltaEncoding(bool delta, double tolerance = 0.0);
+
+    /**
+     * Add a field to be sent. The values are not copied until the message is packed.
+     * A field added twice is sent once, with the last values given.
+     * @param rName the field name
+     * @param pValues the values, valid until rPack() is called
+     * @param numValues the number of values, the same for every field
+     */
+    void AddField(const std::string& rName, const double* pValues, unsigned numValues);
+
+    /**
+     * @return the names of the fields added for sending, in order
+     */
+    const std::vector<std::string>& rGetAddedFieldNames() const;
+
+    /**
+     * @return the values of the fields added for sending, in the order of rGetAddedFieldNames()
+     */
+    const std::vector<const double*>& rGetAddedFieldValues() const;
+
+    /**
+     * Pack the added fields into a single buffer
+     * @return the message, valid until the message is next changed
+     */
+    const std::vector<char>& rPack();
+
+    /**
+     * Read a received message, which is copied. In delta mode the received changes are
+     * applied to the copies of the fields kept from earlier messages.
+     * @param pData the message
+     * @param numBytes the size of the message
+     */
+    void Unpack(const void* pData, std::size_t numBytes);
+
+    /**
+     * @return the number of values in each field
+     */
+    unsigned GetNumberOfValues() const;
+
+    /**
+     * @return the names of the fields in the packed or received message
+     */
+    std::vector<std::string> GetFieldNames() const;
+
+    /**
+     * @param rName the field name
+     * @return whether the packed or received message has the field
+     */
+    bool HasField(const std::string& rName) const;
+
+    /**
+     * @param rName the field name
+     * @return how the field is encoded in the packed or received message
+     */
+    FieldEncoding GetFieldEncoding(const std::string& rName) const;
+
+    /**
+     * Decode a field in the packed or received message
+     * @param rName the field name
+     * @param pDestination a buffer for GetNumberOfValues() values
+     */
+    void CopyField(const std::string& rName, double* pDestination) const;
+
+    /**
+     * @param rName the name of an encoding: double, float, fixed or bitset
+     * @return the encoding
+     */
+    static FieldEncoding GetEncoding(const std::string& rName);
+
+    /**
+     * Parse a field encoding given as name:encoding, with a trailing :error_bound for fixed point
+     * @param rSpecification the encoding, for example tumour:bitset or nutrient:fixed:0.001
+     * @param rName set to the field name
+     * @param rEncoding set to the encoding
+     * @param rErrorBound set to the error bound, zero if not given
+     */
+    static void ParseEncoding(const std::string& rSpecification, std::string& rName,
+                              FieldEncoding& rEncoding, double& rErrorBound);
+};
+
+#endif /*COUPLINGMESSAGE_HPP_*/
@@ -0,0 +1,87 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "Exception.hpp"
+
+#include "CouplingScheme.hpp"
+
+void CouplingScheme::Couple(const std::string& rSender, const std::string& rOutgoing,
+                            const std::string& rReceiver, const std::string& rIncoming)
+{
+    for(unsigned idx=0; idx<mCouplings.size(); idx++)
+    {
+        if((mCouplings[idx].mSender == rSender && mCouplings[idx].mOutgoing == rOutgoing) ||
+                (mCouplings[idx].mReceiver == rReceiver && mCouplings[idx].mIncoming == rIncoming))
+        {
+            EXCEPTION("Conduit " + rSender + "." + rOutgoing + " -> " + rReceiver + "." + rIncoming +
+                    " reuses a conduit that is already coupled");
+        }
+    }
+    Coupling coupling;
+    coupling.mSender = rSender;
+    coupling.mOutgoing = rOutgoing;
+    coupling.mReceiver = rReceiver;
+    coupling.mIncoming = rIncoming;
+    mCouplings.push_back(coupling);
+}
+
+const std::vector<CouplingScheme::Coupling>& CouplingScheme::rGetCouplings() const
+{
+    return mCouplings;
+}
+
+CouplingScheme CouplingScheme::Hypermodel(bool batched)
+{
+    CouplingScheme scheme;
+    if(batched)
+    {
+        scheme.Couple("CellSimulator", "fields_out", "VesselSimulator", "fields_in");
+        scheme.Couple("VesselSimulator", "fields_out", "MetabolicSimulator", "fields_in");
+        scheme.Couple("MetabolicSimulator", "fields_out", "CellSimulator", "fields_in");
+    }
+    else
+    {
+        const char* cell_fields[6] = {"proliferating", "quiescent", "apoptotic", "necrotic", "differentiated", "tumour"};
+        for(unsigned idx=0; idx<6; idx++)
+        {
+            scheme.Couple("CellSimulator", std::string(cell_fields[idx]) + "_out",
+                          "VesselSimulator", std::string(cell_fields[idx]) + "_in");
+        }
+        scheme.Couple("VesselSimulator", "Nutrient_out", "MetabolicSimulator", "Nutrient_in");
+        scheme.Couple("MetabolicSimulator", "proliferation_rate_factor_out",
+                      "CellSimulator", "proliferation_rate_factor_in");
+    }
+    return scheme;
+}
@@ -0,0 +1,111 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef COUPLINGSCHEME_HPP_
+#define COUPLINGSCHEME_HPP_
+
+#include <vector>
+#include <string>
+
+/**
+ * The conduits between components, as declared by the couple() calls of a .cxa.rb
+ * configuration. Transports that don't go through MUSCLE use a scheme to find out
+ * where each conduit leads.
+ */
+class CouplingScheme
+{
+public:
+
+    /**
+     * A conduit from one component to another
+     */
+    struct Coupling
+    {
+        /**
+         * The sending component
+         */
+        std::string mSender;
+
+        /**
+         * The conduit it sends on
+         */
+        std::string mOutgoing;
+
+        /**
+         * The receiving component
+         */
+        std::string mReceiver;
+
+        /**
+         * The conduit it receives on
+         */
+        std::string mIncoming;
+    };
+
+private:
+
+    /**
+     * The couplings, in the order they were added
+     */
+    std::vector<Coupling> mCouplings;
+
+public:
+
+    /**
+     * Connect an outgoing conduit of one component to an incoming conduit of another,
+     * as sender.couple(receiver, 'outgoing' => 'incoming') does in a .cxa.rb file
+     * @param rSender the sending component
+     * @param rOutgoing the conduit it sends on
+     * @param rReceiver the receiving component
+     * @param rIncoming the conduit it receives on
+     */
+    void Couple(const std::string& rSender, const std::string& rOutgoing,
+                const std::string& rReceiver, const std::string& rIncoming);
+
+    /**
+     * @return the couplings, in the order they were added
+     */
+    const std::vector<Coupling>& rGetCouplings() const;
+
+    /**
+     * The couplings of the cell, vessel and metabolic hypermodel in test/muscle_config.cxa.rb,
+     * between the CellSimulator, VesselSimulator and MetabolicSimulator components
+     * @param batched whether the components send batched messages on fields_out and fields_in
+     * @return the scheme
+     */
+    static CouplingScheme Hypermodel(bool batched);
+};
+
+#endif /*COUPLINGSCHEME_HPP_*/
@@ -0,0 +1,78 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "Exception.hpp"
+#include "FieldRegistry.hpp"
+
+#include "FieldBuffer.hpp"
+
+FieldBuffer::FieldBuffer(unsigned numValues)
+    : mpData(NULL),
+      mNumberOfValues(numValues)
+{
+    // Padded like the registry's own buffers, so kernels can run vector loads to the end
+    std::size_t num_bytes = std::max(numValues, 1u) * sizeof(double);
+    num_bytes = ((num_bytes + FieldRegistry::ALIGNMENT - 1) / FieldRegistry::ALIGNMENT) * FieldRegistry::ALIGNMENT;
+    void* p_buffer = NULL;
+    if(posix_memalign(&p_buffer, FieldRegistry::ALIGNMENT, num_bytes) != 0)
+    {
+        EXCEPTION("Could not allocate storage for a coupled field");
+    }
+    memset(p_buffer, 0, num_bytes);
+    mpData = static_cast<double*>(p_buffer);
+}
+
+FieldBuffer::~FieldBuffer()
+{
+    free(mpData);
+}
+
+double* FieldBuffer::GetData()
+{
+    return mpData;
+}
+
+const double* FieldBuffer::GetData() const
+{
+    return mpData;
+}
+
+unsigned FieldBuffer::GetNumberOfValues() const
+{
+    return mNumberOfValues;
+}
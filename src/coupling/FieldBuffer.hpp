@@ -0,0 +1,95 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef FIELDBUFFER_HPP_
+#define FIELDBUFFER_HPP_
+
+/**
+ * A field's values in their own aligned buffer, which a component can adopt into
+ * its FieldRegistry. Used to hand fields between in-process components without
+ * copying them out at the receiving end.
+ */
+class FieldBuffer
+{
+    /**
+     * The values, FieldRegistry::ALIGNMENT aligned
+     */
+    double* mpData;
+
+    /**
+     * The number of values
+     */
+    unsigned mNumberOfValues;
+
+    /**
+     * Copy constructor, not implemented. The buffer owns its storage.
+     */
+    FieldBuffer(const FieldBuffer&);
+
+    /**
+     * Assignment, not implemented. The buffer owns its storage.
+     */
+    FieldBuffer& operator=(const FieldBuffer&);
+
+public:
+
+    /**
+     * Constructor, the values are zero initialized
+     * @param numValues the number of values
+     */
+    FieldBuffer(unsigned numValues);
+
+    /**
+     * Destructor
+     */
+    ~FieldBuffer();
+
+    /**
+     * @return the values
+     */
+    double* GetData();
+
+    /**
+     * @return the values
+     */
+    const double* GetData() const;
+
+    /**
+     * @return the number of values
+     */
+    unsigned GetNumberOfValues() const;
+};
+
+#endif /*FIELDBUFFER_HPP_*/
@@ -0,0 +1,99 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "Exception.hpp"
+
+#include "GridDecomposition.hpp"
+
+GridDecomposition::GridDecomposition()
+    : mStarts(2, 0),
+      mReplicated(true)
+{
+}
+
+GridDecomposition GridDecomposition::Block(unsigned numPoints, unsigned numProcs)
+{
+    if(numProcs == 0)
+    {
+        EXCEPTION("A grid decomposition needs at least one process");
+    }
+    GridDecomposition decomposition;
+    decomposition.mReplicated = false;
+    decomposition.mStarts.resize(numProcs + 1);
+    decomposition.mStarts[0] = 0;
+    for(unsigned process=0; process<numProcs; process++)
+    {
+        unsigned num_local = numPoints / numProcs + (process < numPoints % numProcs ? 1 : 0);
+        decomposition.mStarts[process + 1] = decomposition.mStarts[process] + num_local;
+    }
+    return decomposition;
+}
+
+GridDecomposition GridDecomposition::Replicated(unsigned numPoints, unsigned numProcs)
+{
+    if(numProcs == 0)
+    {
+        EXCEPTION("A grid decomposition needs at least one process");
+    }
+    GridDecomposition decomposition;
+    decomposition.mStarts.assign(numProcs + 1, 0);
+    decomposition.mStarts[numProcs] = numPoints;
+    return decomposition;
+}
+
+unsigned GridDecomposition::GetNumberOfPoints() const
+{
+    return mStarts.back();
+}
+
+unsigned GridDecomposition::GetNumberOfProcesses() const
+{
+    return unsigned(mStarts.size()) - 1;
+}
+
+bool GridDecomposition::IsReplicated() const
+{
+    return mReplicated;
+}
+
+unsigned GridDecomposition::GetStart(unsigned process) const
+{
+    return mReplicated ? 0 : mStarts[process];
+}
+
+unsigned GridDecomposition::GetEnd(unsigned process) const
+{
+    return mReplicated ? mStarts.back() : mStarts[process + 1];
+}
@@ -0,0 +1,110 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef GRIDDECOMPOSITION_HPP_
+#define GRIDDECOMPOSITION_HPP_
+
+#include <vector>
+
+/**
+ * How the points of a component's fields are divided between its processes. Points
+ * are numbered x fastest, then y, then z, as in the fields themselves. Either every
+ * process holds the whole grid, or each process holds one contiguous block of points,
+ * which for a whole number of xy planes per process is a slab of the grid.
+ */
+class GridDecomposition
+{
+    /**
+     * The first point of each process, followed by the number of points
+     */
+    std::vector<unsigned> mStarts;
+
+    /**
+     * Whether every process holds the whole grid
+     */
+    bool mReplicated;
+
+public:
+
+    /**
+     * Constructor, one process holding the whole of an empty grid
+     */
+    GridDecomposition();
+
+    /**
+     * Divide the points into blocks the way PETSc divides vectors by default, so the
+     * first numPoints % numProcs processes have one extra point
+     * @param numPoints the number of points in the grid
+     * @param numProcs the number of processes
+     * @return the decomposition
+     */
+    static GridDecomposition Block(unsigned numPoints, unsigned numProcs);
+
+    /**
+     * @param numPoints the number of points in the grid
+     * @param numProcs the number of processes
+     * @return a decomposition where every process holds the whole grid
+     */
+    static GridDecomposition Replicated(unsigned numPoints, unsigned numProcs);
+
+    /**
+     * @return the number of points in the grid
+     */
+    unsigned GetNumberOfPoints() const;
+
+    /**
+     * @return the number of processes
+     */
+    unsigned GetNumberOfProcesses() const;
+
+    /**
+     * @return whether every process holds the whole grid
+     */
+    bool IsReplicated() const;
+
+    /**
+     * @param process the process
+     * @return the first point the process holds
+     */
+    unsigned GetStart(unsigned process) const;
+
+    /**
+     * @param process the process
+     * @return one past the last point the process holds
+     */
+    unsigned GetEnd(unsigned process) const;
+};
+
+#endif /*GRIDDECOMPOSITION_HPP_*/
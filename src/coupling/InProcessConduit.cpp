@@ -0,0 +1,225 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "InProcessConduit.hpp"
+
+InProcessConduit::InProcessConduit(const std::string& rName)
+    : mName(rName),
+      mMessages(),
+      mBuffers(),
+      mFreeBytes(),
+      mClosed(false)
+{
+}
+
+const std::string& InProcessConduit::rGetName() const
+{
+    return mName;
+}
+
+std::string InProcessConduit::GetDescription(MessageKind kind)
+{
+    switch(kind)
+    {
+        case FIELD_MESSAGE:
+            return "fields";
+        case FIELDS_MESSAGE:
+            return "batches of fields";
+        default:
+            return "raw messages";
+    }
+}
+
+boost::shared_ptr<FieldBuffer> InProcessConduit::TakeBuffer(unsigned numValues)
+{
+    // Receivers hold their references until they have finished with the values
+    for(unsigned idx=0; idx<mBuffers.size(); idx++)
+    {
+        if(mBuffers[idx].use_count() == 1 && mBuffers[idx]->GetNumberOfValues() == numValues)
+        {
+            return mBuffers[idx];
+        }
+    }
+    mBuffers.push_back(boost::shared_ptr<FieldBuffer>(new FieldBuffer(numValues)));
+    return mBuffers.back();
+}
+
+void InProcessConduit::QueueFields(MessageKind kind, const std::vector<std::string>& rNames,
+                                   const std::vector<const double*>& rValues, unsigned numValues)
+{
+    Message message;
+    message.mKind = kind;
+    message.mNames = rNames;
+    std::unique_lock<std::mutex> lock(mMutex);
+    for(unsigned idx=0; idx<rValues.size(); idx++)
+    {
+        message.mFields.push_back(TakeBuffer(numValues));
+    }
+    lock.unlock();
+
+    // Copy outside the lock, so the receiver isn't held up
+    for(unsigned idx=0; idx<rValues.size(); idx++)
+    {
+        std::copy(rValues[idx], rValues[idx] + numValues, message.mFields[idx]->GetData());
+    }
+    lock.lock();
+    QueueMessage(lock, message);
+}
+
+void InProcessConduit::WaitForMessage(std::unique_lock<std::mutex>& rLock, MessageKind kind, Message& rMessage)
+{
+    mCondition.wait(rLock, [this]{ return mClosed || !mMessages.empty(); });
+    if(mMessages.empty())
+    {
+        EXCEPTION("Coupling conduit " + mName + " was closed before a message arrived");
+    }
+    if(mMessages.front().mKind != kind)
+    {
+        EXCEPTION("Coupling conduit " + mName + " carries " + GetDescription(mMessages.front().mKind) +
+                ", not " + GetDescription(kind));
+    }
+    rMessage.mKind = kind;
+    rMessage.mNames.swap(mMessages.front().mNames);
+    rMessage.mFields.swap(mMessages.front().mFields);
+    rMessage.mBytes.swap(mMessages.front().mBytes);
+    mMessages.pop_front();
+}
+
+void InProcessConduit::QueueMessage(std::unique_lock<std::mutex>& rLock, Message& rMessage)
+{
+    if(!mClosed)
+    {
+        mMessages.push_back(Message());
+        mMessages.back().mKind = rMessage.mKind;
+        mMessages.back().mNames.swap(rMessage.mNames);
+        mMessages.back().mFields.swap(rMessage.mFields);
+        mMessages.back().mBytes.swap(rMessage.mBytes);
+    }
+    rLock.unlock();
+    mCondition.notify_all();
+}
+
+void InProcessConduit::SendField(const double* pValues, unsigned numValues)
+{
+    QueueFields(FIELD_MESSAGE, std::vector<std::string>(), std::vector<const double*>(1, pValues), numValues);
+}
+
+boost::shared_ptr<FieldBuffer> InProcessConduit::ReceiveFieldBuffer(unsigned numValues)
+{
+    Message message;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        WaitForMessage(lock, FIELD_MESSAGE, message);
+    }
+    if(message.mFields[0]->GetNumberOfValues() != numValues)
+    {
+        EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+    }
+    return message.mFields[0];
+}
+
+void InProcessConduit::ReceiveField(double* pValues, unsigned numValues)
+{
+    // The buffer goes back to the pool when it is released here
+    boost::shared_ptr<FieldBuffer> p_buffer = ReceiveFieldBuffer(numValues);
+    std::copy(p_buffer->GetData(), p_buffer->GetData() + numValues, pValues);
+}
+
+void InProcessConduit::SendFields(const std::vector<std::string>& rNames, const std::vector<const double*>& rValues,
+                                  unsigned numValues)
+{
+    QueueFields(FIELDS_MESSAGE, rNames, rValues, numValues);
+}
+
+void InProcessConduit::ReceiveFields(std::map<std::string, boost::shared_ptr<FieldBuffer> >& rFields)
+{
+    Message message;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        WaitForMessage(lock, FIELDS_MESSAGE, message);
+    }
+    rFields.clear();
+    for(unsigned idx=0; idx<message.mNames.size(); idx++)
+    {
+        rFields[message.mNames[idx]] = message.mFields[idx];
+    }
+}
+
+void InProcessConduit::SendMessage(const std::vector<char>& rMessage)
+{
+    Message message;
+    message.mKind = RAW_MESSAGE;
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(!mFreeBytes.empty())
+    {
+        message.mBytes.swap(mFreeBytes.front());
+        mFreeBytes.pop_front();
+    }
+    lock.unlock();
+    message.mBytes.assign(rMessage.begin(), rMessage.end());
+    lock.lock();
+    QueueMessage(lock, message);
+}
+
+void InProcessConduit::ReceiveMessage(std::vector<char>& rMessage)
+{
+    Message message;
+    std::unique_lock<std::mutex> lock(mMutex);
+    WaitForMessage(lock, RAW_MESSAGE, message);
+
+    // The caller's old buffer is kept for a later send
+    rMessage.swap(message.mBytes);
+    mFreeBytes.push_back(std::vector<char>());
+    mFreeBytes.back().swap(message.mBytes);
+}
+
+bool InProcessConduit::HasNext()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]{ return mClosed || !mMessages.empty(); });
+    return !mMessages.empty();
+}
+
+void InProcessConduit::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+    }
+    mCondition.notify_all();
+}
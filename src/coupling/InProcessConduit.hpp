@@ -0,0 +1,240 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef INPROCESSCONDUIT_HPP_
+#define INPROCESSCONDUIT_HPP_
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include "SmartPointers.hpp"
+#include "FieldBuffer.hpp"
+
+/**
+ * A one way link between two components running in the same process. Messages
+ * queue up in order until received. Fields travel in pooled buffers that the
+ * receiver can adopt, and a buffer goes back to the pool once the receiver lets
+ * go of it, so once both ends have run a few steps a field transfer is a single
+ * copy in, made on the sending thread, and no copy or allocation out.
+ */
+class InProcessConduit
+{
+    /**
+     * What a queued message holds
+     */
+    typedef enum MessageKind_
+    {
+        FIELD_MESSAGE,
+        FIELDS_MESSAGE,
+        RAW_MESSAGE
+    } MessageKind;
+
+    /**
+     * A queued message, a field, a batch of named fields or raw bytes
+     */
+    struct Message
+    {
+        /**
+         * What the message holds
+         */
+        MessageKind mKind;
+
+        /**
+         * The field names, for a batch
+         */
+        std::vector<std::string> mNames;
+
+        /**
+         * The fields, one for a field message
+         */
+        std::vector<boost::shared_ptr<FieldBuffer> > mFields;
+
+        /**
+         * The raw bytes
+         */
+        std::vector<char> mBytes;
+    };
+
+    /**
+     * The conduit name, used in error messages
+     */
+    std::string mName;
+
+    /**
+     * Messages waiting to be received
+     */
+    std::deque<Message> mMessages;
+
+    /**
+     * Every field buffer the conduit has made. Those that only the pool refers to are free.
+     */
+    std::vector<boost::shared_ptr<FieldBuffer> > mBuffers;
+
+    /**
+     * Buffers of received raw messages, for reuse by later sends
+     */
+    std::deque<std::vector<char> > mFreeBytes;
+
+    /**
+     * Set once the sender has finished or the run has failed
+     */
+    bool mClosed;
+
+    /**
+     * Protects the queues and the pool
+     */
+    std::mutex mMutex;
+
+    /**
+     * Signalled when a message is queued or the conduit is closed
+     */
+    std::condition_variable mCondition;
+
+    /**
+     * Take a free field buffer from the pool, or add one. Call with the mutex held.
+     * @param numValues the number of values
+     * @return the buffer
+     */
+    boost::shared_ptr<FieldBuffer> TakeBuffer(unsigned numValues);
+
+    /**
+     * Fill pooled buffers with copies of fields and queue them
+     * @param kind the message kind
+     * @param rNames the field names, empty for a field message
+     * @param rValues the values of each field
+     * @param numValues the number of values in each field
+     */
+    void QueueFields(MessageKind kind, const std::vector<std::string>& rNames,
+                     const std::vector<const double*>& rValues, unsigned numValues);
+
+    /**
+     * Wait for the next message and remove it from the queue
+     * @param rLock the held lock
+     * @param kind the kind of message expected
+     * @param rMessage set to the message
+     */
+    void WaitForMessage(std::unique_lock<std::mutex>& rLock, MessageKind kind, Message& rMessage);
+
+    /**
+     * Queue a message
+     * @param rLock the held lock
+     * @param rMessage the message, swapped into the queue
+     */
+    void QueueMessage(std::unique_lock<std::mutex>& rLock, Message& rMessage);
+
+    /**
+     * @param kind a message kind
+     * @return a description of what messages of this kind carry, for error messages
+     */
+    static std::string GetDescription(MessageKind kind);
+
+public:
+
+    /**
+     * Constructor
+     * @param rName the conduit name, used in error messages
+     */
+    InProcessConduit(const std::string& rName);
+
+    /**
+     * @return the conduit name
+     */
+    const std::string& rGetName() const;
+
+    /**
+     * Queue a copy of a field. The copy is a snapshot, as the sender carries on changing
+     * its fields in place. Fields sent after the conduit is closed are dropped.
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    void SendField(const double* pValues, unsigned numValues);
+
+    /**
+     * Wait for a field and hand its buffer over, without copying
+     * @param numValues the number of values expected
+     * @return the field, which returns to the pool once the caller releases it
+     */
+    boost::shared_ptr<FieldBuffer> ReceiveFieldBuffer(unsigned numValues);
+
+    /**
+     * Wait for a field and copy it out
+     * @param pValues filled with the values
+     * @param numValues the number of values expected
+     */
+    void ReceiveField(double* pValues, unsigned numValues);
+
+    /**
+     * Queue copies of several fields as one message, without serialising them.
+     * Messages sent after the conduit is closed are dropped.
+     * @param rNames the field names
+     * @param rValues the values of each field, in the order of rNames
+     * @param numValues the number of values in each field
+     */
+    void SendFields(const std::vector<std::string>& rNames, const std::vector<const double*>& rValues, unsigned numValues);
+
+    /**
+     * Wait for fields sent together and hand their buffers over, without copying
+     * @param rFields set to the fields by name
+     */
+    void ReceiveFields(std::map<std::string, boost::shared_ptr<FieldBuffer> >& rFields);
+
+    /**
+     * Queue a copy of a raw message. Messages sent after the conduit is closed are dropped.
+     * @param rMessage the message
+     */
+    void SendMessage(const std::vector<char>& rMessage);
+
+    /**
+     * Wait for a raw message and swap it out, without copying
+     * @param rMessage set to the message, its previous buffer is recycled
+     */
+    void ReceiveMessage(std::vector<char>& rMessage);
+
+    /**
+     * Wait until a message is queued or the conduit is closed
+     * @return whether there is a message to receive
+     */
+    bool HasNext();
+
+    /**
+     * Mark the end of the messages. Receivers waiting on an empty conduit are released.
+     */
+    void Close();
+};
+
+#endif /*INPROCESSCONDUIT_HPP_*/
@@ -0,0 +1,160 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <thread>
+#include <exception>
+#include "Exception.hpp"
+
+#include "InProcessCoupling.hpp"
+
+InProcessCoupling::InProcessCoupling()
+    : mComponents(),
+      mConduits(),
+      mErrorMessage()
+{
+}
+
+InProcessCoupling::Component& InProcessCoupling::rGetComponent(const std::string& rName)
+{
+    for(unsigned idx=0; idx<mComponents.size(); idx++)
+    {
+        if(mComponents[idx].mName == rName)
+        {
+            return mComponents[idx];
+        }
+    }
+    EXCEPTION("There is no component named " + rName);
+}
+
+void InProcessCoupling::AddComponent(const std::string& rName, boost::shared_ptr<Simulation> pSimulation)
+{
+    for(unsigned idx=0; idx<mComponents.size(); idx++)
+    {
+        if(mComponents[idx].mName == rName)
+        {
+            EXCEPTION("There is already a component named " + rName);
+        }
+    }
+    Component component;
+    component.mName = rName;
+    component.mpSimulation = pSimulation;
+    component.mpTransport.reset(new InProcessCouplingTransport(rName));
+    pSimulation->SetIsStandalone(false);
+    pSimulation->SetCouplingTransport(component.mpTransport);
+    mComponents.push_back(component);
+}
+
+void InProcessCoupling::Couple(const std::string& rSender, const std::string& rOutgoing,
+                               const std::string& rReceiver, const std::string& rIncoming)
+{
+    Component& r_sender = rGetComponent(rSender);
+    Component& r_receiver = rGetComponent(rReceiver);
+    boost::shared_ptr<InProcessConduit> p_conduit(
+            new InProcessConduit(rSender + "." + rOutgoing + " -> " + rReceiver + "." + rIncoming));
+    r_sender.mpTransport->AddOutgoingConduit(rOutgoing, p_conduit);
+    r_receiver.mpTransport->AddIncomingConduit(rIncoming, p_conduit);
+    mConduits.push_back(p_conduit);
+}
+
+void InProcessCoupling::Couple(const CouplingScheme& rScheme)
+{
+    const std::vector<CouplingScheme::Coupling>& r_couplings = rScheme.rGetCouplings();
+    for(unsigned idx=0; idx<r_couplings.size(); idx++)
+    {
+        Couple(r_couplings[idx].mSender, r_couplings[idx].mOutgoing,
+               r_couplings[idx].mReceiver, r_couplings[idx].mIncoming);
+    }
+}
+
+void InProcessCoupling::Fail(const std::string& rName, const std::string& rMessage)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mErrorMessage.empty())
+        {
+            mErrorMessage = "Component " + rName + " failed: " + rMessage;
+        }
+    }
+    for(unsigned idx=0; idx<mConduits.size(); idx++)
+    {
+        mConduits[idx]->Close();
+    }
+}
+
+void InProcessCoupling::RunComponent(unsigned index)
+{
+    Component& r_component = mComponents[index];
+    try
+    {
+        r_component.mpSimulation->Run();
+    }
+    catch(const Exception& e)
+    {
+        Fail(r_component.mName, e.GetShortMessage());
+    }
+    catch(const std::exception& e)
+    {
+        Fail(r_component.mName, e.what());
+    }
+    catch(...)
+    {
+        Fail(r_component.mName, "unknown error");
+    }
+    r_component.mpTransport->CloseOutgoingConduits();
+}
+
+void InProcessCoupling::Run()
+{
+    if(mComponents.empty())
+    {
+        EXCEPTION("No components have been added");
+    }
+    mErrorMessage.clear();
+
+    std::vector<std::thread> threads;
+    for(unsigned idx=0; idx<mComponents.size(); idx++)
+    {
+        threads.push_back(std::thread(&InProcessCoupling::RunComponent, this, idx));
+    }
+    for(unsigned idx=0; idx<threads.size(); idx++)
+    {
+        threads[idx].join();
+    }
+
+    if(!mErrorMessage.empty())
+    {
+        EXCEPTION(mErrorMessage);
+    }
+}
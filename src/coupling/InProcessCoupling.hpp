@@ -0,0 +1,161 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef INPROCESSCOUPLING_HPP_
+#define INPROCESSCOUPLING_HPP_
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include "SmartPointers.hpp"
+#include "Simulation.hpp"
+#include "InProcessConduit.hpp"
+#include "InProcessCouplingTransport.hpp"
+#include "CouplingScheme.hpp"
+
+/**
+ * Runs coupled components in a single process, in place of MUSCLE. Components are
+ * added under the kernel names of a .cxa.rb configuration and wired with the same
+ * couple() calls, so they send and receive on their usual conduits. Transfers go
+ * through in-process conduits rather than being serialised and sent between
+ * processes.
+ *
+ * Each component runs on its own thread. Components block on each other's data, so
+ * they can't share fewer threads without deadlocking a cyclic coupling. When a
+ * component finishes, its outgoing conduits are closed and has_next() on them
+ * becomes false. If a component fails, every conduit is closed so the others stop
+ * at their next receive, and Run() reports the first failure.
+ */
+class InProcessCoupling
+{
+    /**
+     * A component and its end of the conduits
+     */
+    struct Component
+    {
+        /**
+         * The component name
+         */
+        std::string mName;
+
+        /**
+         * The component
+         */
+        boost::shared_ptr<Simulation> mpSimulation;
+
+        /**
+         * The component's conduits
+         */
+        boost::shared_ptr<InProcessCouplingTransport> mpTransport;
+    };
+
+    /**
+     * The components, in the order they were added
+     */
+    std::vector<Component> mComponents;
+
+    /**
+     * All conduits
+     */
+    std::vector<boost::shared_ptr<InProcessConduit> > mConduits;
+
+    /**
+     * The first failure, if any
+     */
+    std::string mErrorMessage;
+
+    /**
+     * Protects the failure message
+     */
+    std::mutex mMutex;
+
+    /**
+     * @param rName the component name
+     * @return the component
+     */
+    Component& rGetComponent(const std::string& rName);
+
+    /**
+     * Run a component and close its outgoing conduits, runs on the component's thread
+     * @param index the index of the component
+     */
+    void RunComponent(unsigned index);
+
+    /**
+     * Record a failure and close every conduit
+     * @param rName the component name
+     * @param rMessage the error
+     */
+    void Fail(const std::string& rName, const std::string& rMessage);
+
+public:
+
+    /**
+     * Constructor
+     */
+    InProcessCoupling();
+
+    /**
+     * Add a component. It is set up to run coupled on in-process conduits.
+     * @param rName the component name, as used in Couple()
+     * @param pSimulation the component
+     */
+    void AddComponent(const std::string& rName, boost::shared_ptr<Simulation> pSimulation);
+
+    /**
+     * Connect an outgoing conduit of one component to an incoming conduit of another,
+     * as sender.couple(receiver, 'outgoing' => 'incoming') does in a .cxa.rb file
+     * @param rSender the sending component
+     * @param rOutgoing the conduit it sends on
+     * @param rReceiver the receiving component
+     * @param rIncoming the conduit it receives on
+     */
+    void Couple(const std::string& rSender, const std::string& rOutgoing,
+                const std::string& rReceiver, const std::string& rIncoming);
+
+    /**
+     * Make every coupling in a scheme
+     * @param rScheme the couplings
+     */
+    void Couple(const CouplingScheme& rScheme);
+
+    /**
+     * Run all components to completion. The conduits are closed afterwards, so only
+     * call this once.
+     */
+    void Run();
+};
+
+#endif /*INPROCESSCOUPLING_HPP_*/
@@ -0,0 +1,131 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "Exception.hpp"
+
+#include "InProcessCouplingTransport.hpp"
+
+InProcessCouplingTransport::InProcessCouplingTransport(const std::string& rComponentName)
+    : mComponentName(rComponentName),
+      mOutgoing(),
+      mIncoming()
+{
+}
+
+InProcessConduit& InProcessCouplingTransport::rGetConduit(
+        const std::map<std::string, boost::shared_ptr<InProcessConduit> >& rConduits,
+        const std::string& rConduit) const
+{
+    std::map<std::string, boost::shared_ptr<InProcessConduit> >::const_iterator it = rConduits.find(rConduit);
+    if(it == rConduits.end())
+    {
+        EXCEPTION("Conduit " + rConduit + " of component " + mComponentName + " is not coupled");
+    }
+    return *(it->second);
+}
+
+void InProcessCouplingTransport::AddOutgoingConduit(const std::string& rConduit, boost::shared_ptr<InProcessConduit> pConduit)
+{
+    if(mOutgoing.count(rConduit) > 0)
+    {
+        EXCEPTION("Conduit " + rConduit + " of component " + mComponentName + " is already coupled");
+    }
+    mOutgoing[rConduit] = pConduit;
+}
+
+void InProcessCouplingTransport::AddIncomingConduit(const std::string& rConduit, boost::shared_ptr<InProcessConduit> pConduit)
+{
+    if(mIncoming.count(rConduit) > 0)
+    {
+        EXCEPTION("Conduit " + rConduit + " of component " + mComponentName + " is already coupled");
+    }
+    mIncoming[rConduit] = pConduit;
+}
+
+void InProcessCouplingTransport::CloseOutgoingConduits()
+{
+    std::map<std::string, boost::shared_ptr<InProcessConduit> >::iterator it;
+    for(it = mOutgoing.begin(); it != mOutgoing.end(); ++it)
+    {
+        it->second->Close();
+    }
+}
+
+void InProcessCouplingTransport::SendField(const std::string& rConduit, const double* pValues, unsigned numValues)
+{
+    rGetConduit(mOutgoing, rConduit).SendField(pValues, numValues);
+}
+
+void InProcessCouplingTransport::ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues)
+{
+    rGetConduit(mIncoming, rConduit).ReceiveField(pValues, numValues);
+}
+
+bool InProcessCouplingTransport::HandsOverFields() const
+{
+    return true;
+}
+
+boost::shared_ptr<FieldBuffer> InProcessCouplingTransport::ReceiveFieldBuffer(const std::string& rConduit, unsigned numValues)
+{
+    return rGetConduit(mIncoming, rConduit).ReceiveFieldBuffer(numValues);
+}
+
+void InProcessCouplingTransport::SendFields(const std::string& rConduit, const std::vector<std::string>& rNames,
+                                            const std::vector<const double*>& rValues, unsigned numValues)
+{
+    rGetConduit(mOutgoing, rConduit).SendFields(rNames, rValues, numValues);
+}
+
+void InProcessCouplingTransport::ReceiveFields(const std::string& rConduit,
+                                               std::map<std::string, boost::shared_ptr<FieldBuffer> >& rFields)
+{
+    rGetConduit(mIncoming, rConduit).ReceiveFields(rFields);
+}
+
+void InProcessCouplingTransport::SendMessage(const std::string& rConduit, const std::vector<char>& rMessage)
+{
+    rGetConduit(mOutgoing, rConduit).SendMessage(rMessage);
+}
+
+void InProcessCouplingTransport::ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage)
+{
+    rGetConduit(mIncoming, rConduit).ReceiveMessage(rMessage);
+}
+
+bool InProcessCouplingTransport::HasNext(const std::string& rConduit)
+{
+    return rGetConduit(mIncoming, rConduit).HasNext();
+}
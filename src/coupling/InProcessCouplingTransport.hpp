@@ -0,0 +1,165 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef INPROCESSCOUPLINGTRANSPORT_HPP_
+#define INPROCESSCOUPLINGTRANSPORT_HPP_
+
+#include <map>
+#include "SmartPointers.hpp"
+#include "AbstractCouplingTransport.hpp"
+#include "InProcessConduit.hpp"
+
+/**
+ * One component's end of the in-process conduits, mapping the component's own
+ * conduit names to the conduits they were coupled to.
+ */
+class InProcessCouplingTransport : public AbstractCouplingTransport
+{
+    /**
+     * The component name, used in error messages
+     */
+    std::string mComponentName;
+
+    /**
+     * Conduits sent on, by conduit name
+     */
+    std::map<std::string, boost::shared_ptr<InProcessConduit> > mOutgoing;
+
+    /**
+     * Conduits received from, by conduit name
+     */
+    std::map<std::string, boost::shared_ptr<InProcessConduit> > mIncoming;
+
+    /**
+     * @param rConduits the outgoing or incoming conduits
+     * @param rConduit the conduit name
+     * @return the conduit
+     */
+    InProcessConduit& rGetConduit(const std::map<std::string, boost::shared_ptr<InProcessConduit> >& rConduits,
+                                  const std::string& rConduit) const;
+
+public:
+
+    /**
+     * Constructor
+     * @param rComponentName the component name
+     */
+    InProcessCouplingTransport(const std::string& rComponentName);
+
+    /**
+     * @param rConduit the name the component sends on
+     * @param pConduit the conduit
+     */
+    void AddOutgoingConduit(const std::string& rConduit, boost::shared_ptr<InProcessConduit> pConduit);
+
+    /**
+     * @param rConduit the name the component receives on
+     * @param pConduit the conduit
+     */
+    void AddIncomingConduit(const std::string& rConduit, boost::shared_ptr<InProcessConduit> pConduit);
+
+    /**
+     * Close the outgoing conduits, once the component has sent everything
+     */
+    void CloseOutgoingConduits();
+
+    /**
+     * Send a field
+     * @param rConduit the conduit
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    void SendField(const std::string& rConduit, const double* pValues, unsigned numValues);
+
+    /**
+     * Receive a field
+     * @param rConduit the conduit
+     * @param pValues filled with the received values
+     * @param numValues the number of values expected
+     */
+    void ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues);
+
+    /**
+     * @return true, fields are handed over between the components
+     */
+    bool HandsOverFields() const;
+
+    /**
+     * Receive a field as a buffer, without copying
+     * @param rConduit the conduit
+     * @param numValues the number of values expected
+     * @return the field
+     */
+    boost::shared_ptr<FieldBuffer> ReceiveFieldBuffer(const std::string& rConduit, unsigned numValues);
+
+    /**
+     * Send several fields together, without serialising them
+     * @param rConduit the conduit
+     * @param rNames the field names
+     * @param rValues the values of each field
+     * @param numValues the number of values in each field
+     */
+    void SendFields(const std::string& rConduit, const std::vector<std::string>& rNames,
+                    const std::vector<const double*>& rValues, unsigned numValues);
+
+    /**
+     * Receive fields sent together, without copying
+     * @param rConduit the conduit
+     * @param rFields set to the fields by name
+     */
+    void ReceiveFields(const std::string& rConduit, std::map<std::string, boost::shared_ptr<FieldBuffer> >& rFields);
+
+    /**
+     * Send a raw message
+     * @param rConduit the conduit
+     * @param rMessage the message
+     */
+    void SendMessage(const std::string& rConduit, const std::vector<char>& rMessage);
+
+    /**
+     * Receive a raw message, swapping the buffer out of the conduit
+     * @param rConduit the conduit
+     * @param rMessage set to the message
+     */
+    void ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage);
+
+    /**
+     * @param rConduit the conduit
+     * @return whether another message will arrive, waits until one does or the sender finishes
+     */
+    bool HasNext(const std::string& rConduit);
+};
+
+#endif /*INPROCESSCOUPLINGTRANSPORT_HPP_*/
@@ -0,0 +1,663 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include "Exception.hpp"
+
+#include "MpiCouplingTransport.hpp"
+
+MpiCouplingTransport::Conduit::Conduit()
+    : mDescription(),
+      mPeerComponent(),
+      mPeer(0),
+      mTag(0),
+      mHasTransfers(false),
+      mNumberOfPoints(0),
+      mTransfers(),
+      mTransferRanks(),
+      mBroadcast(false),
+      mFieldBuffer(),
+      mFieldRequests(),
+      mFieldRequestsActive(false),
+      mFieldReady(false),
+      mMessageBuffer(),
+      mMessageRequest(MPI_REQUEST_NULL),
+      mProbedMessage(MPI_MESSAGE_NULL),
+      mHasProbedMessage(false),
+      mProbedSize(0),
+      mEnded(false)
+{
+}
+
+MpiCouplingTransport::MpiCouplingTransport(const std::string& rComponentName, bool distributedFields)
+    : mComponentName(rComponentName),
+      mCouplingCommunicator(MPI_COMM_NULL),
+      mComponentCommunicator(MPI_COMM_NULL),
+      mTransportCommunicator(MPI_COMM_NULL),
+      mComponentRank(0),
+      mIsRoot(false),
+      mComponentSize(1),
+      mComponentRanks(),
+      mDistributedComponents(),
+      mScheme(),
+      mOutgoing(),
+      mIncoming()
+{
+    int initialised = 0;
+    MPI_Initialized(&initialised);
+    if(!initialised)
+    {
+        EXCEPTION("MPI must be initialised before the MPI coupling transport is created");
+    }
+    MPI_Comm_dup(MPI_COMM_WORLD, &mCouplingCommunicator);
+    MPI_Comm_set_errhandler(mCouplingCommunicator, MPI_ERRORS_RETURN);
+
+    int rank = 0;
+    int num_procs = 0;
+    MPI_Comm_rank(mCouplingCommunicator, &rank);
+    MPI_Comm_size(mCouplingCommunicator, &num_procs);
+
+    // Gather the component name of every process, and whether it divides fields
+    int name_length = int(mComponentName.size());
+    std::vector<int> name_lengths(num_procs);
+    MPI_Allgather(&name_length, 1, MPI_INT, &name_lengths[0], 1, MPI_INT, mCouplingCommunicator);
+    std::vector<int> offsets(num_procs, 0);
+    for(int idx=1; idx<num_procs; idx++)
+    {
+        offsets[idx] = offsets[idx-1] + name_lengths[idx-1];
+    }
+    std::vector<char> names(offsets[num_procs-1] + name_lengths[num_procs-1] + 1);
+    std::vector<char> name(mComponentName.begin(), mComponentName.end());
+    name.push_back('\0');
+    MPI_Allgatherv(&name[0], name_length, MPI_CHAR, &names[0], &name_lengths[0], &offsets[0], MPI_CHAR,
+            mCouplingCommunicator);
+    int distributed = distributedFields ? 1 : 0;
+    std::vector<int> distributed_flags(num_procs);
+    MPI_Allgather(&distributed, 1, MPI_INT, &distributed_flags[0], 1, MPI_INT, mCouplingCommunicator);
+
+    // Processes are grouped by component in order of rank
+    for(int idx=0; idx<num_procs; idx++)
+    {
+        std::string component(&names[offsets[idx]], name_lengths[idx]);
+        mComponentRanks[component].push_back(idx);
+        if(mDistributedComponents.find(component) == mDistributedComponents.end())
+        {
+            mDistributedComponents[component] = (distributed_flags[idx] == 1);
+        }
+        else if(mDistributedComponents[component] != (distributed_flags[idx] == 1))
+        {
+            EXCEPTION("Processes of component " + component + " disagree on whether fields are distributed");
+        }
+    }
+    int colour = int(std::distance(mComponentRanks.begin(), mComponentRanks.find(mComponentName)));
+    MPI_Comm_split(mCouplingCommunicator, colour, rank, &mComponentCommunicator);
+    MPI_Comm_dup(mComponentCommunicator, &mTransportCommunicator);
+
+    MPI_Comm_rank(mComponentCommunicator, &mComponentRank);
+    MPI_Comm_size(mComponentCommunicator, &mComponentSize);
+    mIsRoot = (mComponentRank == 0);
+}
+
+MpiCouplingTransport::~MpiCouplingTransport()
+{
+    int finalised = 0;
+    MPI_Finalized(&finalised);
+    if(finalised)
+    {
+        return;
+    }
+
+    // Finish sending
+    for(std::map<std::string, Conduit>::iterator iter = mOutgoing.begin(); iter != mOutgoing.end(); ++iter)
+    {
+        Conduit& r_conduit = iter->second;
+        MPI_Wait(&r_conduit.mMessageRequest, MPI_STATUS_IGNORE);
+        if(r_conduit.mFieldRequestsActive)
+        {
+            MPI_Waitall(int(r_conduit.mFieldRequests.size()), &r_conduit.mFieldRequests[0], MPI_STATUSES_IGNORE);
+        }
+        for(unsigned idx=0; idx<r_conduit.mFieldRequests.size(); idx++)
+        {
+            MPI_Request_free(&r_conduit.mFieldRequests[idx]);
+        }
+    }
+
+    // End the streams, in place of each field transfer or from the lowest process, including
+    // those of conduits that were never used
+    std::vector<MPI_Request> end_requests;
+    const std::vector<CouplingScheme::Coupling>& r_couplings = mScheme.rGetCouplings();
+    for(unsigned idx=0; idx<r_couplings.size(); idx++)
+    {
+        const CouplingScheme::Coupling& r_coupling = r_couplings[idx];
+        std::map<std::string, std::vector<int> >::const_iterator peer_iter = mComponentRanks.find(r_coupling.mReceiver);
+        if(r_coupling.mSender != mComponentName || peer_iter == mComponentRanks.end())
+        {
+            continue;
+        }
+        std::vector<int> end_ranks;
+        std::map<std::string, Conduit>::const_iterator conduit_iter = mOutgoing.find(r_coupling.mOutgoing);
+        if(conduit_iter != mOutgoing.end() && conduit_iter->second.mHasTransfers)
+        {
+            end_ranks = conduit_iter->second.mTransferRanks;
+        }
+        else if(mIsRoot)
+        {
+            end_ranks.push_back(peer_iter->second[0]);
+        }
+        for(unsigned jdx=0; jdx<end_ranks.size(); jdx++)
+        {
+            end_requests.push_back(MPI_REQUEST_NULL);
+            MPI_Isend(NULL, 0, MPI_BYTE, end_ranks[jdx], int(idx), mCouplingCommunicator, &end_requests.back());
+        }
+    }
+    if(!end_requests.empty())
+    {
+        MPI_Waitall(int(end_requests.size()), &end_requests[0], MPI_STATUSES_IGNORE);
+    }
+
+    // Withdraw receives posted for data that won't be collected
+    for(std::map<std::string, Conduit>::iterator iter = mIncoming.begin(); iter != mIncoming.end(); ++iter)
+    {
+        Conduit& r_conduit = iter->second;
+        for(unsigned idx=0; idx<r_conduit.mFieldRequests.size(); idx++)
+        {
+            if(r_conduit.mFieldRequestsActive)
+            {
+                MPI_Cancel(&r_conduit.mFieldRequests[idx]);
+                MPI_Wait(&r_conduit.mFieldRequests[idx], MPI_STATUS_IGNORE);
+            }
+            MPI_Request_free(&r_conduit.mFieldRequests[idx]);
+        }
+        if(r_conduit.mHasProbedMessage)
+        {
+            std::vector<char> discarded(std::max(r_conduit.mProbedSize, 1));
+            MPI_Mrecv(&discarded[0], r_conduit.mProbedSize, MPI_BYTE, &r_conduit.mProbedMessage, MPI_STATUS_IGNORE);
+        }
+    }
+
+    MPI_Comm_free(&mTransportCommunicator);
+    MPI_Comm_free(&mComponentCommunicator);
+    MPI_Comm_free(&mCouplingCommunicator);
+}
+
+void MpiCouplingTransport::InitialiseMpi(int* pArgc, char*** pArgv)
+{
+    int initialised = 0;
+    MPI_Initialized(&initialised);
+    if(!initialised)
+    {
+        int provided = 0;
+        MPI_Init_thread(pArgc, pArgv, MPI_THREAD_MULTIPLE, &provided);
+    }
+}
+
+bool MpiCouplingTransport::IsThreadSafe()
+{
+    int provided = 0;
+    MPI_Query_thread(&provided);
+    return provided == MPI_THREAD_MULTIPLE;
+}
+
+std::string MpiCouplingTransport::FindOption(int argc, char* argv[], const std::string& rOption)
+{
+    for(int idx=1; idx+1<argc; idx++)
+    {
+        if(rOption == argv[idx])
+        {
+            return argv[idx+1];
+        }
+    }
+    return "";
+}
+
+bool MpiCouplingTransport::IsSelected(int argc, char* argv[])
+{
+    return FindOption(argc, argv, "-coupling_transport") == "mpi";
+}
+
+bool MpiCouplingTransport::AreFieldsDistributed(int argc, char* argv[])
+{
+    std::string value = FindOption(argc, argv, "-distributed_fields");
+    return value == "1" || value == "true";
+}
+
+const std::string& MpiCouplingTransport::rGetComponentName() const
+{
+    return mComponentName;
+}
+
+MPI_Comm MpiCouplingTransport::GetComponentCommunicator() const
+{
+    return mComponentCommunicator;
+}
+
+void MpiCouplingTransport::SetCouplingScheme(const CouplingScheme& rScheme)
+{
+    if(!mOutgoing.empty() || !mIncoming.empty())
+    {
+        EXCEPTION("The coupling scheme can't be changed once conduits are in use");
+    }
+    mScheme = rScheme;
+}
+
+GridDecomposition MpiCouplingTransport::GetDecomposition(unsigned numPoints) const
+{
+    return GetDecomposition(mComponentName, numPoints);
+}
+
+GridDecomposition MpiCouplingTransport::GetDecomposition(const std::string& rComponent, unsigned numPoints) const
+{
+    unsigned num_procs = unsigned(mComponentRanks.find(rComponent)->second.size());
+    if(mDistributedComponents.find(rComponent)->second)
+    {
+        return GridDecomposition::Block(numPoints, num_procs);
+    }
+    return GridDecomposition::Replicated(numPoints, num_procs);
+}
+
+MpiCouplingTransport::Conduit& MpiCouplingTransport::rGetConduit(const std::string& rConduit, bool outgoing)
+{
+    std::map<std::string, Conduit>& r_conduits = outgoing ? mOutgoing : mIncoming;
+    std::map<std::string, Conduit>::iterator iter = r_conduits.find(rConduit);
+    if(iter != r_conduits.end())
+    {
+        return iter->second;
+    }
+
+    const std::vector<CouplingScheme::Coupling>& r_couplings = mScheme.rGetCouplings();
+    for(unsigned idx=0; idx<r_couplings.size(); idx++)
+    {
+        const CouplingScheme::Coupling& r_coupling = r_couplings[idx];
+        bool matches = outgoing ? (r_coupling.mSender == mComponentName && r_coupling.mOutgoing == rConduit) :
+                (r_coupling.mReceiver == mComponentName && r_coupling.mIncoming == rConduit);
+        if(matches)
+        {
+            const std::string& r_peer = outgoing ? r_coupling.mReceiver : r_coupling.mSender;
+            std::map<std::string, std::vector<int> >::const_iterator peer_iter = mComponentRanks.find(r_peer);
+            if(peer_iter == mComponentRanks.end())
+            {
+                EXCEPTION("Conduit " + rConduit + " of component " + mComponentName + " is coupled to " + r_peer +
+                        ", which is not part of this job");
+            }
+            Conduit& r_conduit = r_conduits[rConduit];
+            r_conduit.mDescription = r_coupling.mSender + "." + r_coupling.mOutgoing + " -> " +
+                    r_coupling.mReceiver + "." + r_coupling.mIncoming;
+            r_conduit.mPeerComponent = r_peer;
+            r_conduit.mPeer = peer_iter->second[0];
+            r_conduit.mTag = int(idx);
+            return r_conduit;
+        }
+    }
+    EXCEPTION("Conduit " + rConduit + " of component " + mComponentName + " is not coupled");
+}
+
+void MpiCouplingTransport::SetUpTransfers(Conduit& rConduit, unsigned numPoints, bool outgoing)
+{
+    const std::string& r_sender = outgoing ? mComponentName : rConduit.mPeerComponent;
+    const std::string& r_receiver = outgoing ? rConduit.mPeerComponent : mComponentName;
+    RedistributionSchedule schedule(GetDecomposition(r_sender, numPoints), GetDecomposition(r_receiver, numPoints));
+    rConduit.mTransfers = outgoing ? schedule.rGetSends(mComponentRank) : schedule.rGetReceives(mComponentRank);
+    rConduit.mBroadcast = !outgoing && schedule.ReceiverBroadcasts();
+    rConduit.mNumberOfPoints = numPoints;
+
+    unsigned buffer_size = 0;
+    for(unsigned idx=0; idx<rConduit.mTransfers.size(); idx++)
+    {
+        buffer_size += rConduit.mTransfers[idx].mCount;
+    }
+    rConduit.mFieldBuffer.resize(buffer_size);
+
+    const std::vector<int>& r_peer_ranks = mComponentRanks[rConduit.mPeerComponent];
+    rConduit.mTransferRanks.resize(rConduit.mTransfers.size());
+    rConduit.mFieldRequests.assign(rConduit.mTransfers.size(), MPI_REQUEST_NULL);
+    unsigned offset = 0;
+    for(unsigned idx=0; idx<rConduit.mTransfers.size(); idx++)
+    {
+        const RedistributionSchedule::Transfer& r_transfer = rConduit.mTransfers[idx];
+        rConduit.mTransferRanks[idx] = r_peer_ranks[r_transfer.mProcess];
+        if(outgoing)
+        {
+            CheckMpiError(MPI_Send_init(&rConduit.mFieldBuffer[offset], int(r_transfer.mCount), MPI_DOUBLE,
+                    rConduit.mTransferRanks[idx], rConduit.mTag, mCouplingCommunicator, &rConduit.mFieldRequests[idx]),
+                    rConduit);
+        }
+        else
+        {
+            CheckMpiError(MPI_Recv_init(&rConduit.mFieldBuffer[offset], int(r_transfer.mCount), MPI_DOUBLE,
+                    rConduit.mTransferRanks[idx], rConduit.mTag, mCouplingCommunicator, &rConduit.mFieldRequests[idx]),
+                    rConduit);
+        }
+        offset += r_transfer.mCount;
+    }
+    rConduit.mHasTransfers = true;
+}
+
+void MpiCouplingTransport::CheckMpiError(int error, const Conduit& rConduit) const
+{
+    if(error != MPI_SUCCESS)
+    {
+        char text[MPI_MAX_ERROR_STRING];
+        int length = 0;
+        MPI_Error_string(error, text, &length);
+        EXCEPTION("MPI error on coupling conduit " + rConduit.mDescription + ": " + std::string(text, length));
+    }
+}
+
+void MpiCouplingTransport::ShareError(const std::string& rError) const
+{
+    std::string error = rError;
+    if(mComponentSize > 1)
+    {
+        // The lowest process with an error tells the others
+        int source = error.empty() ? mComponentSize : mComponentRank;
+        MPI_Allreduce(MPI_IN_PLACE, &source, 1, MPI_INT, MPI_MIN, mTransportCommunicator);
+        if(source < mComponentSize)
+        {
+            int length = int(error.size());
+            MPI_Bcast(&length, 1, MPI_INT, source, mTransportCommunicator);
+            error.resize(length);
+            MPI_Bcast(&error[0], length, MPI_CHAR, source, mTransportCommunicator);
+        }
+    }
+    if(!error.empty())
+    {
+        EXCEPTION(error);
+    }
+}
+
+void MpiCouplingTransport::WaitForField(Conduit& rConduit)
+{
+    if(rConduit.mFieldReady || rConduit.mEnded)
+    {
+        return;
+    }
+    unsigned num_transfers = unsigned(rConduit.mTransfers.size());
+    int probed_transfer = -1;
+    if(!rConduit.mFieldRequestsActive)
+    {
+        for(unsigned idx=0; idx<num_transfers; idx++)
+        {
+            // HasNext() may have found the block from the other lowest process before the receives were set up
+            if(rConduit.mHasProbedMessage && rConduit.mTransferRanks[idx] == rConduit.mPeer)
+            {
+                probed_transfer = int(idx);
+                rConduit.mHasProbedMessage = false;
+                if(rConduit.mProbedSize != int(rConduit.mTransfers[idx].mCount * sizeof(double)))
+                {
+                    EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+                }
+                unsigned offset = 0;
+                for(unsigned jdx=0; jdx<idx; jdx++)
+                {
+                    offset += rConduit.mTransfers[jdx].mCount;
+                }
+                CheckMpiError(MPI_Mrecv(&rConduit.mFieldBuffer[offset], int(rConduit.mTransfers[idx].mCount), MPI_DOUBLE,
+                        &rConduit.mProbedMessage, MPI_STATUS_IGNORE), rConduit);
+            }
+            else
+            {
+                CheckMpiError(MPI_Start(&rConduit.mFieldRequests[idx]), rConduit);
+            }
+        }
+        rConduit.mFieldRequestsActive = true;
+    }
+
+    std::vector<MPI_Status> statuses(std::max(num_transfers, 1u));
+    int error = num_transfers == 0 ? int(MPI_SUCCESS) :
+            MPI_Waitall(int(num_transfers), &rConduit.mFieldRequests[0], &statuses[0]);
+    rConduit.mFieldRequestsActive = false;
+    for(unsigned idx=0; idx<num_transfers; idx++)
+    {
+        if(int(idx) == probed_transfer)
+        {
+            continue;
+        }
+        int transfer_error = (error == MPI_ERR_IN_STATUS) ? statuses[idx].MPI_ERROR : error;
+        int error_class = MPI_SUCCESS;
+        MPI_Error_class(transfer_error, &error_class);
+        if(error_class == MPI_ERR_TRUNCATE)
+        {
+            EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+        }
+        CheckMpiError(transfer_error, rConduit);
+        int num_received = 0;
+        MPI_Get_count(&statuses[idx], MPI_DOUBLE, &num_received);
+        if(num_received == 0)
+        {
+            rConduit.mEnded = true;
+        }
+        else if(num_received != int(rConduit.mTransfers[idx].mCount))
+        {
+            EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+        }
+    }
+    rConduit.mFieldReady = !rConduit.mEnded;
+}
+
+void MpiCouplingTransport::ProbeForMessage(Conduit& rConduit)
+{
+    if(rConduit.mHasProbedMessage || rConduit.mEnded)
+    {
+        return;
+    }
+    MPI_Status status;
+    CheckMpiError(MPI_Mprobe(rConduit.mPeer, rConduit.mTag, mCouplingCommunicator, &rConduit.mProbedMessage, &status),
+            rConduit);
+    MPI_Get_count(&status, MPI_BYTE, &rConduit.mProbedSize);
+    if(rConduit.mProbedSize == 0)
+    {
+        CheckMpiError(MPI_Mrecv(NULL, 0, MPI_BYTE, &rConduit.mProbedMessage, MPI_STATUS_IGNORE), rConduit);
+        rConduit.mEnded = true;
+    }
+    else
+    {
+        rConduit.mHasProbedMessage = true;
+    }
+}
+
+void MpiCouplingTransport::SendField(const std::string& rConduit, const double* pValues, unsigned numValues)
+{
+    Conduit& r_conduit = rGetConduit(rConduit, true);
+    if(numValues == 0)
+    {
+        EXCEPTION("Can't send an empty field on coupling conduit " + r_conduit.mDescription);
+    }
+    if(!r_conduit.mHasTransfers)
+    {
+        SetUpTransfers(r_conduit, numValues, true);
+    }
+    else if(numValues != r_conduit.mNumberOfPoints)
+    {
+        EXCEPTION("Fields sent on coupling conduit " + r_conduit.mDescription + " must all have the same number of values");
+    }
+    if(r_conduit.mTransfers.empty())
+    {
+        return;
+    }
+
+    // The previous send has to finish before its buffer is reused
+    if(r_conduit.mFieldRequestsActive)
+    {
+        CheckMpiError(MPI_Waitall(int(r_conduit.mFieldRequests.size()), &r_conduit.mFieldRequests[0],
+                MPI_STATUSES_IGNORE), r_conduit);
+        r_conduit.mFieldRequestsActive = false;
+    }
+    unsigned offset = 0;
+    for(unsigned idx=0; idx<r_conduit.mTransfers.size(); idx++)
+    {
+        const RedistributionSchedule::Transfer& r_transfer = r_conduit.mTransfers[idx];
+        std::memcpy(&r_conduit.mFieldBuffer[offset], pValues + r_transfer.mStart, r_transfer.mCount * sizeof(double));
+        offset += r_transfer.mCount;
+    }
+    CheckMpiError(MPI_Startall(int(r_conduit.mFieldRequests.size()), &r_conduit.mFieldRequests[0]), r_conduit);
+    r_conduit.mFieldRequestsActive = true;
+}
+
+void MpiCouplingTransport::ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues)
+{
+    Conduit& r_conduit = rGetConduit(rConduit, false);
+    std::string error;
+    try
+    {
+        if(!r_conduit.mHasTransfers)
+        {
+            SetUpTransfers(r_conduit, numValues, false);
+        }
+        else if(numValues != r_conduit.mNumberOfPoints)
+        {
+            EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+        }
+        WaitForField(r_conduit);
+        if(r_conduit.mEnded)
+        {
+            EXCEPTION("Coupling conduit " + r_conduit.mDescription + " was closed before a message arrived");
+        }
+        r_conduit.mFieldReady = false;
+
+        unsigned offset = 0;
+        for(unsigned idx=0; idx<r_conduit.mTransfers.size(); idx++)
+        {
+            const RedistributionSchedule::Transfer& r_transfer = r_conduit.mTransfers[idx];
+            std::memcpy(pValues + r_transfer.mStart, &r_conduit.mFieldBuffer[offset], r_transfer.mCount * sizeof(double));
+            offset += r_transfer.mCount;
+        }
+
+        // Post the receives for the next step straight away
+        if(!r_conduit.mTransfers.empty())
+        {
+            CheckMpiError(MPI_Startall(int(r_conduit.mFieldRequests.size()), &r_conduit.mFieldRequests[0]), r_conduit);
+        }
+        r_conduit.mFieldRequestsActive = true;
+    }
+    catch(const Exception& e)
+    {
+        error = e.GetShortMessage();
+    }
+    ShareError(error);
+    if(r_conduit.mBroadcast)
+    {
+        MPI_Bcast(pValues, int(numValues), MPI_DOUBLE, 0, mTransportCommunicator);
+    }
+}
+
+void MpiCouplingTransport::SendMessage(const std::string& rConduit, const std::vector<char>& rMessage)
+{
+    Conduit& r_conduit = rGetConduit(rConduit, true);
+    if(rMessage.empty())
+    {
+        EXCEPTION("Can't send an empty message on coupling conduit " + r_conduit.mDescription);
+    }
+    if(!mIsRoot)
+    {
+        return;
+    }
+
+    // The previous send has to finish before its buffer is reused
+    CheckMpiError(MPI_Wait(&r_conduit.mMessageRequest, MPI_STATUS_IGNORE), r_conduit);
+    r_conduit.mMessageBuffer = rMessage;
+    CheckMpiError(MPI_Isend(&r_conduit.mMessageBuffer[0], int(r_conduit.mMessageBuffer.size()), MPI_BYTE,
+            r_conduit.mPeer, r_conduit.mTag, mCouplingCommunicator, &r_conduit.mMessageRequest), r_conduit);
+}
+
+void MpiCouplingTransport::ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage)
+{
+    Conduit& r_conduit = rGetConduit(rConduit, false);
+    std::string error;
+    int size = 0;
+    if(mIsRoot)
+    {
+        try
+        {
+            if(r_conduit.mHasTransfers)
+            {
+                EXCEPTION("Coupling conduit " + r_conduit.mDescription + " carries fields, not raw messages");
+            }
+            ProbeForMessage(r_conduit);
+            if(r_conduit.mEnded)
+            {
+                EXCEPTION("Coupling conduit " + r_conduit.mDescription + " was closed before a message arrived");
+            }
+            size = r_conduit.mProbedSize;
+            rMessage.resize(size);
+            r_conduit.mHasProbedMessage = false;
+            CheckMpiError(MPI_Mrecv(&rMessage[0], size, MPI_BYTE, &r_conduit.mProbedMessage, MPI_STATUS_IGNORE),
+                    r_conduit);
+        }
+        catch(const Exception& e)
+        {
+            error = e.GetShortMessage();
+        }
+    }
+    ShareError(error);
+    if(mComponentSize > 1)
+    {
+        MPI_Bcast(&size, 1, MPI_INT, 0, mTransportCommunicator);
+        rMessage.resize(size);
+        MPI_Bcast(&rMessage[0], size, MPI_BYTE, 0, mTransportCommunicator);
+    }
+}
+
+bool MpiCouplingTransport::HasNext(const std::string& rConduit)
+{
+    Conduit& r_conduit = rGetConduit(rConduit, false);
+    std::string error;
+    int has_next = 1;
+    try
+    {
+        // Fields arrive in the posted receives, anything else is found with a probe
+        if(r_conduit.mHasTransfers)
+        {
+            WaitForField(r_conduit);
+            has_next = r_conduit.mEnded ? 0 : 1;
+        }
+        else if(mIsRoot)
+        {
+            ProbeForMessage(r_conduit);
+            has_next = r_conduit.mEnded ? 0 : 1;
+        }
+    }
+    catch(const Exception& e)
+    {
+        error = e.GetShortMessage();
+    }
+    ShareError(error);
+    if(mComponentSize > 1)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, &has_next, 1, MPI_INT, MPI_MIN, mTransportCommunicator);
+    }
+    return has_next == 1;
+}
@@ -0,0 +1,404 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef MPICOUPLINGTRANSPORT_HPP_
+#define MPICOUPLINGTRANSPORT_HPP_
+
+#include <map>
+#include <mpi.h>
+#include "AbstractCouplingTransport.hpp"
+#include "CouplingScheme.hpp"
+#include "RedistributionSchedule.hpp"
+
+/**
+ * Couples components launched together as one MPI job, in place of MUSCLE, for
+ * example with
+ *
+ *   mpirun -np 4 CellSimulator -coupling_transport mpi : -np 2 VesselSimulator -coupling_transport mpi : ...
+ *
+ * Each process names the component it runs. Construction splits MPI_COMM_WORLD into a
+ * communicator per component, which the component should use in place of
+ * MPI_COMM_WORLD for its own work, such as PETSc solves. A coupling scheme says which
+ * component is at the other end of each conduit.
+ *
+ * A component either holds whole fields on every process, or divides them between its
+ * processes in blocks (see GridDecomposition). Fields go straight from the processes
+ * that hold each block on the sending side to those that hold it on the receiving
+ * side, following a RedistributionSchedule worked out on the first transfer. Each
+ * transfer of the schedule has a persistent request that is reused every step, and
+ * the receives for the next step are posted as soon as a field has been received. A
+ * component holding whole fields sends from its lowest process, and receives there
+ * then broadcasts to the rest.
+ *
+ * Raw messages vary in size, so they are sent nonblocking between the lowest processes
+ * and matched with a probe. A conduit carries either fields or raw messages. Each
+ * coupling has its own tag. When the transport is destroyed an empty message is sent
+ * in place of each transfer, after which HasNext() is false at the other end.
+ */
+class MpiCouplingTransport : public AbstractCouplingTransport
+{
+    /**
+     * One end of a coupling
+     */
+    struct Conduit
+    {
+        /**
+         * The coupling, as sender.outgoing -> receiver.incoming
+         */
+        std::string mDescription;
+
+        /**
+         * The component at the other end
+         */
+        std::string mPeerComponent;
+
+        /**
+         * The rank of the lowest process of the other component
+         */
+        int mPeer;
+
+        /**
+         * The tag of the coupling
+         */
+        int mTag;
+
+        /**
+         * Whether the field transfers have been set up
+         */
+        bool mHasTransfers;
+
+        /**
+         * The number of points in the fields
+         */
+        unsigned mNumberOfPoints;
+
+        /**
+         * This process's field transfers
+         */
+        std::vector<RedistributionSchedule::Transfer> mTransfers;
+
+        /**
+         * The rank of the process at the other end of each transfer
+         */
+        std::vector<int> mTransferRanks;
+
+        /**
+         * Whether received fields are broadcast to the whole component
+         */
+        bool mBroadcast;
+
+        /**
+         * Field values in flight, transfer after transfer
+         */
+        std::vector<double> mFieldBuffer;
+
+        /**
+         * The persistent request of each transfer
+         */
+        std::vector<MPI_Request> mFieldRequests;
+
+        /**
+         * Whether the field requests have been started and not yet waited for
+         */
+        bool mFieldRequestsActive;
+
+        /**
+         * Whether a field has been received into the buffer and not yet collected
+         */
+        bool mFieldReady;
+
+        /**
+         * A raw message in flight
+         */
+        std::vector<char> mMessageBuffer;
+
+        /**
+         * The send of the raw message in flight
+         */
+        MPI_Request mMessageRequest;
+
+        /**
+         * A message from the lowest process of the other component, found by a probe and
+         * not yet received
+         */
+        MPI_Message mProbedMessage;
+
+        /**
+         * Whether there is a probed message
+         */
+        bool mHasProbedMessage;
+
+        /**
+         * The size of the probed message in bytes
+         */
+        int mProbedSize;
+
+        /**
+         * Whether the empty message that ends the stream has arrived
+         */
+        bool mEnded;
+
+        /**
+         * Constructor
+         */
+        Conduit();
+    };
+
+    /**
+     * The name of this process's component
+     */
+    std::string mComponentName;
+
+    /**
+     * A duplicate of MPI_COMM_WORLD for coupling, so tags don't clash with other traffic
+     */
+    MPI_Comm mCouplingCommunicator;
+
+    /**
+     * The communicator of this process's component
+     */
+    MPI_Comm mComponentCommunicator;
+
+    /**
+     * A duplicate of the component communicator for broadcasts of received data, which
+     * may happen on a communication thread while the component uses its own
+     */
+    MPI_Comm mTransportCommunicator;
+
+    /**
+     * The rank of this process within its component
+     */
+    int mComponentRank;
+
+    /**
+     * Whether this is the lowest process of its component
+     */
+    bool mIsRoot;
+
+    /**
+     * The number of processes in this process's component
+     */
+    int mComponentSize;
+
+    /**
+     * The ranks of the processes of each component, lowest first
+     */
+    std::map<std::string, std::vector<int> > mComponentRanks;
+
+    /**
+     * Whether each component divides its fields between its processes
+     */
+    std::map<std::string, bool> mDistributedComponents;
+
+    /**
+     * The couplings
+     */
+    CouplingScheme mScheme;
+
+    /**
+     * Conduits this component sends on
+     */
+    std::map<std::string, Conduit> mOutgoing;
+
+    /**
+     * Conduits this component receives on
+     */
+    std::map<std::string, Conduit> mIncoming;
+
+    /**
+     * @param rConduit the conduit
+     * @param outgoing whether the component sends on it
+     * @return the conduit, set up from the coupling scheme on first use
+     */
+    Conduit& rGetConduit(const std::string& rConduit, bool outgoing);
+
+    /**
+     * @param rComponent a component
+     * @param numPoints the number of points in the grid
+     * @return how the component divides fields between its processes
+     */
+    GridDecomposition GetDecomposition(const std::string& rComponent, unsigned numPoints) const;
+
+    /**
+     * Work out this process's field transfers on a conduit and set up their requests
+     * @param rConduit the conduit
+     * @param numPoints the number of points in the fields
+     * @param outgoing whether the component sends on the conduit
+     */
+    void SetUpTransfers(Conduit& rConduit, unsigned numPoints, bool outgoing);
+
+    /**
+     * Wait for this process's part of the field in flight on an incoming conduit
+     * @param rConduit the conduit
+     */
+    void WaitForField(Conduit& rConduit);
+
+    /**
+     * Probe for the next message from the other component's lowest process on an
+     * incoming conduit, unless one was found already
+     * @param rConduit the conduit
+     */
+    void ProbeForMessage(Conduit& rConduit);
+
+    /**
+     * Throw if an MPI call failed
+     * @param error the error code
+     * @param rConduit the conduit
+     */
+    void CheckMpiError(int error, const Conduit& rConduit) const;
+
+    /**
+     * Make an error found by any process of the component an error on every process of
+     * the component, so none of them goes on to wait for data
+     * @param rError the error message on this process, empty if there was none
+     */
+    void ShareError(const std::string& rError) const;
+
+    /**
+     * Find an option on the command line, before it has been handed to PETSc
+     * @param argc the number of command line arguments
+     * @param argv the command line arguments
+     * @param rOption the option
+     * @return the value following the option, empty if it isn't there
+     */
+    static std::string FindOption(int argc, char* argv[], const std::string& rOption);
+
+public:
+
+    /**
+     * Constructor. Collective over MPI_COMM_WORLD, each process names its component.
+     * @param rComponentName the name of this process's component, as used in the coupling scheme
+     * @param distributedFields whether the component divides fields between its processes in
+     *     blocks, rather than holding them whole on every process
+     */
+    MpiCouplingTransport(const std::string& rComponentName, bool distributedFields = false);
+
+    /**
+     * Destructor. Completes pending sends and ends the streams on outgoing conduits.
+     * Call before MPI_Finalize().
+     */
+    ~MpiCouplingTransport();
+
+    /**
+     * Initialise MPI, if it isn't already, with support for calls from several threads
+     * so that coupling can run on a communication thread
+     * @param pArgc pointer to the number of command line arguments
+     * @param pArgv pointer to the command line arguments
+     */
+    static void InitialiseMpi(int* pArgc, char*** pArgv);
+
+    /**
+     * @return whether MPI allows calls from several threads at once, needed for asynchronous coupling
+     */
+    static bool IsThreadSafe();
+
+    /**
+     * Find out whether the MPI transport was chosen with -coupling_transport mpi, before
+     * the command line has been handed to PETSc
+     * @param argc the number of command line arguments
+     * @param argv the command line arguments
+     * @return whether the MPI transport was chosen
+     */
+    static bool IsSelected(int argc, char* argv[]);
+
+    /**
+     * Find out whether fields were to be divided between processes with -distributed_fields 1,
+     * before the command line has been handed to PETSc
+     * @param argc the number of command line arguments
+     * @param argv the command line arguments
+     * @return whether fields are divided between processes
+     */
+    static bool AreFieldsDistributed(int argc, char* argv[]);
+
+    /**
+     * @return the name of this process's component
+     */
+    const std::string& rGetComponentName() const;
+
+    /**
+     * @return the communicator of this process's component
+     */
+    MPI_Comm GetComponentCommunicator() const;
+
+    /**
+     * Set the couplings. Every process of a job must use the same scheme.
+     * @param rScheme the couplings
+     */
+    void SetCouplingScheme(const CouplingScheme& rScheme);
+
+    /**
+     * @param numPoints the number of points in the grid
+     * @return how this process's component divides fields between its processes
+     */
+    GridDecomposition GetDecomposition(unsigned numPoints) const;
+
+    /**
+     * Send a field. Only the points this process holds are read.
+     * @param rConduit the conduit
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    void SendField(const std::string& rConduit, const double* pValues, unsigned numValues);
+
+    /**
+     * Receive a field. Only the points this process holds are filled in.
+     * @param rConduit the conduit
+     * @param pValues filled with the received values
+     * @param numValues the number of values expected
+     */
+    void ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues);
+
+    /**
+     * Send a raw message
+     * @param rConduit the conduit
+     * @param rMessage the message, which can't be empty
+     */
+    void SendMessage(const std::string& rConduit, const std::vector<char>& rMessage);
+
+    /**
+     * Receive a raw message
+     * @param rConduit the conduit
+     * @param rMessage set to the message
+     */
+    void ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage);
+
+    /**
+     * @param rConduit the conduit
+     * @return whether another message will arrive, waits until one does or the stream ends
+     */
+    bool HasNext(const std::string& rConduit);
+};
+
+#endif /*MPICOUPLINGTRANSPORT_HPP_*/
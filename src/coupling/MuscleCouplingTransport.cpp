@@ -0,0 +1,70 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include <muscle2/cppmuscle.hpp>
+
+#include "MuscleCouplingTransport.hpp"
+
+void MuscleCouplingTransport::SendField(const std::string& rConduit, const double* pValues, unsigned numValues)
+{
+    muscle::env::sendDoubleVector(rConduit, std::vector<double>(pValues, pValues + numValues));
+}
+
+void MuscleCouplingTransport::ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues)
+{
+    std::vector<double> incoming_vector = muscle::env::receiveDoubleVector(rConduit);
+    CheckNumberOfValues(incoming_vector.size(), numValues);
+    std::copy(incoming_vector.begin(), incoming_vector.end(), pValues);
+}
+
+void MuscleCouplingTransport::SendMessage(const std::string& rConduit, const std::vector<char>& rMessage)
+{
+    muscle::env::send(rConduit, rMessage.empty() ? NULL : &rMessage[0], rMessage.size(), MUSCLE_RAW);
+}
+
+void MuscleCouplingTransport::ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage)
+{
+    std::size_t num_bytes = 0;
+    void* p_data = muscle::env::receive(rConduit, NULL, num_bytes, MUSCLE_RAW);
+    const char* p_bytes = static_cast<const char*>(p_data);
+    rMessage.assign(p_bytes, p_bytes + num_bytes);
+    muscle::env::free_data(p_data, MUSCLE_RAW);
+}
+
+bool MuscleCouplingTransport::HasNext(const std::string& rConduit)
+{
+    return muscle::env::has_next(rConduit);
+}
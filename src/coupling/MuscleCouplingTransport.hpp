@@ -0,0 +1,88 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef MUSCLECOUPLINGTRANSPORT_HPP_
+#define MUSCLECOUPLINGTRANSPORT_HPP_
+
+#include "AbstractCouplingTransport.hpp"
+
+/**
+ * Couples components running as separate MUSCLE kernels. Conduits are those
+ * declared in the .cxa.rb configuration, the MUSCLE environment must be
+ * initialised before the first transfer.
+ */
+class MuscleCouplingTransport : public AbstractCouplingTransport
+{
+
+public:
+
+    /**
+     * Send a field with MUSCLE
+     * @param rConduit the conduit
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    void SendField(const std::string& rConduit, const double* pValues, unsigned numValues);
+
+    /**
+     * Receive a field with MUSCLE
+     * @param rConduit the conduit
+     * @param pValues filled with the received values
+     * @param numValues the number of values expected
+     */
+    void ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues);
+
+    /**
+     * Send a raw message with MUSCLE
+     * @param rConduit the conduit
+     * @param rMessage the message
+     */
+    void SendMessage(const std::string& rConduit, const std::vector<char>& rMessage);
+
+    /**
+     * Receive a raw message with MUSCLE
+     * @param rConduit the conduit
+     * @param rMessage set to the message
+     */
+    void ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage);
+
+    /**
+     * @param rConduit the conduit
+     * @return whether the sender on the conduit has another message to send
+     */
+    bool HasNext(const std::string& rConduit);
+};
+
+#endif /*MUSCLECOUPLINGTRANSPORT_HPP_*/
@@ -0,0 +1,93 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "RedistributionSchedule.hpp"
+
+RedistributionSchedule::RedistributionSchedule(const GridDecomposition& rSender, const GridDecomposition& rReceiver)
+    : mSends(rSender.GetNumberOfProcesses()),
+      mReceives(rReceiver.GetNumberOfProcesses()),
+      mReceiverBroadcasts(rReceiver.IsReplicated() && rReceiver.GetNumberOfProcesses() > 1)
+{
+    if(rSender.GetNumberOfPoints() != rReceiver.GetNumberOfPoints())
+    {
+        EXCEPTION("Number of points in incoming vector does not match number of points in grid");
+    }
+
+    // A component holding the whole grid everywhere takes part through its first process
+    unsigned num_senders = rSender.IsReplicated() ? 1 : rSender.GetNumberOfProcesses();
+    unsigned num_receivers = rReceiver.IsReplicated() ? 1 : rReceiver.GetNumberOfProcesses();
+
+    // Both sides are contiguous blocks in order, so the overlaps are found in one sweep
+    unsigned sender = 0;
+    unsigned receiver = 0;
+    while(sender < num_senders && receiver < num_receivers)
+    {
+        unsigned start = std::max(rSender.GetStart(sender), rReceiver.GetStart(receiver));
+        unsigned end = std::min(rSender.GetEnd(sender), rReceiver.GetEnd(receiver));
+        if(start < end)
+        {
+            Transfer send = {receiver, start, end - start};
+            mSends[sender].push_back(send);
+            Transfer receive = {sender, start, end - start};
+            mReceives[receiver].push_back(receive);
+        }
+        if(rSender.GetEnd(sender) <= rReceiver.GetEnd(receiver))
+        {
+            sender++;
+        }
+        else
+        {
+            receiver++;
+        }
+    }
+}
+
+const std::vector<RedistributionSchedule::Transfer>& RedistributionSchedule::rGetSends(unsigned process) const
+{
+    return mSends[process];
+}
+
+const std::vector<RedistributionSchedule::Transfer>& RedistributionSchedule::rGetReceives(unsigned process) const
+{
+    return mReceives[process];
+}
+
+bool RedistributionSchedule::ReceiverBroadcasts() const
+{
+    return mReceiverBroadcasts;
+}
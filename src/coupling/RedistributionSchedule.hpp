@@ -0,0 +1,122 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef REDISTRIBUTIONSCHEDULE_HPP_
+#define REDISTRIBUTIONSCHEDULE_HPP_
+
+#include <vector>
+#include "GridDecomposition.hpp"
+
+/**
+ * Which blocks of a field each process of a sending component sends to each process
+ * of a receiving component, when the two components divide the grid differently.
+ * Each receiving process gets only the points it holds, from the processes that hold
+ * them on the sending side. A component that holds the whole grid on every process
+ * sends from its first process, and receives on its first process then broadcasts.
+ *
+ * The schedule depends only on the two decompositions, so it is worked out once and
+ * reused for every step.
+ */
+class RedistributionSchedule
+{
+public:
+
+    /**
+     * A block of points moved between two processes
+     */
+    struct Transfer
+    {
+        /**
+         * The process at the other end, numbered within its component
+         */
+        unsigned mProcess;
+
+        /**
+         * The first point
+         */
+        unsigned mStart;
+
+        /**
+         * The number of points
+         */
+        unsigned mCount;
+    };
+
+private:
+
+    /**
+     * The transfers from each sending process, in order of points
+     */
+    std::vector<std::vector<Transfer> > mSends;
+
+    /**
+     * The transfers to each receiving process, in order of points
+     */
+    std::vector<std::vector<Transfer> > mReceives;
+
+    /**
+     * Whether the receiving component broadcasts what its first process receives
+     */
+    bool mReceiverBroadcasts;
+
+public:
+
+    /**
+     * Constructor
+     * @param rSender the decomposition of the sending component
+     * @param rReceiver the decomposition of the receiving component
+     */
+    RedistributionSchedule(const GridDecomposition& rSender, const GridDecomposition& rReceiver);
+
+    /**
+     * @param process a process of the sending component
+     * @return the blocks it sends, numbered by receiving process
+     */
+    const std::vector<Transfer>& rGetSends(unsigned process) const;
+
+    /**
+     * @param process a process of the receiving component
+     * @return the blocks it receives, numbered by sending process
+     */
+    const std::vector<Transfer>& rGetReceives(unsigned process) const;
+
+    /**
+     * @return whether the receiving component holds the whole grid on every process, so
+     * its first process receives the whole field and broadcasts it
+     */
+    bool ReceiverBroadcasts() const;
+};
+
+#endif /*REDISTRIBUTIONSCHEDULE_HPP_*/
@@ -0,0 +1,202 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "RegriddingOperator.hpp"
+
+namespace
+{
+    /**
+     * A source index and its weight along one axis
+     */
+    typedef std::pair<unsigned, double> AxisWeight;
+
+    /**
+     * Work out the weights along one axis
+     * @param method the regridding method
+     * @param numSource the number of source points
+     * @param sourceSpacing the source spacing
+     * @param sourceOrigin the source origin
+     * @param numTarget the number of target points
+     * @param targetSpacing the target spacing
+     * @param targetOrigin the target origin
+     * @param rWeights filled with the weights of each target point
+     */
+    void GetAxisWeights(RegriddingMethod method, unsigned numSource, double sourceSpacing, double sourceOrigin,
+                        unsigned numTarget, double targetSpacing, double targetOrigin,
+                        std::vector<std::vector<AxisWeight> >& rWeights)
+    {
+        rWeights.assign(numTarget, std::vector<AxisWeight>());
+        if(numSource == 0)
+        {
+            return;
+        }
+        for(unsigned target=0; target<numTarget; target++)
+        {
+            std::vector<AxisWeight>& r_weights = rWeights[target];
+            double location = targetOrigin + target * targetSpacing;
+            if(method == CONSERVATIVE_REGRIDDING)
+            {
+                // Lengths of overlap of the voxels, only those in range of the target voxel are visited
+                double lower = location - 0.5 * targetSpacing;
+                double upper = location + 0.5 * targetSpacing;
+                int first = std::max(int(std::floor((lower - sourceOrigin) / sourceSpacing + 0.5)), 0);
+                int last = std::min(int(std::ceil((upper - sourceOrigin) / sourceSpacing - 0.5)), int(numSource) - 1);
+                double total = 0.0;
+                for(int source=first; source<=last; source++)
+                {
+                    double centre = sourceOrigin + source * sourceSpacing;
+                    double overlap = std::min(upper, centre + 0.5 * sourceSpacing) -
+                            std::max(lower, centre - 0.5 * sourceSpacing);
+                    if(overlap > 0.0)
+                    {
+                        r_weights.push_back(AxisWeight(unsigned(source), overlap));
+                        total += overlap;
+                    }
+                }
+                for(unsigned idx=0; idx<r_weights.size(); idx++)
+                {
+                    r_weights[idx].second /= total;
+                }
+            }
+            else
+            {
+                // Points off the grid take the value on its boundary
+                double position = std::min(std::max((location - sourceOrigin) / sourceSpacing, 0.0), double(numSource - 1));
+                unsigned below = std::min(unsigned(position), numSource > 1 ? numSource - 2 : 0u);
+                double fraction = position - below;
+                if(fraction < 1.0)
+                {
+                    r_weights.push_back(AxisWeight(below, 1.0 - fraction));
+                }
+                if(fraction > 0.0)
+                {
+                    r_weights.push_back(AxisWeight(below + 1, fraction));
+                }
+            }
+        }
+    }
+}
+
+RegriddingOperator::RegriddingOperator()
+    : mNumSourcePoints(0),
+      mRowStarts(1, 0),
+      mColumns(),
+      mWeights()
+{
+}
+
+RegriddingOperator::RegriddingOperator(RegriddingMethod method,
+                                       const c_vector<unsigned, 3>& rSourceSize, double sourceSpacing,
+                                       const c_vector<double, 3>& rSourceOrigin,
+                                       const c_vector<unsigned, 3>& rTargetSize, double targetSpacing,
+                                       const c_vector<double, 3>& rTargetOrigin)
+    : mNumSourcePoints(rSourceSize[0] * rSourceSize[1] * rSourceSize[2]),
+      mRowStarts(1, 0),
+      mColumns(),
+      mWeights()
+{
+    if(sourceSpacing <= 0.0 || targetSpacing <= 0.0)
+    {
+        EXCEPTION("Grids must have a positive spacing to be regridded");
+    }
+
+    std::vector<std::vector<AxisWeight> > axis_weights[3];
+    for(unsigned axis=0; axis<3; axis++)
+    {
+        GetAxisWeights(method, rSourceSize[axis], sourceSpacing, rSourceOrigin[axis],
+                rTargetSize[axis], targetSpacing, rTargetOrigin[axis], axis_weights[axis]);
+    }
+
+    // Each row is the product of the weights along the three axes
+    unsigned num_target = rTargetSize[0] * rTargetSize[1] * rTargetSize[2];
+    mRowStarts.reserve(num_target + 1);
+    for(unsigned kdx=0; kdx<rTargetSize[2]; kdx++)
+    {
+        for(unsigned jdx=0; jdx<rTargetSize[1]; jdx++)
+        {
+            for(unsigned idx=0; idx<rTargetSize[0]; idx++)
+            {
+                const std::vector<AxisWeight>& r_z = axis_weights[2][kdx];
+                const std::vector<AxisWeight>& r_y = axis_weights[1][jdx];
+                const std::vector<AxisWeight>& r_x = axis_weights[0][idx];
+                for(unsigned c=0; c<r_z.size(); c++)
+                {
+                    for(unsigned b=0; b<r_y.size(); b++)
+                    {
+                        for(unsigned a=0; a<r_x.size(); a++)
+                        {
+                            mColumns.push_back(r_x[a].first + rSourceSize[0] * (r_y[b].first + rSourceSize[1] * r_z[c].first));
+                            mWeights.push_back(r_x[a].second * r_y[b].second * r_z[c].second);
+                        }
+                    }
+                }
+                mRowStarts.push_back(mColumns.size());
+            }
+        }
+    }
+}
+
+unsigned RegriddingOperator::GetNumberOfSourcePoints() const
+{
+    return mNumSourcePoints;
+}
+
+unsigned RegriddingOperator::GetNumberOfTargetPoints() const
+{
+    return mRowStarts.size() - 1;
+}
+
+unsigned RegriddingOperator::GetNumberOfWeights() const
+{
+    return mWeights.size();
+}
+
+void RegriddingOperator::Apply(const double* pSource, double* pTarget) const
+{
+    unsigned num_target = mRowStarts.size() - 1;
+    for(unsigned target=0; target<num_target; target++)
+    {
+        double value = 0.0;
+        for(unsigned idx=mRowStarts[target]; idx<mRowStarts[target + 1]; idx++)
+        {
+            value += mWeights[idx] * pSource[mColumns[idx]];
+        }
+        pTarget[target] = value;
+    }
+}
@@ -0,0 +1,131 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef REGRIDDINGOPERATOR_HPP_
+#define REGRIDDINGOPERATOR_HPP_
+
+#include <vector>
+#include "UblasVectorInclude.hpp"
+
+/**
+ * How a field is carried between grids of different resolution
+ */
+typedef enum RegriddingMethod_
+{
+    CONSERVATIVE_REGRIDDING, /**< Volume weighted averages of the overlapping voxels, keeps the integral of populations */
+    TRILINEAR_REGRIDDING     /**< Trilinear interpolation at the points, for smooth fields such as the nutrient */
+} RegriddingMethod;
+
+/**
+ * Carries fields from one regular grid to another, for components that run at different
+ * resolutions. The weights are worked out once and kept as a sparse matrix with a row
+ * per target point, so each transfer is a single pass over the non-zeros.
+ *
+ * Each point stands for the voxel of one spacing centred on it. Conservative weights are
+ * the volumes of overlap of the target voxel with the source voxels, scaled to sum to
+ * one, so when the target voxels are covered by the source the integral over the grid is
+ * kept. Target voxels outside the source grid are set to zero. Trilinear weights are those of the eight surrounding source points, with target
+ * points outside the source grid taking the nearest value on its boundary. Both are a
+ * product of weights along each axis.
+ */
+class RegriddingOperator
+{
+    /**
+     * The number of source points
+     */
+    unsigned mNumSourcePoints;
+
+    /**
+     * The first weight of each target point, followed by the number of weights
+     */
+    std::vector<unsigned> mRowStarts;
+
+    /**
+     * The source point of each weight
+     */
+    std::vector<unsigned> mColumns;
+
+    /**
+     * The weights
+     */
+    std::vector<double> mWeights;
+
+public:
+
+    /**
+     * Constructor, an operator between empty grids
+     */
+    RegriddingOperator();
+
+    /**
+     * Constructor
+     * @param method the regridding method
+     * @param rSourceSize the number of source grid points in each direction
+     * @param sourceSpacing the source grid spacing
+     * @param rSourceOrigin the source grid origin
+     * @param rTargetSize the number of target grid points in each direction
+     * @param targetSpacing the target grid spacing
+     * @param rTargetOrigin the target grid origin
+     */
+    RegriddingOperator(RegriddingMethod method,
+                       const c_vector<unsigned, 3>& rSourceSize, double sourceSpacing,
+                       const c_vector<double, 3>& rSourceOrigin,
+                       const c_vector<unsigned, 3>& rTargetSize, double targetSpacing,
+                       const c_vector<double, 3>& rTargetOrigin);
+
+    /**
+     * @return the number of source points
+     */
+    unsigned GetNumberOfSourcePoints() const;
+
+    /**
+     * @return the number of target points
+     */
+    unsigned GetNumberOfTargetPoints() const;
+
+    /**
+     * @return the number of non-zero weights
+     */
+    unsigned GetNumberOfWeights() const;
+
+    /**
+     * Carry a field to the target grid
+     * @param pSource the values at the source points
+     * @param pTarget filled with the values at the target points
+     */
+    void Apply(const double* pSource, double* pTarget) const;
+};
+
+#endif /*REGRIDDINGOPERATOR_HPP_*/
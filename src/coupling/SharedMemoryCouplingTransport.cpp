@@ -0,0 +1,223 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include "Exception.hpp"
+
+#include "SharedMemoryCouplingTransport.hpp"
+
+namespace
+{
+    /**
+     * The frame kind of a field
+     */
+    const uint32_t FIELD_FRAME = 1;
+
+    /**
+     * The frame kind of a raw message
+     */
+    const uint32_t RAW_FRAME = 2;
+
+    /**
+     * Written before each message
+     */
+    struct Frame
+    {
+        /**
+         * The kind of message
+         */
+        uint32_t mKind;
+
+        /**
+         * Padding
+         */
+        uint32_t mPadding;
+
+        /**
+         * The message size in bytes
+         */
+        uint64_t mSize;
+    };
+
+    /**
+     * @param rName a conduit or channel name
+     * @param rSuffix a suffix
+     * @return whether the name ends with the suffix
+     */
+    bool EndsWith(const std::string& rName, const std::string& rSuffix)
+    {
+        return rName.size() > rSuffix.size() &&
+                rName.compare(rName.size() - rSuffix.size(), rSuffix.size(), rSuffix) == 0;
+    }
+}
+
+SharedMemoryCouplingTransport::SharedMemoryCouplingTransport(const std::string& rSession, std::size_t capacity)
+    : mSession(rSession),
+      mCapacity(capacity),
+      mChannels(),
+      mRings()
+{
+    if(rSession.empty() || rSession.find('/') != std::string::npos)
+    {
+        EXCEPTION("Shared memory session name " + rSession + " should be non-empty and contain no slashes");
+    }
+}
+
+void SharedMemoryCouplingTransport::SetChannel(const std::string& rConduit, const std::string& rChannel)
+{
+    if(rChannel.empty() || rChannel.find('/') != std::string::npos)
+    {
+        EXCEPTION("Shared memory channel name " + rChannel + " should be non-empty and contain no slashes");
+    }
+    if(mRings.count(rConduit) > 0)
+    {
+        EXCEPTION("Conduit " + rConduit + " is already in use");
+    }
+    mChannels[rConduit] = rChannel;
+}
+
+std::string SharedMemoryCouplingTransport::GetChannel(const std::string& rConduit) const
+{
+    std::map<std::string, std::string>::const_iterator it = mChannels.find(rConduit);
+    if(it != mChannels.end())
+    {
+        return it->second;
+    }
+    if(EndsWith(rConduit, "_out"))
+    {
+        return rConduit.substr(0, rConduit.size() - 4);
+    }
+    if(EndsWith(rConduit, "_in"))
+    {
+        return rConduit.substr(0, rConduit.size() - 3);
+    }
+    EXCEPTION("Conduit " + rConduit + " should end in _out or _in");
+}
+
+void SharedMemoryCouplingTransport::ParseChannel(const std::string& rSpecification, std::string& rConduit,
+                                                 std::string& rChannel)
+{
+    std::size_t colon = rSpecification.find(':');
+    if(colon == std::string::npos || colon == 0 || colon + 1 == rSpecification.size())
+    {
+        EXCEPTION("Shared memory channel " + rSpecification + " should be given as conduit:channel");
+    }
+    rConduit = rSpecification.substr(0, colon);
+    rChannel = rSpecification.substr(colon + 1);
+}
+
+SharedMemoryRing& SharedMemoryCouplingTransport::rGetRing(const std::string& rConduit)
+{
+    boost::shared_ptr<SharedMemoryRing>& rp_ring = mRings[rConduit];
+    if(!rp_ring)
+    {
+        try
+        {
+            SharedMemoryRing::End end = EndsWith(rConduit, "_in") ? SharedMemoryRing::READER_END :
+                    SharedMemoryRing::WRITER_END;
+            rp_ring.reset(new SharedMemoryRing("/" + mSession + "_" + GetChannel(rConduit), end, mCapacity));
+        }
+        catch(const Exception&)
+        {
+            mRings.erase(rConduit);
+            throw;
+        }
+    }
+    return *rp_ring;
+}
+
+void SharedMemoryCouplingTransport::WriteFrame(SharedMemoryRing& rRing, bool isField, uint64_t numBytes)
+{
+    Frame frame;
+    frame.mKind = isField ? FIELD_FRAME : RAW_FRAME;
+    frame.mPadding = 0;
+    frame.mSize = numBytes;
+    rRing.Write(&frame, sizeof(frame));
+}
+
+uint64_t SharedMemoryCouplingTransport::ReadFrame(SharedMemoryRing& rRing, bool isField)
+{
+    Frame frame;
+    rRing.Read(&frame, sizeof(frame));
+    if(frame.mKind != FIELD_FRAME && frame.mKind != RAW_FRAME)
+    {
+        EXCEPTION("Shared memory conduit " + rRing.rGetName() + " is out of step with its sender");
+    }
+    if((frame.mKind == FIELD_FRAME) != isField)
+    {
+        EXCEPTION("Shared memory conduit " + rRing.rGetName() + (isField ? " carries raw messages, not fields" :
+                " carries fields, not raw messages"));
+    }
+    return frame.mSize;
+}
+
+void SharedMemoryCouplingTransport::SendField(const std::string& rConduit, const double* pValues, unsigned numValues)
+{
+    SharedMemoryRing& r_ring = rGetRing(rConduit);
+    WriteFrame(r_ring, true, uint64_t(numValues) * sizeof(double));
+    r_ring.Write(pValues, numValues * sizeof(double));
+}
+
+void SharedMemoryCouplingTransport::ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues)
+{
+    SharedMemoryRing& r_ring = rGetRing(rConduit);
+    uint64_t num_bytes = ReadFrame(r_ring, true);
+    CheckNumberOfValues(num_bytes / sizeof(double), numValues);
+    r_ring.Read(pValues, num_bytes);
+}
+
+void SharedMemoryCouplingTransport::SendMessage(const std::string& rConduit, const std::vector<char>& rMessage)
+{
+    SharedMemoryRing& r_ring = rGetRing(rConduit);
+    WriteFrame(r_ring, false, rMessage.size());
+    if(!rMessage.empty())
+    {
+        r_ring.Write(&rMessage[0], rMessage.size());
+    }
+}
+
+void SharedMemoryCouplingTransport::ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage)
+{
+    SharedMemoryRing& r_ring = rGetRing(rConduit);
+    rMessage.resize(ReadFrame(r_ring, false));
+    if(!rMessage.empty())
+    {
+        r_ring.Read(&rMessage[0], rMessage.size());
+    }
+}
+
+bool SharedMemoryCouplingTransport::HasNext(const std::string& rConduit)
+{
+    return rGetRing(rConduit).WaitForData();
+}
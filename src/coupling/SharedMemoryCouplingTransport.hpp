@@ -0,0 +1,166 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef SHAREDMEMORYCOUPLINGTRANSPORT_HPP_
+#define SHAREDMEMORYCOUPLINGTRANSPORT_HPP_
+
+#include <map>
+#include "SmartPointers.hpp"
+#include "AbstractCouplingTransport.hpp"
+#include "SharedMemoryRing.hpp"
+
+/**
+ * Couples components running as separate processes on the same machine, through
+ * shared memory rings rather than MUSCLE. Each conduit maps to a channel, and a
+ * component's _out conduit reaches the component whose _in conduit maps to the same
+ * channel. By default the channel is the conduit name without its _out or _in suffix,
+ * so proliferating_out reaches proliferating_in. Conduits that share a name between
+ * several pairs of components, such as fields_out, need a channel set for each pair.
+ *
+ * Channels live in segments named /<session>_<channel>, so separate runs on the same
+ * machine need separate session names. Rings are attached on first use.
+ */
+class SharedMemoryCouplingTransport : public AbstractCouplingTransport
+{
+    /**
+     * The session name
+     */
+    std::string mSession;
+
+    /**
+     * The capacity of each ring in bytes
+     */
+    std::size_t mCapacity;
+
+    /**
+     * Channels set for conduits
+     */
+    std::map<std::string, std::string> mChannels;
+
+    /**
+     * Attached rings, by conduit name
+     */
+    std::map<std::string, boost::shared_ptr<SharedMemoryRing> > mRings;
+
+    /**
+     * @param rConduit the conduit
+     * @return the ring for the conduit, attaching to it on first use
+     */
+    SharedMemoryRing& rGetRing(const std::string& rConduit);
+
+    /**
+     * Write the frame that starts a message
+     * @param rRing the ring
+     * @param isField whether the message is a field
+     * @param numBytes the size of the message in bytes
+     */
+    static void WriteFrame(SharedMemoryRing& rRing, bool isField, uint64_t numBytes);
+
+    /**
+     * Read the frame that starts a message
+     * @param rRing the ring
+     * @param isField whether a field is expected
+     * @return the size of the message in bytes
+     */
+    static uint64_t ReadFrame(SharedMemoryRing& rRing, bool isField);
+
+public:
+
+    /**
+     * Constructor
+     * @param rSession the session name, both ends of each channel must use the same one
+     * @param capacity the capacity of each ring in bytes, both ends must agree
+     */
+    SharedMemoryCouplingTransport(const std::string& rSession = "chic", std::size_t capacity = 1048576);
+
+    /**
+     * Set the channel a conduit connects to, in place of the default
+     * @param rConduit the conduit
+     * @param rChannel the channel
+     */
+    void SetChannel(const std::string& rConduit, const std::string& rChannel);
+
+    /**
+     * @param rConduit the conduit
+     * @return the channel the conduit connects to
+     */
+    std::string GetChannel(const std::string& rConduit) const;
+
+    /**
+     * Parse a channel given as conduit:channel, as on the command line
+     * @param rSpecification the specification
+     * @param rConduit set to the conduit
+     * @param rChannel set to the channel
+     */
+    static void ParseChannel(const std::string& rSpecification, std::string& rConduit, std::string& rChannel);
+
+    /**
+     * Send a field
+     * @param rConduit the conduit
+     * @param pValues the values
+     * @param numValues the number of values
+     */
+    void SendField(const std::string& rConduit, const double* pValues, unsigned numValues);
+
+    /**
+     * Receive a field
+     * @param rConduit the conduit
+     * @param pValues filled with the received values
+     * @param numValues the number of values expected
+     */
+    void ReceiveField(const std::string& rConduit, double* pValues, unsigned numValues);
+
+    /**
+     * Send a raw message
+     * @param rConduit the conduit
+     * @param rMessage the message
+     */
+    void SendMessage(const std::string& rConduit, const std::vector<char>& rMessage);
+
+    /**
+     * Receive a raw message
+     * @param rConduit the conduit
+     * @param rMessage set to the message
+     */
+    void ReceiveMessage(const std::string& rConduit, std::vector<char>& rMessage);
+
+    /**
+     * @param rConduit the conduit
+     * @return whether another message will arrive, waits until one does or the sender detaches
+     */
+    bool HasNext(const std::string& rConduit);
+};
+
+#endif /*SHAREDMEMORYCOUPLINGTRANSPORT_HPP_*/
@@ -0,0 +1,356 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <new>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "Exception.hpp"
+
+#include "SharedMemoryRing.hpp"
+
+/**
+ * The start of the segment. Positions count bytes since the ring was created, so
+ * the data between the read and write positions is waiting to be read.
+ */
+struct SharedMemoryRing::Header
+{
+    /**
+     * Set once the creator has initialised the segment
+     */
+    std::atomic<uint32_t> mReady;
+
+    /**
+     * The ring capacity in bytes
+     */
+    uint64_t mCapacity;
+
+    /**
+     * Bytes written
+     */
+    std::atomic<uint64_t> mWritePosition;
+
+    /**
+     * Bytes read
+     */
+    std::atomic<uint64_t> mReadPosition;
+
+    /**
+     * Moved on whenever the writer writes or detaches, the reader sleeps on it
+     */
+    std::atomic<uint32_t> mWriteSequence;
+
+    /**
+     * Moved on whenever the reader reads or detaches, the writer sleeps on it
+     */
+    std::atomic<uint32_t> mReadSequence;
+
+    /**
+     * Whether the reader is asleep
+     */
+    std::atomic<uint32_t> mReaderWaiting;
+
+    /**
+     * Whether the writer is asleep
+     */
+    std::atomic<uint32_t> mWriterWaiting;
+
+    /**
+     * Set when the writer detaches
+     */
+    std::atomic<uint32_t> mWriterClosed;
+
+    /**
+     * Set when the reader detaches
+     */
+    std::atomic<uint32_t> mReaderClosed;
+
+    /**
+     * The writer's process id, zero until it attaches
+     */
+    std::atomic<int32_t> mWriterPid;
+
+    /**
+     * The reader's process id, zero until it attaches
+     */
+    std::atomic<int32_t> mReaderPid;
+
+    /**
+     * The number of attached ends
+     */
+    std::atomic<uint32_t> mNumberAttached;
+};
+
+namespace
+{
+    /**
+     * The space reserved for the header, keeping the ring cache line aligned
+     */
+    const std::size_t HEADER_SIZE = 256;
+
+    /**
+     * How long to sleep before checking on the other end, in milliseconds
+     */
+    const long CHECK_INTERVAL = 200;
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string& rName, End end, std::size_t capacity)
+    : mName(rName),
+      mEnd(end),
+      mCapacity(capacity),
+      mpSegment(NULL),
+      mpHeader(NULL),
+      mpData(NULL)
+{
+    if(capacity == 0)
+    {
+        EXCEPTION("Shared memory conduit " + mName + " needs a non-zero capacity");
+    }
+    std::size_t segment_size = HEADER_SIZE + capacity;
+
+    // Create the segment, or wait for the other end to finish creating it
+    bool created = false;
+    int fd = shm_open(mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd >= 0)
+    {
+        created = true;
+        if(ftruncate(fd, segment_size) != 0)
+        {
+            close(fd);
+            shm_unlink(mName.c_str());
+            EXCEPTION("Could not size shared memory conduit " + mName);
+        }
+    }
+    else if(errno == EEXIST)
+    {
+        fd = shm_open(mName.c_str(), O_RDWR, 0600);
+        struct stat status;
+        memset(&status, 0, sizeof(status));
+        int stat_result = 0;
+        while(fd >= 0 && (stat_result = fstat(fd, &status)) == 0 && status.st_size == 0)
+        {
+            usleep(1000);
+        }
+        if(fd >= 0 && stat_result != 0)
+        {
+            close(fd);
+            EXCEPTION("Could not open shared memory conduit " + mName);
+        }
+        if(fd >= 0 && std::size_t(status.st_size) != segment_size)
+        {
+            close(fd);
+            EXCEPTION("Shared memory conduit " + mName + " was created with a different capacity");
+        }
+    }
+    if(fd < 0)
+    {
+        EXCEPTION("Could not open shared memory conduit " + mName);
+    }
+
+    mpSegment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mpSegment == MAP_FAILED)
+    {
+        mpSegment = NULL;
+        EXCEPTION("Could not map shared memory conduit " + mName);
+    }
+    mpHeader = static_cast<Header*>(mpSegment);
+    mpData = static_cast<char*>(mpSegment) + HEADER_SIZE;
+
+    // The segment starts zeroed, which is a valid initial state for the atomics
+    if(created)
+    {
+        new(mpHeader) Header();
+        mpHeader->mCapacity = capacity;
+        mpHeader->mReady.store(1);
+    }
+    while(mpHeader->mReady.load() == 0)
+    {
+        usleep(1000);
+    }
+
+    // Each end can only be taken once, a taken end means a live run or a crashed one
+    std::atomic<int32_t>& r_pid = (mEnd == WRITER_END) ? mpHeader->mWriterPid : mpHeader->mReaderPid;
+    int32_t no_pid = 0;
+    if(!r_pid.compare_exchange_strong(no_pid, int32_t(getpid())))
+    {
+        munmap(mpSegment, segment_size);
+        mpSegment = NULL;
+        EXCEPTION("Shared memory conduit " + mName + " already has a " +
+                (mEnd == WRITER_END ? "sender" : "receiver") +
+                ", remove /dev/shm" + mName + " if it is left over from an earlier run");
+    }
+    mpHeader->mNumberAttached++;
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    if(!mpSegment)
+    {
+        return;
+    }
+    if(mEnd == WRITER_END)
+    {
+        mpHeader->mWriterClosed.store(1);
+        Wake(mpHeader->mWriteSequence, mpHeader->mReaderWaiting);
+    }
+    else
+    {
+        mpHeader->mReaderClosed.store(1);
+        Wake(mpHeader->mReadSequence, mpHeader->mWriterWaiting);
+    }
+    // A writer that finishes before the reader arrives leaves its data behind for it
+    if(--mpHeader->mNumberAttached == 0 && mpHeader->mReaderPid.load() != 0)
+    {
+        shm_unlink(mName.c_str());
+    }
+    munmap(mpSegment, HEADER_SIZE + mCapacity);
+}
+
+const std::string& SharedMemoryRing::rGetName() const
+{
+    return mName;
+}
+
+void SharedMemoryRing::Wait(std::atomic<uint32_t>& rSequence, std::atomic<uint32_t>& rWaiting, uint32_t sequence)
+{
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = CHECK_INTERVAL * 1000000L;
+    rWaiting.store(1);
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&rSequence), FUTEX_WAIT, sequence, &timeout, NULL, 0);
+    rWaiting.store(0);
+    if(result != 0 && errno == ETIMEDOUT)
+    {
+        CheckOtherEnd();
+    }
+}
+
+void SharedMemoryRing::Wake(std::atomic<uint32_t>& rSequence, std::atomic<uint32_t>& rWaiting)
+{
+    rSequence++;
+    if(rWaiting.load() != 0)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&rSequence), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+void SharedMemoryRing::CheckOtherEnd()
+{
+    bool writer = (mEnd == WRITER_END);
+    int32_t pid = writer ? mpHeader->mReaderPid.load() : mpHeader->mWriterPid.load();
+    bool closed = writer ? mpHeader->mReaderClosed.load() != 0 : mpHeader->mWriterClosed.load() != 0;
+    if(pid != 0 && !closed && kill(pid, 0) != 0 && errno == ESRCH)
+    {
+        EXCEPTION("The " + std::string(writer ? "receiver" : "sender") + " on shared memory conduit " +
+                mName + " has exited");
+    }
+}
+
+void SharedMemoryRing::Write(const void* pData, std::size_t numBytes)
+{
+    const char* p_bytes = static_cast<const char*>(pData);
+    while(numBytes > 0)
+    {
+        uint32_t sequence = mpHeader->mReadSequence.load();
+        if(mpHeader->mReaderClosed.load() != 0)
+        {
+            EXCEPTION("The receiver on shared memory conduit " + mName + " has closed");
+        }
+        uint64_t write_position = mpHeader->mWritePosition.load();
+        std::size_t space = mCapacity - std::size_t(write_position - mpHeader->mReadPosition.load());
+        if(space == 0)
+        {
+            Wait(mpHeader->mReadSequence, mpHeader->mWriterWaiting, sequence);
+            continue;
+        }
+
+        // Copy up to the end of the ring, the rest wraps round on the next pass
+        std::size_t offset = write_position % mCapacity;
+        std::size_t num_copied = std::min(std::min(numBytes, space), mCapacity - offset);
+        memcpy(mpData + offset, p_bytes, num_copied);
+        mpHeader->mWritePosition.store(write_position + num_copied);
+        Wake(mpHeader->mWriteSequence, mpHeader->mReaderWaiting);
+        p_bytes += num_copied;
+        numBytes -= num_copied;
+    }
+}
+
+void SharedMemoryRing::Read(void* pData, std::size_t numBytes)
+{
+    char* p_bytes = static_cast<char*>(pData);
+    while(numBytes > 0)
+    {
+        if(!WaitForData())
+        {
+            EXCEPTION("Shared memory conduit " + mName + " was closed before a message arrived");
+        }
+        uint64_t read_position = mpHeader->mReadPosition.load();
+        std::size_t available = std::size_t(mpHeader->mWritePosition.load() - read_position);
+        std::size_t offset = read_position % mCapacity;
+        std::size_t num_copied = std::min(std::min(numBytes, available), mCapacity - offset);
+        memcpy(p_bytes, mpData + offset, num_copied);
+        mpHeader->mReadPosition.store(read_position + num_copied);
+        Wake(mpHeader->mReadSequence, mpHeader->mWriterWaiting);
+        p_bytes += num_copied;
+        numBytes -= num_copied;
+    }
+}
+
+bool SharedMemoryRing::WaitForData()
+{
+    while(true)
+    {
+        uint32_t sequence = mpHeader->mWriteSequence.load();
+        if(mpHeader->mWritePosition.load() != mpHeader->mReadPosition.load())
+        {
+            return true;
+        }
+        if(mpHeader->mWriterClosed.load() != 0)
+        {
+            return false;
+        }
+        Wait(mpHeader->mWriteSequence, mpHeader->mReaderWaiting, sequence);
+    }
+}
@@ -0,0 +1,168 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef SHAREDMEMORYRING_HPP_
+#define SHAREDMEMORYRING_HPP_
+
+#include <string>
+#include <cstddef>
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * A single producer, single consumer byte stream between two processes on the same
+ * machine, in a POSIX shared memory segment. Whichever end attaches first creates the
+ * segment, and it is removed once both ends have detached. Data is written and read
+ * in order through a ring of fixed capacity, so messages of any size can be streamed
+ * through it. An end that has to wait, for data or for space, sleeps on a futex in
+ * the segment and is woken by the other end. Nothing but the Linux kernel is needed.
+ *
+ * While waiting, the other end's process is checked now and then, so a crash on one
+ * side is reported rather than leaving the other side waiting forever.
+ */
+class SharedMemoryRing
+{
+public:
+
+    /**
+     * Which end of the ring this is
+     */
+    enum End
+    {
+        WRITER_END,
+        READER_END
+    };
+
+    /**
+     * The shared segment header
+     */
+    struct Header;
+
+private:
+
+    /**
+     * The segment name
+     */
+    std::string mName;
+
+    /**
+     * Which end this is
+     */
+    End mEnd;
+
+    /**
+     * The capacity of the ring in bytes
+     */
+    std::size_t mCapacity;
+
+    /**
+     * The mapped segment
+     */
+    void* mpSegment;
+
+    /**
+     * The segment header, at the start of the segment
+     */
+    Header* mpHeader;
+
+    /**
+     * The ring, after the header
+     */
+    char* mpData;
+
+    /**
+     * Sleep until a sequence number moves on, the other end is checked if this takes a while
+     * @param rSequence the sequence number
+     * @param rWaiting the count of waiters at this end, so the other end knows to wake it
+     * @param sequence the value seen before deciding to wait
+     */
+    void Wait(std::atomic<uint32_t>& rSequence, std::atomic<uint32_t>& rWaiting, uint32_t sequence);
+
+    /**
+     * Move a sequence number on and wake the other end if it is waiting
+     * @param rSequence the sequence number
+     * @param rWaiting the count of waiters at the other end
+     */
+    static void Wake(std::atomic<uint32_t>& rSequence, std::atomic<uint32_t>& rWaiting);
+
+    /**
+     * Throw if the process at the other end has gone without detaching
+     */
+    void CheckOtherEnd();
+
+public:
+
+    /**
+     * Attach to a ring, creating it if the other end hasn't yet. Waits for the other end
+     * to finish creating the segment if it got there first.
+     * @param rName the segment name, beginning with a slash
+     * @param end which end this is
+     * @param capacity the ring capacity in bytes, both ends must agree
+     */
+    SharedMemoryRing(const std::string& rName, End end, std::size_t capacity);
+
+    /**
+     * Detach, closing this end. Pending data is still delivered after the writer detaches.
+     */
+    ~SharedMemoryRing();
+
+    /**
+     * @return the segment name
+     */
+    const std::string& rGetName() const;
+
+    /**
+     * Write bytes, waiting for space as needed. Throws once the reader has detached, as
+     * the bytes would be lost.
+     * @param pData the bytes
+     * @param numBytes the number of bytes
+     */
+    void Write(const void* pData, std::size_t numBytes);
+
+    /**
+     * Read bytes, waiting for them as needed
+     * @param pData filled with the bytes
+     * @param numBytes the number of bytes
+     */
+    void Read(void* pData, std::size_t numBytes);
+
+    /**
+     * Wait until there is data to read or the writer has detached
+     * @return whether there is data to read
+     */
+    bool WaitForData();
+};
+
+#endif /*SHAREDMEMORYRING_HPP_*/
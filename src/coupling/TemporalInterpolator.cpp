@@ -0,0 +1,152 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "TemporalInterpolator.hpp"
+
+TemporalInterpolator::TemporalInterpolator(unsigned order)
+    : mOrder(order),
+      mNumValues(0),
+      mTimes(),
+      mSnapshots()
+{
+    if(order > 2)
+    {
+        EXCEPTION("Coupled fields can only be interpolated with order 0, 1 or 2");
+    }
+}
+
+unsigned TemporalInterpolator::GetOrder() const
+{
+    return mOrder;
+}
+
+unsigned TemporalInterpolator::GetNumberOfSnapshots() const
+{
+    return mTimes.size();
+}
+
+void TemporalInterpolator::Clear()
+{
+    mTimes.clear();
+    mSnapshots.clear();
+}
+
+void TemporalInterpolator::AddSnapshot(double time, const double* pValues, unsigned numValues)
+{
+    if(!mTimes.empty() && numValues != mNumValues)
+    {
+        EXCEPTION("Snapshots of a coupled field must all have the same number of values");
+    }
+    if(!mTimes.empty() && time <= mTimes.back())
+    {
+        EXCEPTION("Snapshots of a coupled field must be added in time order");
+    }
+    mNumValues = numValues;
+
+    // Once full, the oldest buffer is moved to the back and overwritten
+    if(mTimes.size() == mOrder + 1)
+    {
+        std::rotate(mTimes.begin(), mTimes.begin() + 1, mTimes.end());
+        std::rotate(mSnapshots.begin(), mSnapshots.begin() + 1, mSnapshots.end());
+        mTimes.back() = time;
+    }
+    else
+    {
+        mTimes.push_back(time);
+        mSnapshots.push_back(std::vector<double>());
+    }
+    mSnapshots.back().assign(pValues, pValues + numValues);
+}
+
+void TemporalInterpolator::Interpolate(double time, double* pValues) const
+{
+    if(mTimes.empty())
+    {
+        EXCEPTION("There are no snapshots of the coupled field to interpolate");
+    }
+    if(mNumValues == 0)
+    {
+        return;
+    }
+
+    // Lagrange weights, so each point is a weighted sum of its snapshots
+    unsigned num_snapshots = mTimes.size();
+    std::vector<double> weights(num_snapshots, 1.0);
+    for(unsigned idx=0; idx<num_snapshots; idx++)
+    {
+        for(unsigned jdx=0; jdx<num_snapshots; jdx++)
+        {
+            if(jdx != idx)
+            {
+                weights[idx] *= (time - mTimes[jdx]) / (mTimes[idx] - mTimes[jdx]);
+            }
+        }
+    }
+
+    const double* p_first = &mSnapshots[0][0];
+    for(unsigned point=0; point<mNumValues; point++)
+    {
+        pValues[point] = weights[0] * p_first[point];
+    }
+    for(unsigned idx=1; idx<num_snapshots; idx++)
+    {
+        const double* p_snapshot = &mSnapshots[idx][0];
+        double weight = weights[idx];
+        for(unsigned point=0; point<mNumValues; point++)
+        {
+            pValues[point] += weight * p_snapshot[point];
+        }
+    }
+
+    // Past the last snapshot the polynomial extrapolates, so keep each point within the
+    // range of its snapshots. Populations stay positive and fractions within [0, 1].
+    if(num_snapshots > 1)
+    {
+        for(unsigned point=0; point<mNumValues; point++)
+        {
+            double lower = p_first[point];
+            double upper = p_first[point];
+            for(unsigned idx=1; idx<num_snapshots; idx++)
+            {
+                lower = std::min(lower, mSnapshots[idx][point]);
+                upper = std::max(upper, mSnapshots[idx][point]);
+            }
+            pValues[point] = std::min(std::max(pValues[point], lower), upper);
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TEMPORALINTERPOLATOR_HPP_
+#define TEMPORALINTERPOLATOR_HPP_
+
+#include <vector>
+
+/**
+ * Holds the last few snapshots of a coupled field and evaluates the polynomial through
+ * them at any time, so a component that steps more often than its peer can follow the
+ * peer's fields between exchanges. Order 0 holds the last snapshot, order 1 is linear
+ * and order 2 quadratic in time. Past the last snapshot the polynomial extrapolates, so
+ * each value is clamped to the range of the snapshots it was evaluated from.
+ */
+class TemporalInterpolator
+{
+    /**
+     * The interpolation order
+     */
+    unsigned mOrder;
+
+    /**
+     * The number of values in each snapshot
+     */
+    unsigned mNumValues;
+
+    /**
+     * The snapshot times, oldest first
+     */
+    std::vector<double> mTimes;
+
+    /**
+     * The snapshots, oldest first. The buffers are reused as snapshots are replaced.
+     */
+    std::vector<std::vector<double> > mSnapshots;
+
+public:
+
+    /**
+     * Constructor
+     * @param order the interpolation order, 0, 1 or 2
+     */
+    TemporalInterpolator(unsigned order = 0);
+
+    /**
+     * @return the interpolation order
+     */
+    unsigned GetOrder() const;
+
+    /**
+     * @return the number of snapshots held, at most order + 1
+     */
+    unsigned GetNumberOfSnapshots() const;
+
+    /**
+     * Drop all the snapshots
+     */
+    void Clear();
+
+    /**
+     * Add a snapshot, replacing the oldest once order + 1 are held
+     * @param time the time of the snapshot, later than any held
+     * @param pValues the values
+     * @param numValues the number of values, the same for every snapshot
+     */
+    void AddSnapshot(double time, const double* pValues, unsigned numValues);
+
+    /**
+     * Evaluate the fields at a time. Until enough snapshots are held the order is
+     * reduced to fit the ones there are. Each value is clamped to the range of its
+     * snapshots.
+     * @param time the time
+     * @param pValues filled with the values
+     */
+    void Interpolate(double time, double* pValues) const;
+};
+
+#endif /*TEMPORALINTERPOLATOR_HPP_*/
@@ -0,0 +1,200 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstring>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include "Exception.hpp"
+
+#include "AsyncOutputWriter.hpp"
+
+AsyncOutputWriter::AsyncOutputWriter(vtkImageData* pGeometry,
+                                     const std::vector<std::string>& rFieldNames,
+                                     ImageWriter writeImage,
+                                     unsigned numberOfSlots)
+    : mSlots(),
+      mHead(0),
+      mTail(0),
+      mStop(false),
+      mWriteImage(writeImage),
+      mMutex(),
+      mCondition(),
+      mErrorMessage(),
+      mThread()
+{
+    if(numberOfSlots == 0)
+    {
+        EXCEPTION("At least one output slot is required");
+    }
+
+    unsigned num_points = pGeometry->GetNumberOfPoints();
+    for(unsigned idx=0; idx<numberOfSlots; idx++)
+    {
+        boost::shared_ptr<Slot> p_slot(new Slot);
+        p_slot->mFields.Reset(num_points);
+        p_slot->mpImage = vtkSmartPointer<vtkImageData>::New();
+        p_slot->mpImage->SetOrigin(pGeometry->GetOrigin()[0], pGeometry->GetOrigin()[1], pGeometry->GetOrigin()[2]);
+        p_slot->mpImage->SetSpacing(pGeometry->GetSpacing()[0], pGeometry->GetSpacing()[1], pGeometry->GetSpacing()[2]);
+        p_slot->mpImage->SetDimensions(pGeometry->GetDimensions()[0], pGeometry->GetDimensions()[1], pGeometry->GetDimensions()[2]);
+        for(unsigned jdx=0; jdx<rFieldNames.size(); jdx++)
+        {
+            unsigned handle = p_slot->mFields.Register(rFieldNames[jdx]);
+            vtkSmartPointer<vtkDoubleArray> p_point_data = vtkSmartPointer<vtkDoubleArray>::New();
+            p_point_data->SetNumberOfComponents(1);
+            p_point_data->SetArray(p_slot->mFields.GetField(handle), num_points, 1);
+            p_point_data->SetName(rFieldNames[jdx].c_str());
+            p_slot->mpImage->GetPointData()->AddArray(p_point_data);
+        }
+        mSlots.push_back(p_slot);
+    }
+
+    mThread = std::thread(&AsyncOutputWriter::WriterLoop, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter()
+{
+    // Don't throw from the destructor, errors should be collected with Flush()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]{ return mTail.load() == mHead.load(); });
+    }
+    mStop = true;
+    Notify();
+    mThread.join();
+}
+
+void AsyncOutputWriter::Post(const std::string& rFilename, double time, const std::vector<const double*>& rFields)
+{
+    ThrowIfFailed();
+
+    // Wait for a free slot
+    unsigned head = mHead.load(std::memory_order_relaxed);
+    if(head - mTail.load(std::memory_order_acquire) >= mSlots.size())
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this, head]{ return head - mTail.load(std::memory_order_acquire) < mSlots.size(); });
+    }
+
+    Slot& r_slot = *mSlots[head % mSlots.size()];
+    if(rFields.size() != r_slot.mFields.GetNumberOfFields())
+    {
+        EXCEPTION("Number of fields posted does not match the output writer set up");
+    }
+    std::size_t num_bytes = r_slot.mFields.GetNumberOfPoints() * sizeof(double);
+    for(unsigned idx=0; idx<rFields.size(); idx++)
+    {
+        memcpy(r_slot.mFields.GetField(idx), rFields[idx], num_bytes);
+    }
+    r_slot.mFilename = rFilename;
+    r_slot.mTime = time;
+
+    mHead.store(head + 1, std::memory_order_release);
+    Notify();
+}
+
+void AsyncOutputWriter::Flush()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]{ return mTail.load() == mHead.load(); });
+    }
+    ThrowIfFailed();
+}
+
+void AsyncOutputWriter::WriterLoop()
+{
+    while(true)
+    {
+        unsigned tail = mTail.load(std::memory_order_relaxed);
+        if(tail == mHead.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this, tail]{ return mStop.load() || tail != mHead.load(std::memory_order_acquire); });
+            if(tail == mHead.load(std::memory_order_acquire))
+            {
+                return;
+            }
+        }
+
+        Slot& r_slot = *mSlots[tail % mSlots.size()];
+        try
+        {
+            r_slot.mpImage->Modified();
+            mWriteImage(r_slot.mpImage, r_slot.mFilename, r_slot.mTime);
+        }
+        catch(const Exception& e)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mErrorMessage.empty())
+            {
+                mErrorMessage = e.GetShortMessage();
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mErrorMessage.empty())
+            {
+                mErrorMessage = "Error writing " + r_slot.mFilename;
+            }
+        }
+
+        mTail.store(tail + 1, std::memory_order_release);
+        Notify();
+    }
+}
+
+void AsyncOutputWriter::ThrowIfFailed()
+{
+    std::string message;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        message.swap(mErrorMessage);
+    }
+    if(!message.empty())
+    {
+        EXCEPTION("Asynchronous output failed: " + message);
+    }
+}
+
+void AsyncOutputWriter::Notify()
+{
+    // Taking the lock orders the index update before any waiter re-checks its predicate
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mCondition.notify_all();
+}
@@ -0,0 +1,192 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef ASYNCOUTPUTWRITER_HPP_
+#define ASYNCOUTPUTWRITER_HPP_
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <boost/function.hpp>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include "SmartPointers.hpp"
+#include "FieldRegistry.hpp"
+
+/**
+ * Writes snapshots of the solution fields on a background thread, so that a
+ * simulation can carry on with the next step while the previous one is being
+ * compressed and written. Snapshots are copied into a fixed ring of slots, two
+ * by default, which gives double buffering. The ring indices are lock-free, a
+ * mutex is only used to park a thread that has nothing to do.
+ */
+class AsyncOutputWriter
+{
+public:
+
+    /**
+     * Function used to write an image at a given time to a file, called on the writer thread
+     */
+    typedef boost::function<void (vtkImageData*, const std::string&, double)> ImageWriter;
+
+private:
+
+    /**
+     * A snapshot buffer, with an image that wraps its field copies
+     */
+    struct Slot
+    {
+        /**
+         * Copies of the fields
+         */
+        FieldRegistry mFields;
+
+        /**
+         * Image with arrays wrapping mFields
+         */
+        vtkSmartPointer<vtkImageData> mpImage;
+
+        /**
+         * The file to write the snapshot to
+         */
+        std::string mFilename;
+
+        /**
+         * The time of the snapshot
+         */
+        double mTime;
+    };
+
+    /**
+     * The snapshot slots
+     */
+    std::vector<boost::shared_ptr<Slot> > mSlots;
+
+    /**
+     * Number of snapshots posted, the next slot to fill is mHead modulo the number of slots
+     */
+    std::atomic<unsigned> mHead;
+
+    /**
+     * Number of snapshots written
+     */
+    std::atomic<unsigned> mTail;
+
+    /**
+     * Set to stop the writer thread
+     */
+    std::atomic<bool> mStop;
+
+    /**
+     * The function that writes each image
+     */
+    ImageWriter mWriteImage;
+
+    /**
+     * Mutex for parking threads and for the error message
+     */
+    std::mutex mMutex;
+
+    /**
+     * Signalled whenever mHead or mTail changes
+     */
+    std::condition_variable mCondition;
+
+    /**
+     * The first error raised on the writer thread
+     */
+    std::string mErrorMessage;
+
+    /**
+     * The writer thread
+     */
+    std::thread mThread;
+
+public:
+
+    /**
+     * Constructor. Starts the writer thread.
+     * @param pGeometry image providing the origin, spacing and dimensions of the output
+     * @param rFieldNames the names of the fields in each snapshot
+     * @param writeImage the function used to write each image
+     * @param numberOfSlots the number of snapshots that can be queued
+     */
+    AsyncOutputWriter(vtkImageData* pGeometry,
+                      const std::vector<std::string>& rFieldNames,
+                      ImageWriter writeImage,
+                      unsigned numberOfSlots = 2);
+
+    /**
+     * Destructor. Writes any queued snapshots and stops the writer thread.
+     */
+    ~AsyncOutputWriter();
+
+    /**
+     * Copy the fields into a free slot and queue them for writing. Blocks only if
+     * all slots are still waiting to be written.
+     * @param rFilename the output file
+     * @param time the time of the snapshot
+     * @param rFields one buffer per field name, in the order given on construction
+     */
+    void Post(const std::string& rFilename, double time, const std::vector<const double*>& rFields);
+
+    /**
+     * Wait until every posted snapshot has been written
+     */
+    void Flush();
+
+private:
+
+    /**
+     * The writer thread main loop
+     */
+    void WriterLoop();
+
+    /**
+     * Raise any error reported by the writer thread
+     */
+    void ThrowIfFailed();
+
+    /**
+     * Wake up any parked thread
+     */
+    void Notify();
+};
+
+#endif /*ASYNCOUTPUTWRITER_HPP_*/
@@ -0,0 +1,329 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Exception.hpp"
+
+#include "BinaryFieldFile.hpp"
+
+namespace
+{
+    /**
+     * Identifies the file type
+     */
+    const char MAGIC[8] = {'C', 'H', 'I', 'C', 'B', 'I', 'N', '\0'};
+
+    /**
+     * Current format version
+     */
+    const uint32_t VERSION = 1;
+
+    /**
+     * Alignment of the tables and arrays in bytes
+     */
+    const uint64_t BLOCK_SIZE = 64;
+
+    /**
+     * Space reserved for the header
+     */
+    const uint64_t HEADER_SIZE = 128;
+
+    /**
+     * @param offset an offset in bytes
+     * @return the offset rounded up to a whole number of blocks
+     */
+    uint64_t RoundUp(uint64_t offset)
+    {
+        return ((offset + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+    }
+
+    /**
+     * Copy a name into a fixed size field
+     * @param rName the name
+     * @param pDestination the field, NAME_LENGTH long
+     */
+    void CopyName(const std::string& rName, char* pDestination)
+    {
+        if(rName.size() >= BinaryFieldFile::NAME_LENGTH)
+        {
+            EXCEPTION("Name " + rName + " is too long for a binary field file");
+        }
+        memset(pDestination, 0, BinaryFieldFile::NAME_LENGTH);
+        memcpy(pDestination, rName.c_str(), rName.size());
+    }
+
+    /**
+     * Write zeros up to an offset
+     * @param rFile the file
+     * @param offset the offset
+     */
+    void PadTo(std::ofstream& rFile, uint64_t offset)
+    {
+        static const char zeros[BLOCK_SIZE] = {0};
+        uint64_t position = rFile.tellp();
+        while(position < offset)
+        {
+            uint64_t num_bytes = std::min(offset - position, BLOCK_SIZE);
+            rFile.write(zeros, num_bytes);
+            position += num_bytes;
+        }
+    }
+}
+
+BinaryFieldFile::BinaryFieldFile(const std::string& rFilename)
+    : mpMapping(MAP_FAILED),
+      mMappingSize(0),
+      mpHeader(NULL),
+      mArrayOffsets(),
+      mArrayNames(),
+      mScalars()
+{
+    int file_descriptor = open(rFilename.c_str(), O_RDONLY);
+    if(file_descriptor < 0)
+    {
+        EXCEPTION("Could not open binary field file " + rFilename);
+    }
+
+    struct stat file_status;
+    if(fstat(file_descriptor, &file_status) != 0 || uint64_t(file_status.st_size) < HEADER_SIZE)
+    {
+        close(file_descriptor);
+        EXCEPTION("File " + rFilename + " is too small to be a binary field file");
+    }
+    mMappingSize = file_status.st_size;
+
+    // A private mapping lets fields that adopt the arrays be updated in place
+    mpMapping = mmap(NULL, mMappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+    close(file_descriptor);
+    if(mpMapping == MAP_FAILED)
+    {
+        EXCEPTION("Could not map binary field file " + rFilename);
+    }
+
+    const char* p_bytes = static_cast<const char*>(mpMapping);
+    mpHeader = reinterpret_cast<const Header*>(p_bytes);
+    if(memcmp(mpHeader->mMagic, MAGIC, sizeof(MAGIC)) != 0 || mpHeader->mVersion != VERSION)
+    {
+        munmap(mpMapping, mMappingSize);
+        EXCEPTION("File " + rFilename + " is not a supported binary field file");
+    }
+
+    uint64_t scalar_table = HEADER_SIZE;
+    uint64_t array_table = scalar_table + mpHeader->mNumberOfScalars * sizeof(ScalarEntry);
+    uint64_t array_bytes = uint64_t(mpHeader->mNumberOfValues) * sizeof(double);
+    if(array_table + mpHeader->mNumberOfArrays * sizeof(ArrayEntry) > mMappingSize)
+    {
+        munmap(mpMapping, mMappingSize);
+        EXCEPTION("Binary field file " + rFilename + " is truncated");
+    }
+
+    const ScalarEntry* p_scalars = reinterpret_cast<const ScalarEntry*>(p_bytes + scalar_table);
+    for(unsigned idx=0; idx<mpHeader->mNumberOfScalars; idx++)
+    {
+        mScalars[std::string(p_scalars[idx].mName, strnlen(p_scalars[idx].mName, NAME_LENGTH))] = p_scalars[idx].mValue;
+    }
+
+    const ArrayEntry* p_arrays = reinterpret_cast<const ArrayEntry*>(p_bytes + array_table);
+    for(unsigned idx=0; idx<mpHeader->mNumberOfArrays; idx++)
+    {
+        std::string name(p_arrays[idx].mName, strnlen(p_arrays[idx].mName, NAME_LENGTH));
+        if(p_arrays[idx].mOffset % BLOCK_SIZE != 0 || p_arrays[idx].mOffset + array_bytes > mMappingSize)
+        {
+            munmap(mpMapping, mMappingSize);
+            EXCEPTION("Binary field file " + rFilename + " has a bad entry for array " + name);
+        }
+        mArrayOffsets[name] = p_arrays[idx].mOffset;
+        mArrayNames.push_back(name);
+    }
+}
+
+BinaryFieldFile::~BinaryFieldFile()
+{
+    if(mpMapping != MAP_FAILED)
+    {
+        munmap(mpMapping, mMappingSize);
+    }
+}
+
+void BinaryFieldFile::Write(const std::string& rFilename,
+                            const c_vector<unsigned, 3>& rGridSize,
+                            double gridSpacing,
+                            const c_vector<double, 3>& rGridOrigin,
+                            const std::map<std::string, double>& rScalars,
+                            const std::vector<std::string>& rArrayNames,
+                            const std::vector<const double*>& rArrays)
+{
+    if(rArrayNames.size() != rArrays.size())
+    {
+        EXCEPTION("Each array written to a binary field file needs a name");
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.mMagic, MAGIC, sizeof(MAGIC));
+    header.mVersion = VERSION;
+    header.mNumberOfScalars = rScalars.size();
+    header.mNumberOfArrays = rArrays.size();
+    header.mNumberOfValues = rGridSize[0] * rGridSize[1] * rGridSize[2];
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        header.mGridSize[idx] = rGridSize[idx];
+        header.mGridOrigin[idx] = rGridOrigin[idx];
+    }
+    header.mGridSpacing = gridSpacing;
+
+    std::vector<ScalarEntry> scalars(rScalars.size());
+    unsigned scalar_index = 0;
+    for(std::map<std::string, double>::const_iterator it = rScalars.begin(); it != rScalars.end(); ++it)
+    {
+        memset(&scalars[scalar_index], 0, sizeof(ScalarEntry));
+        CopyName(it->first, scalars[scalar_index].mName);
+        scalars[scalar_index].mValue = it->second;
+        scalar_index++;
+    }
+
+    uint64_t array_bytes = uint64_t(header.mNumberOfValues) * sizeof(double);
+    uint64_t data_start = RoundUp(HEADER_SIZE + scalars.size() * sizeof(ScalarEntry) + rArrays.size() * sizeof(ArrayEntry));
+    std::vector<ArrayEntry> arrays(rArrays.size());
+    for(unsigned idx=0; idx<rArrays.size(); idx++)
+    {
+        memset(&arrays[idx], 0, sizeof(ArrayEntry));
+        CopyName(rArrayNames[idx], arrays[idx].mName);
+        arrays[idx].mOffset = data_start + idx * RoundUp(array_bytes);
+    }
+
+    std::string temp_filename = rFilename + ".tmp";
+    std::ofstream file(temp_filename.c_str(), std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+    {
+        EXCEPTION("Could not open " + temp_filename + " for writing");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    PadTo(file, HEADER_SIZE);
+    if(!scalars.empty())
+    {
+        file.write(reinterpret_cast<const char*>(&scalars[0]), scalars.size() * sizeof(ScalarEntry));
+    }
+    if(!arrays.empty())
+    {
+        file.write(reinterpret_cast<const char*>(&arrays[0]), arrays.size() * sizeof(ArrayEntry));
+    }
+    for(unsigned idx=0; idx<rArrays.size(); idx++)
+    {
+        PadTo(file, arrays[idx].mOffset);
+        file.write(reinterpret_cast<const char*>(rArrays[idx]), array_bytes);
+    }
+    PadTo(file, RoundUp(file.tellp()));
+    file.close();
+    if(file.fail())
+    {
+        EXCEPTION("Error writing binary field file " + temp_filename);
+    }
+
+    if(rename(temp_filename.c_str(), rFilename.c_str()) != 0)
+    {
+        EXCEPTION("Could not move " + temp_filename + " to " + rFilename);
+    }
+}
+
+bool BinaryFieldFile::IsBinaryFieldFile(const std::string& rFilename)
+{
+    char magic[sizeof(MAGIC)];
+    std::ifstream file(rFilename.c_str(), std::ios::binary);
+    file.read(magic, sizeof(magic));
+    return file.good() && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+c_vector<unsigned, 3> BinaryFieldFile::GetGridSize() const
+{
+    c_vector<unsigned, 3> grid_size;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        grid_size[idx] = mpHeader->mGridSize[idx];
+    }
+    return grid_size;
+}
+
+double BinaryFieldFile::GetGridSpacing() const
+{
+    return mpHeader->mGridSpacing;
+}
+
+c_vector<double, 3> BinaryFieldFile::GetGridOrigin() const
+{
+    c_vector<double, 3> grid_origin;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        grid_origin[idx] = mpHeader->mGridOrigin[idx];
+    }
+    return grid_origin;
+}
+
+unsigned BinaryFieldFile::GetNumberOfValues() const
+{
+    return mpHeader->mNumberOfValues;
+}
+
+const std::map<std::string, double>& BinaryFieldFile::rGetScalars() const
+{
+    return mScalars;
+}
+
+const std::vector<std::string>& BinaryFieldFile::rGetArrayNames() const
+{
+    return mArrayNames;
+}
+
+bool BinaryFieldFile::HasArray(const std::string& rName) const
+{
+    return mArrayOffsets.find(rName) != mArrayOffsets.end();
+}
+
+double* BinaryFieldFile::GetArray(const std::string& rName) const
+{
+    std::map<std::string, uint64_t>::const_iterator it = mArrayOffsets.find(rName);
+    if(it == mArrayOffsets.end())
+    {
+        EXCEPTION("Binary field file does not contain the array " + rName);
+    }
+    return reinterpret_cast<double*>(static_cast<char*>(mpMapping) + it->second);
+}
@@ -0,0 +1,282 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef BINARYFIELDFILE_HPP_
+#define BINARYFIELDFILE_HPP_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+#include "UblasVectorInclude.hpp"
+
+/**
+ * A memory-mapped binary file holding named fields on a regular grid, along with
+ * named scalar values. It is used for checkpoints and pre-processed inputs.
+ *
+ * The layout is a fixed header with the grid description, a table of scalars, a
+ * table of arrays and then the raw arrays of doubles, each starting on a 64 byte
+ * boundary. Opening a file maps it and reads only the tables; array pages are
+ * loaded by the OS when first touched. The mapping is private, so arrays can be
+ * modified in place without changing the file.
+ */
+class BinaryFieldFile
+{
+public:
+
+    /**
+     * Length of the fixed size name fields, including the terminating null
+     */
+    static const unsigned NAME_LENGTH = 48;
+
+    /**
+     * File header
+     */
+    struct Header
+    {
+        /**
+         * Identifies the file type
+         */
+        char mMagic[8];
+
+        /**
+         * Format version
+         */
+        uint32_t mVersion;
+
+        /**
+         * Number of entries in the scalar table
+         */
+        uint32_t mNumberOfScalars;
+
+        /**
+         * Number of entries in the array table
+         */
+        uint32_t mNumberOfArrays;
+
+        /**
+         * Number of values in each array
+         */
+        uint32_t mNumberOfValues;
+
+        /**
+         * Number of grid points in each direction
+         */
+        uint32_t mGridSize[3];
+
+        /**
+         * Padding
+         */
+        uint32_t mReserved;
+
+        /**
+         * Grid spacing
+         */
+        double mGridSpacing;
+
+        /**
+         * Grid origin
+         */
+        double mGridOrigin[3];
+    };
+
+    /**
+     * Scalar table entry
+     */
+    struct ScalarEntry
+    {
+        /**
+         * Scalar name
+         */
+        char mName[NAME_LENGTH];
+
+        /**
+         * Scalar value
+         */
+        double mValue;
+
+        /**
+         * Padding to 64 bytes
+         */
+        double mReserved;
+    };
+
+    /**
+     * Array table entry
+     */
+    struct ArrayEntry
+    {
+        /**
+         * Array name
+         */
+        char mName[NAME_LENGTH];
+
+        /**
+         * Offset of the array from the start of the file, in bytes
+         */
+        uint64_t mOffset;
+
+        /**
+         * Padding to 64 bytes
+         */
+        uint64_t mReserved;
+    };
+
+private:
+
+    /**
+     * The mapped file
+     */
+    void* mpMapping;
+
+    /**
+     * Size of the mapping in bytes
+     */
+    std::size_t mMappingSize;
+
+    /**
+     * The header, in the mapping
+     */
+    const Header* mpHeader;
+
+    /**
+     * Array offsets keyed by name
+     */
+    std::map<std::string, uint64_t> mArrayOffsets;
+
+    /**
+     * Array names in file order
+     */
+    std::vector<std::string> mArrayNames;
+
+    /**
+     * Scalars keyed by name
+     */
+    std::map<std::string, double> mScalars;
+
+    /**
+     * Copy constructor, not implemented. The object owns the mapping.
+     */
+    BinaryFieldFile(const BinaryFieldFile&);
+
+    /**
+     * Assignment, not implemented. The object owns the mapping.
+     */
+    BinaryFieldFile& operator=(const BinaryFieldFile&);
+
+public:
+
+    /**
+     * Constructor. Map a file and read its tables.
+     * @param rFilename the path to the file
+     */
+    BinaryFieldFile(const std::string& rFilename);
+
+    /**
+     * Destructor. Unmaps the file.
+     */
+    ~BinaryFieldFile();
+
+    /**
+     * Write a file. The data is written to a temporary file which is then renamed,
+     * so an existing file of the same name, even if mapped, stays intact until the write succeeds.
+     * @param rFilename the path to the file
+     * @param rGridSize the number of grid points in each direction
+     * @param gridSpacing the grid spacing
+     * @param rGridOrigin the grid origin
+     * @param rScalars named scalar values
+     * @param rArrayNames the array names
+     * @param rArrays the arrays, each with one value per grid point
+     */
+    static void Write(const std::string& rFilename,
+                      const c_vector<unsigned, 3>& rGridSize,
+                      double gridSpacing,
+                      const c_vector<double, 3>& rGridOrigin,
+                      const std::map<std::string, double>& rScalars,
+                      const std::vector<std::string>& rArrayNames,
+                      const std::vector<const double*>& rArrays);
+
+    /**
+     * Check the start of a file for the binary field file signature. This is cheap, only
+     * a few bytes are read, so it can be used to choose a reader for an input file.
+     * @param rFilename the path to the file
+     * @return whether the file is a binary field file
+     */
+    static bool IsBinaryFieldFile(const std::string& rFilename);
+
+    /**
+     * @return the number of grid points in each direction
+     */
+    c_vector<unsigned, 3> GetGridSize() const;
+
+    /**
+     * @return the grid spacing
+     */
+    double GetGridSpacing() const;
+
+    /**
+     * @return the grid origin
+     */
+    c_vector<double, 3> GetGridOrigin() const;
+
+    /**
+     * @return the number of values in each array
+     */
+    unsigned GetNumberOfValues() const;
+
+    /**
+     * @return the named scalars
+     */
+    const std::map<std::string, double>& rGetScalars() const;
+
+    /**
+     * @return the array names in file order
+     */
+    const std::vector<std::string>& rGetArrayNames() const;
+
+    /**
+     * @param rName the array name
+     * @return whether the file has the array
+     */
+    bool HasArray(const std::string& rName) const;
+
+    /**
+     * @param rName the array name
+     * @return the array, 64 byte aligned and writable, valid while this object exists
+     */
+    double* GetArray(const std::string& rName) const;
+};
+
+#endif /*BINARYFIELDFILE_HPP_*/
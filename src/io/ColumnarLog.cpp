@@ -0,0 +1,274 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <fstream>
+#include <algorithm>
+#include "Exception.hpp"
+#include "Hdf5Lock.hpp"
+
+#include "ColumnarLog.hpp"
+
+namespace
+{
+    /**
+     * Open a column dataset, checking for it first so missing columns don't print HDF5 error stacks
+     * @param file the open log file
+     * @param rColumnName the column name
+     * @return the dataset, or a negative id if there is no such column
+     */
+    hid_t OpenColumn(hid_t file, const std::string& rColumnName)
+    {
+        if(H5Lexists(file, "columns", H5P_DEFAULT) <= 0 ||
+                H5Lexists(file, ("columns/" + rColumnName).c_str(), H5P_DEFAULT) <= 0)
+        {
+            return -1;
+        }
+        return H5Dopen2(file, ("columns/" + rColumnName).c_str(), H5P_DEFAULT);
+    }
+}
+
+ColumnarLog::ColumnarLog(const std::string& rFilename,
+                         const std::vector<std::string>& rColumnNames,
+                         bool append,
+                         unsigned bufferRows)
+    : mFilename(rFilename),
+      mColumnNames(rColumnNames),
+      mFile(-1),
+      mDatasets(),
+      mPending(rColumnNames.size()),
+      mNumberOfWrittenRows(0),
+      mBufferRows(std::max(bufferRows, 1u))
+{
+    Hdf5Lock lock;
+    std::ifstream existing(mFilename.c_str());
+    bool open_existing = append && existing.good();
+    existing.close();
+
+    if(open_existing)
+    {
+        mFile = H5Fopen(mFilename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+        if(mFile < 0)
+        {
+            EXCEPTION("Could not open log file " + mFilename);
+        }
+        hsize_t num_rows = 0;
+        for(unsigned idx=0; idx<mColumnNames.size(); idx++)
+        {
+            hid_t dataset = OpenColumn(mFile, mColumnNames[idx]);
+            if(dataset < 0)
+            {
+                Close();
+                EXCEPTION("Log file " + mFilename + " has no column " + mColumnNames[idx]);
+            }
+            mDatasets.push_back(dataset);
+
+            // Rows are only complete once every column has them
+            hid_t space = H5Dget_space(dataset);
+            hsize_t size;
+            H5Sget_simple_extent_dims(space, &size, NULL);
+            H5Sclose(space);
+            num_rows = idx == 0 ? size : std::min(num_rows, size);
+        }
+        mNumberOfWrittenRows = num_rows;
+        return;
+    }
+
+    mFile = H5Fcreate(mFilename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if(mFile < 0)
+    {
+        EXCEPTION("Could not create log file " + mFilename);
+    }
+
+    // Track creation order so readers see the columns in the order they were given
+    hid_t group_properties = H5Pcreate(H5P_GROUP_CREATE);
+    H5Pset_link_creation_order(group_properties, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+    hid_t group = H5Gcreate2(mFile, "columns", H5P_DEFAULT, group_properties, H5P_DEFAULT);
+    H5Pclose(group_properties);
+
+    hsize_t size = 0;
+    hsize_t max_size = H5S_UNLIMITED;
+    hsize_t chunk = 1024;
+    hid_t space = H5Screate_simple(1, &size, &max_size);
+    hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, 1, &chunk);
+    H5Pset_shuffle(properties);
+    H5Pset_deflate(properties, 1);
+    for(unsigned idx=0; idx<mColumnNames.size(); idx++)
+    {
+        hid_t dataset = H5Dcreate2(group, mColumnNames[idx].c_str(), H5T_IEEE_F64LE, space,
+                H5P_DEFAULT, properties, H5P_DEFAULT);
+        if(dataset < 0)
+        {
+            H5Pclose(properties);
+            H5Sclose(space);
+            H5Gclose(group);
+            EXCEPTION("Could not create column " + mColumnNames[idx] + " in " + mFilename);
+        }
+        mDatasets.push_back(dataset);
+    }
+    H5Pclose(properties);
+    H5Sclose(space);
+    H5Gclose(group);
+}
+
+ColumnarLog::~ColumnarLog()
+{
+    try
+    {
+        Close();
+    }
+    catch(...)
+    {
+        // Destructors must not throw
+    }
+}
+
+void ColumnarLog::AppendRow(const std::vector<double>& rValues)
+{
+    if(rValues.size() != mColumnNames.size())
+    {
+        EXCEPTION("Number of values does not match the number of columns in " + mFilename);
+    }
+    for(unsigned idx=0; idx<rValues.size(); idx++)
+    {
+        mPending[idx].push_back(rValues[idx]);
+    }
+    if(!mPending.empty() && mPending[0].size() >= mBufferRows)
+    {
+        Flush();
+    }
+}
+
+void ColumnarLog::Flush()
+{
+    Hdf5Lock lock;
+    if(mFile < 0)
+    {
+        EXCEPTION("Log file " + mFilename + " has been closed");
+    }
+    if(mPending.empty() || mPending[0].empty())
+    {
+        return;
+    }
+
+    hsize_t start = mNumberOfWrittenRows;
+    hsize_t count = mPending[0].size();
+    hsize_t size = start + count;
+    hid_t memory_space = H5Screate_simple(1, &count, NULL);
+    for(unsigned idx=0; idx<mDatasets.size(); idx++)
+    {
+        herr_t status = H5Dset_extent(mDatasets[idx], &size);
+        hid_t file_space = H5Dget_space(mDatasets[idx]);
+        if(status >= 0)
+        {
+            status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start, NULL, &count, NULL);
+        }
+        if(status >= 0)
+        {
+            status = H5Dwrite(mDatasets[idx], H5T_NATIVE_DOUBLE, memory_space, file_space, H5P_DEFAULT, &mPending[idx][0]);
+        }
+        H5Sclose(file_space);
+        if(status < 0)
+        {
+            H5Sclose(memory_space);
+            EXCEPTION("Could not write column " + mColumnNames[idx] + " to " + mFilename);
+        }
+        mPending[idx].clear();
+    }
+    H5Sclose(memory_space);
+    mNumberOfWrittenRows += count;
+    H5Fflush(mFile, H5F_SCOPE_LOCAL);
+}
+
+void ColumnarLog::Close()
+{
+    Hdf5Lock lock;
+    if(mFile < 0)
+    {
+        return;
+    }
+    Flush();
+    for(unsigned idx=0; idx<mDatasets.size(); idx++)
+    {
+        H5Dclose(mDatasets[idx]);
+    }
+    mDatasets.clear();
+    H5Fclose(mFile);
+    mFile = -1;
+}
+
+unsigned ColumnarLog::GetNumberOfRows() const
+{
+    return mNumberOfWrittenRows + (mPending.empty() ? 0 : mPending[0].size());
+}
+
+const std::vector<std::string>& ColumnarLog::rGetColumnNames() const
+{
+    return mColumnNames;
+}
+
+std::vector<double> ColumnarLog::ReadColumn(const std::string& rFilename, const std::string& rColumnName)
+{
+    Hdf5Lock lock;
+    hid_t file = H5Fopen(rFilename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(file < 0)
+    {
+        EXCEPTION("Could not open log file " + rFilename);
+    }
+    hid_t dataset = OpenColumn(file, rColumnName);
+    if(dataset < 0)
+    {
+        H5Fclose(file);
+        EXCEPTION("Log file " + rFilename + " has no column " + rColumnName);
+    }
+    hid_t space = H5Dget_space(dataset);
+    hsize_t size = 0;
+    H5Sget_simple_extent_dims(space, &size, NULL);
+    H5Sclose(space);
+
+    std::vector<double> values(size);
+    herr_t status = 0;
+    if(size > 0)
+    {
+        status = H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0]);
+    }
+    H5Dclose(dataset);
+    H5Fclose(file);
+    if(status < 0)
+    {
+        EXCEPTION("Could not read column " + rColumnName + " from " + rFilename);
+    }
+    return values;
+}
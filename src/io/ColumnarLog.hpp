@@ -0,0 +1,149 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef COLUMNARLOG_HPP_
+#define COLUMNARLOG_HPP_
+
+#include <vector>
+#include <string>
+#include <hdf5.h>
+
+/**
+ * A compact log of per-step values, stored as one extensible, compressed HDF5
+ * dataset per column under /columns. Rows are buffered and written in blocks,
+ * so logging every step costs little more than the copy.
+ */
+class ColumnarLog
+{
+    /**
+     * The HDF5 file path
+     */
+    std::string mFilename;
+
+    /**
+     * Column names
+     */
+    std::vector<std::string> mColumnNames;
+
+    /**
+     * The HDF5 file
+     */
+    hid_t mFile;
+
+    /**
+     * One dataset per column
+     */
+    std::vector<hid_t> mDatasets;
+
+    /**
+     * Rows not yet written, stored by column
+     */
+    std::vector<std::vector<double> > mPending;
+
+    /**
+     * Number of rows written to the file
+     */
+    unsigned mNumberOfWrittenRows;
+
+    /**
+     * Number of rows buffered before they are written
+     */
+    unsigned mBufferRows;
+
+    /**
+     * Copy constructor, not implemented. The object owns the file.
+     */
+    ColumnarLog(const ColumnarLog&);
+
+    /**
+     * Assignment, not implemented. The object owns the file.
+     */
+    ColumnarLog& operator=(const ColumnarLog&);
+
+public:
+
+    /**
+     * Constructor. Creates the file, or opens it to add further rows.
+     * @param rFilename the HDF5 file path
+     * @param rColumnNames the column names
+     * @param append whether to add to an existing file with the same columns
+     * @param bufferRows the number of rows buffered before they are written
+     */
+    ColumnarLog(const std::string& rFilename,
+                const std::vector<std::string>& rColumnNames,
+                bool append = false,
+                unsigned bufferRows = 64);
+
+    /**
+     * Destructor. Writes any buffered rows and closes the file.
+     */
+    ~ColumnarLog();
+
+    /**
+     * Add a row
+     * @param rValues one value per column
+     */
+    void AppendRow(const std::vector<double>& rValues);
+
+    /**
+     * Write any buffered rows
+     */
+    void Flush();
+
+    /**
+     * Write any buffered rows and close the file. Called by the destructor if needed.
+     */
+    void Close();
+
+    /**
+     * @return the number of rows, including buffered rows
+     */
+    unsigned GetNumberOfRows() const;
+
+    /**
+     * @return the column names
+     */
+    const std::vector<std::string>& rGetColumnNames() const;
+
+    /**
+     * Read a column back from a closed log
+     * @param rFilename the HDF5 file path
+     * @param rColumnName the column name
+     * @return the column values
+     */
+    static std::vector<double> ReadColumn(const std::string& rFilename, const std::string& rColumnName);
+};
+
+#endif /*COLUMNARLOG_HPP_*/
@@ -0,0 +1,446 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <boost/lexical_cast.hpp>
+#include "Exception.hpp"
+
+#include "FieldStatistics.hpp"
+
+namespace
+{
+    /**
+     * Grids smaller than this are reduced on a single thread
+     */
+    const unsigned MIN_POINTS_PER_THREAD = 16384;
+}
+
+/**
+ * A fixed set of threads that each run a task for their block, so the statistics
+ * logged every step don't start and join threads every time.
+ */
+class FieldStatistics::ReductionPool
+{
+    /**
+     * The worker threads, worker i runs the task for block i + 1
+     */
+    std::vector<std::thread> mThreads;
+
+    /**
+     * Lets one caller at a time hand out blocks, as copies of the statistics share the pool
+     */
+    std::mutex mRunMutex;
+
+    /**
+     * Guards the members below
+     */
+    std::mutex mMutex;
+
+    /**
+     * Signals a new task, or stopping, to the workers
+     */
+    std::condition_variable mStartCondition;
+
+    /**
+     * Signals the caller that all the workers are done
+     */
+    std::condition_variable mDoneCondition;
+
+    /**
+     * The current task, called with the block number
+     */
+    std::function<void(unsigned)> mTask;
+
+    /**
+     * Counts the tasks handed out, so each worker runs each one once
+     */
+    unsigned mGeneration;
+
+    /**
+     * The number of workers still running the current task
+     */
+    unsigned mNumPending;
+
+    /**
+     * Whether the workers should exit
+     */
+    bool mStop;
+
+    /**
+     * The loop run by each worker
+     * @param block the block the worker reduces
+     */
+    void WorkerLoop(unsigned block)
+    {
+        unsigned generation = 0;
+        while(true)
+        {
+            std::function<void(unsigned)> task;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mStartCondition.wait(lock, [&]{ return mStop || mGeneration != generation; });
+                if(mStop)
+                {
+                    return;
+                }
+                generation = mGeneration;
+                task = mTask;
+            }
+            task(block);
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(--mNumPending == 0)
+            {
+                mDoneCondition.notify_one();
+            }
+        }
+    }
+
+public:
+
+    /**
+     * Constructor, starts the workers
+     * @param numberOfWorkers the number of threads besides the caller's
+     */
+    ReductionPool(unsigned numberOfWorkers)
+        : mThreads(),
+          mTask(),
+          mGeneration(0),
+          mNumPending(0),
+          mStop(false)
+    {
+        for(unsigned worker=0; worker<numberOfWorkers; worker++)
+        {
+            mThreads.push_back(std::thread(&ReductionPool::WorkerLoop, this, worker + 1));
+        }
+    }
+
+    /**
+     * Destructor, stops the workers
+     */
+    ~ReductionPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mStartCondition.notify_all();
+        for(unsigned idx=0; idx<mThreads.size(); idx++)
+        {
+            mThreads[idx].join();
+        }
+    }
+
+    /**
+     * @return the number of blocks a task is run for, including the caller's
+     */
+    unsigned GetNumberOfBlocks() const
+    {
+        return mThreads.size() + 1;
+    }
+
+    /**
+     * Run a task for every block, the calling thread takes block 0
+     * @param rTask the task, called with the block number
+     */
+    void Run(const std::function<void(unsigned)>& rTask)
+    {
+        std::lock_guard<std::mutex> run_lock(mRunMutex);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTask = rTask;
+            mNumPending = mThreads.size();
+            mGeneration++;
+        }
+        mStartCondition.notify_all();
+        rTask(0);
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDoneCondition.wait(lock, [&]{ return mNumPending == 0; });
+    }
+};
+
+FieldStatistics::FieldStatistics(unsigned numberOfThreads)
+    : mSummaries(),
+      mHistograms(),
+      mMaskedMeans(),
+      mFractions(),
+      mColumnNames(),
+      mNumberOfThreads(numberOfThreads),
+      mNumberOfPoints(0),
+      mPointVolume(1.0),
+      mpFields(NULL),
+      mSummaryHandles(),
+      mHistogramHandles(),
+      mMaskedHandles(),
+      mMaskHandles(),
+      mpPool()
+{
+    if(mNumberOfThreads == 0)
+    {
+        mNumberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+unsigned FieldStatistics::GetSummaryIndex(const std::string& rField)
+{
+    std::vector<std::string>::iterator it = std::find(mSummaries.begin(), mSummaries.end(), rField);
+    if(it != mSummaries.end())
+    {
+        return it - mSummaries.begin();
+    }
+    mSummaries.push_back(rField);
+    return mSummaries.size() - 1;
+}
+
+void FieldStatistics::AddSummary(const std::string& rField)
+{
+    GetSummaryIndex(rField);
+}
+
+void FieldStatistics::AddHistogram(const std::string& rField, double lower, double upper, unsigned numberOfBins)
+{
+    if(numberOfBins == 0 || upper <= lower)
+    {
+        EXCEPTION("Histogram of " + rField + " needs at least one bin and a non-empty range");
+    }
+    Histogram histogram;
+    histogram.mField = rField;
+    histogram.mLower = lower;
+    histogram.mUpper = upper;
+    histogram.mNumberOfBins = numberOfBins;
+    mHistograms.push_back(histogram);
+}
+
+void FieldStatistics::AddMaskedMean(const std::string& rField, const std::string& rMask)
+{
+    MaskedMean masked_mean;
+    masked_mean.mField = rField;
+    masked_mean.mMask = rMask;
+    mMaskedMeans.push_back(masked_mean);
+}
+
+void FieldStatistics::AddFraction(const std::string& rName, const std::string& rNumerator, const std::string& rDenominator)
+{
+    Fraction fraction;
+    fraction.mName = rName;
+    fraction.mNumerator = GetSummaryIndex(rNumerator);
+    fraction.mDenominator = GetSummaryIndex(rDenominator);
+    mFractions.push_back(fraction);
+}
+
+void FieldStatistics::Bind(const FieldRegistry& rFields, double pointVolume)
+{
+    mNumberOfPoints = rFields.GetNumberOfPoints();
+    mPointVolume = pointVolume;
+    mpFields = &rFields;
+    mColumnNames.clear();
+    mSummaryHandles.clear();
+    mHistogramHandles.clear();
+    mMaskedHandles.clear();
+    mMaskHandles.clear();
+
+    for(unsigned idx=0; idx<mSummaries.size(); idx++)
+    {
+        mSummaryHandles.push_back(rFields.GetHandle(mSummaries[idx]));
+        mColumnNames.push_back(mSummaries[idx] + "_total");
+        mColumnNames.push_back(mSummaries[idx] + "_min");
+        mColumnNames.push_back(mSummaries[idx] + "_mean");
+        mColumnNames.push_back(mSummaries[idx] + "_max");
+    }
+    for(unsigned idx=0; idx<mHistograms.size(); idx++)
+    {
+        mHistogramHandles.push_back(rFields.GetHandle(mHistograms[idx].mField));
+        for(unsigned bin=0; bin<mHistograms[idx].mNumberOfBins; bin++)
+        {
+            mColumnNames.push_back(mHistograms[idx].mField + "_hist_" + boost::lexical_cast<std::string>(bin));
+        }
+    }
+    for(unsigned idx=0; idx<mMaskedMeans.size(); idx++)
+    {
+        mMaskedHandles.push_back(rFields.GetHandle(mMaskedMeans[idx].mField));
+        mMaskHandles.push_back(rFields.GetHandle(mMaskedMeans[idx].mMask));
+        mColumnNames.push_back(mMaskedMeans[idx].mField + "_mean_in_" + mMaskedMeans[idx].mMask);
+        mColumnNames.push_back(mMaskedMeans[idx].mField + "_mean_out_" + mMaskedMeans[idx].mMask);
+    }
+    for(unsigned idx=0; idx<mFractions.size(); idx++)
+    {
+        mColumnNames.push_back(mFractions[idx].mName);
+    }
+}
+
+const std::vector<std::string>& FieldStatistics::rGetColumnNames() const
+{
+    return mColumnNames;
+}
+
+void FieldStatistics::Reduce(unsigned begin, unsigned end, Partial& rPartial) const
+{
+    // One pass per field keeps each inner loop simple enough to vectorise
+    rPartial.mSums.assign(mSummaryHandles.size(), 0.0);
+    rPartial.mMins.assign(mSummaryHandles.size(), std::numeric_limits<double>::max());
+    rPartial.mMaxs.assign(mSummaryHandles.size(), -std::numeric_limits<double>::max());
+    for(unsigned field=0; field<mSummaryHandles.size(); field++)
+    {
+        const double* p_values = mpFields->GetField(mSummaryHandles[field]);
+        double sum = 0.0;
+        double min = rPartial.mMins[field];
+        double max = rPartial.mMaxs[field];
+        for(unsigned idx=begin; idx<end; idx++)
+        {
+            sum += p_values[idx];
+            min = std::min(min, p_values[idx]);
+            max = std::max(max, p_values[idx]);
+        }
+        rPartial.mSums[field] = sum;
+        rPartial.mMins[field] = min;
+        rPartial.mMaxs[field] = max;
+    }
+
+    rPartial.mCounts.clear();
+    for(unsigned histogram=0; histogram<mHistograms.size(); histogram++)
+    {
+        const Histogram& r_histogram = mHistograms[histogram];
+        const double* p_values = mpFields->GetField(mHistogramHandles[histogram]);
+        std::vector<double> counts(r_histogram.mNumberOfBins, 0.0);
+        double scale = double(r_histogram.mNumberOfBins) / (r_histogram.mUpper - r_histogram.mLower);
+        int last_bin = r_histogram.mNumberOfBins - 1;
+        for(unsigned idx=begin; idx<end; idx++)
+        {
+            int bin = int(std::floor((p_values[idx] - r_histogram.mLower) * scale));
+            counts[std::min(std::max(bin, 0), last_bin)] += 1.0;
+        }
+        rPartial.mCounts.insert(rPartial.mCounts.end(), counts.begin(), counts.end());
+    }
+
+    rPartial.mInsideSums.assign(mMaskedMeans.size(), 0.0);
+    rPartial.mInsideCounts.assign(mMaskedMeans.size(), 0.0);
+    rPartial.mOutsideSums.assign(mMaskedMeans.size(), 0.0);
+    rPartial.mOutsideCounts.assign(mMaskedMeans.size(), 0.0);
+    for(unsigned masked=0; masked<mMaskedMeans.size(); masked++)
+    {
+        const double* p_values = mpFields->GetField(mMaskedHandles[masked]);
+        const double* p_mask = mpFields->GetField(mMaskHandles[masked]);
+        double inside_sum = 0.0;
+        double inside_count = 0.0;
+        double total_sum = 0.0;
+        for(unsigned idx=begin; idx<end; idx++)
+        {
+            double inside = p_mask[idx] > 0.5 ? 1.0 : 0.0;
+            inside_sum += inside * p_values[idx];
+            inside_count += inside;
+            total_sum += p_values[idx];
+        }
+        rPartial.mInsideSums[masked] = inside_sum;
+        rPartial.mInsideCounts[masked] = inside_count;
+        rPartial.mOutsideSums[masked] = total_sum - inside_sum;
+        rPartial.mOutsideCounts[masked] = double(end - begin) - inside_count;
+    }
+}
+
+std::vector<double> FieldStatistics::Compute() const
+{
+    // Split the grid into contiguous blocks, the calling thread takes the first. The pool
+    // is kept between calls, and only replaced if binding to another grid changes its size.
+    unsigned num_threads = std::max(1u, std::min(mNumberOfThreads, mNumberOfPoints / MIN_POINTS_PER_THREAD));
+    std::vector<Partial> partials(num_threads);
+    if(num_threads == 1)
+    {
+        Reduce(0, mNumberOfPoints, partials[0]);
+    }
+    else
+    {
+        if(!mpPool || mpPool->GetNumberOfBlocks() != num_threads)
+        {
+            mpPool.reset(new ReductionPool(num_threads - 1));
+        }
+        mpPool->Run([&](unsigned block)
+        {
+            unsigned begin = (unsigned long long)mNumberOfPoints * block / num_threads;
+            unsigned end = (unsigned long long)mNumberOfPoints * (block + 1) / num_threads;
+            Reduce(begin, end, partials[block]);
+        });
+    }
+
+    // Combine the blocks in a fixed order, so results don't depend on thread timing
+    Partial total = partials[0];
+    for(unsigned thread=1; thread<num_threads; thread++)
+    {
+        const Partial& r_partial = partials[thread];
+        for(unsigned idx=0; idx<total.mSums.size(); idx++)
+        {
+            total.mSums[idx] += r_partial.mSums[idx];
+            total.mMins[idx] = std::min(total.mMins[idx], r_partial.mMins[idx]);
+            total.mMaxs[idx] = std::max(total.mMaxs[idx], r_partial.mMaxs[idx]);
+        }
+        for(unsigned idx=0; idx<total.mCounts.size(); idx++)
+        {
+            total.mCounts[idx] += r_partial.mCounts[idx];
+        }
+        for(unsigned idx=0; idx<total.mInsideSums.size(); idx++)
+        {
+            total.mInsideSums[idx] += r_partial.mInsideSums[idx];
+            total.mInsideCounts[idx] += r_partial.mInsideCounts[idx];
+            total.mOutsideSums[idx] += r_partial.mOutsideSums[idx];
+            total.mOutsideCounts[idx] += r_partial.mOutsideCounts[idx];
+        }
+    }
+
+    std::vector<double> values;
+    values.reserve(mColumnNames.size());
+    for(unsigned idx=0; idx<total.mSums.size(); idx++)
+    {
+        values.push_back(total.mSums[idx] * mPointVolume);
+        values.push_back(total.mMins[idx]);
+        values.push_back(mNumberOfPoints > 0 ? total.mSums[idx] / double(mNumberOfPoints) : 0.0);
+        values.push_back(total.mMaxs[idx]);
+    }
+    values.insert(values.end(), total.mCounts.begin(), total.mCounts.end());
+    for(unsigned idx=0; idx<total.mInsideSums.size(); idx++)
+    {
+        values.push_back(total.mInsideCounts[idx] > 0.0 ? total.mInsideSums[idx] / total.mInsideCounts[idx] : 0.0);
+        values.push_back(total.mOutsideCounts[idx] > 0.0 ? total.mOutsideSums[idx] / total.mOutsideCounts[idx] : 0.0);
+    }
+    for(unsigned idx=0; idx<mFractions.size(); idx++)
+    {
+        double denominator = total.mSums[mFractions[idx].mDenominator];
+        values.push_back(denominator != 0.0 ? total.mSums[mFractions[idx].mNumerator] / denominator : 0.0);
+    }
+    return values;
+}
@@ -0,0 +1,279 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef FIELDSTATISTICS_HPP_
+#define FIELDSTATISTICS_HPP_
+
+#include <vector>
+#include <string>
+#include "SmartPointers.hpp"
+#include "FieldRegistry.hpp"
+
+/**
+ * In-situ reductions of the solution fields, computed every step so that runs
+ * can be summarised without writing whole fields. Statistics are configured by
+ * field name, bound to the field buffers once, and then computed in a single
+ * pass over the grid split between several threads. Each statistic gives one
+ * or more named columns.
+ */
+class FieldStatistics
+{
+    /**
+     * Worker threads kept between calls to Compute(), defined in the source file
+     */
+    class ReductionPool;
+
+    /**
+     * A histogram of a field
+     */
+    struct Histogram
+    {
+        /**
+         * Field name
+         */
+        std::string mField;
+
+        /**
+         * Lower end of the first bin
+         */
+        double mLower;
+
+        /**
+         * Upper end of the last bin
+         */
+        double mUpper;
+
+        /**
+         * Number of bins
+         */
+        unsigned mNumberOfBins;
+    };
+
+    /**
+     * A mean of a field inside and outside a mask
+     */
+    struct MaskedMean
+    {
+        /**
+         * Field name
+         */
+        std::string mField;
+
+        /**
+         * Mask field name, points with mask values above one half are inside
+         */
+        std::string mMask;
+    };
+
+    /**
+     * A ratio of two field totals
+     */
+    struct Fraction
+    {
+        /**
+         * Column name
+         */
+        std::string mName;
+
+        /**
+         * Index of the numerator in mSummaries
+         */
+        unsigned mNumerator;
+
+        /**
+         * Index of the denominator in mSummaries
+         */
+        unsigned mDenominator;
+    };
+
+    /**
+     * Partial results for one block of points
+     */
+    struct Partial
+    {
+        /**
+         * Sum, min and max of each summarised field
+         */
+        std::vector<double> mSums, mMins, mMaxs;
+
+        /**
+         * Bin counts of each histogram, concatenated
+         */
+        std::vector<double> mCounts;
+
+        /**
+         * Sums and counts inside and outside each mask
+         */
+        std::vector<double> mInsideSums, mInsideCounts, mOutsideSums, mOutsideCounts;
+    };
+
+    /**
+     * Summarised field names
+     */
+    std::vector<std::string> mSummaries;
+
+    /**
+     * Histograms
+     */
+    std::vector<Histogram> mHistograms;
+
+    /**
+     * Masked means
+     */
+    std::vector<MaskedMean> mMaskedMeans;
+
+    /**
+     * Fractions
+     */
+    std::vector<Fraction> mFractions;
+
+    /**
+     * Column names, in the order of the computed values
+     */
+    std::vector<std::string> mColumnNames;
+
+    /**
+     * Number of threads used for the reductions
+     */
+    unsigned mNumberOfThreads;
+
+    /**
+     * Number of grid points
+     */
+    unsigned mNumberOfPoints;
+
+    /**
+     * Volume of the grid cell around each point
+     */
+    double mPointVolume;
+
+    /**
+     * The solution fields, looked up at each Compute() as coupling may replace their buffers
+     */
+    const FieldRegistry* mpFields;
+
+    /**
+     * Summarised field handles
+     */
+    std::vector<unsigned> mSummaryHandles;
+
+    /**
+     * Histogram field handles
+     */
+    std::vector<unsigned> mHistogramHandles;
+
+    /**
+     * Masked mean field and mask handles
+     */
+    std::vector<unsigned> mMaskedHandles, mMaskHandles;
+
+    /**
+     * The threads that reduce all but the first block, started by the first Compute()
+     */
+    mutable boost::shared_ptr<ReductionPool> mpPool;
+
+public:
+
+    /**
+     * Constructor.
+     * @param numberOfThreads the number of threads for the reductions, 0 for one per core
+     */
+    FieldStatistics(unsigned numberOfThreads = 0);
+
+    /**
+     * Add the total, min, mean and max of a field. The total is the field integrated over the grid.
+     * @param rField the field name
+     */
+    void AddSummary(const std::string& rField);
+
+    /**
+     * Add a histogram of a field. Values outside the range are counted in the end bins.
+     * @param rField the field name
+     * @param lower the lower end of the first bin
+     * @param upper the upper end of the last bin
+     * @param numberOfBins the number of bins
+     */
+    void AddHistogram(const std::string& rField, double lower, double upper, unsigned numberOfBins);
+
+    /**
+     * Add the mean of a field inside and outside a mask
+     * @param rField the field name
+     * @param rMask the mask field name, points with mask values above one half are inside
+     */
+    void AddMaskedMean(const std::string& rField, const std::string& rMask);
+
+    /**
+     * Add the ratio of two field totals. Both fields are summarised.
+     * @param rName the column name
+     * @param rNumerator the numerator field name
+     * @param rDenominator the denominator field name
+     */
+    void AddFraction(const std::string& rName, const std::string& rNumerator, const std::string& rDenominator);
+
+    /**
+     * Resolve the statistics to field handles. The registry must outlive the binding.
+     * @param rFields the solution fields
+     * @param pointVolume the volume of the grid cell around each point
+     */
+    void Bind(const FieldRegistry& rFields, double pointVolume);
+
+    /**
+     * @return the column names, in the order of the values from Compute()
+     */
+    const std::vector<std::string>& rGetColumnNames() const;
+
+    /**
+     * @return the statistics of the current field values
+     */
+    std::vector<double> Compute() const;
+
+private:
+
+    /**
+     * @param rField a field name
+     * @return the index of the field in mSummaries, adding it if needed
+     */
+    unsigned GetSummaryIndex(const std::string& rField);
+
+    /**
+     * Reduce a block of points
+     * @param begin the first point
+     * @param end one past the last point
+     * @param rPartial the results for the block
+     */
+    void Reduce(unsigned begin, unsigned end, Partial& rPartial) const;
+};
+
+#endif /*FIELDSTATISTICS_HPP_*/
@@ -0,0 +1,77 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef HDF5LOCK_HPP_
+#define HDF5LOCK_HPP_
+
+#include <mutex>
+
+/**
+ * Holds the process-wide lock on the HDF5 library for its lifetime. The library is
+ * not built thread-safe, and components run on their own threads in one process,
+ * as do background output writers, so every call into it is made under this lock.
+ * The lock is recursive, so methods holding it can call each other.
+ */
+class Hdf5Lock
+{
+    /**
+     * The held lock
+     */
+    std::lock_guard<std::recursive_mutex> mLock;
+
+    /**
+     * Copy constructor, not implemented. The object holds the lock.
+     */
+    Hdf5Lock(const Hdf5Lock&);
+
+    /**
+     * Assignment, not implemented. The object holds the lock.
+     */
+    Hdf5Lock& operator=(const Hdf5Lock&);
+
+    /**
+     * @return the mutex shared by all HDF5 calls in the process
+     */
+    static std::recursive_mutex& rGetMutex();
+
+public:
+
+    /**
+     * Constructor. Waits for the lock.
+     */
+    Hdf5Lock();
+};
+
+#endif /*HDF5LOCK_HPP_*/
@@ -0,0 +1,208 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "Exception.hpp"
+#include "Hdf5Lock.hpp"
+
+#include "Hdf5TimeSeriesReader.hpp"
+
+Hdf5TimeSeriesReader::Hdf5TimeSeriesReader(const std::string& rFilename)
+    : mFilename(rFilename),
+      mFile(-1),
+      mGridSize(zero_vector<unsigned>(3)),
+      mGridSpacing(1.0),
+      mGridOrigin(zero_vector<double>(3)),
+      mFieldNames(),
+      mTimes()
+{
+    Hdf5Lock lock;
+    mFile = H5Fopen(mFilename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(mFile < 0)
+    {
+        EXCEPTION("Could not open HDF5 file " + mFilename);
+    }
+
+    hid_t attribute = H5Aopen(mFile, "grid_size", H5P_DEFAULT);
+    herr_t status = H5Aread(attribute, H5T_NATIVE_UINT, &mGridSize[0]);
+    H5Aclose(attribute);
+    attribute = H5Aopen(mFile, "grid_spacing", H5P_DEFAULT);
+    status = std::min(status, H5Aread(attribute, H5T_NATIVE_DOUBLE, &mGridSpacing));
+    H5Aclose(attribute);
+    attribute = H5Aopen(mFile, "grid_origin", H5P_DEFAULT);
+    status = std::min(status, H5Aread(attribute, H5T_NATIVE_DOUBLE, &mGridOrigin[0]));
+    H5Aclose(attribute);
+    if(status < 0)
+    {
+        H5Fclose(mFile);
+        EXCEPTION("HDF5 file " + mFilename + " has no grid description");
+    }
+
+    // Field names in the order they were created
+    hid_t group = H5Gopen2(mFile, "fields", H5P_DEFAULT);
+    H5G_info_t group_info;
+    if(group < 0 || H5Gget_info(group, &group_info) < 0)
+    {
+        H5Fclose(mFile);
+        EXCEPTION("HDF5 file " + mFilename + " has no fields group");
+    }
+    hsize_t num_steps = 0;
+    hid_t time_dataset = H5Dopen2(mFile, "time", H5P_DEFAULT);
+    if(time_dataset >= 0)
+    {
+        hid_t time_space = H5Dget_space(time_dataset);
+        H5Sget_simple_extent_dims(time_space, &num_steps, NULL);
+        H5Sclose(time_space);
+    }
+
+    for(hsize_t idx=0; idx<group_info.nlinks; idx++)
+    {
+        ssize_t length = H5Lget_name_by_idx(group, ".", H5_INDEX_CRT_ORDER, H5_ITER_INC, idx, NULL, 0, H5P_DEFAULT);
+        std::vector<char> name(length + 1);
+        H5Lget_name_by_idx(group, ".", H5_INDEX_CRT_ORDER, H5_ITER_INC, idx, &name[0], name.size(), H5P_DEFAULT);
+        mFieldNames.push_back(std::string(&name[0]));
+
+        // Only steps present in every field and the time index are complete
+        hid_t dataset = H5Dopen2(group, &name[0], H5P_DEFAULT);
+        hid_t space = H5Dget_space(dataset);
+        hsize_t size[4];
+        H5Sget_simple_extent_dims(space, size, NULL);
+        H5Sclose(space);
+        H5Dclose(dataset);
+        num_steps = std::min(num_steps, size[0]);
+    }
+    H5Gclose(group);
+
+    mTimes.resize(num_steps);
+    if(num_steps > 0)
+    {
+        hid_t memory_space = H5Screate_simple(1, &num_steps, NULL);
+        hid_t file_space = H5Dget_space(time_dataset);
+        hsize_t start = 0;
+        H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start, NULL, &num_steps, NULL);
+        status = H5Dread(time_dataset, H5T_NATIVE_DOUBLE, memory_space, file_space, H5P_DEFAULT, &mTimes[0]);
+        H5Sclose(file_space);
+        H5Sclose(memory_space);
+    }
+    if(time_dataset >= 0)
+    {
+        H5Dclose(time_dataset);
+    }
+    if(status < 0)
+    {
+        H5Fclose(mFile);
+        EXCEPTION("Could not read the times in " + mFilename);
+    }
+}
+
+Hdf5TimeSeriesReader::~Hdf5TimeSeriesReader()
+{
+    Hdf5Lock lock;
+    H5Fclose(mFile);
+}
+
+c_vector<unsigned, 3> Hdf5TimeSeriesReader::GetGridSize() const
+{
+    return mGridSize;
+}
+
+double Hdf5TimeSeriesReader::GetGridSpacing() const
+{
+    return mGridSpacing;
+}
+
+c_vector<double, 3> Hdf5TimeSeriesReader::GetGridOrigin() const
+{
+    return mGridOrigin;
+}
+
+const std::vector<std::string>& Hdf5TimeSeriesReader::rGetFieldNames() const
+{
+    return mFieldNames;
+}
+
+bool Hdf5TimeSeriesReader::HasField(const std::string& rName) const
+{
+    return std::find(mFieldNames.begin(), mFieldNames.end(), rName) != mFieldNames.end();
+}
+
+const std::vector<double>& Hdf5TimeSeriesReader::rGetTimes() const
+{
+    return mTimes;
+}
+
+unsigned Hdf5TimeSeriesReader::GetNumberOfSteps() const
+{
+    return mTimes.size();
+}
+
+void Hdf5TimeSeriesReader::ReadField(unsigned step, const std::string& rName, double* pValues) const
+{
+    Hdf5Lock lock;
+    if(step >= mTimes.size())
+    {
+        EXCEPTION("Requested step is beyond the end of " + mFilename);
+    }
+    if(!HasField(rName))
+    {
+        EXCEPTION("HDF5 file " + mFilename + " does not contain the field " + rName);
+    }
+
+    hid_t dataset = H5Dopen2(mFile, ("fields/" + rName).c_str(), H5P_DEFAULT);
+    hsize_t num_points = hsize_t(mGridSize[0]) * hsize_t(mGridSize[1]) * hsize_t(mGridSize[2]);
+    hsize_t start[4] = {step, 0, 0, 0};
+    hsize_t count[4] = {1, mGridSize[2], mGridSize[1], mGridSize[0]};
+    hid_t memory_space = H5Screate_simple(1, &num_points, NULL);
+    hid_t file_space = H5Dget_space(dataset);
+    herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
+    if(status >= 0)
+    {
+        status = H5Dread(dataset, H5T_NATIVE_DOUBLE, memory_space, file_space, H5P_DEFAULT, pValues);
+    }
+    H5Sclose(file_space);
+    H5Sclose(memory_space);
+    H5Dclose(dataset);
+    if(status < 0)
+    {
+        EXCEPTION("Could not read field " + rName + " from " + mFilename);
+    }
+}
+
+std::vector<double> Hdf5TimeSeriesReader::ReadField(unsigned step, const std::string& rName) const
+{
+    std::vector<double> values(mGridSize[0] * mGridSize[1] * mGridSize[2]);
+    ReadField(step, rName, &values[0]);
+    return values;
+}
@@ -0,0 +1,162 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef HDF5TIMESERIESREADER_HPP_
+#define HDF5TIMESERIESREADER_HPP_
+
+#include <vector>
+#include <string>
+#include <hdf5.h>
+#include "UblasVectorInclude.hpp"
+
+/**
+ * Random access reader for time series written by Hdf5TimeSeriesWriter. Opening
+ * the file reads only the grid description, field names and the time index, any
+ * step of any field is then read with a single hyperslab.
+ */
+class Hdf5TimeSeriesReader
+{
+    /**
+     * The HDF5 file path
+     */
+    std::string mFilename;
+
+    /**
+     * The HDF5 file
+     */
+    hid_t mFile;
+
+    /**
+     * Number of grid points in each direction
+     */
+    c_vector<unsigned, 3> mGridSize;
+
+    /**
+     * Grid spacing
+     */
+    double mGridSpacing;
+
+    /**
+     * Grid origin
+     */
+    c_vector<double, 3> mGridOrigin;
+
+    /**
+     * Field names, in the order they were written
+     */
+    std::vector<std::string> mFieldNames;
+
+    /**
+     * The time of each complete step
+     */
+    std::vector<double> mTimes;
+
+    /**
+     * Copy constructor, not implemented. The object owns the file.
+     */
+    Hdf5TimeSeriesReader(const Hdf5TimeSeriesReader&);
+
+    /**
+     * Assignment, not implemented. The object owns the file.
+     */
+    Hdf5TimeSeriesReader& operator=(const Hdf5TimeSeriesReader&);
+
+public:
+
+    /**
+     * Constructor. Opens the file and reads its index.
+     * @param rFilename the HDF5 file path
+     */
+    Hdf5TimeSeriesReader(const std::string& rFilename);
+
+    /**
+     * Destructor. Closes the file.
+     */
+    ~Hdf5TimeSeriesReader();
+
+    /**
+     * @return the number of grid points in each direction
+     */
+    c_vector<unsigned, 3> GetGridSize() const;
+
+    /**
+     * @return the grid spacing
+     */
+    double GetGridSpacing() const;
+
+    /**
+     * @return the grid origin
+     */
+    c_vector<double, 3> GetGridOrigin() const;
+
+    /**
+     * @return the field names
+     */
+    const std::vector<std::string>& rGetFieldNames() const;
+
+    /**
+     * @param rName the field name
+     * @return whether the file has the field
+     */
+    bool HasField(const std::string& rName) const;
+
+    /**
+     * @return the time of each step
+     */
+    const std::vector<double>& rGetTimes() const;
+
+    /**
+     * @return the number of steps
+     */
+    unsigned GetNumberOfSteps() const;
+
+    /**
+     * Read one step of a field
+     * @param step the step index
+     * @param rName the field name
+     * @param pValues destination, one value per grid point
+     */
+    void ReadField(unsigned step, const std::string& rName, double* pValues) const;
+
+    /**
+     * Read one step of a field
+     * @param step the step index
+     * @param rName the field name
+     * @return one value per grid point
+     */
+    std::vector<double> ReadField(unsigned step, const std::string& rName) const;
+};
+
+#endif /*HDF5TIMESERIESREADER_HPP_*/
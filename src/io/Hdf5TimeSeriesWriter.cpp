@@ -0,0 +1,421 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "Exception.hpp"
+#include "Hdf5Lock.hpp"
+
+#include "Hdf5TimeSeriesWriter.hpp"
+
+namespace
+{
+    /**
+     * Largest number of values in a chunk, chunks hold whole z planes of one step
+     */
+    const unsigned MAX_CHUNK_VALUES = 1u << 20;
+
+    /**
+     * Raise an exception if an HDF5 call failed
+     * @param status the value returned by the call
+     * @param rMessage the error message
+     */
+    void CheckStatus(herr_t status, const std::string& rMessage)
+    {
+        if(status < 0)
+        {
+            EXCEPTION(rMessage);
+        }
+    }
+
+    /**
+     * Write a one dimensional attribute
+     * @param location the object to attach the attribute to
+     * @param rName the attribute name
+     * @param type the memory type of the values
+     * @param size the number of values
+     * @param pValues the values
+     */
+    void WriteAttribute(hid_t location, const std::string& rName, hid_t type, hsize_t size, const void* pValues)
+    {
+        hid_t space = H5Screate_simple(1, &size, NULL);
+        hid_t attribute = H5Acreate2(location, rName.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+        herr_t status = H5Awrite(attribute, type, pValues);
+        H5Aclose(attribute);
+        H5Sclose(space);
+        CheckStatus(status, "Could not write HDF5 attribute " + rName);
+    }
+
+    /**
+     * Read a one dimensional attribute
+     * @param location the object the attribute is attached to
+     * @param rName the attribute name
+     * @param type the memory type of the values
+     * @param pValues the values, sized by the caller
+     */
+    void ReadAttribute(hid_t location, const std::string& rName, hid_t type, void* pValues)
+    {
+        hid_t attribute = H5Aopen(location, rName.c_str(), H5P_DEFAULT);
+        CheckStatus(attribute, "Could not open HDF5 attribute " + rName);
+        herr_t status = H5Aread(attribute, type, pValues);
+        H5Aclose(attribute);
+        CheckStatus(status, "Could not read HDF5 attribute " + rName);
+    }
+}
+
+Hdf5TimeSeriesWriter::Hdf5TimeSeriesWriter(const std::string& rFilename,
+                                           const c_vector<unsigned, 3>& rGridSize,
+                                           double gridSpacing,
+                                           const c_vector<double, 3>& rGridOrigin,
+                                           const std::vector<std::string>& rFieldNames,
+                                           bool append,
+                                           unsigned compressionLevel,
+                                           double restartTime)
+    : mFilename(rFilename),
+      mGridSize(rGridSize),
+      mGridSpacing(gridSpacing),
+      mGridOrigin(rGridOrigin),
+      mFieldNames(rFieldNames),
+      mTimes(),
+      mFile(-1),
+      mTimeDataset(-1),
+      mFieldDatasets()
+{
+    Hdf5Lock lock;
+    if(compressionLevel > 9)
+    {
+        EXCEPTION("HDF5 compression level should be between 0 and 9");
+    }
+
+    std::ifstream existing(mFilename.c_str());
+    if(append && existing.good())
+    {
+        existing.close();
+        OpenLayout(restartTime);
+    }
+    else
+    {
+        CreateLayout(compressionLevel);
+    }
+}
+
+Hdf5TimeSeriesWriter::~Hdf5TimeSeriesWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch(...)
+    {
+        // Destructors must not throw, the data written so far is already in the file
+    }
+}
+
+void Hdf5TimeSeriesWriter::CreateLayout(unsigned compressionLevel)
+{
+    mFile = H5Fcreate(mFilename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    CheckStatus(mFile, "Could not create HDF5 file " + mFilename);
+
+    WriteAttribute(mFile, "grid_size", H5T_NATIVE_UINT, 3, &mGridSize[0]);
+    WriteAttribute(mFile, "grid_spacing", H5T_NATIVE_DOUBLE, 1, &mGridSpacing);
+    WriteAttribute(mFile, "grid_origin", H5T_NATIVE_DOUBLE, 3, &mGridOrigin[0]);
+
+    // The time dataset is the step index
+    hsize_t time_size = 0;
+    hsize_t time_max_size = H5S_UNLIMITED;
+    hsize_t time_chunk = 256;
+    hid_t time_space = H5Screate_simple(1, &time_size, &time_max_size);
+    hid_t time_properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(time_properties, 1, &time_chunk);
+    mTimeDataset = H5Dcreate2(mFile, "time", H5T_IEEE_F64LE, time_space, H5P_DEFAULT, time_properties, H5P_DEFAULT);
+    H5Pclose(time_properties);
+    H5Sclose(time_space);
+    CheckStatus(mTimeDataset, "Could not create the time dataset in " + mFilename);
+
+    // Track creation order so readers see the fields in the order they were given
+    hid_t group_properties = H5Pcreate(H5P_GROUP_CREATE);
+    H5Pset_link_creation_order(group_properties, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+    hid_t group = H5Gcreate2(mFile, "fields", H5P_DEFAULT, group_properties, H5P_DEFAULT);
+    H5Pclose(group_properties);
+    CheckStatus(group, "Could not create the fields group in " + mFilename);
+
+    // Each chunk holds whole z planes of a single step, so reading one step of one field
+    // touches only that step's chunks
+    hsize_t plane_size = hsize_t(mGridSize[0]) * hsize_t(mGridSize[1]);
+    hsize_t planes_per_chunk = std::max(hsize_t(1), std::min(hsize_t(mGridSize[2]), MAX_CHUNK_VALUES / std::max(plane_size, hsize_t(1))));
+    hsize_t size[4] = {0, mGridSize[2], mGridSize[1], mGridSize[0]};
+    hsize_t max_size[4] = {H5S_UNLIMITED, mGridSize[2], mGridSize[1], mGridSize[0]};
+    hsize_t chunk[4] = {1, planes_per_chunk, mGridSize[1], mGridSize[0]};
+
+    hid_t field_properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(field_properties, 4, chunk);
+    if(compressionLevel > 0)
+    {
+        // Shuffling the bytes of neighbouring doubles makes them compress much better
+        H5Pset_shuffle(field_properties);
+        H5Pset_deflate(field_properties, compressionLevel);
+    }
+    hid_t field_space = H5Screate_simple(4, size, max_size);
+    for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+    {
+        hid_t dataset = H5Dcreate2(group, mFieldNames[idx].c_str(), H5T_IEEE_F64LE, field_space,
+                H5P_DEFAULT, field_properties, H5P_DEFAULT);
+        if(dataset < 0)
+        {
+            H5Sclose(field_space);
+            H5Pclose(field_properties);
+            H5Gclose(group);
+            EXCEPTION("Could not create a dataset for field " + mFieldNames[idx] + " in " + mFilename);
+        }
+        mFieldDatasets.push_back(dataset);
+    }
+    H5Sclose(field_space);
+    H5Pclose(field_properties);
+    H5Gclose(group);
+}
+
+void Hdf5TimeSeriesWriter::OpenLayout(double restartTime)
+{
+    mFile = H5Fopen(mFilename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    CheckStatus(mFile, "Could not open HDF5 file " + mFilename);
+
+    c_vector<unsigned, 3> grid_size;
+    double grid_spacing;
+    c_vector<double, 3> grid_origin;
+    ReadAttribute(mFile, "grid_size", H5T_NATIVE_UINT, &grid_size[0]);
+    ReadAttribute(mFile, "grid_spacing", H5T_NATIVE_DOUBLE, &grid_spacing);
+    ReadAttribute(mFile, "grid_origin", H5T_NATIVE_DOUBLE, &grid_origin[0]);
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        if(grid_size[idx] != mGridSize[idx] || grid_origin[idx] != mGridOrigin[idx])
+        {
+            EXCEPTION("HDF5 file " + mFilename + " does not match the output grid");
+        }
+    }
+    if(grid_spacing != mGridSpacing)
+    {
+        EXCEPTION("HDF5 file " + mFilename + " does not match the output grid");
+    }
+
+    mTimeDataset = H5Dopen2(mFile, "time", H5P_DEFAULT);
+    CheckStatus(mTimeDataset, "HDF5 file " + mFilename + " has no time dataset");
+    hid_t time_space = H5Dget_space(mTimeDataset);
+    hsize_t num_steps = 0;
+    H5Sget_simple_extent_dims(time_space, &num_steps, NULL);
+    H5Sclose(time_space);
+
+    for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+    {
+        hid_t dataset = H5Dopen2(mFile, ("fields/" + mFieldNames[idx]).c_str(), H5P_DEFAULT);
+        if(dataset < 0)
+        {
+            EXCEPTION("HDF5 file " + mFilename + " has no dataset for field " + mFieldNames[idx]);
+        }
+        mFieldDatasets.push_back(dataset);
+
+        // A step only counts once its time is written, so steps left over
+        // from an interrupted write are dropped
+        hid_t space = H5Dget_space(dataset);
+        hsize_t size[4];
+        H5Sget_simple_extent_dims(space, size, NULL);
+        H5Sclose(space);
+        num_steps = std::min(num_steps, size[0]);
+    }
+
+    mTimes.resize(num_steps);
+    if(num_steps > 0)
+    {
+        hid_t memory_space = H5Screate_simple(1, &num_steps, NULL);
+        hid_t file_space = H5Dget_space(mTimeDataset);
+        hsize_t start = 0;
+        H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start, NULL, &num_steps, NULL);
+        herr_t status = H5Dread(mTimeDataset, H5T_NATIVE_DOUBLE, memory_space, file_space, H5P_DEFAULT, &mTimes[0]);
+        H5Sclose(file_space);
+        H5Sclose(memory_space);
+        CheckStatus(status, "Could not read the times in " + mFilename);
+    }
+
+    // Steps written after the checkpoint are written again by the restarted run
+    hsize_t num_kept = std::upper_bound(mTimes.begin(), mTimes.end(), restartTime) - mTimes.begin();
+    mTimes.resize(num_kept);
+    herr_t status = H5Dset_extent(mTimeDataset, &num_kept);
+    for(unsigned idx=0; idx<mFieldDatasets.size() && status >= 0; idx++)
+    {
+        hsize_t size[4] = {num_kept, mGridSize[2], mGridSize[1], mGridSize[0]};
+        status = H5Dset_extent(mFieldDatasets[idx], size);
+    }
+    CheckStatus(status, "Could not drop the steps after the restart from " + mFilename);
+}
+
+void Hdf5TimeSeriesWriter::WriteStep(double time, const std::vector<const double*>& rFields)
+{
+    Hdf5Lock lock;
+    if(mFile < 0)
+    {
+        EXCEPTION("HDF5 file " + mFilename + " has been closed");
+    }
+    if(rFields.size() != mFieldDatasets.size())
+    {
+        EXCEPTION("Number of fields written does not match the HDF5 file set up");
+    }
+
+    hsize_t step = mTimes.size();
+    hsize_t num_points = hsize_t(mGridSize[0]) * hsize_t(mGridSize[1]) * hsize_t(mGridSize[2]);
+    hsize_t size[4] = {step + 1, mGridSize[2], mGridSize[1], mGridSize[0]};
+    hsize_t start[4] = {step, 0, 0, 0};
+    hsize_t count[4] = {1, mGridSize[2], mGridSize[1], mGridSize[0]};
+    hid_t memory_space = H5Screate_simple(1, &num_points, NULL);
+    for(unsigned idx=0; idx<mFieldDatasets.size(); idx++)
+    {
+        herr_t status = H5Dset_extent(mFieldDatasets[idx], size);
+        hid_t file_space = H5Dget_space(mFieldDatasets[idx]);
+        if(status >= 0)
+        {
+            status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
+        }
+        if(status >= 0)
+        {
+            status = H5Dwrite(mFieldDatasets[idx], H5T_NATIVE_DOUBLE, memory_space, file_space, H5P_DEFAULT, rFields[idx]);
+        }
+        H5Sclose(file_space);
+        if(status < 0)
+        {
+            H5Sclose(memory_space);
+            EXCEPTION("Could not write field " + mFieldNames[idx] + " to " + mFilename);
+        }
+    }
+    H5Sclose(memory_space);
+
+    // The time is written last, it marks the step as complete
+    hsize_t time_size = step + 1;
+    hsize_t one = 1;
+    herr_t status = H5Dset_extent(mTimeDataset, &time_size);
+    hid_t time_file_space = H5Dget_space(mTimeDataset);
+    hid_t time_memory_space = H5Screate_simple(1, &one, NULL);
+    if(status >= 0)
+    {
+        status = H5Sselect_hyperslab(time_file_space, H5S_SELECT_SET, &step, NULL, &one, NULL);
+    }
+    if(status >= 0)
+    {
+        status = H5Dwrite(mTimeDataset, H5T_NATIVE_DOUBLE, time_memory_space, time_file_space, H5P_DEFAULT, &time);
+    }
+    H5Sclose(time_memory_space);
+    H5Sclose(time_file_space);
+    CheckStatus(status, "Could not write the time to " + mFilename);
+    mTimes.push_back(time);
+
+    // Keep the file readable if the run is interrupted
+    H5Fflush(mFile, H5F_SCOPE_LOCAL);
+}
+
+unsigned Hdf5TimeSeriesWriter::GetNumberOfSteps() const
+{
+    return mTimes.size();
+}
+
+void Hdf5TimeSeriesWriter::Close()
+{
+    Hdf5Lock lock;
+    if(mFile < 0)
+    {
+        return;
+    }
+    for(unsigned idx=0; idx<mFieldDatasets.size(); idx++)
+    {
+        H5Dclose(mFieldDatasets[idx]);
+    }
+    mFieldDatasets.clear();
+    H5Dclose(mTimeDataset);
+    H5Fclose(mFile);
+    mTimeDataset = -1;
+    mFile = -1;
+    WriteXdmf();
+}
+
+std::string Hdf5TimeSeriesWriter::GetXdmfFilename(const std::string& rFilename)
+{
+    std::string::size_type extension = rFilename.rfind(".h5");
+    if(extension != std::string::npos && extension + 3 == rFilename.size())
+    {
+        return rFilename.substr(0, extension) + ".xdmf";
+    }
+    return rFilename + ".xdmf";
+}
+
+void Hdf5TimeSeriesWriter::WriteXdmf() const
+{
+    // The sidecar sits next to the HDF5 file and refers to it by name only
+    std::string data_file = mFilename.substr(mFilename.find_last_of('/') + 1);
+    std::stringstream dimensions;
+    dimensions << mGridSize[2] << " " << mGridSize[1] << " " << mGridSize[0];
+
+    std::ofstream xdmf(GetXdmfFilename(mFilename).c_str());
+    if(!xdmf.is_open())
+    {
+        EXCEPTION("Could not open " + GetXdmfFilename(mFilename) + " for writing");
+    }
+    xdmf << std::setprecision(17);
+    xdmf << "<?xml version=\"1.0\" ?>\n";
+    xdmf << "<Xdmf Version=\"3.0\">\n";
+    xdmf << " <Domain>\n";
+    xdmf << "  <Grid Name=\"TimeSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+    for(unsigned step=0; step<mTimes.size(); step++)
+    {
+        xdmf << "   <Grid Name=\"step_" << step << "\" GridType=\"Uniform\">\n";
+        xdmf << "    <Time Value=\"" << mTimes[step] << "\"/>\n";
+        xdmf << "    <Topology TopologyType=\"3DCoRectMesh\" Dimensions=\"" << dimensions.str() << "\"/>\n";
+        xdmf << "    <Geometry GeometryType=\"ORIGIN_DXDYDZ\">\n";
+        xdmf << "     <DataItem Dimensions=\"3\" Format=\"XML\">" << mGridOrigin[2] << " " << mGridOrigin[1] << " " << mGridOrigin[0] << "</DataItem>\n";
+        xdmf << "     <DataItem Dimensions=\"3\" Format=\"XML\">" << mGridSpacing << " " << mGridSpacing << " " << mGridSpacing << "</DataItem>\n";
+        xdmf << "    </Geometry>\n";
+        for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+        {
+            xdmf << "    <Attribute Name=\"" << mFieldNames[idx] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+            xdmf << "     <DataItem ItemType=\"HyperSlab\" Dimensions=\"" << dimensions.str() << "\">\n";
+            xdmf << "      <DataItem Dimensions=\"3 4\" Format=\"XML\">" << step << " 0 0 0 1 1 1 1 1 " << dimensions.str() << "</DataItem>\n";
+            xdmf << "      <DataItem Dimensions=\"" << mTimes.size() << " " << dimensions.str()
+                 << "\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">" << data_file << ":/fields/" << mFieldNames[idx] << "</DataItem>\n";
+            xdmf << "     </DataItem>\n";
+            xdmf << "    </Attribute>\n";
+        }
+        xdmf << "   </Grid>\n";
+    }
+    xdmf << "  </Grid>\n";
+    xdmf << " </Domain>\n";
+    xdmf << "</Xdmf>\n";
+}
@@ -0,0 +1,180 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef HDF5TIMESERIESWRITER_HPP_
+#define HDF5TIMESERIESWRITER_HPP_
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <hdf5.h>
+#include "UblasVectorInclude.hpp"
+
+/**
+ * Appends output steps to a single chunked, compressed HDF5 file rather than writing
+ * one image file per step. Each field is a dataset /fields/<name> of shape
+ * (step, z, y, x) that grows by one step per write, and /time holds the time of each
+ * step, so any step of any field can be read back with a single hyperslab. An XDMF
+ * sidecar describing the time series is written on Close(), so ParaView can open it.
+ */
+class Hdf5TimeSeriesWriter
+{
+    /**
+     * The HDF5 file path
+     */
+    std::string mFilename;
+
+    /**
+     * Number of grid points in each direction
+     */
+    c_vector<unsigned, 3> mGridSize;
+
+    /**
+     * Grid spacing
+     */
+    double mGridSpacing;
+
+    /**
+     * Grid origin
+     */
+    c_vector<double, 3> mGridOrigin;
+
+    /**
+     * Field names, in the order the fields are written
+     */
+    std::vector<std::string> mFieldNames;
+
+    /**
+     * The time of each step written so far
+     */
+    std::vector<double> mTimes;
+
+    /**
+     * The HDF5 file
+     */
+    hid_t mFile;
+
+    /**
+     * The time dataset
+     */
+    hid_t mTimeDataset;
+
+    /**
+     * One dataset per field
+     */
+    std::vector<hid_t> mFieldDatasets;
+
+    /**
+     * Copy constructor, not implemented. The object owns the file.
+     */
+    Hdf5TimeSeriesWriter(const Hdf5TimeSeriesWriter&);
+
+    /**
+     * Assignment, not implemented. The object owns the file.
+     */
+    Hdf5TimeSeriesWriter& operator=(const Hdf5TimeSeriesWriter&);
+
+public:
+
+    /**
+     * Constructor. Creates the file, or opens it to add further steps.
+     * @param rFilename the HDF5 file path
+     * @param rGridSize the number of grid points in each direction
+     * @param gridSpacing the grid spacing
+     * @param rGridOrigin the grid origin
+     * @param rFieldNames the names of the fields in each step
+     * @param append whether to add to an existing file with the same grid and fields
+     * @param compressionLevel the deflate level, 0 for no compression
+     * @param restartTime when appending, steps later than this are dropped, as they were
+     *     written after the checkpoint that the run restarts from
+     */
+    Hdf5TimeSeriesWriter(const std::string& rFilename,
+                         const c_vector<unsigned, 3>& rGridSize,
+                         double gridSpacing,
+                         const c_vector<double, 3>& rGridOrigin,
+                         const std::vector<std::string>& rFieldNames,
+                         bool append = false,
+                         unsigned compressionLevel = 1,
+                         double restartTime = std::numeric_limits<double>::max());
+
+    /**
+     * Destructor. Closes the file.
+     */
+    ~Hdf5TimeSeriesWriter();
+
+    /**
+     * Append a step
+     * @param time the time of the step
+     * @param rFields one buffer per field name, in the order given on construction
+     */
+    void WriteStep(double time, const std::vector<const double*>& rFields);
+
+    /**
+     * @return the number of steps in the file
+     */
+    unsigned GetNumberOfSteps() const;
+
+    /**
+     * Write the XDMF sidecar and close the file. Called by the destructor if needed.
+     */
+    void Close();
+
+    /**
+     * @param rFilename the HDF5 file path
+     * @return the path of the XDMF sidecar for the file
+     */
+    static std::string GetXdmfFilename(const std::string& rFilename);
+
+private:
+
+    /**
+     * Create the file layout
+     * @param compressionLevel the deflate level, 0 for no compression
+     */
+    void CreateLayout(unsigned compressionLevel);
+
+    /**
+     * Open and check the layout of an existing file, dropping steps after a time
+     * @param restartTime the time of the last step to keep
+     */
+    void OpenLayout(double restartTime);
+
+    /**
+     * Write the XDMF sidecar for the steps written so far
+     */
+    void WriteXdmf() const;
+};
+
+#endif /*HDF5TIMESERIESWRITER_HPP_*/
@@ -0,0 +1,142 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <map>
+#include <algorithm>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSetGet.h>
+#include "UblasVectorInclude.hpp"
+#include "Exception.hpp"
+#include "BinaryFieldFile.hpp"
+
+#include "InputFileConverter.hpp"
+
+namespace
+{
+    /**
+     * Copy a typed array into a double buffer
+     * @param pSource the source values
+     * @param numValues the number of values
+     * @param pDestination the destination buffer
+     */
+    template<typename TYPE>
+    void CopyValues(const TYPE* pSource, unsigned numValues, double* pDestination)
+    {
+        std::copy(pSource, pSource + numValues, pDestination);
+    }
+}
+
+void InputFileConverter::Convert(vtkImageData* pImage,
+                                 const std::string& rFilename,
+                                 const std::vector<std::string>& rArrayNames)
+{
+    vtkPointData* p_point_data = pImage->GetPointData();
+    std::vector<std::string> names = rArrayNames;
+    if(names.empty())
+    {
+        for(int idx=0; idx<p_point_data->GetNumberOfArrays(); idx++)
+        {
+            vtkDataArray* p_array = p_point_data->GetArray(idx);
+            if(p_array && p_array->GetName() && p_array->GetNumberOfComponents() == 1)
+            {
+                names.push_back(p_array->GetName());
+            }
+        }
+    }
+
+    c_vector<unsigned, 3> grid_size;
+    c_vector<double, 3> grid_origin;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        grid_size[idx] = pImage->GetDimensions()[idx];
+        grid_origin[idx] = pImage->GetOrigin()[idx];
+    }
+    unsigned num_points = grid_size[0] * grid_size[1] * grid_size[2];
+
+    // Convert each array to doubles. Aligned padding is added when writing.
+    std::vector<std::vector<double> > values(names.size());
+    std::vector<const double*> arrays(names.size());
+    for(unsigned idx=0; idx<names.size(); idx++)
+    {
+        vtkDataArray* p_array = p_point_data->GetArray(names[idx].c_str());
+        if(!p_array)
+        {
+            EXCEPTION("Input image does not contain the array " + names[idx]);
+        }
+        if(p_array->GetNumberOfComponents() != 1)
+        {
+            EXCEPTION("Input array " + names[idx] + " should have a single component");
+        }
+        if(p_array->GetNumberOfTuples() != vtkIdType(num_points))
+        {
+            EXCEPTION("Number of points in input array " + names[idx] + " does not match number of points in grid");
+        }
+
+        values[idx].resize(num_points);
+        double* p_destination = num_points > 0 ? &values[idx][0] : NULL;
+        switch(p_array->GetDataType())
+        {
+            vtkTemplateMacro(CopyValues(static_cast<const VTK_TT*>(p_array->GetVoidPointer(0)), num_points, p_destination));
+            default:
+                for(unsigned jdx=0; jdx<num_points; jdx++)
+                {
+                    p_destination[jdx] = p_array->GetTuple1(jdx);
+                }
+        }
+        arrays[idx] = p_destination;
+    }
+
+    BinaryFieldFile::Write(rFilename, grid_size, pImage->GetSpacing()[0], grid_origin,
+            std::map<std::string, double>(), names, arrays);
+}
+
+void InputFileConverter::Convert(const std::string& rInputFilename,
+                                 const std::string& rFilename,
+                                 const std::vector<std::string>& rArrayNames)
+{
+    vtkSmartPointer<vtkXMLImageDataReader> p_reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
+    p_reader->SetFileName(rInputFilename.c_str());
+    p_reader->Update();
+    vtkImageData* p_image = p_reader->GetOutput();
+    if(!p_image)
+    {
+        EXCEPTION("Error reading input VTK file " + rInputFilename);
+    }
+    Convert(p_image, rFilename, rArrayNames);
+}
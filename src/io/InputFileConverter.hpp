@@ -0,0 +1,75 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef INPUTFILECONVERTER_HPP_
+#define INPUTFILECONVERTER_HPP_
+
+#include <vector>
+#include <string>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkImageData.h>
+
+/**
+ * Converts VTK image inputs into pre-processed binary field files. The compressed,
+ * encoded XML inputs have to be decoded in full on every run, while the binary
+ * files can be mapped and only the arrays a component needs are read.
+ */
+class InputFileConverter
+{
+public:
+
+    /**
+     * Write the point data of an image to a binary field file. Arrays of any numeric
+     * type are stored as doubles.
+     * @param pImage the image
+     * @param rFilename the path to the binary field file
+     * @param rArrayNames the arrays to store, all single component point arrays if empty
+     */
+    static void Convert(vtkImageData* pImage,
+                        const std::string& rFilename,
+                        const std::vector<std::string>& rArrayNames = std::vector<std::string>());
+
+    /**
+     * Read a VTK image file and write it to a binary field file.
+     * @param rInputFilename the path to the VTK image file
+     * @param rFilename the path to the binary field file
+     * @param rArrayNames the arrays to store, all single component point arrays if empty
+     */
+    static void Convert(const std::string& rInputFilename,
+                        const std::string& rFilename,
+                        const std::vector<std::string>& rArrayNames = std::vector<std::string>());
+};
+
+#endif /*INPUTFILECONVERTER_HPP_*/
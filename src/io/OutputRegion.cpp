@@ -0,0 +1,196 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <climits>
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "OutputRegion.hpp"
+
+OutputRegion::OutputRegion()
+    : mLower(zero_vector<unsigned>(3)),
+      mUpper(scalar_vector<unsigned>(3, UINT_MAX)),
+      mStride(1),
+      mAverage(false)
+{
+}
+
+OutputRegion OutputRegion::SubVolume(const c_vector<unsigned, 3>& rLower, const c_vector<unsigned, 3>& rUpper)
+{
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        if(rLower[idx] > rUpper[idx])
+        {
+            EXCEPTION("Output region lower bounds must not exceed upper bounds");
+        }
+    }
+    OutputRegion region;
+    region.mLower = rLower;
+    region.mUpper = rUpper;
+    return region;
+}
+
+OutputRegion OutputRegion::Slice(unsigned axis, unsigned index)
+{
+    if(axis > 2)
+    {
+        EXCEPTION("Slice axis must be 0, 1 or 2");
+    }
+    OutputRegion region;
+    region.mLower[axis] = index;
+    region.mUpper[axis] = index;
+    return region;
+}
+
+OutputRegion OutputRegion::Downsample(unsigned stride, bool average)
+{
+    OutputRegion region;
+    region.SetStride(stride, average);
+    return region;
+}
+
+OutputRegion& OutputRegion::SetStride(unsigned stride, bool average)
+{
+    if(stride == 0)
+    {
+        EXCEPTION("Output stride must be at least one");
+    }
+    mStride = stride;
+    mAverage = average && stride > 1;
+    return *this;
+}
+
+c_vector<unsigned, 3> OutputRegion::GetClippedUpper(const c_vector<unsigned, 3>& rGridSize) const
+{
+    c_vector<unsigned, 3> upper;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        if(mLower[idx] >= rGridSize[idx])
+        {
+            EXCEPTION("Output region lies outside the grid");
+        }
+        upper[idx] = std::min(mUpper[idx], rGridSize[idx] - 1);
+    }
+    return upper;
+}
+
+c_vector<unsigned, 3> OutputRegion::GetSize(const c_vector<unsigned, 3>& rGridSize) const
+{
+    c_vector<unsigned, 3> upper = GetClippedUpper(rGridSize);
+    c_vector<unsigned, 3> size;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        size[idx] = (upper[idx] - mLower[idx]) / mStride + 1;
+    }
+    return size;
+}
+
+c_vector<double, 3> OutputRegion::GetOrigin(const c_vector<double, 3>& rGridOrigin, double gridSpacing) const
+{
+    // Averages sit at the centre of their blocks, a region one point thick has no offset
+    c_vector<double, 3> origin;
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        double offset = mAverage ? 0.5 * double(std::min(mStride - 1, mUpper[idx] - mLower[idx])) : 0.0;
+        origin[idx] = rGridOrigin[idx] + (double(mLower[idx]) + offset) * gridSpacing;
+    }
+    return origin;
+}
+
+double OutputRegion::GetSpacing(double gridSpacing) const
+{
+    return gridSpacing * double(mStride);
+}
+
+bool OutputRegion::IsWholeGrid(const c_vector<unsigned, 3>& rGridSize) const
+{
+    c_vector<unsigned, 3> upper = GetClippedUpper(rGridSize);
+    for(unsigned idx=0; idx<3; idx++)
+    {
+        if(mLower[idx] != 0 || upper[idx] != rGridSize[idx] - 1)
+        {
+            return false;
+        }
+    }
+    return mStride == 1;
+}
+
+void OutputRegion::Extract(const double* pValues, const c_vector<unsigned, 3>& rGridSize, double* pOutput) const
+{
+    c_vector<unsigned, 3> upper = GetClippedUpper(rGridSize);
+    c_vector<unsigned, 3> size = GetSize(rGridSize);
+    unsigned plane_size = rGridSize[0] * rGridSize[1];
+
+    unsigned output_index = 0;
+    for(unsigned kdx=0; kdx<size[2]; kdx++)
+    {
+        unsigned z = mLower[2] + kdx * mStride;
+        for(unsigned jdx=0; jdx<size[1]; jdx++)
+        {
+            unsigned y = mLower[1] + jdx * mStride;
+            const double* p_row = pValues + z * plane_size + y * rGridSize[0];
+            if(!mAverage)
+            {
+                for(unsigned idx=0; idx<size[0]; idx++)
+                {
+                    pOutput[output_index++] = p_row[mLower[0] + idx * mStride];
+                }
+                continue;
+            }
+
+            // Blocks at the upper edges of the region are clipped
+            unsigned z_end = std::min(z + mStride, upper[2] + 1);
+            unsigned y_end = std::min(y + mStride, upper[1] + 1);
+            for(unsigned idx=0; idx<size[0]; idx++)
+            {
+                unsigned x = mLower[0] + idx * mStride;
+                unsigned x_end = std::min(x + mStride, upper[0] + 1);
+                double sum = 0.0;
+                for(unsigned block_z=z; block_z<z_end; block_z++)
+                {
+                    for(unsigned block_y=y; block_y<y_end; block_y++)
+                    {
+                        const double* p_block_row = pValues + block_z * plane_size + block_y * rGridSize[0];
+                        for(unsigned block_x=x; block_x<x_end; block_x++)
+                        {
+                            sum += p_block_row[block_x];
+                        }
+                    }
+                }
+                pOutput[output_index++] = sum / double((z_end - z) * (y_end - y) * (x_end - x));
+            }
+        }
+    }
+}
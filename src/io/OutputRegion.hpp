@@ -0,0 +1,148 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef OUTPUTREGION_HPP_
+#define OUTPUTREGION_HPP_
+
+#include "UblasVectorInclude.hpp"
+
+/**
+ * The part of the grid written for an output field. A region is a box of grid
+ * point indices, clipped to the grid, sampled every stride points in each
+ * direction. Sampled values are either taken directly or averaged over the
+ * stride^3 block of points starting at each sample. Subvolumes, slices and
+ * downsampling are all special cases and can be combined.
+ */
+class OutputRegion
+{
+    /**
+     * Lowest grid point index in each direction
+     */
+    c_vector<unsigned, 3> mLower;
+
+    /**
+     * Highest grid point index in each direction, inclusive. Clipped to the grid.
+     */
+    c_vector<unsigned, 3> mUpper;
+
+    /**
+     * Sampling stride
+     */
+    unsigned mStride;
+
+    /**
+     * Whether to average over each block rather than sample
+     */
+    bool mAverage;
+
+public:
+
+    /**
+     * Constructor. The whole grid.
+     */
+    OutputRegion();
+
+    /**
+     * @param rLower lowest grid point index in each direction
+     * @param rUpper highest grid point index in each direction, inclusive
+     * @return a subvolume, such as the tumour bounding box
+     */
+    static OutputRegion SubVolume(const c_vector<unsigned, 3>& rLower, const c_vector<unsigned, 3>& rUpper);
+
+    /**
+     * @param axis the slice normal, 0, 1 or 2 for x, y or z
+     * @param index the grid point index of the slice along the axis
+     * @return an axis aligned slice through the whole grid
+     */
+    static OutputRegion Slice(unsigned axis, unsigned index);
+
+    /**
+     * @param stride the sampling stride
+     * @param average whether to average over each block rather than sample
+     * @return the whole grid downsampled
+     */
+    static OutputRegion Downsample(unsigned stride, bool average = true);
+
+    /**
+     * Set the sampling stride of the region
+     * @param stride the sampling stride
+     * @param average whether to average over each block rather than sample
+     * @return this region
+     */
+    OutputRegion& SetStride(unsigned stride, bool average = true);
+
+    /**
+     * @param rGridSize the number of grid points in each direction
+     * @return the number of output points in each direction
+     */
+    c_vector<unsigned, 3> GetSize(const c_vector<unsigned, 3>& rGridSize) const;
+
+    /**
+     * @param rGridOrigin the grid origin
+     * @param gridSpacing the grid spacing
+     * @return the location of the first output point, the centre of the first block when averaging
+     */
+    c_vector<double, 3> GetOrigin(const c_vector<double, 3>& rGridOrigin, double gridSpacing) const;
+
+    /**
+     * @param gridSpacing the grid spacing
+     * @return the spacing of the output points
+     */
+    double GetSpacing(double gridSpacing) const;
+
+    /**
+     * @param rGridSize the number of grid points in each direction
+     * @return whether the region is the whole grid at full resolution
+     */
+    bool IsWholeGrid(const c_vector<unsigned, 3>& rGridSize) const;
+
+    /**
+     * Extract the region from a field
+     * @param pValues the field, one value per grid point
+     * @param rGridSize the number of grid points in each direction
+     * @param pOutput destination, one value per output point
+     */
+    void Extract(const double* pValues, const c_vector<unsigned, 3>& rGridSize, double* pOutput) const;
+
+private:
+
+    /**
+     * @param rGridSize the number of grid points in each direction
+     * @return the upper index in each direction, clipped to the grid
+     */
+    c_vector<unsigned, 3> GetClippedUpper(const c_vector<unsigned, 3>& rGridSize) const;
+};
+
+#endif /*OUTPUTREGION_HPP_*/
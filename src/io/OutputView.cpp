@@ -0,0 +1,152 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include "Exception.hpp"
+
+#include "OutputView.hpp"
+
+OutputView::OutputView(const std::string& rName, const OutputRegion& rRegion, const std::vector<std::string>& rFieldNames)
+    : mName(rName),
+      mRegion(rRegion),
+      mFieldNames(rFieldNames),
+      mGridSize(zero_vector<unsigned>(3)),
+      mpFields(NULL),
+      mHandles(),
+      mValues(),
+      mWrapsFields(false),
+      mpImage()
+{
+}
+
+void OutputView::Bind(FieldRegistry& rFields, const c_vector<unsigned, 3>& rGridSize,
+                      double gridSpacing, const c_vector<double, 3>& rGridOrigin)
+{
+    mGridSize = rGridSize;
+    c_vector<unsigned, 3> size = mRegion.GetSize(rGridSize);
+    c_vector<double, 3> origin = mRegion.GetOrigin(rGridOrigin, gridSpacing);
+    double spacing = mRegion.GetSpacing(gridSpacing);
+    unsigned num_points = size[0] * size[1] * size[2];
+
+    mWrapsFields = mRegion.IsWholeGrid(rGridSize);
+    mValues.Reset(mWrapsFields ? 0 : num_points);
+    mpFields = &rFields;
+    mHandles.clear();
+
+    mpImage = vtkSmartPointer<vtkImageData>::New();
+    mpImage->SetDimensions(size[0], size[1], size[2]);
+    mpImage->SetOrigin(origin[0], origin[1], origin[2]);
+    mpImage->SetSpacing(spacing, spacing, spacing);
+    for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+    {
+        mHandles.push_back(rFields.GetHandle(mFieldNames[idx]));
+        double* p_source = rFields.GetField(mHandles.back());
+
+        // VTK is told not to free the buffers
+        double* p_values = mWrapsFields ? p_source : mValues.GetField(mValues.Register(mFieldNames[idx]));
+        vtkSmartPointer<vtkDoubleArray> p_point_data = vtkSmartPointer<vtkDoubleArray>::New();
+        p_point_data->SetNumberOfComponents(1);
+        p_point_data->SetArray(p_values, num_points, 1);
+        p_point_data->SetName(mFieldNames[idx].c_str());
+        mpImage->GetPointData()->AddArray(p_point_data);
+    }
+}
+
+void OutputView::Update()
+{
+    if(!mpImage)
+    {
+        EXCEPTION("Output view has not been bound to the solution fields");
+    }
+    for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+    {
+        const double* p_source = mpFields->GetField(mHandles[idx]);
+        vtkDoubleArray* p_point_data = vtkDoubleArray::SafeDownCast(
+                mpImage->GetPointData()->GetArray(mFieldNames[idx].c_str()));
+        if(!mWrapsFields)
+        {
+            mRegion.Extract(p_source, mGridSize, mValues.GetField(mValues.GetHandle(mFieldNames[idx])));
+        }
+        else if(p_point_data->GetPointer(0) != p_source)
+        {
+            // A received field has been handed a new buffer. VTK is told not to free it.
+            p_point_data->SetArray(const_cast<double*>(p_source), p_point_data->GetNumberOfTuples(), 1);
+        }
+        p_point_data->Modified();
+    }
+}
+
+const std::string& OutputView::rGetName() const
+{
+    return mName;
+}
+
+const std::vector<std::string>& OutputView::rGetFieldNames() const
+{
+    return mFieldNames;
+}
+
+vtkImageData* OutputView::GetImage() const
+{
+    return mpImage;
+}
+
+std::vector<const double*> OutputView::GetValues() const
+{
+    std::vector<const double*> values;
+    for(unsigned idx=0; idx<mFieldNames.size(); idx++)
+    {
+        values.push_back(mWrapsFields ? mpFields->GetField(mHandles[idx]) :
+                mValues.GetField(mValues.GetHandle(mFieldNames[idx])));
+    }
+    return values;
+}
+
+std::string OutputView::GetFilename(const std::string& rFilename) const
+{
+    if(mName.empty())
+    {
+        return rFilename;
+    }
+    std::string::size_type extension = rFilename.find_last_of('.');
+    std::string::size_type directory = rFilename.find_last_of('/');
+    if(extension == std::string::npos || (directory != std::string::npos && extension < directory))
+    {
+        return rFilename + "_" + mName;
+    }
+    return rFilename.substr(0, extension) + "_" + mName + rFilename.substr(extension);
+}
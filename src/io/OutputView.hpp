@@ -0,0 +1,162 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef OUTPUTVIEW_HPP_
+#define OUTPUTVIEW_HPP_
+
+#include <vector>
+#include <string>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include "UblasVectorInclude.hpp"
+#include "FieldRegistry.hpp"
+#include "OutputRegion.hpp"
+
+/**
+ * A named set of output fields written over one region of the grid, as a VTK
+ * image. A view of the whole grid at full resolution wraps the solution fields
+ * directly, other views extract their region into their own buffers at each write.
+ */
+class OutputView
+{
+    /**
+     * The view name, appended to output file names. Empty for the default view.
+     */
+    std::string mName;
+
+    /**
+     * The region written
+     */
+    OutputRegion mRegion;
+
+    /**
+     * The fields written
+     */
+    std::vector<std::string> mFieldNames;
+
+    /**
+     * Number of grid points in each direction of the solution grid
+     */
+    c_vector<unsigned, 3> mGridSize;
+
+    /**
+     * The solution fields, looked up at each update as coupling may replace their buffers
+     */
+    const FieldRegistry* mpFields;
+
+    /**
+     * The solution field handles, in the order of mFieldNames
+     */
+    std::vector<unsigned> mHandles;
+
+    /**
+     * The extracted fields, unused if the view wraps the solution fields
+     */
+    FieldRegistry mValues;
+
+    /**
+     * Whether the view wraps the solution fields directly
+     */
+    bool mWrapsFields;
+
+    /**
+     * The image written, with arrays wrapping the view values
+     */
+    vtkSmartPointer<vtkImageData> mpImage;
+
+    /**
+     * Copy constructor, not implemented. The image wraps the view buffers.
+     */
+    OutputView(const OutputView&);
+
+    /**
+     * Assignment, not implemented. The image wraps the view buffers.
+     */
+    OutputView& operator=(const OutputView&);
+
+public:
+
+    /**
+     * Constructor.
+     * @param rName the view name, appended to output file names
+     * @param rRegion the region written
+     * @param rFieldNames the fields written
+     */
+    OutputView(const std::string& rName, const OutputRegion& rRegion, const std::vector<std::string>& rFieldNames);
+
+    /**
+     * Attach the view to the solution fields. The registry must outlive the view's use.
+     * @param rFields the solution fields
+     * @param rGridSize the number of grid points in each direction
+     * @param gridSpacing the grid spacing
+     * @param rGridOrigin the grid origin
+     */
+    void Bind(FieldRegistry& rFields, const c_vector<unsigned, 3>& rGridSize,
+              double gridSpacing, const c_vector<double, 3>& rGridOrigin);
+
+    /**
+     * Bring the image up to date with the solution fields
+     */
+    void Update();
+
+    /**
+     * @return the view name
+     */
+    const std::string& rGetName() const;
+
+    /**
+     * @return the fields written
+     */
+    const std::vector<std::string>& rGetFieldNames() const;
+
+    /**
+     * @return the image, valid after Bind()
+     */
+    vtkImageData* GetImage() const;
+
+    /**
+     * @return the values of each field in the image, in the order of rGetFieldNames()
+     */
+    std::vector<const double*> GetValues() const;
+
+    /**
+     * @param rFilename an output file name
+     * @return the file name with the view name inserted before the extension
+     */
+    std::string GetFilename(const std::string& rFilename) const;
+};
+
+#endif /*OUTPUTVIEW_HPP_*/
@@ -0,0 +1,154 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkXMLImageDataWriter.h>
+#include <vtkVersion.h>
+#include "Exception.hpp"
+
+#include "VtkImageWriter.hpp"
+
+/**
+ * LZ4 and LZMA compressors were added in VTK 8.1, compression levels in 8.2
+ */
+#define CHIC_VTK_HAS_LZ4 (VTK_MAJOR_VERSION > 8 || (VTK_MAJOR_VERSION == 8 && VTK_MINOR_VERSION >= 1))
+#define CHIC_VTK_HAS_COMPRESSION_LEVEL (VTK_MAJOR_VERSION > 8 || (VTK_MAJOR_VERSION == 8 && VTK_MINOR_VERSION >= 2))
+
+VtkImageWriter::VtkImageWriter(VtkCodec codec, int compressionLevel)
+    : mCodec(codec),
+      mCompressionLevel(compressionLevel)
+{
+    if(compressionLevel != -1 && (compressionLevel < 1 || compressionLevel > 9))
+    {
+        EXCEPTION("VTK compression level should be between 1 and 9");
+    }
+#if !CHIC_VTK_HAS_LZ4
+    if(codec == LZ4_CODEC || codec == LZMA_CODEC)
+    {
+        EXCEPTION("The " + GetCodecName(codec) + " codec needs VTK 8.1 or later");
+    }
+#endif
+}
+
+VtkCodec VtkImageWriter::GetCodec() const
+{
+    return mCodec;
+}
+
+int VtkImageWriter::GetCompressionLevel() const
+{
+    return mCompressionLevel;
+}
+
+void VtkImageWriter::Write(vtkImageData* pImage, const std::string& rFilename) const
+{
+    vtkSmartPointer<vtkXMLImageDataWriter> p_image_data_writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
+    p_image_data_writer->SetFileName(rFilename.c_str());
+    p_image_data_writer->SetInputData(pImage);
+
+    if(mCodec != ZLIB_BASE64_CODEC)
+    {
+        // Raw appended data is read back with a single read per array
+        p_image_data_writer->SetDataModeToAppended();
+        p_image_data_writer->EncodeAppendedDataOff();
+        switch(mCodec)
+        {
+            case RAW_CODEC:
+                p_image_data_writer->SetCompressorTypeToNone();
+                break;
+            case ZLIB_CODEC:
+                p_image_data_writer->SetCompressorTypeToZLib();
+                break;
+#if CHIC_VTK_HAS_LZ4
+            case LZ4_CODEC:
+                p_image_data_writer->SetCompressorTypeToLZ4();
+                break;
+            case LZMA_CODEC:
+                p_image_data_writer->SetCompressorTypeToLZMA();
+                break;
+#endif
+            default:
+                EXCEPTION("Unsupported VTK codec " + GetCodecName(mCodec));
+        }
+    }
+#if CHIC_VTK_HAS_COMPRESSION_LEVEL
+    if(mCompressionLevel != -1)
+    {
+        p_image_data_writer->SetCompressionLevel(mCompressionLevel);
+    }
+#endif
+    p_image_data_writer->Update();
+
+    try
+    {
+        p_image_data_writer->Write();
+    }
+    catch(...)
+    {
+        EXCEPTION("Error writing to VTK file.");
+    }
+}
+
+VtkCodec VtkImageWriter::GetCodec(const std::string& rName)
+{
+    VtkCodec codecs[5] = {ZLIB_BASE64_CODEC, RAW_CODEC, ZLIB_CODEC, LZ4_CODEC, LZMA_CODEC};
+    for(unsigned idx=0; idx<5; idx++)
+    {
+        if(GetCodecName(codecs[idx]) == rName)
+        {
+            return codecs[idx];
+        }
+    }
+    EXCEPTION("Unknown VTK codec " + rName + ". Use zlib_base64, raw, zlib, lz4 or lzma");
+}
+
+std::string VtkImageWriter::GetCodecName(VtkCodec codec)
+{
+    switch(codec)
+    {
+        case ZLIB_BASE64_CODEC:
+            return "zlib_base64";
+        case RAW_CODEC:
+            return "raw";
+        case ZLIB_CODEC:
+            return "zlib";
+        case LZ4_CODEC:
+            return "lz4";
+        case LZMA_CODEC:
+            return "lzma";
+    }
+    return "unknown";
+}
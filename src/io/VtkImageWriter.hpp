@@ -0,0 +1,100 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef VTKIMAGEWRITER_HPP_
+#define VTKIMAGEWRITER_HPP_
+
+#include <string>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkImageData.h>
+#include "OutputFormat.hpp"
+
+/**
+ * Writes VTK image files with a selectable codec. Appended raw data avoids the
+ * base64 encoding VTK applies by default, which is a large part of the cost of
+ * writing and reading back output.
+ */
+class VtkImageWriter
+{
+    /**
+     * The codec
+     */
+    VtkCodec mCodec;
+
+    /**
+     * The compression level, or -1 for the compressor's default
+     */
+    int mCompressionLevel;
+
+public:
+
+    /**
+     * Constructor.
+     * @param codec the codec
+     * @param compressionLevel the compression level from 1 to 9, or -1 for the compressor's default
+     */
+    VtkImageWriter(VtkCodec codec = ZLIB_BASE64_CODEC, int compressionLevel = -1);
+
+    /**
+     * @return the codec
+     */
+    VtkCodec GetCodec() const;
+
+    /**
+     * @return the compression level, -1 for the compressor's default
+     */
+    int GetCompressionLevel() const;
+
+    /**
+     * Write an image
+     * @param pImage the image
+     * @param rFilename the path to the file
+     */
+    void Write(vtkImageData* pImage, const std::string& rFilename) const;
+
+    /**
+     * @param rName a codec name: zlib_base64, raw, zlib, lz4 or lzma
+     * @return the codec
+     */
+    static VtkCodec GetCodec(const std::string& rName);
+
+    /**
+     * @param codec a codec
+     * @return the codec name
+     */
+    static std::string GetCodecName(VtkCodec codec);
+};
+
+#endif /*VTKIMAGEWRITER_HPP_*/
@@ -0,0 +1,307 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "PetscTools.hpp"
+
+#include "DiffusionReactionSystem.hpp"
+
+DiffusionReactionSystem::DiffusionReactionSystem(const c_vector<unsigned, 3>& rGridSize, double spacing,
+                                                 double diffusivity)
+    : mGridSize(rGridSize),
+      mDiffusionTerm(diffusivity / (spacing * spacing)),
+      mMatrix(NULL),
+      mRhs(NULL),
+      mDiagonal(NULL),
+      mLo(0),
+      mHi(0),
+      mDirichletRows(),
+      mRowsWritten(false),
+      mPreviousRhs(NULL),
+      mRhsChange(-1.0),
+      mChangeTolerance(0.0),
+      mLagging(),
+      mPreconditionerRebuilt(false),
+      mKsp(NULL),
+      mNumIterations(0)
+{
+    PetscInt num_points = mGridSize[0] * mGridSize[1] * mGridSize[2];
+    mRhs = PetscTools::CreateVec(num_points);
+    VecDuplicate(mRhs, &mDiagonal);
+    VecDuplicate(mRhs, &mPreviousRhs);
+    VecGetOwnershipRange(mRhs, &mLo, &mHi);
+    PetscInt num_local = mHi - mLo;
+    mDirichletRows.assign(num_local, false);
+
+    // Exact preallocation, splitting each row's neighbours into those owned here and elsewhere
+    std::vector<PetscInt> diagonal_nnz(num_local, 1);
+    std::vector<PetscInt> off_diagonal_nnz(num_local, 0);
+    PetscInt offsets[3] = {1, PetscInt(mGridSize[0]), PetscInt(mGridSize[0] * mGridSize[1])};
+    for(PetscInt row=mLo; row<mHi; row++)
+    {
+        unsigned position[3] = {row % mGridSize[0], (row / mGridSize[0]) % mGridSize[1],
+                row / (mGridSize[0] * mGridSize[1])};
+        for(unsigned axis=0; axis<3; axis++)
+        {
+            for(int side=-1; side<=1; side+=2)
+            {
+                if((side < 0 && position[axis] == 0) || (side > 0 && position[axis] + 1 == mGridSize[axis]))
+                {
+                    continue;
+                }
+                PetscInt column = row + side * offsets[axis];
+                if(column >= mLo && column < mHi)
+                {
+                    diagonal_nnz[row - mLo]++;
+                }
+                else
+                {
+                    off_diagonal_nnz[row - mLo]++;
+                }
+            }
+        }
+    }
+
+    MatCreate(PETSC_COMM_WORLD, &mMatrix);
+    MatSetSizes(mMatrix, num_local, num_local, num_points, num_points);
+    MatSetType(mMatrix, MATAIJ);
+    MatSeqAIJSetPreallocation(mMatrix, 0, diagonal_nnz.empty() ? NULL : &diagonal_nnz[0]);
+    MatMPIAIJSetPreallocation(mMatrix, 0, diagonal_nnz.empty() ? NULL : &diagonal_nnz[0],
+            0, off_diagonal_nnz.empty() ? NULL : &off_diagonal_nnz[0]);
+    MatSetOption(mMatrix, MAT_NEW_NONZERO_ALLOCATION_ERR, PETSC_TRUE);
+
+    // GMRES with Jacobi unless the options say otherwise, as for LinearSystem
+    KSPCreate(PETSC_COMM_WORLD, &mKsp);
+    KSPSetOperators(mKsp, mMatrix, mMatrix);
+    KSPSetType(mKsp, KSPGMRES);
+    PC pc;
+    KSPGetPC(mKsp, &pc);
+    PCSetType(pc, PCJACOBI);
+    KSPSetFromOptions(mKsp);
+}
+
+DiffusionReactionSystem::~DiffusionReactionSystem()
+{
+    KSPDestroy(&mKsp);
+    PetscTools::Destroy(mMatrix);
+    PetscTools::Destroy(mRhs);
+    PetscTools::Destroy(mDiagonal);
+    PetscTools::Destroy(mPreviousRhs);
+}
+
+void DiffusionReactionSystem::GetOwnershipRange(PetscInt& rLo, PetscInt& rHi) const
+{
+    rLo = mLo;
+    rHi = mHi;
+}
+
+unsigned DiffusionReactionSystem::GetNumberOfNeighbours(PetscInt row) const
+{
+    unsigned position[3] = {row % mGridSize[0], (row / mGridSize[0]) % mGridSize[1],
+            row / (mGridSize[0] * mGridSize[1])};
+    unsigned num_neighbours = 0;
+    for(unsigned axis=0; axis<3; axis++)
+    {
+        num_neighbours += (position[axis] > 0 ? 1 : 0) + (position[axis] + 1 < mGridSize[axis] ? 1 : 0);
+    }
+    return num_neighbours;
+}
+
+void DiffusionReactionSystem::WriteRow(PetscInt row, double diagonal, bool isDirichlet)
+{
+    unsigned position[3] = {row % mGridSize[0], (row / mGridSize[0]) % mGridSize[1],
+            row / (mGridSize[0] * mGridSize[1])};
+    PetscInt offsets[3] = {1, PetscInt(mGridSize[0]), PetscInt(mGridSize[0] * mGridSize[1])};
+    PetscInt columns[7];
+    PetscScalar values[7];
+    unsigned num_entries = 0;
+    columns[num_entries] = row;
+    values[num_entries++] = diagonal;
+
+    // Dirichlet rows keep their neighbours as zeros, so the pattern stays the same
+    double off_diagonal = isDirichlet ? 0.0 : mDiffusionTerm;
+    for(unsigned axis=0; axis<3; axis++)
+    {
+        if(position[axis] > 0)
+        {
+            columns[num_entries] = row - offsets[axis];
+            values[num_entries++] = off_diagonal;
+        }
+        if(position[axis] + 1 < mGridSize[axis])
+        {
+            columns[num_entries] = row + offsets[axis];
+            values[num_entries++] = off_diagonal;
+        }
+    }
+    MatSetValues(mMatrix, 1, &row, num_entries, columns, values, INSERT_VALUES);
+}
+
+void DiffusionReactionSystem::Update(const double* pReaction, const double* pSource,
+                                     const std::vector<bool>& rIsDirichlet, double dirichletValue)
+{
+    bool first_update = !mRowsWritten;
+    if(!first_update)
+    {
+        VecCopy(mRhs, mPreviousRhs);
+    }
+
+    mPreconditionerRebuilt = mLagging.Update();
+
+    // Whole rows only where the Dirichlet points changed. The assembly is collective,
+    // so every process takes part even if it wrote nothing.
+    for(PetscInt row=mLo; row<mHi; row++)
+    {
+        bool is_dirichlet = rIsDirichlet[row];
+        if(!mRowsWritten || is_dirichlet != mDirichletRows[row - mLo])
+        {
+            WriteRow(row, 1.0, is_dirichlet);
+            mDirichletRows[row - mLo] = is_dirichlet;
+        }
+    }
+    mRowsWritten = true;
+    MatAssemblyBegin(mMatrix, MAT_FINAL_ASSEMBLY);
+    MatAssemblyEnd(mMatrix, MAT_FINAL_ASSEMBLY);
+
+    // No flux faces reflect the missing neighbours back onto the diagonal
+    double* p_diagonal;
+    double* p_rhs;
+    VecGetArray(mDiagonal, &p_diagonal);
+    VecGetArray(mRhs, &p_rhs);
+    for(PetscInt row=mLo; row<mHi; row++)
+    {
+        if(mDirichletRows[row - mLo])
+        {
+            p_diagonal[row - mLo] = 1.0;
+            p_rhs[row - mLo] = dirichletValue;
+        }
+        else
+        {
+            p_diagonal[row - mLo] = pReaction[row] - GetNumberOfNeighbours(row) * mDiffusionTerm;
+            p_rhs[row - mLo] = -pSource[row];
+        }
+    }
+    VecRestoreArray(mDiagonal, &p_diagonal);
+    VecRestoreArray(mRhs, &p_rhs);
+    MatDiagonalSet(mMatrix, mDiagonal, INSERT_VALUES);
+
+    // Otherwise PETSc would build the preconditioner inside the next solve. A kept
+    // preconditioner isn't rebuilt for the changed matrix.
+    KSPSetReusePreconditioner(mKsp, mPreconditionerRebuilt ? PETSC_FALSE : PETSC_TRUE);
+    if(mPreconditionerRebuilt)
+    {
+        KSPSetUp(mKsp);
+    }
+
+    mRhsChange = -1.0;
+    if(!first_update)
+    {
+        VecAXPY(mPreviousRhs, -1.0, mRhs);
+        VecNorm(mPreviousRhs, NORM_2, &mRhsChange);
+    }
+}
+
+Mat& DiffusionReactionSystem::rGetMatrix()
+{
+    return mMatrix;
+}
+
+unsigned DiffusionReactionSystem::GetNumIterations() const
+{
+    return mNumIterations;
+}
+
+void DiffusionReactionSystem::SetChangeTolerance(double changeTolerance)
+{
+    mChangeTolerance = changeTolerance;
+}
+
+void DiffusionReactionSystem::SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold)
+{
+    mLagging.SetLag(maxLag, iterationThreshold);
+}
+
+bool DiffusionReactionSystem::WasPreconditionerRebuilt() const
+{
+    return mPreconditionerRebuilt;
+}
+
+double DiffusionReactionSystem::GetRhsChange() const
+{
+    return mRhsChange;
+}
+
+Vec DiffusionReactionSystem::Solve(const double* pInitialGuess)
+{
+    Vec solution = SolveLinearSystem(pInitialGuess);
+    PetscInt num_iterations;
+    KSPGetIterationNumber(mKsp, &num_iterations);
+    mNumIterations = num_iterations;
+    mLagging.RecordIterations(mNumIterations);
+    return solution;
+}
+
+Vec DiffusionReactionSystem::SolveLinearSystem(const double* pInitialGuess)
+{
+    Vec solution;
+    VecDuplicate(mRhs, &solution);
+    if(pInitialGuess == NULL)
+    {
+        KSPSetTolerances(mKsp, 1.e-6, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT);
+        KSPSetInitialGuessNonzero(mKsp, PETSC_FALSE);
+        KSPSolve(mKsp, mRhs, solution);
+        return solution;
+    }
+
+    // The tolerance is relative to the right-hand side, so the change's share of it sets how far to go
+    double relative_tolerance = 1.e-6;
+    if(mChangeTolerance > 0.0 && mRhsChange >= 0.0)
+    {
+        double rhs_norm;
+        VecNorm(mRhs, NORM_2, &rhs_norm);
+        if(rhs_norm > 0.0)
+        {
+            relative_tolerance = std::max(relative_tolerance, mChangeTolerance * mRhsChange / rhs_norm);
+        }
+    }
+    KSPSetTolerances(mKsp, relative_tolerance, PETSC_DEFAULT, PETSC_DEFAULT, PETSC_DEFAULT);
+
+    double* p_guess;
+    VecGetArray(solution, &p_guess);
+    std::copy(pInitialGuess + mLo, pInitialGuess + mHi, p_guess);
+    VecRestoreArray(solution, &p_guess);
+    KSPSetInitialGuessNonzero(mKsp, PETSC_TRUE);
+    KSPSolve(mKsp, mRhs, solution);
+    return solution;
+}
@@ -0,0 +1,244 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef DIFFUSIONREACTIONSYSTEM_HPP_
+#define DIFFUSIONREACTIONSYSTEM_HPP_
+
+#include <vector>
+#include <petscvec.h>
+#include <petscmat.h>
+#include <petscksp.h>
+#include "UblasVectorInclude.hpp"
+#include "PreconditionerLagging.hpp"
+
+/**
+ * The linear system for a steady diffusion-reaction field on the regular grid,
+ *
+ *   D lap(u) + a u + s = 0,
+ *
+ * with no flux through the faces of the grid and u fixed at Dirichlet points. The
+ * Laplacian is the 7 point stencil.
+ *
+ * The system is kept from step to step. The matrix is preallocated with exactly the
+ * stencil's non-zeros, and the pattern never changes: Dirichlet rows keep their
+ * off-diagonal entries as explicit zeros. After the first step only the diagonal and
+ * right-hand side are written, plus the whole rows of points that became or stopped
+ * being Dirichlet points, so there is no re-assembly and no PETSc allocation.
+ */
+class DiffusionReactionSystem
+{
+    /**
+     * The number of grid points in each direction
+     */
+    c_vector<unsigned, 3> mGridSize;
+
+    /**
+     * The diffusivity over the grid spacing squared
+     */
+    double mDiffusionTerm;
+
+    /**
+     * The matrix
+     */
+    Mat mMatrix;
+
+    /**
+     * The right-hand side
+     */
+    Vec mRhs;
+
+    /**
+     * The diagonal, written in one go each step
+     */
+    Vec mDiagonal;
+
+    /**
+     * The first row this process owns
+     */
+    PetscInt mLo;
+
+    /**
+     * One past the last row this process owns
+     */
+    PetscInt mHi;
+
+    /**
+     * Whether each owned row was a Dirichlet row when last written
+     */
+    std::vector<bool> mDirichletRows;
+
+    /**
+     * Whether every row has been written
+     */
+    bool mRowsWritten;
+
+    /**
+     * The right-hand side of the previous update, then its difference from the current one
+     */
+    Vec mPreviousRhs;
+
+    /**
+     * The norm of the change in the right-hand side at the last update, negative after the first
+     */
+    double mRhsChange;
+
+    /**
+     * The fraction of the right-hand side's change that warm started solves converge to
+     */
+    double mChangeTolerance;
+
+    /**
+     * When to rebuild the preconditioner
+     */
+    PreconditionerLagging mLagging;
+
+    /**
+     * Whether the preconditioner is rebuilt for the solve after the last update
+     */
+    bool mPreconditionerRebuilt;
+
+    /**
+     * The Krylov solver, kept with its preconditioner between steps
+     */
+    KSP mKsp;
+
+    /**
+     * The number of iterations the last solve took
+     */
+    unsigned mNumIterations;
+
+    /**
+     * Write a whole row of the matrix
+     * @param row the row
+     * @param diagonal the diagonal value
+     * @param isDirichlet whether the row is a Dirichlet row
+     */
+    void WriteRow(PetscInt row, double diagonal, bool isDirichlet);
+
+    /**
+     * Solve, with the tolerance for warm starts
+     * @param pInitialGuess the initial guess indexed over the whole grid, or NULL
+     * @return the solution
+     */
+    Vec SolveLinearSystem(const double* pInitialGuess);
+
+    /**
+     * @param row the row
+     * @return the number of neighbours of the point on the grid
+     */
+    unsigned GetNumberOfNeighbours(PetscInt row) const;
+
+public:
+
+    /**
+     * Constructor
+     * @param rGridSize the number of grid points in each direction
+     * @param spacing the grid spacing
+     * @param diffusivity the diffusivity
+     */
+    DiffusionReactionSystem(const c_vector<unsigned, 3>& rGridSize, double spacing, double diffusivity);
+
+    /**
+     * Destructor
+     */
+    ~DiffusionReactionSystem();
+
+    /**
+     * Get the rows this process owns
+     * @param rLo set to the first row
+     * @param rHi set to one past the last row
+     */
+    void GetOwnershipRange(PetscInt& rLo, PetscInt& rHi) const;
+
+    /**
+     * Update the system for a step, and build the preconditioner if it is due. The arrays
+     * are indexed over the whole grid, only the rows this process owns are read.
+     * @param pReaction the reaction coefficient a at each point
+     * @param pSource the source s at each point
+     * @param rIsDirichlet whether each point is a Dirichlet point
+     * @param dirichletValue the value at Dirichlet points
+     */
+    void Update(const double* pReaction, const double* pSource, const std::vector<bool>& rIsDirichlet,
+                double dirichletValue);
+
+    /**
+     * @return the matrix
+     */
+    Mat& rGetMatrix();
+
+    /**
+     * @return the number of iterations the last solve took
+     */
+    unsigned GetNumIterations() const;
+
+    /**
+     * Let warm started solves stop once the residual is within a fraction of the change in
+     * the right-hand side since the previous update, rather than of the right-hand side
+     * itself. They never go beyond the usual relative tolerance of 1e-6.
+     * @param changeTolerance the fraction, zero to always use the usual tolerance
+     */
+    void SetChangeTolerance(double changeTolerance);
+
+    /**
+     * Keep the solver's preconditioner across updates, rather than building it again for
+     * every solve. The preconditioner type comes from PETSc's options, for example -pc_type,
+     * and is Jacobi by default. It is built by Update() on the updates it is rebuilt for,
+     * rather than lazily by the solve, so the time it takes is part of the update.
+     * @param maxLag the most updates the preconditioner is reused for after the one it was built at
+     * @param iterationThreshold solves needing more iterations than this trigger a rebuild,
+     *     zero for no limit
+     */
+    void SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold = 0);
+
+    /**
+     * @return whether the preconditioner is rebuilt for the solve after the last update
+     */
+    bool WasPreconditionerRebuilt() const;
+
+    /**
+     * @return the norm of the change in the right-hand side at the last update, negative after the first
+     */
+    double GetRhsChange() const;
+
+    /**
+     * Solve the system as last updated
+     * @param pInitialGuess the initial guess indexed over the whole grid, only the rows this
+     *     process owns are read. NULL to start from zero.
+     * @return the solution, to be destroyed by the caller
+     */
+    Vec Solve(const double* pInitialGuess = NULL);
+};
+
+#endif /*DIFFUSIONREACTIONSYSTEM_HPP_*/
@@ -0,0 +1,389 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "GeometricMultigrid.hpp"
+
+namespace
+{
+    /**
+     * Coarsening stops once a level has no more points than this, the coarsest level is
+     * then factored densely
+     */
+    const unsigned MAX_COARSEST_POINTS = 512;
+}
+
+GeometricMultigrid::GeometricMultigrid(const StencilOperator& rFineOperator, unsigned smoothingDegree)
+    : mrFineOperator(rFineOperator),
+      mSmoothingDegree(smoothingDegree),
+      mLevels(1),
+      mCoarsestFreePoints(),
+      mCoarsestFactor(),
+      mCoarsestValues()
+{
+    c_vector<unsigned, 3> size = rFineOperator.rGetGridSize();
+    mLevels[0].mResidual.resize(rFineOperator.GetNumberOfPoints());
+    double spacing = 1.0;
+    while(size[0] * size[1] * size[2] > MAX_COARSEST_POINTS)
+    {
+        // Pairs of points merge along each direction, with the trilinear weights of cell centres
+        c_vector<unsigned, 3> coarse_size;
+        Level& r_fine = mLevels.back();
+        r_fine.mRestrictionScale = 1.0;
+        for(unsigned axis=0; axis<3; axis++)
+        {
+            unsigned fine_points = size[axis];
+            coarse_size[axis] = (fine_points + 1) / 2;
+            r_fine.mNearest[axis].resize(fine_points);
+            r_fine.mFarthest[axis].resize(fine_points);
+            r_fine.mNearestWeight[axis].resize(fine_points);
+            for(unsigned idx=0; idx<fine_points; idx++)
+            {
+                int nearest = idx / 2;
+                int farthest = (idx % 2 == 0) ? nearest - 1 : nearest + 1;
+                r_fine.mNearest[axis][idx] = nearest;
+                if(farthest < 0 || farthest >= int(coarse_size[axis]))
+                {
+                    // No flux at the faces, so the nearest value carries to the edge
+                    r_fine.mFarthest[axis][idx] = nearest;
+                    r_fine.mNearestWeight[axis][idx] = 1.0;
+                }
+                else
+                {
+                    r_fine.mFarthest[axis][idx] = farthest;
+                    r_fine.mNearestWeight[axis][idx] = 0.75;
+                }
+            }
+            if(fine_points > 1)
+            {
+                r_fine.mRestrictionScale *= 0.5;
+            }
+        }
+
+        spacing *= 2.0;
+        Level coarse;
+        coarse.mpOperator.reset(new StencilOperator(coarse_size, spacing, rFineOperator.GetDiffusionTerm()));
+        unsigned num_coarse_points = coarse.mpOperator->GetNumberOfPoints();
+        coarse.mReaction.resize(num_coarse_points);
+        coarse.mRhs.resize(num_coarse_points);
+        coarse.mSolution.resize(num_coarse_points);
+        coarse.mResidual.resize(num_coarse_points);
+        coarse.mRestrictionScale = 1.0;
+        mLevels.push_back(coarse);
+        size = coarse_size;
+    }
+}
+
+const StencilOperator& GeometricMultigrid::rGetOperator(unsigned level) const
+{
+    return level == 0 ? mrFineOperator : *mLevels[level].mpOperator;
+}
+
+unsigned GeometricMultigrid::GetNumberOfLevels() const
+{
+    return mLevels.size();
+}
+
+const c_vector<unsigned, 3>& GeometricMultigrid::rGetGridSize(unsigned level) const
+{
+    return rGetOperator(level).rGetGridSize();
+}
+
+void GeometricMultigrid::Update(const double* pReaction)
+{
+    for(unsigned level=0; level+1<mLevels.size(); level++)
+    {
+        const StencilOperator& r_fine_operator = rGetOperator(level);
+        const c_vector<unsigned, 3>& r_fine_size = r_fine_operator.rGetGridSize();
+        const std::vector<bool>& r_fine_dirichlet = r_fine_operator.rGetDirichletPoints();
+        const double* p_fine_reaction = level == 0 ? pReaction : &mLevels[level].mReaction[0];
+
+        // Average the reaction over the free fine points of each coarse point
+        Level& r_coarse = mLevels[level + 1];
+        const c_vector<unsigned, 3>& r_coarse_size = r_coarse.mpOperator->rGetGridSize();
+        unsigned num_coarse_points = r_coarse.mReaction.size();
+        std::vector<bool> coarse_dirichlet(num_coarse_points, false);
+        std::vector<unsigned> num_free(num_coarse_points, 0);
+        std::fill(r_coarse.mReaction.begin(), r_coarse.mReaction.end(), 0.0);
+        unsigned fine_index = 0;
+        for(unsigned i=0; i<r_fine_size[2]; i++)
+        {
+            for(unsigned j=0; j<r_fine_size[1]; j++)
+            {
+                unsigned coarse_line = r_coarse_size[0] * (j / 2 + r_coarse_size[1] * (i / 2));
+                for(unsigned k=0; k<r_fine_size[0]; k++, fine_index++)
+                {
+                    unsigned coarse_index = coarse_line + k / 2;
+                    if(r_fine_dirichlet[fine_index])
+                    {
+                        coarse_dirichlet[coarse_index] = true;
+                    }
+                    else
+                    {
+                        r_coarse.mReaction[coarse_index] += p_fine_reaction[fine_index];
+                        num_free[coarse_index]++;
+                    }
+                }
+            }
+        }
+        for(unsigned idx=0; idx<num_coarse_points; idx++)
+        {
+            if(num_free[idx] > 0)
+            {
+                r_coarse.mReaction[idx] /= double(num_free[idx]);
+            }
+        }
+        r_coarse.mpOperator->Update(&r_coarse.mReaction[0], coarse_dirichlet);
+    }
+    FactorCoarsest();
+}
+
+void GeometricMultigrid::FactorCoarsest()
+{
+    const StencilOperator& r_operator = rGetOperator(mLevels.size() - 1);
+    const c_vector<unsigned, 3>& r_size = r_operator.rGetGridSize();
+    const std::vector<bool>& r_dirichlet = r_operator.rGetDirichletPoints();
+    const std::vector<double>& r_diagonal = r_operator.rGetDiagonal();
+    double coupling = r_operator.GetDiffusionTerm();
+
+    unsigned num_points = r_operator.GetNumberOfPoints();
+    std::vector<int> positions(num_points, -1);
+    mCoarsestFreePoints.clear();
+    for(unsigned idx=0; idx<num_points; idx++)
+    {
+        if(!r_dirichlet[idx])
+        {
+            positions[idx] = mCoarsestFreePoints.size();
+            mCoarsestFreePoints.push_back(idx);
+        }
+    }
+
+    // Dense operator on the free points, Dirichlet neighbours hold no correction
+    unsigned num_free = mCoarsestFreePoints.size();
+    mCoarsestFactor.assign(num_free * num_free, 0.0);
+    mCoarsestValues.resize(num_free);
+    unsigned offsets[3] = {1, r_size[0], r_size[0] * r_size[1]};
+    for(unsigned row=0; row<num_free; row++)
+    {
+        unsigned point = mCoarsestFreePoints[row];
+        unsigned position[3] = {point % r_size[0], (point / r_size[0]) % r_size[1], point / (r_size[0] * r_size[1])};
+        mCoarsestFactor[row * num_free + row] = r_diagonal[point];
+        for(unsigned axis=0; axis<3; axis++)
+        {
+            if(position[axis] > 0 && positions[point - offsets[axis]] >= 0)
+            {
+                mCoarsestFactor[row * num_free + positions[point - offsets[axis]]] = -coupling;
+            }
+            if(position[axis] + 1 < r_size[axis] && positions[point + offsets[axis]] >= 0)
+            {
+                mCoarsestFactor[row * num_free + positions[point + offsets[axis]]] = -coupling;
+            }
+        }
+    }
+
+    // Cholesky, in place in the lower triangle
+    for(unsigned col=0; col<num_free; col++)
+    {
+        double* p_col_row = &mCoarsestFactor[col * num_free];
+        double pivot = p_col_row[col];
+        for(unsigned k=0; k<col; k++)
+        {
+            pivot -= p_col_row[k] * p_col_row[k];
+        }
+        if(pivot <= 0.0)
+        {
+            EXCEPTION("The coarsest multigrid operator is not positive definite");
+        }
+        pivot = sqrt(pivot);
+        p_col_row[col] = pivot;
+        for(unsigned row=col+1; row<num_free; row++)
+        {
+            double* p_row = &mCoarsestFactor[row * num_free];
+            double value = p_row[col];
+            for(unsigned k=0; k<col; k++)
+            {
+                value -= p_row[k] * p_col_row[k];
+            }
+            p_row[col] = value / pivot;
+        }
+    }
+}
+
+void GeometricMultigrid::SolveCoarsest(const double* pRhs, double* pSolution)
+{
+    unsigned num_free = mCoarsestFreePoints.size();
+    std::fill(pSolution, pSolution + rGetOperator(mLevels.size() - 1).GetNumberOfPoints(), 0.0);
+    for(unsigned row=0; row<num_free; row++)
+    {
+        const double* p_row = &mCoarsestFactor[row * num_free];
+        double value = pRhs[mCoarsestFreePoints[row]];
+        for(unsigned k=0; k<row; k++)
+        {
+            value -= p_row[k] * mCoarsestValues[k];
+        }
+        mCoarsestValues[row] = value / p_row[row];
+    }
+    for(unsigned row=num_free; row-- > 0;)
+    {
+        double value = mCoarsestValues[row];
+        for(unsigned k=row+1; k<num_free; k++)
+        {
+            value -= mCoarsestFactor[k * num_free + row] * mCoarsestValues[k];
+        }
+        mCoarsestValues[row] = value / mCoarsestFactor[row * num_free + row];
+        pSolution[mCoarsestFreePoints[row]] = mCoarsestValues[row];
+    }
+}
+
+void GeometricMultigrid::Restrict(unsigned level, const double* pResidual)
+{
+    const Level& r_fine = mLevels[level];
+    const StencilOperator& r_fine_operator = rGetOperator(level);
+    const c_vector<unsigned, 3>& r_fine_size = r_fine_operator.rGetGridSize();
+    const std::vector<bool>& r_fine_dirichlet = r_fine_operator.rGetDirichletPoints();
+    Level& r_coarse = mLevels[level + 1];
+    const c_vector<unsigned, 3>& r_coarse_size = r_coarse.mpOperator->rGetGridSize();
+    const std::vector<bool>& r_coarse_dirichlet = r_coarse.mpOperator->rGetDirichletPoints();
+    std::fill(r_coarse.mRhs.begin(), r_coarse.mRhs.end(), 0.0);
+
+    // The transpose of Prolongate, scaled to a weighted average
+    unsigned fine_index = 0;
+    for(unsigned i=0; i<r_fine_size[2]; i++)
+    {
+        unsigned z_points[2] = {r_fine.mNearest[2][i], r_fine.mFarthest[2][i]};
+        double z_weights[2] = {r_fine.mNearestWeight[2][i], 1.0 - r_fine.mNearestWeight[2][i]};
+        for(unsigned j=0; j<r_fine_size[1]; j++)
+        {
+            unsigned y_points[2] = {r_fine.mNearest[1][j], r_fine.mFarthest[1][j]};
+            double y_weights[2] = {r_fine.mNearestWeight[1][j], 1.0 - r_fine.mNearestWeight[1][j]};
+            for(unsigned k=0; k<r_fine_size[0]; k++, fine_index++)
+            {
+                if(r_fine_dirichlet[fine_index])
+                {
+                    continue;
+                }
+                unsigned x_points[2] = {r_fine.mNearest[0][k], r_fine.mFarthest[0][k]};
+                double x_weights[2] = {r_fine.mNearestWeight[0][k], 1.0 - r_fine.mNearestWeight[0][k]};
+                double value = r_fine.mRestrictionScale * pResidual[fine_index];
+                for(unsigned a=0; a<2; a++)
+                {
+                    for(unsigned b=0; b<2; b++)
+                    {
+                        double weight = value * z_weights[a] * y_weights[b];
+                        unsigned coarse_line = r_coarse_size[0] * (y_points[b] + r_coarse_size[1] * z_points[a]);
+                        r_coarse.mRhs[coarse_line + x_points[0]] += weight * x_weights[0];
+                        r_coarse.mRhs[coarse_line + x_points[1]] += weight * x_weights[1];
+                    }
+                }
+            }
+        }
+    }
+    for(unsigned idx=0; idx<r_coarse.mRhs.size(); idx++)
+    {
+        if(r_coarse_dirichlet[idx])
+        {
+            r_coarse.mRhs[idx] = 0.0;
+        }
+    }
+}
+
+void GeometricMultigrid::Prolongate(unsigned level, double* pSolution)
+{
+    const Level& r_fine = mLevels[level];
+    const StencilOperator& r_fine_operator = rGetOperator(level);
+    const c_vector<unsigned, 3>& r_fine_size = r_fine_operator.rGetGridSize();
+    const std::vector<bool>& r_fine_dirichlet = r_fine_operator.rGetDirichletPoints();
+    const Level& r_coarse = mLevels[level + 1];
+    const c_vector<unsigned, 3>& r_coarse_size = r_coarse.mpOperator->rGetGridSize();
+
+    unsigned fine_index = 0;
+    for(unsigned i=0; i<r_fine_size[2]; i++)
+    {
+        unsigned z_points[2] = {r_fine.mNearest[2][i], r_fine.mFarthest[2][i]};
+        double z_weights[2] = {r_fine.mNearestWeight[2][i], 1.0 - r_fine.mNearestWeight[2][i]};
+        for(unsigned j=0; j<r_fine_size[1]; j++)
+        {
+            unsigned y_points[2] = {r_fine.mNearest[1][j], r_fine.mFarthest[1][j]};
+            double y_weights[2] = {r_fine.mNearestWeight[1][j], 1.0 - r_fine.mNearestWeight[1][j]};
+            for(unsigned k=0; k<r_fine_size[0]; k++, fine_index++)
+            {
+                if(r_fine_dirichlet[fine_index])
+                {
+                    continue;
+                }
+                unsigned x_points[2] = {r_fine.mNearest[0][k], r_fine.mFarthest[0][k]};
+                double x_weights[2] = {r_fine.mNearestWeight[0][k], 1.0 - r_fine.mNearestWeight[0][k]};
+                double value = 0.0;
+                for(unsigned a=0; a<2; a++)
+                {
+                    for(unsigned b=0; b<2; b++)
+                    {
+                        const double* p_coarse_line = &r_coarse.mSolution[r_coarse_size[0] *
+                                (y_points[b] + r_coarse_size[1] * z_points[a])];
+                        value += z_weights[a] * y_weights[b] *
+                                (x_weights[0] * p_coarse_line[x_points[0]] + x_weights[1] * p_coarse_line[x_points[1]]);
+                    }
+                }
+                pSolution[fine_index] += value;
+            }
+        }
+    }
+}
+
+void GeometricMultigrid::Cycle(unsigned level, const double* pRhs, double* pSolution)
+{
+    if(level + 1 == mLevels.size())
+    {
+        SolveCoarsest(pRhs, pSolution);
+        return;
+    }
+
+    const StencilOperator& r_operator = rGetOperator(level);
+    std::fill(pSolution, pSolution + r_operator.GetNumberOfPoints(), 0.0);
+    r_operator.Chebyshev(pRhs, pSolution, mSmoothingDegree);
+    r_operator.Residual(pRhs, pSolution, &mLevels[level].mResidual[0]);
+    Restrict(level, &mLevels[level].mResidual[0]);
+    Cycle(level + 1, &mLevels[level + 1].mRhs[0], &mLevels[level + 1].mSolution[0]);
+    Prolongate(level, pSolution);
+    r_operator.Chebyshev(pRhs, pSolution, mSmoothingDegree);
+}
+
+void GeometricMultigrid::Apply(const double* pResidual, double* pCorrection)
+{
+    Cycle(0, pResidual, pCorrection);
+}
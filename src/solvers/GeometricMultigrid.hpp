@@ -0,0 +1,214 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef GEOMETRICMULTIGRID_HPP_
+#define GEOMETRICMULTIGRID_HPP_
+
+#include <vector>
+#include "SmartPointers.hpp"
+#include "UblasVectorInclude.hpp"
+#include "StencilOperator.hpp"
+
+/**
+ * A geometric multigrid V-cycle for a StencilOperator, used to precondition conjugate
+ * gradients. Each coarser grid merges pairs of points along each direction and is
+ * discretised again at twice the spacing, so every level keeps the 7 point stencil.
+ *
+ * The grid points are taken as cell centres, which matches the no flux faces.
+ * Corrections move between levels by trilinear interpolation and its transpose, and are
+ * kept at zero on Dirichlet points. A coarse point is a Dirichlet point when any of its
+ * fine points are. Each level is smoothed with Chebyshev before and after the coarse
+ * correction, and the coarsest level is solved directly. The cycle is a fixed,
+ * symmetric, positive definite operation, as conjugate gradients needs.
+ */
+class GeometricMultigrid
+{
+    /**
+     * A grid in the hierarchy, and how it passes to the next coarser one
+     */
+    struct Level
+    {
+        /**
+         * The operator, empty on the finest level where it isn't owned
+         */
+        boost::shared_ptr<StencilOperator> mpOperator;
+
+        /**
+         * The reaction coefficient, on coarse levels
+         */
+        std::vector<double> mReaction;
+
+        /**
+         * The right-hand side, on coarse levels
+         */
+        std::vector<double> mRhs;
+
+        /**
+         * The solution, on coarse levels
+         */
+        std::vector<double> mSolution;
+
+        /**
+         * The residual after pre-smoothing
+         */
+        std::vector<double> mResidual;
+
+        /**
+         * For each point along each direction, the nearest point of the coarser grid
+         */
+        std::vector<unsigned> mNearest[3];
+
+        /**
+         * For each point along each direction, the other coarser point it interpolates from
+         */
+        std::vector<unsigned> mFarthest[3];
+
+        /**
+         * For each point along each direction, the weight of the nearest coarser point
+         */
+        std::vector<double> mNearestWeight[3];
+
+        /**
+         * Scales the transpose of interpolation so that restriction averages
+         */
+        double mRestrictionScale;
+    };
+
+    /**
+     * The finest operator
+     */
+    const StencilOperator& mrFineOperator;
+
+    /**
+     * The number of Chebyshev steps before and after each coarse correction
+     */
+    unsigned mSmoothingDegree;
+
+    /**
+     * The levels, finest first
+     */
+    std::vector<Level> mLevels;
+
+    /**
+     * The free points of the coarsest level
+     */
+    std::vector<unsigned> mCoarsestFreePoints;
+
+    /**
+     * The Cholesky factor of the coarsest operator on its free points, row major
+     */
+    std::vector<double> mCoarsestFactor;
+
+    /**
+     * Scratch space for the coarsest solve
+     */
+    std::vector<double> mCoarsestValues;
+
+    /**
+     * @param level the level
+     * @return the level's operator
+     */
+    const StencilOperator& rGetOperator(unsigned level) const;
+
+    /**
+     * Set up the coarsest solve for the current coefficients
+     */
+    void FactorCoarsest();
+
+    /**
+     * Solve on the coarsest level
+     * @param pRhs the right-hand side
+     * @param pSolution set to the solution
+     */
+    void SolveCoarsest(const double* pRhs, double* pSolution);
+
+    /**
+     * Restrict a residual to the next coarser level's right-hand side
+     * @param level the finer level
+     * @param pResidual the residual on it
+     */
+    void Restrict(unsigned level, const double* pResidual);
+
+    /**
+     * Interpolate the next coarser level's solution and add it to a finer solution
+     * @param level the finer level
+     * @param pSolution the solution on it, updated in place
+     */
+    void Prolongate(unsigned level, double* pSolution);
+
+    /**
+     * A V-cycle from a zero initial guess
+     * @param level the level
+     * @param pRhs the right-hand side on it
+     * @param pSolution set to the approximate solution
+     */
+    void Cycle(unsigned level, const double* pRhs, double* pSolution);
+
+public:
+
+    /**
+     * Constructor. Sets up the hierarchy of grids, the coefficients come with Update.
+     * @param rFineOperator the finest operator, which must outlive the multigrid
+     * @param smoothingDegree the number of Chebyshev steps before and after each coarse correction
+     */
+    GeometricMultigrid(const StencilOperator& rFineOperator, unsigned smoothingDegree = 2);
+
+    /**
+     * Rebuild the coarse levels from the finest operator's Dirichlet points and the
+     * reaction coefficient
+     * @param pReaction the reaction coefficient at each point of the finest grid
+     */
+    void Update(const double* pReaction);
+
+    /**
+     * @return the number of levels, including the finest
+     */
+    unsigned GetNumberOfLevels() const;
+
+    /**
+     * @param level the level
+     * @return the number of grid points in each direction on it
+     */
+    const c_vector<unsigned, 3>& rGetGridSize(unsigned level) const;
+
+    /**
+     * Apply one V-cycle
+     * @param pResidual the residual on the finest grid, zero at Dirichlet points
+     * @param pCorrection set to the approximate correction
+     */
+    void Apply(const double* pResidual, double* pCorrection);
+};
+
+#endif /*GEOMETRICMULTIGRID_HPP_*/
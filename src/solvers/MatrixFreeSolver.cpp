@@ -0,0 +1,247 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include "Exception.hpp"
+
+#include "MatrixFreeSolver.hpp"
+
+namespace
+{
+    /**
+     * @param rX a vector
+     * @param rY a vector of the same size
+     * @return the dot product
+     */
+    double Dot(const std::vector<double>& rX, const std::vector<double>& rY)
+    {
+        double total = 0.0;
+        for(unsigned idx=0; idx<rX.size(); idx++)
+        {
+            total += rX[idx] * rY[idx];
+        }
+        return total;
+    }
+}
+
+MatrixFreeSolver::MatrixFreeSolver(const c_vector<unsigned, 3>& rGridSize, double spacing, double diffusivity,
+                                   StencilPreconditioner preconditioner)
+    : mOperator(rGridSize, spacing, diffusivity),
+      mPreconditioner(preconditioner),
+      mChebyshevDegree(3),
+      mpMultigrid(),
+      mLagging(),
+      mPreconditionerRebuilt(false),
+      mRelativeTolerance(1.e-6),
+      mAbsoluteTolerance(0.0),
+      mMaxIterations(1000),
+      mNumIterations(0),
+      mChangeTolerance(0.0),
+      mRhsChange(-1.0),
+      mRhs(mOperator.GetNumberOfPoints(), 0.0),
+      mPreviousRhs(),
+      mResidual(mOperator.GetNumberOfPoints()),
+      mPreconditioned(mOperator.GetNumberOfPoints()),
+      mDirection(mOperator.GetNumberOfPoints()),
+      mProduct(mOperator.GetNumberOfPoints())
+{
+    if(mPreconditioner == MULTIGRID_PRECONDITIONER)
+    {
+        mpMultigrid.reset(new GeometricMultigrid(mOperator));
+    }
+}
+
+void MatrixFreeSolver::SetTolerances(double relative, double absolute)
+{
+    mRelativeTolerance = relative;
+    mAbsoluteTolerance = absolute;
+}
+
+void MatrixFreeSolver::SetChangeTolerance(double changeTolerance)
+{
+    mChangeTolerance = changeTolerance;
+}
+
+double MatrixFreeSolver::GetRhsChange() const
+{
+    return mRhsChange;
+}
+
+void MatrixFreeSolver::SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold)
+{
+    mLagging.SetLag(maxLag, iterationThreshold);
+}
+
+bool MatrixFreeSolver::WasPreconditionerRebuilt() const
+{
+    return mPreconditionerRebuilt;
+}
+
+void MatrixFreeSolver::SetMaxIterations(unsigned maxIterations)
+{
+    mMaxIterations = maxIterations;
+}
+
+void MatrixFreeSolver::SetChebyshevDegree(unsigned degree)
+{
+    if(degree == 0)
+    {
+        EXCEPTION("The Chebyshev preconditioner needs a degree of at least one");
+    }
+    mChebyshevDegree = degree;
+}
+
+void MatrixFreeSolver::Update(const double* pReaction, const double* pSource,
+                              const std::vector<bool>& rIsDirichlet, double dirichletValue)
+{
+    mOperator.Update(pReaction, rIsDirichlet);
+    mPreconditionerRebuilt = true;
+    if(mpMultigrid)
+    {
+        mPreconditionerRebuilt = mLagging.Update();
+        if(mPreconditionerRebuilt)
+        {
+            mpMultigrid->Update(pReaction);
+        }
+    }
+    bool first_update = mPreviousRhs.empty();
+    mPreviousRhs.swap(mRhs);
+    mRhs.resize(mPreviousRhs.size());
+    double change = 0.0;
+    for(unsigned idx=0; idx<mRhs.size(); idx++)
+    {
+        mRhs[idx] = rIsDirichlet[idx] ? dirichletValue : pSource[idx];
+        change += (mRhs[idx] - mPreviousRhs[idx]) * (mRhs[idx] - mPreviousRhs[idx]);
+    }
+    mRhsChange = first_update ? -1.0 : sqrt(change);
+}
+
+void MatrixFreeSolver::Precondition()
+{
+    if(mPreconditioner == JACOBI_PRECONDITIONER)
+    {
+        const std::vector<double>& r_diagonal = mOperator.rGetDiagonal();
+        for(unsigned idx=0; idx<mResidual.size(); idx++)
+        {
+            mPreconditioned[idx] = mResidual[idx] / r_diagonal[idx];
+        }
+    }
+    else if(mPreconditioner == CHEBYSHEV_PRECONDITIONER)
+    {
+        std::fill(mPreconditioned.begin(), mPreconditioned.end(), 0.0);
+        mOperator.Chebyshev(&mResidual[0], &mPreconditioned[0], mChebyshevDegree);
+    }
+    else
+    {
+        mpMultigrid->Apply(&mResidual[0], &mPreconditioned[0]);
+    }
+}
+
+void MatrixFreeSolver::Solve(double* pSolution)
+{
+    ConjugateGradients(pSolution);
+    mLagging.RecordIterations(mNumIterations);
+}
+
+void MatrixFreeSolver::ConjugateGradients(double* pSolution)
+{
+    unsigned num_points = mRhs.size();
+    const std::vector<bool>& r_dirichlet = mOperator.rGetDirichletPoints();
+    for(unsigned idx=0; idx<num_points; idx++)
+    {
+        if(r_dirichlet[idx])
+        {
+            pSolution[idx] = mRhs[idx];
+        }
+    }
+
+    mOperator.Residual(&mRhs[0], pSolution, &mResidual[0]);
+    double target = std::max(mRelativeTolerance * sqrt(Dot(mRhs, mRhs)), mAbsoluteTolerance);
+    if(mChangeTolerance > 0.0 && mRhsChange >= 0.0)
+    {
+        target = std::max(target, mChangeTolerance * mRhsChange);
+    }
+    mNumIterations = 0;
+    if(sqrt(Dot(mResidual, mResidual)) <= target)
+    {
+        return;
+    }
+
+    Precondition();
+    mDirection = mPreconditioned;
+    double residual_product = Dot(mResidual, mPreconditioned);
+    for(mNumIterations=1; mNumIterations<=mMaxIterations; mNumIterations++)
+    {
+        mOperator.Apply(&mDirection[0], &mProduct[0]);
+        double step = residual_product / Dot(mDirection, mProduct);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            pSolution[idx] += step * mDirection[idx];
+            mResidual[idx] -= step * mProduct[idx];
+        }
+        if(sqrt(Dot(mResidual, mResidual)) <= target)
+        {
+            return;
+        }
+
+        Precondition();
+        double next_residual_product = Dot(mResidual, mPreconditioned);
+        double direction_weight = next_residual_product / residual_product;
+        residual_product = next_residual_product;
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            mDirection[idx] = mPreconditioned[idx] + direction_weight * mDirection[idx];
+        }
+    }
+    EXCEPTION("The matrix-free solver did not converge in " +
+            boost::lexical_cast<std::string>(mMaxIterations) + " iterations");
+}
+
+unsigned MatrixFreeSolver::GetNumIterations() const
+{
+    return mNumIterations;
+}
+
+const StencilOperator& MatrixFreeSolver::rGetOperator() const
+{
+    return mOperator;
+}
+
+boost::shared_ptr<GeometricMultigrid> MatrixFreeSolver::GetMultigrid() const
+{
+    return mpMultigrid;
+}
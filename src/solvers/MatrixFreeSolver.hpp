@@ -0,0 +1,260 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef MATRIXFREESOLVER_HPP_
+#define MATRIXFREESOLVER_HPP_
+
+#include <vector>
+#include "UblasVectorInclude.hpp"
+#include "SmartPointers.hpp"
+#include "StencilOperator.hpp"
+#include "GeometricMultigrid.hpp"
+#include "PreconditionerLagging.hpp"
+
+/**
+ * Preconditioners for the matrix-free solver
+ */
+typedef enum StencilPreconditioner_
+{
+    JACOBI_PRECONDITIONER,     // Divide by the diagonal
+    CHEBYSHEV_PRECONDITIONER,  // A Jacobi preconditioned Chebyshev polynomial
+    MULTIGRID_PRECONDITIONER   // A geometric multigrid V-cycle, iterations stay flat as the grid is refined
+} StencilPreconditioner;
+
+/**
+ * Preconditioned conjugate gradients for a diffusion-reaction field on the regular
+ * grid, using a StencilOperator rather than an assembled matrix. It takes the same
+ * coefficients as DiffusionReactionSystem.
+ *
+ * The whole grid is held and solved on each process, so it suits fields that are
+ * replicated rather than distributed.
+ *
+ * The Dirichlet rows make the operator unsymmetric. The solution starts with the
+ * Dirichlet values in place, so the residual and search directions are zero at
+ * Dirichlet points, and the iteration only sees the symmetric block of free points.
+ */
+class MatrixFreeSolver
+{
+    /**
+     * The operator
+     */
+    StencilOperator mOperator;
+
+    /**
+     * The preconditioner
+     */
+    StencilPreconditioner mPreconditioner;
+
+    /**
+     * The degree of the Chebyshev preconditioner
+     */
+    unsigned mChebyshevDegree;
+
+    /**
+     * The multigrid preconditioner, if used
+     */
+    boost::shared_ptr<GeometricMultigrid> mpMultigrid;
+
+    /**
+     * When to rebuild the multigrid preconditioner
+     */
+    PreconditionerLagging mLagging;
+
+    /**
+     * Whether the preconditioner was rebuilt at the last update
+     */
+    bool mPreconditionerRebuilt;
+
+    /**
+     * Converged once the residual norm is below this times the right-hand side norm
+     */
+    double mRelativeTolerance;
+
+    /**
+     * Converged once the residual norm is below this
+     */
+    double mAbsoluteTolerance;
+
+    /**
+     * The most iterations before giving up
+     */
+    unsigned mMaxIterations;
+
+    /**
+     * The number of iterations in the last solve
+     */
+    unsigned mNumIterations;
+
+    /**
+     * The fraction of the right-hand side's change that solves converge to
+     */
+    double mChangeTolerance;
+
+    /**
+     * The norm of the change in the right-hand side at the last update, negative after the first
+     */
+    double mRhsChange;
+
+    /**
+     * The right-hand side
+     */
+    std::vector<double> mRhs;
+
+    /**
+     * The right-hand side of the previous update, empty before the first
+     */
+    std::vector<double> mPreviousRhs;
+
+    /**
+     * The residual
+     */
+    std::vector<double> mResidual;
+
+    /**
+     * The preconditioned residual
+     */
+    std::vector<double> mPreconditioned;
+
+    /**
+     * The search direction
+     */
+    std::vector<double> mDirection;
+
+    /**
+     * The operator applied to the search direction
+     */
+    std::vector<double> mProduct;
+
+    /**
+     * Apply the preconditioner to the residual
+     */
+    void Precondition();
+
+    /**
+     * Run conjugate gradients
+     * @param pSolution the initial guess, overwritten with the solution
+     */
+    void ConjugateGradients(double* pSolution);
+
+public:
+
+    /**
+     * Constructor
+     * @param rGridSize the number of grid points in each direction
+     * @param spacing the grid spacing
+     * @param diffusivity the diffusivity
+     * @param preconditioner the preconditioner
+     */
+    MatrixFreeSolver(const c_vector<unsigned, 3>& rGridSize, double spacing, double diffusivity,
+                     StencilPreconditioner preconditioner = MULTIGRID_PRECONDITIONER);
+
+    /**
+     * Set the convergence tolerances. The defaults match LinearSystem's.
+     * @param relative the tolerance relative to the right-hand side norm
+     * @param absolute the tolerance on the residual norm
+     */
+    void SetTolerances(double relative, double absolute = 0.0);
+
+    /**
+     * Let solves stop once the residual is within a fraction of the change in the
+     * right-hand side since the previous update, rather than of the right-hand side itself.
+     * This suits solves that start from the previous solution. They never go beyond the
+     * relative tolerance.
+     * @param changeTolerance the fraction, zero to always use the relative tolerance
+     */
+    void SetChangeTolerance(double changeTolerance);
+
+    /**
+     * @return the norm of the change in the right-hand side at the last update, negative after the first
+     */
+    double GetRhsChange() const;
+
+    /**
+     * Keep the multigrid preconditioner's coarse levels across updates. The Jacobi and
+     * Chebyshev preconditioners only use the diagonal, so they are always current.
+     * @param maxLag the most updates the preconditioner is reused for after the one it was built at
+     * @param iterationThreshold solves needing more iterations than this trigger a rebuild,
+     *     zero for no limit
+     */
+    void SetPreconditionerLag(unsigned maxLag, unsigned iterationThreshold = 0);
+
+    /**
+     * @return whether the preconditioner was rebuilt at the last update
+     */
+    bool WasPreconditionerRebuilt() const;
+
+    /**
+     * @param maxIterations the most iterations before the solve fails
+     */
+    void SetMaxIterations(unsigned maxIterations);
+
+    /**
+     * @param degree the degree of the Chebyshev preconditioner
+     */
+    void SetChebyshevDegree(unsigned degree);
+
+    /**
+     * Update the system for a step. The arrays are indexed over the whole grid.
+     * @param pReaction the reaction coefficient a at each point
+     * @param pSource the source s at each point
+     * @param rIsDirichlet whether each point is a Dirichlet point
+     * @param dirichletValue the value at Dirichlet points
+     */
+    void Update(const double* pReaction, const double* pSource, const std::vector<bool>& rIsDirichlet,
+                double dirichletValue);
+
+    /**
+     * Solve the system as last updated
+     * @param pSolution the initial guess, overwritten with the solution
+     */
+    void Solve(double* pSolution);
+
+    /**
+     * @return the number of iterations in the last solve
+     */
+    unsigned GetNumIterations() const;
+
+    /**
+     * @return the operator
+     */
+    const StencilOperator& rGetOperator() const;
+
+    /**
+     * @return the multigrid preconditioner, empty unless it is used
+     */
+    boost::shared_ptr<GeometricMultigrid> GetMultigrid() const;
+};
+
+#endif /*MATRIXFREESOLVER_HPP_*/
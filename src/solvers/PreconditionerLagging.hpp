@@ -0,0 +1,99 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef PRECONDITIONERLAGGING_HPP_
+#define PRECONDITIONERLAGGING_HPP_
+
+/**
+ * Decides when a preconditioner kept across solves should be rebuilt. It is rebuilt at
+ * the first update, once it has been reused for a set number of updates, and after a
+ * solve that needed more than a set number of iterations. With no lag it is rebuilt at
+ * every update.
+ */
+class PreconditionerLagging
+{
+    /**
+     * The most updates a preconditioner is reused for
+     */
+    unsigned mMaxLag;
+
+    /**
+     * Solves needing more iterations than this trigger a rebuild, zero for no limit
+     */
+    unsigned mIterationThreshold;
+
+    /**
+     * Updates since the last rebuild, including it
+     */
+    unsigned mUpdatesSinceRebuild;
+
+    /**
+     * Whether a rebuild is due at the next update
+     */
+    bool mRebuildDue;
+
+public:
+
+    /**
+     * Constructor. Rebuilds at every update.
+     */
+    PreconditionerLagging();
+
+    /**
+     * @param maxLag the most updates a preconditioner is reused for after the one it was built at
+     * @param iterationThreshold solves needing more iterations than this trigger a rebuild,
+     *     zero for no limit
+     */
+    void SetLag(unsigned maxLag, unsigned iterationThreshold = 0);
+
+    /**
+     * @return whether a preconditioner is reused for any updates
+     */
+    bool IsLagged() const;
+
+    /**
+     * Note an update of the system
+     * @return whether the preconditioner should be rebuilt for it
+     */
+    bool Update();
+
+    /**
+     * Note the iterations a solve needed
+     * @param iterations the number of iterations
+     */
+    void RecordIterations(unsigned iterations);
+};
+
+#endif /*PRECONDITIONERLAGGING_HPP_*/
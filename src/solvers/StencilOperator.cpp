@@ -0,0 +1,242 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <algorithm>
+#include "Exception.hpp"
+
+#include "StencilOperator.hpp"
+
+StencilOperator::StencilOperator(const c_vector<unsigned, 3>& rGridSize, double spacing, double diffusivity)
+    : mGridSize(rGridSize),
+      mDiffusionTerm(diffusivity / (spacing * spacing)),
+      mDiagonal(),
+      mCoupling(),
+      mDirichletPoints(),
+      mSpectralBound(1.0),
+      mResidual(),
+      mUpdate()
+{
+    if(mGridSize[0] == 0 || mGridSize[1] == 0 || mGridSize[2] == 0)
+    {
+        EXCEPTION("The grid must have at least one point in each direction");
+    }
+    unsigned num_points = GetNumberOfPoints();
+    mDiagonal.assign(num_points, 1.0);
+    mCoupling.assign(num_points, 0.0);
+    mDirichletPoints.assign(num_points, true);
+}
+
+void StencilOperator::Update(const double* pReaction, const std::vector<bool>& rIsDirichlet)
+{
+    unsigned num_points = GetNumberOfPoints();
+    mDiagonal.resize(num_points);
+    mCoupling.resize(num_points);
+    mDirichletPoints = rIsDirichlet;
+
+    // Gershgorin: each row of the Jacobi preconditioned operator has its eigenvalues
+    // within 1 + (sum of off-diagonals) / diagonal
+    mSpectralBound = 1.0;
+    unsigned grid_index = 0;
+    for(unsigned i=0; i<mGridSize[2]; i++)
+    {
+        for(unsigned j=0; j<mGridSize[1]; j++)
+        {
+            unsigned line_neighbours = (i > 0) + (i + 1 < mGridSize[2]) + (j > 0) + (j + 1 < mGridSize[1]);
+            for(unsigned k=0; k<mGridSize[0]; k++, grid_index++)
+            {
+                if(rIsDirichlet[grid_index])
+                {
+                    mDiagonal[grid_index] = 1.0;
+                    mCoupling[grid_index] = 0.0;
+                    continue;
+                }
+                unsigned num_neighbours = line_neighbours + (k > 0) + (k + 1 < mGridSize[0]);
+                mDiagonal[grid_index] = num_neighbours * mDiffusionTerm - pReaction[grid_index];
+                mCoupling[grid_index] = mDiffusionTerm;
+                if(mDiagonal[grid_index] <= 0.0)
+                {
+                    EXCEPTION("The stencil operator needs a positive diagonal, so the reaction term can't be positive");
+                }
+                mSpectralBound = std::max(mSpectralBound,
+                        1.0 + num_neighbours * mDiffusionTerm / mDiagonal[grid_index]);
+            }
+        }
+    }
+}
+
+const c_vector<unsigned, 3>& StencilOperator::rGetGridSize() const
+{
+    return mGridSize;
+}
+
+double StencilOperator::GetDiffusionTerm() const
+{
+    return mDiffusionTerm;
+}
+
+unsigned StencilOperator::GetNumberOfPoints() const
+{
+    return mGridSize[0] * mGridSize[1] * mGridSize[2];
+}
+
+const std::vector<double>& StencilOperator::rGetDiagonal() const
+{
+    return mDiagonal;
+}
+
+const std::vector<bool>& StencilOperator::rGetDirichletPoints() const
+{
+    return mDirichletPoints;
+}
+
+double StencilOperator::GetSpectralBound() const
+{
+    return mSpectralBound;
+}
+
+void StencilOperator::Apply(const double* pX, double* pY) const
+{
+    unsigned nx = mGridSize[0];
+    unsigned plane = mGridSize[0] * mGridSize[1];
+    for(unsigned i=0; i<mGridSize[2]; i++)
+    {
+        for(unsigned j=0; j<mGridSize[1]; j++)
+        {
+            unsigned offset = nx * j + plane * i;
+            const double* p_x = pX + offset;
+            double* p_y = pY + offset;
+
+            // Sum the neighbours into the output line, one neighbour line at a time
+            if(nx == 1)
+            {
+                p_y[0] = 0.0;
+            }
+            else
+            {
+                p_y[0] = p_x[1];
+                for(unsigned k=1; k<nx-1; k++)
+                {
+                    p_y[k] = p_x[k-1] + p_x[k+1];
+                }
+                p_y[nx-1] = p_x[nx-2];
+            }
+            const double* neighbour_lines[4] = {j > 0 ? p_x - nx : NULL,
+                                                j + 1 < mGridSize[1] ? p_x + nx : NULL,
+                                                i > 0 ? p_x - plane : NULL,
+                                                i + 1 < mGridSize[2] ? p_x + plane : NULL};
+            for(unsigned line=0; line<4; line++)
+            {
+                const double* p_neighbour = neighbour_lines[line];
+                if(p_neighbour != NULL)
+                {
+                    for(unsigned k=0; k<nx; k++)
+                    {
+                        p_y[k] += p_neighbour[k];
+                    }
+                }
+            }
+
+            const double* p_diagonal = &mDiagonal[offset];
+            const double* p_coupling = &mCoupling[offset];
+            for(unsigned k=0; k<nx; k++)
+            {
+                p_y[k] = p_diagonal[k] * p_x[k] - p_coupling[k] * p_y[k];
+            }
+        }
+    }
+}
+
+void StencilOperator::Residual(const double* pB, const double* pX, double* pR) const
+{
+    Apply(pX, pR);
+    unsigned num_points = GetNumberOfPoints();
+    for(unsigned idx=0; idx<num_points; idx++)
+    {
+        pR[idx] = pB[idx] - pR[idx];
+    }
+}
+
+void StencilOperator::Jacobi(const double* pB, double* pX, unsigned numSweeps, double weight) const
+{
+    unsigned num_points = GetNumberOfPoints();
+    mResidual.resize(num_points);
+    for(unsigned sweep=0; sweep<numSweeps; sweep++)
+    {
+        Residual(pB, pX, &mResidual[0]);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            pX[idx] += weight * mResidual[idx] / mDiagonal[idx];
+        }
+    }
+}
+
+void StencilOperator::Chebyshev(const double* pB, double* pX, unsigned degree) const
+{
+    if(degree == 0)
+    {
+        return;
+    }
+    unsigned num_points = GetNumberOfPoints();
+    mResidual.resize(num_points);
+    mUpdate.resize(num_points);
+
+    // Damp the spectrum from a tenth of its bound upwards, the smoothest modes are left to the outer solver
+    double upper = mSpectralBound;
+    double lower = 0.1 * upper;
+    double theta = 0.5 * (upper + lower);
+    double delta = 0.5 * (upper - lower);
+    double sigma = theta / delta;
+    double rho = 1.0 / sigma;
+
+    Residual(pB, pX, &mResidual[0]);
+    for(unsigned idx=0; idx<num_points; idx++)
+    {
+        mUpdate[idx] = mResidual[idx] / (theta * mDiagonal[idx]);
+        pX[idx] += mUpdate[idx];
+    }
+    for(unsigned step=1; step<degree; step++)
+    {
+        double rho_next = 1.0 / (2.0 * sigma - rho);
+        double update_weight = rho_next * rho;
+        double residual_weight = 2.0 * rho_next / delta;
+        Residual(pB, pX, &mResidual[0]);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            mUpdate[idx] = update_weight * mUpdate[idx] + residual_weight * mResidual[idx] / mDiagonal[idx];
+            pX[idx] += mUpdate[idx];
+        }
+        rho = rho_next;
+    }
+}
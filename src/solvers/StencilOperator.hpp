@@ -0,0 +1,180 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef STENCILOPERATOR_HPP_
+#define STENCILOPERATOR_HPP_
+
+#include <vector>
+#include "UblasVectorInclude.hpp"
+
+/**
+ * The diffusion-reaction operator on the regular grid, applied straight from the
+ * 7 point stencil without storing a matrix. It is the negative of the operator in
+ * DiffusionReactionSystem, so that it is positive definite:
+ *
+ *   M u = n d u - a u - d sum(neighbours of u) = s
+ *
+ * where d is the diffusivity over the grid spacing squared and n the number of
+ * neighbours a point has, which gives no flux through the faces of the grid. Rows of
+ * Dirichlet points are the identity.
+ *
+ * Only a diagonal and a coupling value are kept for each point. The loops run along
+ * x lines with one neighbour line at a time, so they vectorise.
+ */
+class StencilOperator
+{
+    /**
+     * The number of grid points in each direction
+     */
+    c_vector<unsigned, 3> mGridSize;
+
+    /**
+     * The diffusivity over the grid spacing squared
+     */
+    double mDiffusionTerm;
+
+    /**
+     * The diagonal at each point
+     */
+    std::vector<double> mDiagonal;
+
+    /**
+     * The weight of the neighbours at each point, zero at Dirichlet points
+     */
+    std::vector<double> mCoupling;
+
+    /**
+     * Whether each point is a Dirichlet point
+     */
+    std::vector<bool> mDirichletPoints;
+
+    /**
+     * An upper bound on the eigenvalues of the Jacobi preconditioned operator
+     */
+    double mSpectralBound;
+
+    /**
+     * Scratch space for the smoothers' residuals
+     */
+    mutable std::vector<double> mResidual;
+
+    /**
+     * Scratch space for the Chebyshev updates
+     */
+    mutable std::vector<double> mUpdate;
+
+public:
+
+    /**
+     * Constructor. The operator is the identity until Update is called.
+     * @param rGridSize the number of grid points in each direction
+     * @param spacing the grid spacing
+     * @param diffusivity the diffusivity
+     */
+    StencilOperator(const c_vector<unsigned, 3>& rGridSize, double spacing, double diffusivity);
+
+    /**
+     * Set the reaction term and Dirichlet points
+     * @param pReaction the reaction coefficient a at each point, zero or negative
+     * @param rIsDirichlet whether each point is a Dirichlet point
+     */
+    void Update(const double* pReaction, const std::vector<bool>& rIsDirichlet);
+
+    /**
+     * @return the number of grid points in each direction
+     */
+    const c_vector<unsigned, 3>& rGetGridSize() const;
+
+    /**
+     * @return the diffusivity over the grid spacing squared
+     */
+    double GetDiffusionTerm() const;
+
+    /**
+     * @return the number of grid points
+     */
+    unsigned GetNumberOfPoints() const;
+
+    /**
+     * @return the diagonal at each point
+     */
+    const std::vector<double>& rGetDiagonal() const;
+
+    /**
+     * @return whether each point is a Dirichlet point
+     */
+    const std::vector<bool>& rGetDirichletPoints() const;
+
+    /**
+     * @return an upper bound on the eigenvalues of the Jacobi preconditioned operator
+     */
+    double GetSpectralBound() const;
+
+    /**
+     * Apply the operator
+     * @param pX the values to apply it to
+     * @param pY set to the result, which must not overlap pX
+     */
+    void Apply(const double* pX, double* pY) const;
+
+    /**
+     * Compute the residual
+     * @param pB the right-hand side
+     * @param pX the current solution
+     * @param pR set to b - M x, which must not overlap pX
+     */
+    void Residual(const double* pB, const double* pX, double* pR) const;
+
+    /**
+     * Damped Jacobi sweeps
+     * @param pB the right-hand side
+     * @param pX the current solution, updated in place
+     * @param numSweeps the number of sweeps
+     * @param weight the damping, 6/7 damps the high frequencies of the 7 point stencil best
+     */
+    void Jacobi(const double* pB, double* pX, unsigned numSweeps, double weight = 6.0 / 7.0) const;
+
+    /**
+     * Chebyshev smoothing with Jacobi preconditioning, aimed at the upper part of the spectrum.
+     * From a zero initial solution it is a fixed symmetric polynomial in the operator, so it
+     * can precondition conjugate gradients.
+     * @param pB the right-hand side
+     * @param pX the current solution, updated in place
+     * @param degree the degree of the polynomial, the number of operator applications
+     */
+    void Chebyshev(const double* pB, double* pX, unsigned degree) const;
+};
+
+#endif /*STENCILOPERATOR_HPP_*/
@@ -0,0 +1,177 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTASYNCCOUPLING_HPP_
+#define TESTASYNCCOUPLING_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <boost/bind.hpp>
+#include "Exception.hpp"
+#include "AsyncCoupling.hpp"
+
+/**
+ * An in-memory conduit, receives block until a message has been sent
+ */
+class LoopbackConduit
+{
+    std::deque<std::vector<char> > mMessages;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread::id mThreadId;
+    bool mSingleThreaded;
+
+public:
+
+    LoopbackConduit() : mSingleThreaded(true)
+    {
+    }
+
+    void Send(const std::vector<char>& rMessage)
+    {
+        CheckThread();
+        if(rMessage.empty())
+        {
+            EXCEPTION("Empty message");
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mMessages.push_back(rMessage);
+        mCondition.notify_all();
+    }
+
+    void Receive(std::vector<char>& rMessage)
+    {
+        CheckThread();
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]{ return !mMessages.empty(); });
+        rMessage = mMessages.front();
+        mMessages.pop_front();
+    }
+
+    void CheckThread()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mThreadId == std::thread::id())
+        {
+            mThreadId = std::this_thread::get_id();
+        }
+        mSingleThreaded = mSingleThreaded && mThreadId == std::this_thread::get_id();
+    }
+
+    bool IsSingleThreaded()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mSingleThreaded;
+    }
+};
+
+class TestAsyncCoupling : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestSendAndReceiveInOrder()
+    {
+        LoopbackConduit conduit;
+        std::vector<char> received;
+        {
+            AsyncCoupling coupling(boost::bind(&LoopbackConduit::Send, &conduit, _1),
+                                   boost::bind(&LoopbackConduit::Receive, &conduit, _1));
+
+            // The message can be changed as soon as it is posted
+            std::vector<char> message(1000, 'a');
+            for(unsigned step=0; step<10; step++)
+            {
+                message[0] = char('a' + step);
+                coupling.PostSend(message);
+                coupling.PostReceive();
+                TS_ASSERT_EQUALS(coupling.GetNumberOfPendingReceives(), 1u);
+                coupling.WaitForReceive(received);
+                TS_ASSERT_EQUALS(received.size(), 1000u);
+                TS_ASSERT_EQUALS(received[0], char('a' + step));
+            }
+
+            // Two sends and two receives can be in flight before any are collected
+            coupling.PostSend(message);
+            message[0] = 'z';
+            coupling.PostSend(message);
+            coupling.PostReceive();
+            coupling.PostReceive();
+            TS_ASSERT_THROWS_THIS(coupling.PostReceive(), "Too many coupling receives posted without being collected");
+            coupling.WaitForReceive(received);
+            TS_ASSERT_EQUALS(received[0], 'j');
+            coupling.WaitForReceive(received);
+            TS_ASSERT_EQUALS(received[0], 'z');
+            coupling.Flush();
+
+            TS_ASSERT_THROWS_THIS(coupling.WaitForReceive(received), "No coupling receive has been posted");
+        }
+
+        // Every call to the transport came from the communication thread
+        TS_ASSERT(conduit.IsSingleThreaded());
+    }
+
+    void TestErrorsAreReported()
+    {
+        LoopbackConduit conduit;
+        AsyncCoupling coupling(boost::bind(&LoopbackConduit::Send, &conduit, _1),
+                               boost::bind(&LoopbackConduit::Receive, &conduit, _1));
+
+        coupling.PostSend(std::vector<char>());
+        TS_ASSERT_THROWS_THIS(coupling.Flush(), "Asynchronous coupling send failed: Empty message");
+
+        bool called = false;
+        coupling.Call(boost::bind(&TestAsyncCoupling::SetFlag, boost::ref(called)));
+        TS_ASSERT(called);
+        TS_ASSERT_THROWS_THIS(coupling.Call(&TestAsyncCoupling::Fail),
+                "Asynchronous coupling call failed: Conduit closed");
+    }
+
+    static void SetFlag(bool& rFlag)
+    {
+        rFlag = true;
+    }
+
+    static void Fail()
+    {
+        EXCEPTION("Conduit closed");
+    }
+};
+
+#endif /*TESTASYNCCOUPLING_HPP_*/
@@ -0,0 +1,145 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTASYNCOUTPUTWRITER_HPP_
+#define TESTASYNCOUTPUTWRITER_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include "Exception.hpp"
+#include "AsyncOutputWriter.hpp"
+
+/**
+ * Records what the writer thread would have written
+ */
+class RecordingImageWriter
+{
+public:
+    std::vector<std::string> mFilenames;
+    std::vector<double> mTimes;
+    std::vector<double> mFirstValues;
+    bool mFail;
+
+    RecordingImageWriter() : mFilenames(), mTimes(), mFirstValues(), mFail(false)
+    {
+    }
+
+    void Write(vtkImageData* pImage, const std::string& rFilename, double time)
+    {
+        if(mFail)
+        {
+            EXCEPTION("Disk full");
+        }
+        mFilenames.push_back(rFilename);
+        mTimes.push_back(time);
+        mFirstValues.push_back(pImage->GetPointData()->GetArray("nutrient")->GetTuple1(0));
+    }
+};
+
+class TestAsyncOutputWriter : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestSnapshotsAreWrittenInOrder()
+    {
+        vtkSmartPointer<vtkImageData> p_geometry = vtkSmartPointer<vtkImageData>::New();
+        p_geometry->SetDimensions(10, 10, 10);
+
+        std::vector<std::string> names;
+        names.push_back("nutrient");
+        names.push_back("vessel");
+
+        std::vector<double> nutrient(1000, 0.0);
+        std::vector<double> vessel(1000, 0.25);
+        std::vector<const double*> fields;
+        fields.push_back(&nutrient[0]);
+        fields.push_back(&vessel[0]);
+
+        RecordingImageWriter recorder;
+        {
+            AsyncOutputWriter writer(p_geometry, names,
+                    boost::bind(&RecordingImageWriter::Write, &recorder, _1, _2, _3));
+
+            // Changing the fields after posting does not affect the snapshot
+            for(unsigned idx=0; idx<5; idx++)
+            {
+                nutrient[0] = double(idx);
+                writer.Post("step_" + boost::lexical_cast<std::string>(idx), double(idx), fields);
+                nutrient[0] = -1.0;
+            }
+            writer.Flush();
+            TS_ASSERT_EQUALS(recorder.mFilenames.size(), 5u);
+        }
+
+        for(unsigned idx=0; idx<5; idx++)
+        {
+            TS_ASSERT_EQUALS(recorder.mFilenames[idx], "step_" + boost::lexical_cast<std::string>(idx));
+            TS_ASSERT_DELTA(recorder.mTimes[idx], double(idx), 1.e-12);
+            TS_ASSERT_DELTA(recorder.mFirstValues[idx], double(idx), 1.e-12);
+        }
+    }
+
+    void TestErrorsAreReportedOnFlush()
+    {
+        vtkSmartPointer<vtkImageData> p_geometry = vtkSmartPointer<vtkImageData>::New();
+        p_geometry->SetDimensions(2, 2, 2);
+        std::vector<std::string> names(1, "nutrient");
+        std::vector<double> nutrient(8, 1.0);
+        std::vector<const double*> fields(1, &nutrient[0]);
+
+        RecordingImageWriter recorder;
+        recorder.mFail = true;
+        AsyncOutputWriter writer(p_geometry, names,
+                boost::bind(&RecordingImageWriter::Write, &recorder, _1, _2, _3), 1);
+        writer.Post("step_0", 0.0, fields);
+        TS_ASSERT_THROWS_THIS(writer.Flush(), "Asynchronous output failed: Disk full");
+
+        // Mismatched posts are rejected
+        fields.push_back(&nutrient[0]);
+        TS_ASSERT_THROWS_THIS(writer.Post("step_1", 1.0, fields),
+                "Number of fields posted does not match the output writer set up");
+    }
+};
+
+#endif /*TESTASYNCOUTPUTWRITER_HPP_*/
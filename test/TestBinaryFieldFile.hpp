@@ -0,0 +1,166 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTBINARYFIELDFILE_HPP_
+#define TESTBINARYFIELDFILE_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <map>
+#include <string>
+#include "UblasVectorInclude.hpp"
+#include "OutputFileHandler.hpp"
+#include "FieldRegistry.hpp"
+#include "BinaryFieldFile.hpp"
+#include "InputFileConverter.hpp"
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+
+class TestBinaryFieldFile : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestWriteAndMapFile()
+    {
+        OutputFileHandler output_file_handler("TestBinaryFieldFile");
+        std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/fields.chk";
+
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 5;
+        grid_size[1] = 4;
+        grid_size[2] = 3;
+        c_vector<double, 3> grid_origin = zero_vector<double>(3);
+        grid_origin[2] = -1.0;
+
+        std::vector<double> nutrient(60);
+        std::vector<double> vessel(60, 0.25);
+        for(unsigned idx=0; idx<60; idx++)
+        {
+            nutrient[idx] = 2.0 * idx;
+        }
+        std::vector<std::string> names;
+        names.push_back("nutrient");
+        names.push_back("vessel");
+        std::vector<const double*> arrays;
+        arrays.push_back(&nutrient[0]);
+        arrays.push_back(&vessel[0]);
+
+        std::map<std::string, double> scalars;
+        scalars["current_time"] = 12.5;
+        scalars["current_increment"] = 3.0;
+
+        BinaryFieldFile::Write(filename, grid_size, 2.0, grid_origin, scalars, names, arrays);
+
+        BinaryFieldFile file(filename);
+        TS_ASSERT_EQUALS(file.GetGridSize()[0], 5u);
+        TS_ASSERT_EQUALS(file.GetGridSize()[2], 3u);
+        TS_ASSERT_DELTA(file.GetGridSpacing(), 2.0, 1.e-12);
+        TS_ASSERT_DELTA(file.GetGridOrigin()[2], -1.0, 1.e-12);
+        TS_ASSERT_EQUALS(file.GetNumberOfValues(), 60u);
+        TS_ASSERT_DELTA(file.rGetScalars().find("current_time")->second, 12.5, 1.e-12);
+        TS_ASSERT_EQUALS(file.rGetArrayNames().size(), 2u);
+        TS_ASSERT(file.HasArray("vessel"));
+        TS_ASSERT(!file.HasArray("stimulus"));
+
+        // Arrays are aligned so fields can adopt them, and writable without touching the file
+        double* p_nutrient = file.GetArray("nutrient");
+        TS_ASSERT(FieldRegistry::IsAligned(p_nutrient));
+        TS_ASSERT_DELTA(p_nutrient[59], 118.0, 1.e-12);
+        TS_ASSERT_DELTA(file.GetArray("vessel")[10], 0.25, 1.e-12);
+        p_nutrient[59] = 0.0;
+        BinaryFieldFile file_again(filename);
+        TS_ASSERT_DELTA(file_again.GetArray("nutrient")[59], 118.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(file.GetArray("stimulus"), "Binary field file does not contain the array stimulus");
+        TS_ASSERT_THROWS_THIS(BinaryFieldFile(filename + ".missing"),
+                "Could not open binary field file " + filename + ".missing");
+    }
+
+    void TestConvertImage()
+    {
+        OutputFileHandler output_file_handler("TestBinaryFieldFile", false);
+        std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/input.chicbin";
+
+        vtkSmartPointer<vtkImageData> p_image = vtkSmartPointer<vtkImageData>::New();
+        p_image->SetDimensions(4, 3, 2);
+        p_image->SetSpacing(0.5, 0.5, 0.5);
+        p_image->SetOrigin(1.0, 2.0, 3.0);
+
+        // Arrays of other types are stored as doubles
+        vtkSmartPointer<vtkFloatArray> p_tumour = vtkSmartPointer<vtkFloatArray>::New();
+        p_tumour->SetName("tumour");
+        p_tumour->SetNumberOfTuples(24);
+        vtkSmartPointer<vtkDoubleArray> p_factor = vtkSmartPointer<vtkDoubleArray>::New();
+        p_factor->SetName("proliferation_rate_factor");
+        p_factor->SetNumberOfTuples(24);
+        for(unsigned idx=0; idx<24; idx++)
+        {
+            p_tumour->SetValue(idx, float(idx % 2));
+            p_factor->SetValue(idx, 0.25 * idx);
+        }
+        p_image->GetPointData()->AddArray(p_tumour);
+        p_image->GetPointData()->AddArray(p_factor);
+
+        InputFileConverter::Convert(p_image, filename);
+        TS_ASSERT(BinaryFieldFile::IsBinaryFieldFile(filename));
+        {
+            BinaryFieldFile file(filename);
+            TS_ASSERT_EQUALS(file.GetGridSize()[0], 4u);
+            TS_ASSERT_EQUALS(file.GetGridSize()[2], 2u);
+            TS_ASSERT_DELTA(file.GetGridSpacing(), 0.5, 1.e-12);
+            TS_ASSERT_DELTA(file.GetGridOrigin()[1], 2.0, 1.e-12);
+            TS_ASSERT_EQUALS(file.rGetArrayNames().size(), 2u);
+            TS_ASSERT_DELTA(file.GetArray("tumour")[3], 1.0, 1.e-12);
+            TS_ASSERT_DELTA(file.GetArray("proliferation_rate_factor")[23], 5.75, 1.e-12);
+        }
+
+        // A subset of the arrays
+        std::vector<std::string> names(1, "proliferation_rate_factor");
+        InputFileConverter::Convert(p_image, filename, names);
+        BinaryFieldFile subset_file(filename);
+        TS_ASSERT_EQUALS(subset_file.rGetArrayNames().size(), 1u);
+        TS_ASSERT(!subset_file.HasArray("tumour"));
+
+        names.push_back("vessel");
+        TS_ASSERT_THROWS_THIS(InputFileConverter::Convert(p_image, filename, names),
+                "Input image does not contain the array vessel");
+    }
+};
+
+#endif /*TESTBINARYFIELDFILE_HPP_*/
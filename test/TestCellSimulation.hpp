@@ -41,6 +41,7 @@
 #include "FileFinder.hpp"
 #include "OutputFileHandler.hpp"
 #include "CellSimulation.hpp"
+#include "BinaryFieldFile.hpp"
 #include "PetscSetupAndFinalize.hpp"
 
 class TestCellSimulation : public CxxTest::TestSuite
@@ -69,6 +70,114 @@ public:
         cell_simulation.Run();
     }
 
+    void TestRestartFromCheckpoint()
+    {
+        OutputFileHandler output_file_handler("TestCellSimulationRestart");
+        std::string output_directory = output_file_handler.GetOutputDirectoryFullPath();
+
+        // Write an initial checkpoint by hand, so no input image is needed
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 10;
+        grid_size[1] = 10;
+        grid_size[2] = 1;
+        c_vector<double, 3> origin = zero_vector<double>(3);
+        std::map<std::string, double> parameters;
+        parameters["proliferation_rate"] = 150.0;
+        parameters["initial_volume"] = 100.0;
+        parameters["current_volume"] = 100.0;
+        parameters["centre_x"] = 0.0;
+        parameters["centre_y"] = 0.0;
+        parameters["centre_z"] = 0.0;
+        parameters["current_time"] = 0.0;
+        parameters["current_increment"] = 0.0;
+        parameters["target_time_increment"] = 1.0;
+        std::vector<double> zeros(100, 0.0);
+        std::vector<std::string> names;
+        names.push_back("proliferating");
+        names.push_back("tumour");
+        std::vector<const double*> arrays(2, &zeros[0]);
+        BinaryFieldFile::Write(output_directory + "initial.chicbin", grid_size, 1.0, origin, parameters, names, arrays);
+
+        // Run straight through, and in two stages via an intermediate checkpoint
+        CellSimulation straight;
+        straight.SetRestartFile(output_directory + "initial.chicbin");
+        straight.SetCheckpointFile(output_directory + "straight.chicbin");
+        straight.SetMaxIncrements(10);
+        straight.SetOutputFile(output_directory + "straight");
+        straight.Run();
+
+        CellSimulation first_stage;
+        first_stage.SetRestartFile(output_directory + "initial.chicbin");
+        first_stage.SetCheckpointFile(output_directory + "stage.chicbin");
+        first_stage.SetMaxIncrements(5);
+        first_stage.SetOutputFile(output_directory + "staged");
+        first_stage.Run();
+
+        CellSimulation second_stage;
+        second_stage.SetRestartFile(output_directory + "stage.chicbin");
+        second_stage.SetCheckpointFile(output_directory + "staged.chicbin");
+        second_stage.SetMaxIncrements(10);
+        second_stage.SetOutputFile(output_directory + "staged");
+        second_stage.Run();
+
+        BinaryFieldFile straight_file(output_directory + "straight.chicbin");
+        BinaryFieldFile staged_file(output_directory + "staged.chicbin");
+        TS_ASSERT_DELTA(straight_file.rGetScalars().at("current_increment"), 11.0, 1.e-12);
+        TS_ASSERT_DELTA(staged_file.rGetScalars().at("current_increment"), 11.0, 1.e-12);
+        TS_ASSERT_DELTA(staged_file.rGetScalars().at("current_volume"),
+                straight_file.rGetScalars().at("current_volume"), 1.e-9);
+        TS_ASSERT(straight_file.rGetScalars().at("current_volume") > 100.0);
+
+        const double* p_straight = straight_file.GetArray("tumour");
+        const double* p_staged = staged_file.GetArray("tumour");
+        for(unsigned idx=0; idx<100; idx++)
+        {
+            TS_ASSERT_DELTA(p_staged[idx], p_straight[idx], 1.e-12);
+        }
+        TS_ASSERT_DELTA(p_straight[0], 1.0, 1.e-12);
+    }
+
+    void TestRunFromBinaryInput()
+    {
+        OutputFileHandler output_file_handler("TestCellSimulationBinaryInput");
+        std::string output_directory = output_file_handler.GetOutputDirectoryFullPath();
+
+        // A pre-processed input, the grid is taken from the file
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 8;
+        grid_size[1] = 6;
+        grid_size[2] = 1;
+        c_vector<double, 3> origin = zero_vector<double>(3);
+        std::vector<double> factors(48, 2.0);
+        std::vector<double> unused(48, 0.5);
+        std::vector<std::string> names;
+        names.push_back("unused");
+        names.push_back("proliferation_rate_factor");
+        std::vector<const double*> arrays;
+        arrays.push_back(&unused[0]);
+        arrays.push_back(&factors[0]);
+        BinaryFieldFile::Write(output_directory + "input.chicbin", grid_size, 2.0, origin,
+                std::map<std::string, double>(), names, arrays);
+        TS_ASSERT(BinaryFieldFile::IsBinaryFieldFile(output_directory + "input.chicbin"));
+        TS_ASSERT(!BinaryFieldFile::IsBinaryFieldFile(output_directory + "missing.chicbin"));
+
+        CellSimulation cell_simulation;
+        cell_simulation.SetParameters(150.0, 100.0);
+        cell_simulation.SetInputFile(output_directory + "input.chicbin");
+        cell_simulation.SetCheckpointFile(output_directory + "final.chicbin", 2);
+        cell_simulation.SetMaxIncrements(1);
+        cell_simulation.SetOutputFile(output_directory + "binary_input");
+        cell_simulation.Run();
+
+        // Only the arrays the component uses are loaded
+        BinaryFieldFile final_file(output_directory + "final.chicbin");
+        TS_ASSERT_EQUALS(final_file.GetGridSize()[0], 8u);
+        TS_ASSERT_DELTA(final_file.GetGridSpacing(), 2.0, 1.e-12);
+        TS_ASSERT_DELTA(final_file.rGetScalars().at("proliferation_rate"), 300.0, 1.e-9);
+        TS_ASSERT_DELTA(final_file.GetArray("proliferation_rate_factor")[47], 2.0, 1.e-12);
+        TS_ASSERT(!final_file.HasArray("unused"));
+    }
+
 };
 
 #endif /*TESTCELLSIMULATION_HPP_*/
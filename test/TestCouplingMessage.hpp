@@ -0,0 +1,275 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTCOUPLINGMESSAGE_HPP_
+#define TESTCOUPLINGMESSAGE_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <cmath>
+#include "CouplingMessage.hpp"
+
+class TestCouplingMessage : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestPackAndUnpack()
+    {
+        std::vector<double> proliferating(125);
+        std::vector<double> tumour(125);
+        for(unsigned idx=0; idx<125; idx++)
+        {
+            proliferating[idx] = 0.5 * idx;
+            tumour[idx] = double(idx % 2);
+        }
+
+        // A field listed twice is only sent once
+        CouplingMessage outgoing;
+        outgoing.AddField("proliferating", &proliferating[0], 125);
+        outgoing.AddField("tumour", &tumour[0], 125);
+        outgoing.AddField("proliferating", &proliferating[0], 125);
+        const std::vector<char>& r_buffer = outgoing.rPack();
+        TS_ASSERT_EQUALS(r_buffer.size(), sizeof(CouplingMessage::Header) +
+                2 * sizeof(CouplingMessage::DirectoryEntry) + 2 * 125 * sizeof(double));
+
+        CouplingMessage incoming;
+        incoming.Unpack(&r_buffer[0], r_buffer.size());
+        TS_ASSERT_EQUALS(incoming.GetNumberOfValues(), 125u);
+        std::vector<std::string> names = incoming.GetFieldNames();
+        TS_ASSERT_EQUALS(names.size(), 2u);
+        TS_ASSERT_EQUALS(names[0], "proliferating");
+        TS_ASSERT_EQUALS(names[1], "tumour");
+        TS_ASSERT(incoming.HasField("tumour"));
+        TS_ASSERT(!incoming.HasField("quiescent"));
+        std::vector<double> received(125);
+        incoming.CopyField("proliferating", &received[0]);
+        TS_ASSERT_DELTA(received[124], 62.0, 1.e-12);
+        incoming.CopyField("tumour", &received[0]);
+        TS_ASSERT_DELTA(received[3], 1.0, 1.e-12);
+        TS_ASSERT_THROWS_THIS(incoming.CopyField("quiescent", &received[0]),
+                "Coupling message does not contain the field quiescent");
+
+        // Messages can be reused each step
+        outgoing.Clear();
+        outgoing.AddField("tumour", &tumour[0], 125);
+        TS_ASSERT_EQUALS(outgoing.rPack().size(), sizeof(CouplingMessage::Header) +
+                sizeof(CouplingMessage::DirectoryEntry) + 125 * sizeof(double));
+    }
+
+    void TestEncodings()
+    {
+        unsigned num_points = 1000;
+        std::vector<double> tumour(num_points);
+        std::vector<double> nutrient(num_points);
+        std::vector<double> stimulus(num_points);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            tumour[idx] = idx < 300 ? 1.0 : 0.0;
+            nutrient[idx] = 40.0 * std::exp(-0.003 * idx);
+            stimulus[idx] = 1.0 / (1.0 + idx);
+        }
+
+        for(unsigned compression=0; compression<2; compression++)
+        {
+            CouplingMessage outgoing;
+            outgoing.SetEncoding("tumour", BITSET_ENCODING);
+            outgoing.SetEncoding("nutrient", FIXED_POINT_ENCODING, 1.e-3);
+            outgoing.SetEncoding("stimulus", FLOAT_ENCODING);
+            outgoing.SetCompression(compression == 1);
+            outgoing.AddField("tumour", &tumour[0], num_points);
+            outgoing.AddField("nutrient", &nutrient[0], num_points);
+            outgoing.AddField("stimulus", &stimulus[0], num_points);
+            std::vector<char> buffer = outgoing.rPack();
+
+            // Bits, 16 bit levels and floats rather than three arrays of doubles
+            std::size_t data_size = 125 + 8 * 3 + 2 * num_points + 4 * num_points;
+            if(compression == 0)
+            {
+                TS_ASSERT(buffer.size() <= sizeof(CouplingMessage::Header) +
+                        3 * sizeof(CouplingMessage::DirectoryEntry) + data_size);
+            }
+            else
+            {
+                TS_ASSERT(buffer.size() < 3 * sizeof(double) * num_points / 4);
+            }
+
+            CouplingMessage incoming;
+            incoming.Unpack(&buffer[0], buffer.size());
+            TS_ASSERT_EQUALS(incoming.GetFieldEncoding("tumour"), BITSET_ENCODING);
+            TS_ASSERT_EQUALS(incoming.GetFieldEncoding("nutrient"), FIXED_POINT_ENCODING);
+            std::vector<double> received(num_points);
+            incoming.CopyField("tumour", &received[0]);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_EQUALS(received[idx], tumour[idx]);
+            }
+            incoming.CopyField("nutrient", &received[0]);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_DELTA(received[idx], nutrient[idx], 1.e-3);
+            }
+            incoming.CopyField("stimulus", &received[0]);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_DELTA(received[idx], stimulus[idx], 1.e-7 * stimulus[idx]);
+            }
+        }
+
+        // Only masks can be sent as bitsets
+        CouplingMessage outgoing;
+        outgoing.SetEncoding("nutrient", BITSET_ENCODING);
+        outgoing.AddField("nutrient", &nutrient[0], num_points);
+        TS_ASSERT_THROWS_THIS(outgoing.rPack(), "Field nutrient has values other than 0 and 1 and can't be sent as a bitset");
+        TS_ASSERT_THROWS_THIS(outgoing.SetEncoding("nutrient", FIXED_POINT_ENCODING),
+                "Fixed point encoding of nutrient needs a positive error bound");
+
+        std::string name;
+        FieldEncoding encoding;
+        double error_bound;
+        CouplingMessage::ParseEncoding("nutrient:fixed:0.01", name, encoding, error_bound);
+        TS_ASSERT_EQUALS(name, "nutrient");
+        TS_ASSERT_EQUALS(encoding, FIXED_POINT_ENCODING);
+        TS_ASSERT_DELTA(error_bound, 0.01, 1.e-12);
+        CouplingMessage::ParseEncoding("tumour:bitset", name, encoding, error_bound);
+        TS_ASSERT_EQUALS(encoding, BITSET_ENCODING);
+        TS_ASSERT_THROWS_THIS(CouplingMessage::ParseEncoding("tumour:bits", name, encoding, error_bound),
+                "Unknown field encoding bits. Use double, float, fixed or bitset");
+
+        // Encodings from the command line are set together
+        std::vector<std::string> specifications;
+        specifications.push_back("tumour:bitset");
+        specifications.push_back("nutrient:float");
+        CouplingMessage configured;
+        configured.SetEncodings(specifications);
+        configured.AddField("tumour", &tumour[0], num_points);
+        configured.AddField("nutrient", &nutrient[0], num_points);
+        configured.rPack();
+        TS_ASSERT_EQUALS(configured.GetFieldEncoding("tumour"), BITSET_ENCODING);
+        TS_ASSERT_EQUALS(configured.GetFieldEncoding("nutrient"), FLOAT_ENCODING);
+        specifications.push_back("stimulus:fixed");
+        TS_ASSERT_THROWS_THIS(configured.SetEncodings(specifications),
+                "Fixed point encoding of stimulus needs a positive error bound");
+    }
+
+    void TestDeltaEncoding()
+    {
+        // A growing tumour, only a shell of points changes each step
+        unsigned num_points = 20000;
+        std::vector<double> tumour(num_points, 0.0);
+        std::vector<double> nutrient(num_points, 40.0);
+        std::vector<double> received_tumour(num_points);
+        std::vector<double> received_nutrient(num_points);
+
+        CouplingMessage outgoing;
+        outgoing.SetDeltaEncoding(true, 1.e-6);
+        CouplingMessage incoming;
+        for(unsigned step=0; step<5; step++)
+        {
+            for(unsigned idx=0; idx<(step + 1) * 100; idx++)
+            {
+                tumour[idx] = 1.0;
+                nutrient[idx] = 40.0 - 2.0 * step - 1.e-7 * idx;
+            }
+            outgoing.Clear();
+            outgoing.AddField("tumour", &tumour[0], num_points);
+            outgoing.AddField("nutrient", &nutrient[0], num_points);
+            const std::vector<char>& r_buffer = outgoing.rPack();
+            incoming.Unpack(&r_buffer[0], r_buffer.size());
+
+            // The first step has to be sent in full
+            if(step == 0)
+            {
+                TS_ASSERT_EQUALS(incoming.GetFieldEncoding("tumour"), DOUBLE_ENCODING);
+            }
+            else
+            {
+                TS_ASSERT_EQUALS(incoming.GetFieldEncoding("tumour"), DELTA_ENCODING);
+                TS_ASSERT(r_buffer.size() < num_points * sizeof(double) / 10);
+            }
+
+            incoming.CopyField("tumour", &received_tumour[0]);
+            incoming.CopyField("nutrient", &received_nutrient[0]);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_EQUALS(received_tumour[idx], tumour[idx]);
+                TS_ASSERT_DELTA(received_nutrient[idx], nutrient[idx], 1.e-6);
+            }
+        }
+
+        // Dense changes fall back to a full copy
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            nutrient[idx] = 1.0 + idx;
+        }
+        outgoing.Clear();
+        outgoing.AddField("nutrient", &nutrient[0], num_points);
+        std::vector<char> buffer = outgoing.rPack();
+        incoming.Unpack(&buffer[0], buffer.size());
+        TS_ASSERT_EQUALS(incoming.GetFieldEncoding("nutrient"), DOUBLE_ENCODING);
+        incoming.CopyField("nutrient", &received_nutrient[0]);
+        TS_ASSERT_DELTA(received_nutrient[num_points - 1], double(num_points), 1.e-12);
+
+        // Changes can't be applied by a receiver without the earlier messages
+        nutrient[0] = 0.0;
+        outgoing.Clear();
+        outgoing.AddField("nutrient", &nutrient[0], num_points);
+        buffer = outgoing.rPack();
+        CouplingMessage late_incoming;
+        TS_ASSERT_THROWS_THIS(late_incoming.Unpack(&buffer[0], buffer.size()),
+                "Received changes to field nutrient without a full copy to apply them to");
+    }
+
+    void TestBadMessages()
+    {
+        std::vector<double> values(10, 1.0);
+        CouplingMessage message;
+        message.AddField("nutrient", &values[0], 10);
+        TS_ASSERT_THROWS_THIS(message.AddField("stimulus", &values[0], 5),
+                "Field stimulus has a different number of values to the other fields in the coupling message");
+
+        std::vector<char> buffer = message.rPack();
+        CouplingMessage incoming;
+        TS_ASSERT_THROWS_THIS(incoming.Unpack(&buffer[0], 4), "Coupling message is too small");
+        TS_ASSERT_THROWS_THIS(incoming.Unpack(&buffer[0], buffer.size() - 8),
+                "Coupling message has a bad entry for field nutrient");
+        buffer[0] = 'X';
+        TS_ASSERT_THROWS_THIS(incoming.Unpack(&buffer[0], buffer.size()),
+                "Received data is not a supported coupling message");
+    }
+};
+
+#endif /*TESTCOUPLINGMESSAGE_HPP_*/
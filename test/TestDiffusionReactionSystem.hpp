@@ -0,0 +1,235 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTDIFFUSIONREACTIONSYSTEM_HPP_
+#define TESTDIFFUSIONREACTIONSYSTEM_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <cmath>
+#include "UblasVectorInclude.hpp"
+#include "ReplicatableVector.hpp"
+#include "PetscTools.hpp"
+#include "DiffusionReactionSystem.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+class TestDiffusionReactionSystem : public CxxTest::TestSuite
+{
+public:
+
+    void TestUpdatesBetweenSteps()
+    {
+        c_vector<unsigned, 3> grid_size = scalar_vector<unsigned>(3, 3);
+        double spacing = 0.5;
+        double diffusivity = 2.0;
+        double diffusion_term = diffusivity / (spacing * spacing);
+        DiffusionReactionSystem system(grid_size, spacing, diffusivity);
+
+        // Without Dirichlet points the no flux faces leave a uniform solution, u = s / -a
+        std::vector<double> reaction(27, -2.0);
+        std::vector<double> source(27, 3.0);
+        std::vector<bool> dirichlet(27, false);
+        system.Update(&reaction[0], &source[0], dirichlet, 10.0);
+        Vec solution = system.Solve();
+        ReplicatableVector uniform(solution);
+        for(unsigned idx=0; idx<27; idx++)
+        {
+            TS_ASSERT_DELTA(uniform[idx], 1.5, 1.e-6);
+        }
+        PetscTools::Destroy(solution);
+        TS_ASSERT_DELTA(system.GetRhsChange(), -1.0, 1.e-12);
+
+        // Started from the answer, the unchanged system needs no iterations
+        std::vector<double> previous(27, 1.5);
+        system.SetChangeTolerance(1.e-3);
+        system.Update(&reaction[0], &source[0], dirichlet, 10.0);
+        TS_ASSERT_DELTA(system.GetRhsChange(), 0.0, 1.e-12);
+        solution = system.Solve(&previous[0]);
+        TS_ASSERT_EQUALS(system.GetNumIterations(), 0u);
+        PetscTools::Destroy(solution);
+
+        // Fix every point but the centre, which then has all of its neighbours at the fixed value
+        dirichlet.assign(27, true);
+        dirichlet[13] = false;
+        reaction[13] = -1.0;
+        source[13] = 4.0;
+        system.Update(&reaction[0], &source[0], dirichlet, 10.0);
+        solution = system.Solve();
+        ReplicatableVector centre(solution);
+        double expected = -(4.0 + 6.0 * diffusion_term * 10.0) / (-1.0 - 6.0 * diffusion_term);
+        TS_ASSERT_DELTA(centre[13], expected, 1.e-6);
+        TS_ASSERT_DELTA(centre[0], 10.0, 1.e-6);
+        PetscTools::Destroy(solution);
+
+        // Fixing the centre too rewrites its row
+        dirichlet[13] = true;
+        system.Update(&reaction[0], &source[0], dirichlet, 5.0);
+        solution = system.Solve();
+        ReplicatableVector fixed(solution);
+        for(unsigned idx=0; idx<27; idx++)
+        {
+            TS_ASSERT_DELTA(fixed[idx], 5.0, 1.e-6);
+        }
+        PetscTools::Destroy(solution);
+    }
+
+    void TestWarmStartMatchesColdSolve()
+    {
+        c_vector<unsigned, 3> grid_size = scalar_vector<unsigned>(3, 6);
+        unsigned num_points = 216;
+        DiffusionReactionSystem system(grid_size, 1.0, 1.0);
+        system.SetChangeTolerance(1.e-3);
+
+        // Sources chosen so that a known field solves the system exactly, with a Dirichlet face at z = 0
+        std::vector<double> reaction(num_points, -0.5);
+        std::vector<double> source(num_points, 0.0);
+        std::vector<bool> dirichlet(num_points, false);
+        std::vector<double> exact(num_points);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            unsigned x = idx % 6;
+            unsigned z = idx / 36;
+            dirichlet[idx] = z == 0;
+            exact[idx] = 1.0 + z * (0.1 * z + 0.05 * x);
+        }
+        unsigned offsets[3] = {1, 6, 36};
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            unsigned position[3] = {idx % 6, (idx / 6) % 6, idx / 36};
+            double flux = 0.0;
+            for(unsigned axis=0; axis<3; axis++)
+            {
+                if(position[axis] > 0)
+                {
+                    flux += exact[idx - offsets[axis]] - exact[idx];
+                }
+                if(position[axis] < 5)
+                {
+                    flux += exact[idx + offsets[axis]] - exact[idx];
+                }
+            }
+            source[idx] = -(reaction[idx] * exact[idx] + flux);
+        }
+
+        system.Update(&reaction[0], &source[0], dirichlet, 1.0);
+        Vec solution = system.Solve();
+        TS_ASSERT(system.GetNumIterations() > 0u);
+        ReplicatableVector cold(solution);
+        PetscTools::Destroy(solution);
+
+        // With the right-hand side unchanged a converged guess takes no iterations
+        system.Update(&reaction[0], &source[0], dirichlet, 1.0);
+        TS_ASSERT_DELTA(system.GetRhsChange(), 0.0, 1.e-12);
+        solution = system.Solve(&exact[0]);
+        TS_ASSERT_EQUALS(system.GetNumIterations(), 0u);
+        ReplicatableVector warm(solution);
+        PetscTools::Destroy(solution);
+
+        // and the answer agrees with the solve from zero
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            TS_ASSERT_DELTA(warm[idx], exact[idx], 1.e-12);
+            TS_ASSERT_DELTA(warm[idx], cold[idx], 1.e-4);
+        }
+    }
+
+    void TestPreconditionerLagging()
+    {
+        c_vector<unsigned, 3> grid_size = scalar_vector<unsigned>(3, 6);
+        unsigned num_points = 216;
+        std::vector<double> reaction(num_points, -0.5);
+        std::vector<double> source(num_points, 1.0);
+        std::vector<bool> dirichlet(num_points, false);
+        for(unsigned idx=0; idx<36; idx++)
+        {
+            dirichlet[idx] = true;
+        }
+
+        // Kept for two updates after the one it is built at
+        DiffusionReactionSystem lagged(grid_size, 1.0, 1.0);
+        lagged.SetPreconditionerLag(2);
+        DiffusionReactionSystem rebuilt(grid_size, 1.0, 1.0);
+        for(unsigned step=0; step<5; step++)
+        {
+            // The reaction drifts, as the vessel and cell fields do between steps
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                reaction[idx] = -0.5 * (1.0 + 0.2 * step * sin(0.1 * idx));
+            }
+            lagged.Update(&reaction[0], &source[0], dirichlet, 1.0);
+            rebuilt.Update(&reaction[0], &source[0], dirichlet, 1.0);
+            TS_ASSERT_EQUALS(lagged.WasPreconditionerRebuilt(), step % 3 == 0);
+            TS_ASSERT(rebuilt.WasPreconditionerRebuilt());
+
+            // A stale preconditioner gives the same answer
+            Vec lagged_solution = lagged.Solve();
+            Vec rebuilt_solution = rebuilt.Solve();
+            ReplicatableVector lagged_values(lagged_solution);
+            ReplicatableVector rebuilt_values(rebuilt_solution);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_DELTA(lagged_values[idx], rebuilt_values[idx], 1.e-4);
+            }
+            PetscTools::Destroy(lagged_solution);
+            PetscTools::Destroy(rebuilt_solution);
+        }
+
+        // A solve needing more iterations than the threshold brings the rebuild forward
+        DiffusionReactionSystem threshold(grid_size, 1.0, 1.0);
+        threshold.SetPreconditionerLag(10, 1);
+        threshold.Update(&reaction[0], &source[0], dirichlet, 1.0);
+        TS_ASSERT(threshold.WasPreconditionerRebuilt());
+        Vec solution = threshold.Solve();
+        TS_ASSERT_LESS_THAN(1u, threshold.GetNumIterations());
+        ReplicatableVector answer(solution);
+        PetscTools::Destroy(solution);
+        threshold.Update(&reaction[0], &source[0], dirichlet, 1.0);
+        TS_ASSERT(threshold.WasPreconditionerRebuilt());
+
+        // Started from the answer the solve is within the threshold, so the preconditioner is kept
+        std::vector<double> previous(num_points);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            previous[idx] = answer[idx];
+        }
+        solution = threshold.Solve(&previous[0]);
+        TS_ASSERT_LESS_THAN_EQUALS(threshold.GetNumIterations(), 1u);
+        PetscTools::Destroy(solution);
+        threshold.Update(&reaction[0], &source[0], dirichlet, 1.0);
+        TS_ASSERT(!threshold.WasPreconditionerRebuilt());
+    }
+};
+
+#endif /*TESTDIFFUSIONREACTIONSYSTEM_HPP_*/
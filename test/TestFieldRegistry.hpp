@@ -0,0 +1,120 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTFIELDREGISTRY_HPP_
+#define TESTFIELDREGISTRY_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <stdint.h>
+#include <cstdlib>
+#include "FieldRegistry.hpp"
+
+class TestFieldRegistry : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestRegisterAndAccessFields()
+    {
+        FieldRegistry registry;
+        registry.Reset(1000);
+
+        unsigned nutrient_handle = registry.Register("nutrient");
+        unsigned vessel_handle = registry.Register("vessel");
+        TS_ASSERT_EQUALS(registry.GetNumberOfFields(), 2u);
+        TS_ASSERT_EQUALS(registry.GetNumberOfPoints(), 1000u);
+
+        // Registering again returns the same handle
+        TS_ASSERT_EQUALS(registry.Register("nutrient"), nutrient_handle);
+        TS_ASSERT_EQUALS(registry.GetHandle("vessel"), vessel_handle);
+        TS_ASSERT_EQUALS(registry.rGetName(vessel_handle), "vessel");
+        TS_ASSERT(registry.HasField("nutrient"));
+        TS_ASSERT(!registry.HasField("stimulus"));
+
+        // Buffers are aligned and zero initialized
+        double* p_nutrient = registry.GetField(nutrient_handle);
+        TS_ASSERT_EQUALS(reinterpret_cast<uintptr_t>(p_nutrient) % FieldRegistry::ALIGNMENT, 0u);
+        TS_ASSERT_DELTA(p_nutrient[999], 0.0, 1.e-12);
+
+        // Later registrations do not move existing buffers
+        registry.Register("stimulus");
+        TS_ASSERT_EQUALS(registry.GetField(nutrient_handle), p_nutrient);
+
+        std::vector<double> values(1000, 2.0);
+        registry.SetField(vessel_handle, values);
+        TS_ASSERT_DELTA(registry.GetField(vessel_handle)[500], 2.0, 1.e-12);
+        TS_ASSERT_DELTA(registry.GetFieldVector(vessel_handle)[999], 2.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(registry.GetHandle("stimulus_typo"),
+                "Requested field stimulus_typo has not been registered");
+        TS_ASSERT_THROWS_THIS(registry.SetField(vessel_handle, std::vector<double>(10, 1.0)),
+                "Number of values does not match the number of points in field vessel");
+
+        registry.Reset(10);
+        TS_ASSERT_EQUALS(registry.GetNumberOfFields(), 0u);
+    }
+
+    void TestAdoptBuffer()
+    {
+        FieldRegistry registry;
+        registry.Reset(100);
+        unsigned handle = registry.Register("tumour");
+
+        void* p_buffer = NULL;
+        TS_ASSERT_EQUALS(posix_memalign(&p_buffer, FieldRegistry::ALIGNMENT, 100*sizeof(double)), 0);
+        boost::shared_ptr<void> p_owner(p_buffer, free);
+        double* p_values = static_cast<double*>(p_buffer);
+        for(unsigned idx=0; idx<100; idx++)
+        {
+            p_values[idx] = double(idx);
+        }
+
+        registry.Adopt(handle, p_values, p_owner);
+        TS_ASSERT_EQUALS(registry.GetField(handle), p_values);
+        TS_ASSERT_DELTA(registry.GetFieldVector(handle)[42], 42.0, 1.e-12);
+
+        // The registry shares ownership until it is reset
+        TS_ASSERT_EQUALS(p_owner.use_count(), 2);
+        registry.Reset(100);
+        TS_ASSERT_EQUALS(p_owner.use_count(), 1);
+
+        handle = registry.Register("tumour");
+        TS_ASSERT_THROWS_THIS(registry.Adopt(handle, p_values + 1, p_owner),
+                "Buffer adopted for field tumour is not suitably aligned");
+    }
+};
+
+#endif /*TESTFIELDREGISTRY_HPP_*/
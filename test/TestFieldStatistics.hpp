@@ -0,0 +1,172 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTFIELDSTATISTICS_HPP_
+#define TESTFIELDSTATISTICS_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <cmath>
+#include "OutputFileHandler.hpp"
+#include "FieldRegistry.hpp"
+#include "FieldStatistics.hpp"
+#include "ColumnarLog.hpp"
+
+class TestFieldStatistics : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestComputeStatistics()
+    {
+        // Large enough to be split between threads
+        unsigned num_points = 100000;
+        FieldRegistry fields;
+        fields.Reset(num_points);
+        double* p_tumour = fields.GetField(fields.Register("tumour"));
+        double* p_necrotic = fields.GetField(fields.Register("necrotic"));
+        double* p_vessel = fields.GetField(fields.Register("vessel"));
+        double* p_stimulus = fields.GetField(fields.Register("stimulus"));
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            // The first quarter is tumour, half of it necrotic
+            bool in_tumour = idx < num_points / 4;
+            p_tumour[idx] = in_tumour ? 1.0 : 0.0;
+            p_necrotic[idx] = (idx < num_points / 8) ? 1.0 : 0.0;
+            p_vessel[idx] = in_tumour ? 0.1 : 0.3;
+            p_stimulus[idx] = double(idx % 10) / 10.0 + 0.05;
+        }
+
+        std::vector<double> single_threaded;
+        for(unsigned num_threads=1; num_threads<=4; num_threads+=3)
+        {
+            FieldStatistics statistics(num_threads);
+            statistics.AddSummary("vessel");
+            statistics.AddHistogram("stimulus", 0.0, 1.0, 10);
+            statistics.AddMaskedMean("vessel", "tumour");
+            statistics.AddFraction("necrotic_fraction", "necrotic", "tumour");
+            statistics.Bind(fields, 8.0);
+
+            const std::vector<std::string>& r_names = statistics.rGetColumnNames();
+            TS_ASSERT_EQUALS(r_names.size(), 12u + 10u + 2u + 1u);
+            TS_ASSERT_EQUALS(r_names[0], "vessel_total");
+            TS_ASSERT_EQUALS(r_names[4], "necrotic_total");
+            TS_ASSERT_EQUALS(r_names[12], "stimulus_hist_0");
+            TS_ASSERT_EQUALS(r_names[22], "vessel_mean_in_tumour");
+            TS_ASSERT_EQUALS(r_names[24], "necrotic_fraction");
+
+            std::vector<double> values = statistics.Compute();
+            TS_ASSERT_DELTA(values[0], 8.0 * (0.1 * 25000 + 0.3 * 75000), 1.e-6);
+            TS_ASSERT_DELTA(values[1], 0.1, 1.e-12);
+            TS_ASSERT_DELTA(values[2], 0.25, 1.e-12);
+            TS_ASSERT_DELTA(values[3], 0.3, 1.e-12);
+            TS_ASSERT_DELTA(values[4], 8.0 * 12500, 1.e-6);
+            for(unsigned bin=0; bin<10; bin++)
+            {
+                TS_ASSERT_DELTA(values[12 + bin], 10000.0, 1.e-12);
+            }
+            TS_ASSERT_DELTA(values[22], 0.1, 1.e-12);
+            TS_ASSERT_DELTA(values[23], 0.3, 1.e-12);
+            TS_ASSERT_DELTA(values[24], 0.5, 1.e-12);
+
+            // Results don't depend on the number of threads
+            if(num_threads == 1)
+            {
+                single_threaded = values;
+            }
+            else
+            {
+                for(unsigned idx=0; idx<values.size(); idx++)
+                {
+                    TS_ASSERT_DELTA(values[idx], single_threaded[idx], 1.e-10 * (1.0 + std::abs(single_threaded[idx])));
+                }
+            }
+
+            // The threads are kept between steps and pick up changed fields
+            p_vessel[0] += 1.0;
+            std::vector<double> next_values = statistics.Compute();
+            TS_ASSERT_DELTA(next_values[0], values[0] + 8.0, 1.e-6);
+            TS_ASSERT_DELTA(next_values[3], 1.1, 1.e-12);
+            p_vessel[0] -= 1.0;
+        }
+
+        FieldStatistics bad;
+        TS_ASSERT_THROWS_THIS(bad.AddHistogram("stimulus", 1.0, 0.0, 10),
+                "Histogram of stimulus needs at least one bin and a non-empty range");
+    }
+
+    void TestColumnarLog()
+    {
+        OutputFileHandler output_file_handler("TestFieldStatistics");
+        std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/statistics.h5";
+
+        std::vector<std::string> names;
+        names.push_back("time");
+        names.push_back("nutrient_mean");
+        {
+            ColumnarLog log(filename, names, false, 4);
+            for(unsigned step=0; step<10; step++)
+            {
+                std::vector<double> row;
+                row.push_back(double(step));
+                row.push_back(2.0 * step);
+                log.AppendRow(row);
+            }
+            TS_ASSERT_EQUALS(log.GetNumberOfRows(), 10u);
+            TS_ASSERT_THROWS_THIS(log.AppendRow(std::vector<double>(1, 0.0)),
+                    "Number of values does not match the number of columns in " + filename);
+        }
+        {
+            // As after a restart
+            ColumnarLog log(filename, names, true);
+            TS_ASSERT_EQUALS(log.GetNumberOfRows(), 10u);
+            std::vector<double> row;
+            row.push_back(10.0);
+            row.push_back(20.0);
+            log.AppendRow(row);
+        }
+
+        std::vector<double> times = ColumnarLog::ReadColumn(filename, "time");
+        std::vector<double> nutrient = ColumnarLog::ReadColumn(filename, "nutrient_mean");
+        TS_ASSERT_EQUALS(times.size(), 11u);
+        TS_ASSERT_DELTA(times[10], 10.0, 1.e-12);
+        TS_ASSERT_DELTA(nutrient[7], 14.0, 1.e-12);
+        TS_ASSERT_THROWS_THIS(ColumnarLog::ReadColumn(filename, "stimulus_mean"),
+                "Log file " + filename + " has no column stimulus_mean");
+    }
+};
+
+#endif /*TESTFIELDSTATISTICS_HPP_*/
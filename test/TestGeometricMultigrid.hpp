@@ -0,0 +1,187 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTGEOMETRICMULTIGRID_HPP_
+#define TESTGEOMETRICMULTIGRID_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <math.h>
+#include "UblasVectorInclude.hpp"
+#include "StencilOperator.hpp"
+#include "GeometricMultigrid.hpp"
+#include "MatrixFreeSolver.hpp"
+
+class TestGeometricMultigrid : public CxxTest::TestSuite
+{
+    /**
+     * A tumour-like mask: free points in a ball, Dirichlet points outside it
+     */
+    std::vector<bool> BallMask(const c_vector<unsigned, 3>& rSize, double radius)
+    {
+        std::vector<bool> dirichlet(rSize[0] * rSize[1] * rSize[2]);
+        for(unsigned idx=0; idx<dirichlet.size(); idx++)
+        {
+            double x = double(idx % rSize[0]) - 0.5 * double(rSize[0] - 1);
+            double y = double((idx / rSize[0]) % rSize[1]) - 0.5 * double(rSize[1] - 1);
+            double z = double(idx / (rSize[0] * rSize[1])) - 0.5 * double(rSize[2] - 1);
+            dirichlet[idx] = sqrt(x*x + y*y + z*z) > radius;
+        }
+        return dirichlet;
+    }
+
+    /**
+     * @param rSize the grid size
+     * @param rMask the Dirichlet points
+     * @param seed varies the values
+     * @return values that are zero at Dirichlet points
+     */
+    std::vector<double> FreeValues(const c_vector<unsigned, 3>& rSize, const std::vector<bool>& rMask, unsigned seed)
+    {
+        std::vector<double> values(rSize[0] * rSize[1] * rSize[2], 0.0);
+        for(unsigned idx=0; idx<values.size(); idx++)
+        {
+            if(!rMask[idx])
+            {
+                values[idx] = sin(0.37 * double(idx * seed + 1));
+            }
+        }
+        return values;
+    }
+
+public:
+
+    void TestHierarchy()
+    {
+        c_vector<unsigned, 3> size = scalar_vector<unsigned>(3, 33);
+        StencilOperator fine(size, 1.0, 1.0);
+        GeometricMultigrid multigrid(fine);
+        TS_ASSERT_EQUALS(multigrid.GetNumberOfLevels(), 4u);
+        TS_ASSERT_EQUALS(multigrid.rGetGridSize(1)[0], 17u);
+        TS_ASSERT_EQUALS(multigrid.rGetGridSize(2)[1], 9u);
+        TS_ASSERT_EQUALS(multigrid.rGetGridSize(3)[2], 5u);
+
+        // Flat grids keep coarsening until small enough
+        size[0] = 65;
+        size[1] = 65;
+        size[2] = 1;
+        StencilOperator flat(size, 1.0, 1.0);
+        GeometricMultigrid flat_multigrid(flat);
+        TS_ASSERT_EQUALS(flat_multigrid.GetNumberOfLevels(), 3u);
+        TS_ASSERT_EQUALS(flat_multigrid.rGetGridSize(2)[2], 1u);
+    }
+
+    void TestCycleIsSymmetric()
+    {
+        c_vector<unsigned, 3> size;
+        size[0] = 20;
+        size[1] = 17;
+        size[2] = 12;
+        std::vector<bool> mask = BallMask(size, 7.0);
+        std::vector<double> reaction(mask.size(), -0.05);
+        StencilOperator fine(size, 0.5, 2.0);
+        fine.Update(&reaction[0], mask);
+        GeometricMultigrid multigrid(fine);
+        multigrid.Update(&reaction[0]);
+        TS_ASSERT_EQUALS(multigrid.GetNumberOfLevels(), 3u);
+
+        std::vector<double> u = FreeValues(size, mask, 3);
+        std::vector<double> v = FreeValues(size, mask, 7);
+        std::vector<double> cycled_u(u.size());
+        std::vector<double> cycled_v(v.size());
+        multigrid.Apply(&u[0], &cycled_u[0]);
+        multigrid.Apply(&v[0], &cycled_v[0]);
+        double v_cycled_u = 0.0;
+        double u_cycled_v = 0.0;
+        double u_cycled_u = 0.0;
+        for(unsigned idx=0; idx<u.size(); idx++)
+        {
+            v_cycled_u += v[idx] * cycled_u[idx];
+            u_cycled_v += u[idx] * cycled_v[idx];
+            u_cycled_u += u[idx] * cycled_u[idx];
+            if(mask[idx])
+            {
+                TS_ASSERT_EQUALS(cycled_u[idx], 0.0);
+            }
+        }
+        TS_ASSERT_DELTA(v_cycled_u, u_cycled_v, 1.e-10 * fabs(u_cycled_u));
+        TS_ASSERT_LESS_THAN(0.0, u_cycled_u);
+    }
+
+    void TestCoarsestSolveIsExact()
+    {
+        // Small enough for a single level, so a cycle inverts the operator
+        c_vector<unsigned, 3> size = scalar_vector<unsigned>(3, 7);
+        std::vector<bool> mask = BallMask(size, 2.5);
+        std::vector<double> reaction(mask.size(), -0.2);
+        StencilOperator fine(size, 1.0, 1.0);
+        fine.Update(&reaction[0], mask);
+        GeometricMultigrid multigrid(fine);
+        multigrid.Update(&reaction[0]);
+        TS_ASSERT_EQUALS(multigrid.GetNumberOfLevels(), 1u);
+
+        std::vector<double> residual = FreeValues(size, mask, 5);
+        std::vector<double> correction(residual.size());
+        multigrid.Apply(&residual[0], &correction[0]);
+        std::vector<double> product(residual.size());
+        fine.Apply(&correction[0], &product[0]);
+        for(unsigned idx=0; idx<residual.size(); idx++)
+        {
+            TS_ASSERT_DELTA(product[idx], residual[idx], 1.e-10);
+        }
+    }
+
+    void TestIterationsStayFlat()
+    {
+        unsigned sizes[3] = {16, 32, 64};
+        unsigned iterations[3];
+        for(unsigned size_index=0; size_index<3; size_index++)
+        {
+            c_vector<unsigned, 3> size = scalar_vector<unsigned>(3, sizes[size_index]);
+            std::vector<bool> mask = BallMask(size, 0.4 * sizes[size_index]);
+            std::vector<double> reaction(mask.size(), -0.05);
+            std::vector<double> source(mask.size(), 1.0);
+            MatrixFreeSolver solver(size, 1.0, 1.0, MULTIGRID_PRECONDITIONER);
+            solver.Update(&reaction[0], &source[0], mask, 1.0);
+            std::vector<double> solution(mask.size(), 0.0);
+            solver.Solve(&solution[0]);
+            iterations[size_index] = solver.GetNumIterations();
+            TS_ASSERT_LESS_THAN_EQUALS(iterations[size_index], 10u);
+        }
+        TS_ASSERT_LESS_THAN_EQUALS(iterations[2], iterations[0] + 2);
+    }
+};
+
+#endif /*TESTGEOMETRICMULTIGRID_HPP_*/
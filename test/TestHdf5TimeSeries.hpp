@@ -0,0 +1,179 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTHDF5TIMESERIES_HPP_
+#define TESTHDF5TIMESERIES_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include "UblasVectorInclude.hpp"
+#include "OutputFileHandler.hpp"
+#include "Hdf5TimeSeriesWriter.hpp"
+#include "Hdf5TimeSeriesReader.hpp"
+
+class TestHdf5TimeSeries : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestWriteAndReadSteps()
+    {
+        OutputFileHandler output_file_handler("TestHdf5TimeSeries");
+        std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/output.h5";
+
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 5;
+        grid_size[1] = 4;
+        grid_size[2] = 3;
+        c_vector<double, 3> grid_origin = zero_vector<double>(3);
+        grid_origin[0] = 1.0;
+
+        std::vector<std::string> names;
+        names.push_back("nutrient");
+        names.push_back("vessel");
+
+        std::vector<double> nutrient(60);
+        std::vector<double> vessel(60);
+        std::vector<const double*> fields;
+        fields.push_back(&nutrient[0]);
+        fields.push_back(&vessel[0]);
+        {
+            Hdf5TimeSeriesWriter writer(filename, grid_size, 0.5, grid_origin, names);
+            for(unsigned step=0; step<4; step++)
+            {
+                for(unsigned idx=0; idx<60; idx++)
+                {
+                    nutrient[idx] = step * 100.0 + idx;
+                    vessel[idx] = -double(step);
+                }
+                writer.WriteStep(2.0 * step, fields);
+            }
+            TS_ASSERT_EQUALS(writer.GetNumberOfSteps(), 4u);
+
+            std::vector<const double*> too_few(1, &nutrient[0]);
+            TS_ASSERT_THROWS_THIS(writer.WriteStep(8.0, too_few),
+                    "Number of fields written does not match the HDF5 file set up");
+        }
+
+        std::ifstream xdmf(Hdf5TimeSeriesWriter::GetXdmfFilename(filename).c_str());
+        TS_ASSERT(xdmf.good());
+        TS_ASSERT_EQUALS(Hdf5TimeSeriesWriter::GetXdmfFilename(filename),
+                output_file_handler.GetOutputDirectoryFullPath() + "/output.xdmf");
+
+        // Steps and fields can be read in any order
+        Hdf5TimeSeriesReader reader(filename);
+        TS_ASSERT_EQUALS(reader.GetGridSize()[0], 5u);
+        TS_ASSERT_EQUALS(reader.GetGridSize()[2], 3u);
+        TS_ASSERT_DELTA(reader.GetGridSpacing(), 0.5, 1.e-12);
+        TS_ASSERT_DELTA(reader.GetGridOrigin()[0], 1.0, 1.e-12);
+        TS_ASSERT_EQUALS(reader.rGetFieldNames().size(), 2u);
+        TS_ASSERT_EQUALS(reader.rGetFieldNames()[0], "nutrient");
+        TS_ASSERT_EQUALS(reader.rGetFieldNames()[1], "vessel");
+        TS_ASSERT_EQUALS(reader.GetNumberOfSteps(), 4u);
+        TS_ASSERT_DELTA(reader.rGetTimes()[3], 6.0, 1.e-12);
+
+        std::vector<double> values = reader.ReadField(2, "nutrient");
+        TS_ASSERT_DELTA(values[0], 200.0, 1.e-12);
+        TS_ASSERT_DELTA(values[59], 259.0, 1.e-12);
+        values = reader.ReadField(0, "vessel");
+        TS_ASSERT_DELTA(values[30], 0.0, 1.e-12);
+        values = reader.ReadField(3, "vessel");
+        TS_ASSERT_DELTA(values[30], -3.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(reader.ReadField(4, "vessel"), "Requested step is beyond the end of " + filename);
+        TS_ASSERT_THROWS_THIS(reader.ReadField(0, "stimulus"),
+                "HDF5 file " + filename + " does not contain the field stimulus");
+    }
+
+    void TestAppendSteps()
+    {
+        OutputFileHandler output_file_handler("TestHdf5TimeSeries", false);
+        std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/append.h5";
+
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 4;
+        grid_size[1] = 4;
+        grid_size[2] = 1;
+        c_vector<double, 3> grid_origin = zero_vector<double>(3);
+        std::vector<std::string> names(1, "nutrient");
+        std::vector<double> nutrient(16, 1.0);
+        std::vector<const double*> fields(1, &nutrient[0]);
+
+        {
+            Hdf5TimeSeriesWriter writer(filename, grid_size, 1.0, grid_origin, names);
+            writer.WriteStep(0.0, fields);
+            writer.WriteStep(1.0, fields);
+        }
+        {
+            // As after a restart
+            nutrient[0] = 5.0;
+            Hdf5TimeSeriesWriter writer(filename, grid_size, 1.0, grid_origin, names, true);
+            TS_ASSERT_EQUALS(writer.GetNumberOfSteps(), 2u);
+            writer.WriteStep(2.0, fields);
+        }
+
+        {
+            Hdf5TimeSeriesReader reader(filename);
+            TS_ASSERT_EQUALS(reader.GetNumberOfSteps(), 3u);
+            TS_ASSERT_DELTA(reader.ReadField(1, "nutrient")[0], 1.0, 1.e-12);
+            TS_ASSERT_DELTA(reader.ReadField(2, "nutrient")[0], 5.0, 1.e-12);
+        }
+
+        {
+            // Steps written after the checkpoint at time 1 are dropped and written again
+            nutrient[0] = 7.0;
+            Hdf5TimeSeriesWriter writer(filename, grid_size, 1.0, grid_origin, names, true, 1, 1.0);
+            TS_ASSERT_EQUALS(writer.GetNumberOfSteps(), 2u);
+            writer.WriteStep(2.0, fields);
+        }
+
+        {
+            Hdf5TimeSeriesReader reader(filename);
+            TS_ASSERT_EQUALS(reader.GetNumberOfSteps(), 3u);
+            TS_ASSERT_DELTA(reader.rGetTimes()[2], 2.0, 1.e-12);
+            TS_ASSERT_DELTA(reader.ReadField(1, "nutrient")[0], 1.0, 1.e-12);
+            TS_ASSERT_DELTA(reader.ReadField(2, "nutrient")[0], 7.0, 1.e-12);
+        }
+
+        // A different grid can't be appended to
+        grid_size[2] = 2;
+        TS_ASSERT_THROWS_THIS(Hdf5TimeSeriesWriter(filename, grid_size, 1.0, grid_origin, names, true),
+                "HDF5 file " + filename + " does not match the output grid");
+    }
+};
+
+#endif /*TESTHDF5TIMESERIES_HPP_*/
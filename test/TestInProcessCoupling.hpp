@@ -0,0 +1,464 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTINPROCESSCOUPLING_HPP_
+#define TESTINPROCESSCOUPLING_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "SmartPointers.hpp"
+#include "Exception.hpp"
+#include "OutputFileHandler.hpp"
+#include "Simulation.hpp"
+#include "CellSimulation.hpp"
+#include "VesselSimulation.hpp"
+#include "MetabolicSimulation.hpp"
+#include "BinaryFieldFile.hpp"
+#include "ColumnarLog.hpp"
+#include "Hdf5TimeSeriesReader.hpp"
+#include "InProcessConduit.hpp"
+#include "InProcessCouplingTransport.hpp"
+#include "InProcessCoupling.hpp"
+
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Sends a field set to the step number each step
+ */
+class RampSimulation : public Simulation
+{
+public:
+
+    RampSimulation()
+    {
+        mMuscleOutputSpatialParameters.push_back("ramp");
+    }
+
+    void Run()
+    {
+        Initialize();
+        double* p_ramp = mFields.GetField(mFields.GetHandle("ramp"));
+        for(unsigned idx=0; idx<mMaxIncrements; idx++)
+        {
+            std::fill(p_ramp, p_ramp + mFields.GetNumberOfPoints(), double(idx));
+            if(IsCouplingIncrement(idx))
+            {
+                Send();
+            }
+        }
+    }
+};
+
+/**
+ * Receives the ramp until the sender finishes
+ */
+class RampReceiverSimulation : public Simulation
+{
+public:
+
+    std::vector<double> mReceived;
+
+    RampReceiverSimulation()
+    {
+        mMuscleInputSpatialParameters.push_back("ramp");
+    }
+
+    void Run()
+    {
+        Initialize();
+        while(HasNextMessage(mBatchedCoupling ? "fields_in" : "ramp_in"))
+        {
+            Receive();
+            const double* p_ramp = mFields.GetField(mFields.GetHandle("ramp"));
+            mReceived.push_back(p_ramp[mFields.GetNumberOfPoints() - 1]);
+        }
+    }
+};
+
+/**
+ * Steps a fixed number of increments, exchanging on coupling increments
+ */
+class ClockedReceiverSimulation : public Simulation
+{
+public:
+
+    std::vector<double> mReceived;
+
+    ClockedReceiverSimulation()
+    {
+        mMuscleInputSpatialParameters.push_back("ramp");
+    }
+
+    void Run()
+    {
+        Initialize();
+        for(unsigned idx=0; idx<mMaxIncrements; idx++)
+        {
+            UpdateCoupledInputs(idx);
+            const double* p_ramp = mFields.GetField(mFields.GetHandle("ramp"));
+            mReceived.push_back(p_ramp[0]);
+        }
+    }
+};
+
+/**
+ * Fails straight away
+ */
+class FailingSimulation : public Simulation
+{
+public:
+
+    void Run()
+    {
+        EXCEPTION("Out of nutrient");
+    }
+};
+
+class TestInProcessCoupling : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestConduit()
+    {
+        InProcessConduit conduit("a.out -> b.in");
+
+        // Fields arrive in order, from another thread
+        std::thread sender([&conduit]
+        {
+            std::vector<double> values(100);
+            for(unsigned step=0; step<5; step++)
+            {
+                std::fill(values.begin(), values.end(), double(step));
+                conduit.SendField(&values[0], values.size());
+            }
+            conduit.Close();
+        });
+        std::vector<double> received(100);
+        for(unsigned step=0; step<5; step++)
+        {
+            TS_ASSERT(conduit.HasNext());
+            conduit.ReceiveField(&received[0], received.size());
+            TS_ASSERT_DELTA(received[99], double(step), 1.e-12);
+        }
+        sender.join();
+        TS_ASSERT(!conduit.HasNext());
+        TS_ASSERT_THROWS_THIS(conduit.ReceiveField(&received[0], received.size()),
+                "Coupling conduit a.out -> b.in was closed before a message arrived");
+
+        // Sends after closing are dropped
+        conduit.SendField(&received[0], received.size());
+        TS_ASSERT(!conduit.HasNext());
+
+        // Raw messages are swapped out, and fields and messages can't be mixed up
+        InProcessConduit message_conduit("c.out -> d.in");
+        std::vector<char> message(10, 'x');
+        message_conduit.SendMessage(message);
+        message_conduit.SendField(&received[0], 50);
+        std::vector<char> received_message;
+        TS_ASSERT_THROWS_THIS(message_conduit.ReceiveField(&received[0], 50),
+                "Coupling conduit c.out -> d.in carries raw messages, not fields");
+        message_conduit.ReceiveMessage(received_message);
+        TS_ASSERT_EQUALS(received_message.size(), 10u);
+        TS_ASSERT_EQUALS(received_message[9], 'x');
+        TS_ASSERT_THROWS_THIS(message_conduit.ReceiveMessage(received_message),
+                "Coupling conduit c.out -> d.in carries fields, not raw messages");
+        TS_ASSERT_THROWS_THIS(message_conduit.ReceiveField(&received[0], 100),
+                "Number of points in incoming vector does not match number of points in grid");
+    }
+
+    void TestFieldHandover()
+    {
+        InProcessConduit conduit("a.out -> b.in");
+        std::vector<double> values(100, 1.0);
+        conduit.SendField(&values[0], values.size());
+
+        // The receiver gets a snapshot, in a buffer it can adopt
+        boost::shared_ptr<FieldBuffer> p_buffer = conduit.ReceiveFieldBuffer(100);
+        values[0] = 2.0;
+        TS_ASSERT_DELTA(p_buffer->GetData()[0], 1.0, 1.e-12);
+        TS_ASSERT(FieldRegistry::IsAligned(p_buffer->GetData()));
+        const double* p_first = p_buffer->GetData();
+
+        // Buffers the receiver still holds aren't reused, released ones are
+        conduit.SendField(&values[0], values.size());
+        boost::shared_ptr<FieldBuffer> p_second = conduit.ReceiveFieldBuffer(100);
+        TS_ASSERT(p_second->GetData() != p_first);
+        TS_ASSERT_DELTA(p_second->GetData()[0], 2.0, 1.e-12);
+        p_buffer.reset();
+        conduit.SendField(&values[0], values.size());
+        p_buffer = conduit.ReceiveFieldBuffer(100);
+        TS_ASSERT_EQUALS(p_buffer->GetData(), p_first);
+
+        // An adopted buffer is held by the registry until it is replaced
+        FieldRegistry fields;
+        fields.Reset(100);
+        unsigned handle = fields.Register("ramp");
+        fields.Adopt(handle, p_buffer->GetData(), p_buffer);
+        p_buffer.reset();
+        conduit.SendField(&values[0], values.size());
+        p_buffer = conduit.ReceiveFieldBuffer(100);
+        TS_ASSERT(p_buffer->GetData() != p_first);
+        fields.Adopt(handle, p_buffer->GetData(), p_buffer);
+        conduit.SendField(&values[0], values.size());
+        TS_ASSERT_EQUALS(conduit.ReceiveFieldBuffer(100)->GetData(), p_first);
+
+        // Batches of fields are handed over by name, without packing them
+        std::vector<std::string> names;
+        names.push_back("ramp");
+        names.push_back("offset");
+        std::vector<const double*> sources;
+        sources.push_back(&values[0]);
+        sources.push_back(&values[1]);
+        conduit.SendFields(names, sources, 99);
+        TS_ASSERT_THROWS_THIS(conduit.ReceiveFieldBuffer(99),
+                "Coupling conduit a.out -> b.in carries batches of fields, not fields");
+        std::map<std::string, boost::shared_ptr<FieldBuffer> > received;
+        conduit.ReceiveFields(received);
+        TS_ASSERT_EQUALS(received.size(), 2u);
+        TS_ASSERT_EQUALS(received["offset"]->GetNumberOfValues(), 99u);
+        TS_ASSERT_DELTA(received["ramp"]->GetData()[0], 2.0, 1.e-12);
+        TS_ASSERT_DELTA(received["offset"]->GetData()[0], 1.0, 1.e-12);
+    }
+
+    void TestTransport()
+    {
+        boost::shared_ptr<InProcessConduit> p_conduit(new InProcessConduit("a.fields_out -> b.fields_in"));
+        InProcessCouplingTransport sender("a");
+        InProcessCouplingTransport receiver("b");
+        sender.AddOutgoingConduit("fields_out", p_conduit);
+        receiver.AddIncomingConduit("fields_in", p_conduit);
+        TS_ASSERT_THROWS_THIS(receiver.AddIncomingConduit("fields_in", p_conduit),
+                "Conduit fields_in of component b is already coupled");
+
+        TS_ASSERT(sender.HandsOverFields());
+
+        std::vector<char> message(3, 'y');
+        sender.SendMessage("fields_out", message);
+        TS_ASSERT_THROWS_THIS(sender.SendMessage("tumour_out", message), "Conduit tumour_out of component a is not coupled");
+        TS_ASSERT_THROWS_THIS(receiver.HasNext("fields_out"), "Conduit fields_out of component b is not coupled");
+
+        std::vector<char> received;
+        TS_ASSERT(receiver.HasNext("fields_in"));
+        receiver.ReceiveMessage("fields_in", received);
+        TS_ASSERT_EQUALS(received.size(), 3u);
+
+        sender.CloseOutgoingConduits();
+        TS_ASSERT(!receiver.HasNext("fields_in"));
+    }
+
+    void TestCoupledComponents()
+    {
+        for(unsigned batched=0; batched<2; batched++)
+        {
+            boost::shared_ptr<RampSimulation> p_ramp(new RampSimulation);
+            boost::shared_ptr<RampReceiverSimulation> p_receiver(new RampReceiverSimulation);
+            p_ramp->SetMaxIncrements(4);
+            p_ramp->SetGridSize(4, 3, 2);
+            p_ramp->SetBatchedCoupling(batched == 1);
+            p_receiver->SetGridSize(4, 3, 2);
+            p_receiver->SetBatchedCoupling(batched == 1);
+
+            InProcessCoupling coupling;
+            coupling.AddComponent("Ramp", p_ramp);
+            coupling.AddComponent("Receiver", p_receiver);
+            TS_ASSERT_THROWS_THIS(coupling.AddComponent("Ramp", p_ramp), "There is already a component named Ramp");
+            TS_ASSERT_THROWS_THIS(coupling.Couple("Ramp", "ramp_out", "Sink", "ramp_in"), "There is no component named Sink");
+            if(batched == 1)
+            {
+                coupling.Couple("Ramp", "fields_out", "Receiver", "fields_in");
+            }
+            else
+            {
+                coupling.Couple("Ramp", "ramp_out", "Receiver", "ramp_in");
+            }
+            coupling.Run();
+
+            TS_ASSERT_EQUALS(p_receiver->mReceived.size(), 4u);
+            for(unsigned idx=0; idx<p_receiver->mReceived.size(); idx++)
+            {
+                TS_ASSERT_DELTA(p_receiver->mReceived[idx], double(idx), 1.e-12);
+            }
+        }
+    }
+
+    void TestRegriddedCoupling()
+    {
+        // The receiver runs on a grid twice as coarse, each voxel covering eight of the sender's
+        c_vector<unsigned, 3> fine_size;
+        fine_size[0] = 4;
+        fine_size[1] = 4;
+        fine_size[2] = 2;
+        for(unsigned batched=0; batched<2; batched++)
+        {
+            boost::shared_ptr<RampSimulation> p_ramp(new RampSimulation);
+            boost::shared_ptr<RampReceiverSimulation> p_receiver(new RampReceiverSimulation);
+            p_ramp->SetMaxIncrements(3);
+            p_ramp->SetGridSize(4, 4, 2);
+            p_ramp->SetBatchedCoupling(batched == 1);
+            p_receiver->SetGridSize(2, 2, 1);
+            p_receiver->SetGridSpacing(2.0);
+            p_receiver->SetGridOrigin(0.5, 0.5, 0.5);
+            p_receiver->SetPeerGrid(fine_size, 1.0, zero_vector<double>(3));
+            p_receiver->SetRegridding("ramp", CONSERVATIVE_REGRIDDING);
+            p_receiver->SetBatchedCoupling(batched == 1);
+
+            InProcessCoupling coupling;
+            coupling.AddComponent("Ramp", p_ramp);
+            coupling.AddComponent("Receiver", p_receiver);
+            coupling.Couple("Ramp", batched == 1 ? "fields_out" : "ramp_out", "Receiver", batched == 1 ? "fields_in" : "ramp_in");
+            coupling.Run();
+
+            TS_ASSERT_EQUALS(p_receiver->mReceived.size(), 3u);
+            TS_ASSERT_DELTA(p_receiver->mReceived[2], 2.0, 1.e-12);
+        }
+    }
+
+    void TestMultiRateCoupling()
+    {
+        // The ramp is sent every other increment. Between exchanges linear interpolation
+        // would run ahead of the last ramp received, so it is clamped to it, as when held.
+        for(unsigned order=0; order<2; order++)
+        {
+            boost::shared_ptr<RampSimulation> p_ramp(new RampSimulation);
+            boost::shared_ptr<ClockedReceiverSimulation> p_receiver(new ClockedReceiverSimulation);
+            p_ramp->SetMaxIncrements(8);
+            p_ramp->SetGridSize(4, 3, 2);
+            p_ramp->SetCouplingPeriod(2);
+            p_receiver->SetMaxIncrements(8);
+            p_receiver->SetGridSize(4, 3, 2);
+            p_receiver->SetCouplingPeriod(2, order);
+            TS_ASSERT_THROWS_THIS(p_receiver->SetCouplingPeriod(0), "Coupling period must be at least one increment");
+
+            InProcessCoupling coupling;
+            coupling.AddComponent("Ramp", p_ramp);
+            coupling.AddComponent("Receiver", p_receiver);
+            coupling.Couple("Ramp", "ramp_out", "Receiver", "ramp_in");
+            coupling.Run();
+
+            TS_ASSERT_EQUALS(p_receiver->mReceived.size(), 8u);
+            TS_ASSERT_DELTA(p_receiver->mReceived[1], 0.0, 1.e-12);
+            for(unsigned idx=2; idx<8; idx++)
+            {
+                TS_ASSERT_DELTA(p_receiver->mReceived[idx], double(idx - idx % 2), 1.e-12);
+            }
+        }
+    }
+
+    void TestFailuresStopTheOtherComponents()
+    {
+        boost::shared_ptr<FailingSimulation> p_failing(new FailingSimulation);
+        boost::shared_ptr<RampReceiverSimulation> p_receiver(new RampReceiverSimulation);
+        p_receiver->SetGridSize(4, 3, 2);
+
+        InProcessCoupling coupling;
+        coupling.AddComponent("Failing", p_failing);
+        coupling.AddComponent("Receiver", p_receiver);
+        coupling.Couple("Failing", "ramp_out", "Receiver", "ramp_in");
+        TS_ASSERT_THROWS_THIS(coupling.Run(), "Component Failing failed: Out of nutrient");
+        TS_ASSERT(p_receiver->mReceived.empty());
+    }
+
+    void TestHypermodelWithStatisticsOutput()
+    {
+        // As HypermodelSimulator with -statistics_output true. Every component logs
+        // statistics on its own thread while the cell fields are written to HDF5 from
+        // a background output thread.
+        OutputFileHandler output_file_handler("TestHypermodelWithStatisticsOutput");
+        std::string output_directory = output_file_handler.GetOutputDirectoryFullPath();
+        std::string output_file = output_directory + "hypermodel";
+
+        // The cell component's input, on the hypermodel grid
+        c_vector<unsigned, 3> grid_size = scalar_vector<unsigned>(3, 10);
+        std::vector<double> factors(1000, 1.0);
+        BinaryFieldFile::Write(output_directory + "input.chicbin", grid_size, 5.0, zero_vector<double>(3),
+                std::map<std::string, double>(), std::vector<std::string>(1, "proliferation_rate_factor"),
+                std::vector<const double*>(1, &factors[0]));
+
+        boost::shared_ptr<CellSimulation> p_cell(new CellSimulation);
+        p_cell->SetInputFile(output_directory + "input.chicbin");
+        p_cell->SetParameters(150.0, 144000.0, scalar_vector<double>(3, 25.0));
+        boost::shared_ptr<VesselSimulation> p_vessel(new VesselSimulation);
+        p_vessel->SetEndTime(3.0);
+        p_vessel->SetLinearSolver(MATRIX_FREE_SOLVER);
+        p_vessel->SetWarmStart(true);
+        boost::shared_ptr<MetabolicSimulation> p_metabolic(new MetabolicSimulation);
+
+        std::vector<boost::shared_ptr<Simulation> > components;
+        components.push_back(p_cell);
+        components.push_back(p_vessel);
+        components.push_back(p_metabolic);
+        for(unsigned idx=0; idx<components.size(); idx++)
+        {
+            components[idx]->SetOutputFile(output_file);
+            components[idx]->SetMaxIncrements(3);
+            components[idx]->SetTargetTimeIncrement(1.0);
+            components[idx]->SetGridSpacing(5.0);
+            components[idx]->SetGridSize(10, 10, 10);
+            components[idx]->SetStatisticsOutput(true);
+            components[idx]->SetOutputFormat(HDF5_OUTPUT);
+            components[idx]->SetOutputFrequency(1);
+            components[idx]->SetAsynchronousOutput(true);
+        }
+
+        InProcessCoupling coupling;
+        coupling.AddComponent("CellSimulator", p_cell);
+        coupling.AddComponent("VesselSimulator", p_vessel);
+        coupling.AddComponent("MetabolicSimulator", p_metabolic);
+        coupling.Couple(CouplingScheme::Hypermodel(false));
+        coupling.Run();
+
+        // The cell component steps up to and including the last increment
+        const char* component_names[3] = {"cell", "vessel", "metabolic"};
+        unsigned num_rows[3] = {4, 3, 3};
+        for(unsigned idx=0; idx<3; idx++)
+        {
+            std::string log_file = output_file + "_" + component_names[idx] + "_statistics.h5";
+            TS_ASSERT_EQUALS(ColumnarLog::ReadColumn(log_file, "time").size(), num_rows[idx]);
+        }
+
+        // The vessel solver log is closed at the end of the run, with a row per step
+        std::vector<double> iterations = ColumnarLog::ReadColumn(output_file + "_vessel_solver.h5", "nutrient_iterations");
+        TS_ASSERT_EQUALS(iterations.size(), 3u);
+
+        // Only the cell component writes fields when coupled
+        Hdf5TimeSeriesReader reader(output_file + "_cell.h5");
+        TS_ASSERT_EQUALS(reader.GetNumberOfSteps(), 4u);
+    }
+};
+
+#endif /*TESTINPROCESSCOUPLING_HPP_*/
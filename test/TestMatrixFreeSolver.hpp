@@ -0,0 +1,363 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTMATRIXFREESOLVER_HPP_
+#define TESTMATRIXFREESOLVER_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <math.h>
+#include "UblasVectorInclude.hpp"
+#include "StencilOperator.hpp"
+#include "MatrixFreeSolver.hpp"
+#include "PreconditionerLagging.hpp"
+
+class TestMatrixFreeSolver : public CxxTest::TestSuite
+{
+    c_vector<unsigned, 3> Size(unsigned x, unsigned y, unsigned z)
+    {
+        c_vector<unsigned, 3> size;
+        size[0] = x;
+        size[1] = y;
+        size[2] = z;
+        return size;
+    }
+
+    /**
+     * A tumour-like mask: free points in a ball, Dirichlet points outside it
+     */
+    std::vector<bool> BallMask(const c_vector<unsigned, 3>& rSize, double radius)
+    {
+        std::vector<bool> dirichlet(rSize[0] * rSize[1] * rSize[2]);
+        for(unsigned idx=0; idx<dirichlet.size(); idx++)
+        {
+            double x = double(idx % rSize[0]) - 0.5 * double(rSize[0] - 1);
+            double y = double((idx / rSize[0]) % rSize[1]) - 0.5 * double(rSize[1] - 1);
+            double z = double(idx / (rSize[0] * rSize[1])) - 0.5 * double(rSize[2] - 1);
+            dirichlet[idx] = sqrt(x*x + y*y + z*z) > radius;
+        }
+        return dirichlet;
+    }
+
+public:
+
+    void TestApplyMatchesStencil()
+    {
+        c_vector<unsigned, 3> size = Size(5, 4, 3);
+        unsigned num_points = 60;
+        double spacing = 0.5;
+        double diffusion_term = 2.0 / (spacing * spacing);
+        StencilOperator stencil(size, spacing, 2.0);
+
+        std::vector<double> reaction(num_points);
+        std::vector<bool> dirichlet(num_points, false);
+        std::vector<double> x(num_points);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            reaction[idx] = -double(idx % 3);
+            dirichlet[idx] = (idx % 7 == 0);
+            x[idx] = double((idx * 13) % 11) - 5.0;
+        }
+        stencil.Update(&reaction[0], dirichlet);
+        std::vector<double> y(num_points);
+        stencil.Apply(&x[0], &y[0]);
+
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            if(dirichlet[idx])
+            {
+                TS_ASSERT_DELTA(y[idx], x[idx], 1.e-12);
+                continue;
+            }
+            unsigned k = idx % 5;
+            unsigned j = (idx / 5) % 4;
+            unsigned i = idx / 20;
+            double expected = -reaction[idx] * x[idx];
+            if(k > 0)
+            {
+                expected += diffusion_term * (x[idx] - x[idx - 1]);
+            }
+            if(k < 4)
+            {
+                expected += diffusion_term * (x[idx] - x[idx + 1]);
+            }
+            if(j > 0)
+            {
+                expected += diffusion_term * (x[idx] - x[idx - 5]);
+            }
+            if(j < 3)
+            {
+                expected += diffusion_term * (x[idx] - x[idx + 5]);
+            }
+            if(i > 0)
+            {
+                expected += diffusion_term * (x[idx] - x[idx - 20]);
+            }
+            if(i < 2)
+            {
+                expected += diffusion_term * (x[idx] - x[idx + 20]);
+            }
+            TS_ASSERT_DELTA(y[idx], expected, 1.e-10);
+        }
+        TS_ASSERT(stencil.GetSpectralBound() <= 2.0);
+
+        std::vector<double> positive(num_points, 100.0);
+        TS_ASSERT_THROWS_THIS(stencil.Update(&positive[0], std::vector<bool>(num_points, false)),
+                "The stencil operator needs a positive diagonal, so the reaction term can't be positive");
+    }
+
+    void TestSmoothersReduceResidual()
+    {
+        c_vector<unsigned, 3> size = Size(12, 12, 12);
+        unsigned num_points = 1728;
+        StencilOperator stencil(size, 1.0, 1.0);
+        std::vector<double> reaction(num_points, -0.1);
+        stencil.Update(&reaction[0], BallMask(size, 5.0));
+
+        // A checkerboard error, the most oscillatory mode, which smoothers should damp quickly
+        std::vector<double> rhs(num_points, 0.0);
+        std::vector<double> residual(num_points);
+        double reductions[2];
+        for(unsigned smoother=0; smoother<2; smoother++)
+        {
+            std::vector<double> x(num_points);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                x[idx] = stencil.rGetDirichletPoints()[idx] ? 0.0 : ((idx + idx / 12 + idx / 144) % 2 ? 1.0 : -1.0);
+            }
+            stencil.Residual(&rhs[0], &x[0], &residual[0]);
+            double initial = 0.0;
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                initial += residual[idx] * residual[idx];
+            }
+            if(smoother == 0)
+            {
+                stencil.Jacobi(&rhs[0], &x[0], 3);
+            }
+            else
+            {
+                stencil.Chebyshev(&rhs[0], &x[0], 3);
+            }
+            stencil.Residual(&rhs[0], &x[0], &residual[0]);
+            double reduced = 0.0;
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                reduced += residual[idx] * residual[idx];
+            }
+            reductions[smoother] = sqrt(reduced / initial);
+            TS_ASSERT_LESS_THAN(reductions[smoother], 0.4);
+        }
+        TS_ASSERT_LESS_THAN(reductions[1], reductions[0]);
+    }
+
+    void TestSolve()
+    {
+        // The centre point of a 3x3x3 grid with every other point fixed
+        double spacing = 0.5;
+        double diffusion_term = 2.0 / (spacing * spacing);
+        MatrixFreeSolver small(Size(3, 3, 3), spacing, 2.0, JACOBI_PRECONDITIONER);
+        std::vector<double> reaction(27, -1.0);
+        std::vector<double> source(27, 4.0);
+        std::vector<bool> dirichlet(27, true);
+        dirichlet[13] = false;
+        small.Update(&reaction[0], &source[0], dirichlet, 10.0);
+        std::vector<double> solution(27, 0.0);
+        small.Solve(&solution[0]);
+        TS_ASSERT_DELTA(solution[13], (4.0 + 6.0 * diffusion_term * 10.0) / (1.0 + 6.0 * diffusion_term), 1.e-8);
+        TS_ASSERT_DELTA(solution[0], 10.0, 1.e-12);
+
+        // A manufactured solution on a larger grid, with each preconditioner
+        c_vector<unsigned, 3> size = Size(20, 16, 12);
+        unsigned num_points = 3840;
+        std::vector<bool> mask = BallMask(size, 6.0);
+        std::vector<double> large_reaction(num_points);
+        std::vector<double> exact(num_points);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            large_reaction[idx] = -0.01 * double(idx % 5);
+            exact[idx] = mask[idx] ? 1.0 : 1.0 + sin(0.1 * idx);
+        }
+        StencilOperator stencil(size, 1.0, 1.0);
+        stencil.Update(&large_reaction[0], mask);
+        std::vector<double> large_source(num_points);
+        stencil.Apply(&exact[0], &large_source[0]);
+
+        unsigned iterations[3];
+        StencilPreconditioner preconditioners[3] = {JACOBI_PRECONDITIONER, CHEBYSHEV_PRECONDITIONER,
+                                                    MULTIGRID_PRECONDITIONER};
+        for(unsigned idx=0; idx<3; idx++)
+        {
+            MatrixFreeSolver solver(size, 1.0, 1.0, preconditioners[idx]);
+            solver.SetTolerances(1.e-10);
+            solver.Update(&large_reaction[0], &large_source[0], mask, 1.0);
+            std::vector<double> large_solution(num_points, 0.0);
+            solver.Solve(&large_solution[0]);
+            for(unsigned jdx=0; jdx<num_points; jdx++)
+            {
+                TS_ASSERT_DELTA(large_solution[jdx], exact[jdx], 1.e-7);
+            }
+            iterations[idx] = solver.GetNumIterations();
+
+            // Starting from the answer needs no iterations
+            solver.Solve(&large_solution[0]);
+            TS_ASSERT_EQUALS(solver.GetNumIterations(), 0u);
+        }
+        TS_ASSERT_LESS_THAN(iterations[1], iterations[0]);
+        TS_ASSERT_LESS_THAN(iterations[2], iterations[1]);
+
+        MatrixFreeSolver limited(size, 1.0, 1.0, JACOBI_PRECONDITIONER);
+        limited.SetMaxIterations(2);
+        limited.Update(&large_reaction[0], &large_source[0], mask, 1.0);
+        std::vector<double> large_solution(num_points, 0.0);
+        TS_ASSERT_THROWS_THIS(limited.Solve(&large_solution[0]), "The matrix-free solver did not converge in 2 iterations");
+    }
+
+    void TestWarmStart()
+    {
+        c_vector<unsigned, 3> size = Size(24, 24, 24);
+        unsigned num_points = 13824;
+        std::vector<bool> mask = BallMask(size, 9.0);
+        std::vector<double> reaction(num_points, -0.05);
+        std::vector<double> source(num_points, 1.0);
+
+        MatrixFreeSolver warm(size, 1.0, 1.0, CHEBYSHEV_PRECONDITIONER);
+        warm.SetChangeTolerance(1.e-2);
+        warm.Update(&reaction[0], &source[0], mask, 1.0);
+        TS_ASSERT_DELTA(warm.GetRhsChange(), -1.0, 1.e-12);
+        std::vector<double> warm_solution(num_points, 0.0);
+        warm.Solve(&warm_solution[0]);
+        unsigned cold_iterations = warm.GetNumIterations();
+
+        // A small step in the source, as between closely spaced time increments
+        double change = 0.0;
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            source[idx] *= 1.0 + 1.e-3 * sin(0.01 * idx);
+            change += mask[idx] ? 0.0 : pow(1.e-3 * sin(0.01 * idx), 2);
+        }
+        warm.Update(&reaction[0], &source[0], mask, 1.0);
+        TS_ASSERT_DELTA(warm.GetRhsChange(), sqrt(change), 1.e-12);
+        warm.Solve(&warm_solution[0]);
+        unsigned warm_iterations = warm.GetNumIterations();
+        TS_ASSERT_LESS_THAN_EQUALS(warm_iterations, cold_iterations / 2);
+
+        // The answer agrees with a solve from zero to within the change tolerance's share of the step
+        MatrixFreeSolver cold(size, 1.0, 1.0, CHEBYSHEV_PRECONDITIONER);
+        cold.Update(&reaction[0], &source[0], mask, 1.0);
+        std::vector<double> cold_solution(num_points, 0.0);
+        cold.Solve(&cold_solution[0]);
+        for(unsigned idx=0; idx<num_points; idx++)
+        {
+            TS_ASSERT_DELTA(warm_solution[idx], cold_solution[idx], 1.e-4);
+        }
+    }
+
+    void TestPreconditionerLagging()
+    {
+        // Without a lag it is rebuilt at every update
+        PreconditionerLagging every_update;
+        TS_ASSERT(!every_update.IsLagged());
+        for(unsigned idx=0; idx<3; idx++)
+        {
+            TS_ASSERT(every_update.Update());
+        }
+
+        // Built, reused twice, then built again
+        PreconditionerLagging lagged;
+        lagged.SetLag(2);
+        TS_ASSERT(lagged.IsLagged());
+        bool expected[6] = {true, false, false, true, false, false};
+        for(unsigned idx=0; idx<6; idx++)
+        {
+            TS_ASSERT_EQUALS(lagged.Update(), expected[idx]);
+        }
+
+        // A slow solve brings the next rebuild forward
+        PreconditionerLagging threshold;
+        threshold.SetLag(10, 20);
+        TS_ASSERT(threshold.Update());
+        threshold.RecordIterations(20);
+        TS_ASSERT(!threshold.Update());
+        threshold.RecordIterations(21);
+        TS_ASSERT(threshold.Update());
+        TS_ASSERT(!threshold.Update());
+    }
+
+    void TestLaggedMultigrid()
+    {
+        c_vector<unsigned, 3> size = Size(24, 24, 24);
+        unsigned num_points = 13824;
+        std::vector<bool> mask = BallMask(size, 9.0);
+        std::vector<double> reaction(num_points, -0.05);
+        std::vector<double> source(num_points, 1.0);
+
+        MatrixFreeSolver lagged(size, 1.0, 1.0);
+        lagged.SetPreconditionerLag(3);
+        MatrixFreeSolver rebuilt(size, 1.0, 1.0);
+        for(unsigned step=0; step<4; step++)
+        {
+            // The reaction drifts, as the vessel and cell fields do between steps
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                reaction[idx] = -0.05 * (1.0 + 0.1 * step * sin(0.01 * idx));
+            }
+            lagged.Update(&reaction[0], &source[0], mask, 1.0);
+            rebuilt.Update(&reaction[0], &source[0], mask, 1.0);
+            TS_ASSERT_EQUALS(lagged.WasPreconditionerRebuilt(), step == 0);
+            TS_ASSERT(rebuilt.WasPreconditionerRebuilt());
+
+            // A stale coarse operator costs a few iterations but gives the same answer
+            std::vector<double> lagged_solution(num_points, 0.0);
+            std::vector<double> rebuilt_solution(num_points, 0.0);
+            lagged.Solve(&lagged_solution[0]);
+            rebuilt.Solve(&rebuilt_solution[0]);
+            TS_ASSERT_LESS_THAN_EQUALS(lagged.GetNumIterations(), 2 * rebuilt.GetNumIterations());
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                TS_ASSERT_DELTA(lagged_solution[idx], rebuilt_solution[idx], 1.e-4);
+            }
+        }
+
+        // The Jacobi and Chebyshev preconditioners only use the diagonal, so are always current
+        MatrixFreeSolver chebyshev(size, 1.0, 1.0, CHEBYSHEV_PRECONDITIONER);
+        chebyshev.SetPreconditionerLag(3);
+        chebyshev.Update(&reaction[0], &source[0], mask, 1.0);
+        chebyshev.Update(&reaction[0], &source[0], mask, 1.0);
+        TS_ASSERT(chebyshev.WasPreconditionerRebuilt());
+    }
+};
+
+#endif /*TESTMATRIXFREESOLVER_HPP_*/
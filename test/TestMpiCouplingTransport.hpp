@@ -0,0 +1,231 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTMPICOUPLINGTRANSPORT_HPP_
+#define TESTMPICOUPLINGTRANSPORT_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "MpiCouplingTransport.hpp"
+#include "CouplingScheme.hpp"
+#include "PetscTools.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Run sequentially the component couples to itself. In parallel the first process
+ * sends and the others form a receiving component, which exercises the broadcast.
+ */
+class TestMpiCouplingTransport : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestCouplingScheme()
+    {
+        CouplingScheme scheme = CouplingScheme::Hypermodel(false);
+        TS_ASSERT_EQUALS(scheme.rGetCouplings().size(), 8u);
+        TS_ASSERT_EQUALS(scheme.rGetCouplings()[6].mSender, "VesselSimulator");
+        TS_ASSERT_EQUALS(scheme.rGetCouplings()[6].mIncoming, "Nutrient_in");
+        TS_ASSERT_EQUALS(CouplingScheme::Hypermodel(true).rGetCouplings().size(), 3u);
+
+        TS_ASSERT_THROWS_THIS(scheme.Couple("VesselSimulator", "Nutrient_out", "CellSimulator", "Nutrient_in"),
+                "Conduit VesselSimulator.Nutrient_out -> CellSimulator.Nutrient_in reuses a conduit that is already coupled");
+
+        char program[] = "CellSimulator";
+        char option[] = "-coupling_transport";
+        char mpi[] = "mpi";
+        char* argv[3] = {program, option, mpi};
+        TS_ASSERT(MpiCouplingTransport::IsSelected(3, argv));
+        TS_ASSERT(!MpiCouplingTransport::IsSelected(2, argv));
+    }
+
+    void TestFieldsAndMessages()
+    {
+        bool sequential = PetscTools::IsSequential();
+        std::string sender = sequential ? "Loopback" : "Sender";
+        std::string receiver = sequential ? "Loopback" : "Receiver";
+        std::string name = PetscTools::AmMaster() ? sender : receiver;
+
+        CouplingScheme scheme;
+        scheme.Couple(sender, "values_out", receiver, "values_in");
+        scheme.Couple(sender, "fields_out", receiver, "fields_in");
+        scheme.Couple(sender, "unused_out", "Elsewhere", "unused_in");
+
+        MpiCouplingTransport transport(name);
+        transport.SetCouplingScheme(scheme);
+        TS_ASSERT_EQUALS(transport.rGetComponentName(), name);
+        int component_size = 0;
+        MPI_Comm_size(transport.GetComponentCommunicator(), &component_size);
+        TS_ASSERT_EQUALS(unsigned(component_size), name == receiver ? PetscTools::GetNumProcs() - (sequential ? 0 : 1) : 1u);
+
+        TS_ASSERT_THROWS_THIS(transport.SendField("nothing_out", NULL, 1),
+                "Conduit nothing_out of component " + name + " is not coupled");
+
+        if(name == sender)
+        {
+            TS_ASSERT_THROWS_THIS(transport.SendField("unused_out", NULL, 1),
+                    "Conduit unused_out of component " + sender + " is coupled to Elsewhere, which is not part of this job");
+            TS_ASSERT_THROWS_THIS(transport.SendMessage("fields_out", std::vector<char>()),
+                    "Can't send an empty message on coupling conduit " + sender + ".fields_out -> " + receiver + ".fields_in");
+        }
+
+        // The persistent requests are reused every step
+        for(unsigned step=0; step<3; step++)
+        {
+            if(name == sender)
+            {
+                std::vector<double> values(5);
+                for(unsigned idx=0; idx<5; idx++)
+                {
+                    values[idx] = 10.0 * step + idx;
+                }
+                transport.SendField("values_out", &values[0], 5);
+                transport.SendMessage("fields_out", std::vector<char>(1000 * step + 1, char('a' + step)));
+            }
+            if(name == receiver)
+            {
+                TS_ASSERT(transport.HasNext("values_in"));
+                std::vector<double> values(5);
+                transport.ReceiveField("values_in", &values[0], 5);
+                TS_ASSERT_DELTA(values[0], 10.0 * step, 1.e-12);
+                TS_ASSERT_DELTA(values[4], 10.0 * step + 4.0, 1.e-12);
+
+                TS_ASSERT(transport.HasNext("fields_in"));
+                std::vector<char> message;
+                transport.ReceiveMessage("fields_in", message);
+                TS_ASSERT_EQUALS(message.size(), 1000u * step + 1u);
+                TS_ASSERT_EQUALS(message.back(), char('a' + step));
+            }
+        }
+
+        if(name == sender)
+        {
+            std::vector<double> values(5, 1.0);
+            transport.SendField("values_out", &values[0], 5);
+        }
+        if(name == receiver)
+        {
+            // Errors found by the lowest process reach the whole component
+            std::vector<double> values(4);
+            TS_ASSERT_THROWS_THIS(transport.ReceiveField("values_in", &values[0], 4),
+                    "Number of points in incoming vector does not match number of points in grid");
+            std::vector<char> message;
+            TS_ASSERT_THROWS_THIS(transport.ReceiveMessage("values_in", message),
+                    "Coupling conduit " + sender + ".values_out -> " + receiver + ".values_in carries fields, not raw messages");
+
+            // The field is still there to be received whole
+            TS_ASSERT(transport.HasNext("values_in"));
+            values.resize(5);
+            transport.ReceiveField("values_in", &values[0], 5);
+            TS_ASSERT_DELTA(values[2], 1.0, 1.e-12);
+        }
+
+        // The streams end when the sending transport goes
+        if(!sequential)
+        {
+            if(name == receiver)
+            {
+                TS_ASSERT(!transport.HasNext("values_in"));
+                TS_ASSERT(!transport.HasNext("fields_in"));
+                std::vector<char> message;
+                TS_ASSERT_THROWS_THIS(transport.ReceiveMessage("fields_in", message),
+                        "Coupling conduit Sender.fields_out -> Receiver.fields_in was closed before a message arrived");
+            }
+        }
+    }
+
+    void TestDistributedFields()
+    {
+        // The first half of the processes form one component and the rest the other, each holding a block of the grid
+        bool sequential = PetscTools::IsSequential();
+        unsigned num_left = std::max(1u, PetscTools::GetNumProcs() / 2u);
+        std::string left = sequential ? "Loopback" : "Left";
+        std::string right = sequential ? "Loopback" : "Right";
+        std::string name = PetscTools::GetMyRank() < num_left ? left : right;
+
+        CouplingScheme scheme;
+        scheme.Couple(left, "field_out", right, "field_in");
+        scheme.Couple(right, "field_back_out", left, "field_back_in");
+
+        MpiCouplingTransport transport(name, true);
+        transport.SetCouplingScheme(scheme);
+        int component_rank = 0;
+        MPI_Comm_rank(transport.GetComponentCommunicator(), &component_rank);
+        GridDecomposition decomposition = transport.GetDecomposition(11);
+        TS_ASSERT(!decomposition.IsReplicated());
+        unsigned start = decomposition.GetStart(component_rank);
+        unsigned end = decomposition.GetEnd(component_rank);
+
+        for(unsigned step=0; step<2; step++)
+        {
+            // Only the local block is read when sending and filled when receiving
+            if(name == left)
+            {
+                std::vector<double> values(11, -1.0);
+                for(unsigned idx=start; idx<end; idx++)
+                {
+                    values[idx] = 100.0 * step + idx;
+                }
+                transport.SendField("field_out", &values[0], 11);
+            }
+            if(name == right)
+            {
+                std::vector<double> values(11, -2.0);
+                transport.ReceiveField("field_in", &values[0], 11);
+                for(unsigned idx=0; idx<11; idx++)
+                {
+                    bool local = idx >= start && idx < end;
+                    TS_ASSERT_DELTA(values[idx], local ? 100.0 * step + idx : -2.0, 1.e-12);
+                    values[idx] *= 2.0;
+                }
+                transport.SendField("field_back_out", &values[0], 11);
+            }
+            if(name == left)
+            {
+                std::vector<double> values(11, -2.0);
+                transport.ReceiveField("field_back_in", &values[0], 11);
+                for(unsigned idx=0; idx<11; idx++)
+                {
+                    bool local = idx >= start && idx < end;
+                    TS_ASSERT_DELTA(values[idx], local ? 2.0 * (100.0 * step + idx) : -2.0, 1.e-12);
+                }
+            }
+        }
+    }
+};
+
+#endif /*TESTMPICOUPLINGTRANSPORT_HPP_*/
@@ -0,0 +1,181 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTOUTPUTREGION_HPP_
+#define TESTOUTPUTREGION_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include "UblasVectorInclude.hpp"
+#include "FieldRegistry.hpp"
+#include "OutputRegion.hpp"
+#include "OutputView.hpp"
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkPointData.h>
+
+class TestOutputRegion : public CxxTest::TestSuite
+{
+    /**
+     * @return a 4x4x4 grid size
+     */
+    c_vector<unsigned, 3> GetGridSize()
+    {
+        c_vector<unsigned, 3> grid_size;
+        grid_size[0] = 4;
+        grid_size[1] = 4;
+        grid_size[2] = 4;
+        return grid_size;
+    }
+
+public:
+
+    void TestExtractRegions()
+    {
+        // Each value is its own grid point index
+        c_vector<unsigned, 3> grid_size = GetGridSize();
+        std::vector<double> values(64);
+        for(unsigned idx=0; idx<64; idx++)
+        {
+            values[idx] = double(idx);
+        }
+
+        TS_ASSERT(OutputRegion().IsWholeGrid(grid_size));
+        TS_ASSERT(!OutputRegion::Downsample(2).IsWholeGrid(grid_size));
+
+        // A subvolume, clipped to the grid
+        c_vector<unsigned, 3> lower;
+        lower[0] = 1;
+        lower[1] = 2;
+        lower[2] = 3;
+        c_vector<unsigned, 3> upper = scalar_vector<unsigned>(3, 10);
+        OutputRegion sub_volume = OutputRegion::SubVolume(lower, upper);
+        c_vector<unsigned, 3> size = sub_volume.GetSize(grid_size);
+        TS_ASSERT_EQUALS(size[0], 3u);
+        TS_ASSERT_EQUALS(size[1], 2u);
+        TS_ASSERT_EQUALS(size[2], 1u);
+        std::vector<double> output(6);
+        sub_volume.Extract(&values[0], grid_size, &output[0]);
+        TS_ASSERT_DELTA(output[0], 1.0 + 2.0 * 4.0 + 3.0 * 16.0, 1.e-12);
+        TS_ASSERT_DELTA(output[5], 3.0 + 3.0 * 4.0 + 3.0 * 16.0, 1.e-12);
+
+        c_vector<double, 3> origin = sub_volume.GetOrigin(zero_vector<double>(3), 0.5);
+        TS_ASSERT_DELTA(origin[0], 0.5, 1.e-12);
+        TS_ASSERT_DELTA(origin[2], 1.5, 1.e-12);
+
+        // A slice normal to y
+        OutputRegion slice = OutputRegion::Slice(1, 2);
+        size = slice.GetSize(grid_size);
+        TS_ASSERT_EQUALS(size[0], 4u);
+        TS_ASSERT_EQUALS(size[1], 1u);
+        TS_ASSERT_EQUALS(size[2], 4u);
+        output.resize(16);
+        slice.Extract(&values[0], grid_size, &output[0]);
+        TS_ASSERT_DELTA(output[0], 8.0, 1.e-12);
+        TS_ASSERT_DELTA(output[15], 3.0 + 8.0 + 48.0, 1.e-12);
+
+        // Sampled and averaged downsampling
+        OutputRegion sampled = OutputRegion::Downsample(2, false);
+        size = sampled.GetSize(grid_size);
+        TS_ASSERT_EQUALS(size[0], 2u);
+        TS_ASSERT_DELTA(sampled.GetSpacing(0.5), 1.0, 1.e-12);
+        output.resize(8);
+        sampled.Extract(&values[0], grid_size, &output[0]);
+        TS_ASSERT_DELTA(output[1], 2.0, 1.e-12);
+        TS_ASSERT_DELTA(output[7], 2.0 + 8.0 + 32.0, 1.e-12);
+
+        OutputRegion averaged = OutputRegion::Downsample(2);
+        averaged.Extract(&values[0], grid_size, &output[0]);
+        TS_ASSERT_DELTA(output[0], (0.0 + 1.0 + 4.0 + 5.0 + 16.0 + 17.0 + 20.0 + 21.0) / 8.0, 1.e-12);
+
+        // Averages are placed at the centres of their blocks, samples at the points they take
+        origin = averaged.GetOrigin(zero_vector<double>(3), 0.5);
+        TS_ASSERT_DELTA(origin[0], 0.25, 1.e-12);
+        TS_ASSERT_DELTA(origin[2], 0.25, 1.e-12);
+        origin = sampled.GetOrigin(zero_vector<double>(3), 0.5);
+        TS_ASSERT_DELTA(origin[0], 0.0, 1.e-12);
+        origin = OutputRegion::Slice(2, 1).SetStride(2, true).GetOrigin(zero_vector<double>(3), 0.5);
+        TS_ASSERT_DELTA(origin[0], 0.25, 1.e-12);
+        TS_ASSERT_DELTA(origin[2], 0.5, 1.e-12);
+
+        // Blocks at the edge are clipped
+        OutputRegion clipped = OutputRegion::Downsample(3);
+        size = clipped.GetSize(grid_size);
+        TS_ASSERT_EQUALS(size[0], 2u);
+        clipped.Extract(&values[0], grid_size, &output[0]);
+        TS_ASSERT_DELTA(output[7], 63.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(OutputRegion::Slice(3, 0), "Slice axis must be 0, 1 or 2");
+        TS_ASSERT_THROWS_THIS(OutputRegion::Slice(0, 4).GetSize(grid_size), "Output region lies outside the grid");
+        TS_ASSERT_THROWS_THIS(OutputRegion::Downsample(0), "Output stride must be at least one");
+    }
+
+    void TestOutputView()
+    {
+        c_vector<unsigned, 3> grid_size = GetGridSize();
+        FieldRegistry fields;
+        fields.Reset(64);
+        double* p_nutrient = fields.GetField(fields.Register("nutrient"));
+        fields.Register("vessel");
+        for(unsigned idx=0; idx<64; idx++)
+        {
+            p_nutrient[idx] = double(idx);
+        }
+        std::vector<std::string> names(1, "nutrient");
+
+        // The whole grid view wraps the fields
+        OutputView full("", OutputRegion(), names);
+        full.Bind(fields, grid_size, 1.0, zero_vector<double>(3));
+        full.Update();
+        TS_ASSERT_EQUALS(full.GetValues()[0], p_nutrient);
+        TS_ASSERT_EQUALS(full.GetImage()->GetPointData()->GetNumberOfArrays(), 1);
+        TS_ASSERT_EQUALS(full.GetFilename("out/test_vessel_t_0.vti"), "out/test_vessel_t_0.vti");
+
+        // Other views extract at each update
+        OutputView slice("slice_xy", OutputRegion::Slice(2, 1), names);
+        slice.Bind(fields, grid_size, 1.0, zero_vector<double>(3));
+        TS_ASSERT_EQUALS(slice.GetImage()->GetDimensions()[2], 1);
+        TS_ASSERT_DELTA(slice.GetImage()->GetOrigin()[2], 1.0, 1.e-12);
+        slice.Update();
+        TS_ASSERT_DELTA(slice.GetValues()[0][0], 16.0, 1.e-12);
+        p_nutrient[16] = -1.0;
+        slice.Update();
+        TS_ASSERT_DELTA(slice.GetValues()[0][0], -1.0, 1.e-12);
+        TS_ASSERT_EQUALS(slice.GetFilename("out/test_vessel_t_0.vti"), "out/test_vessel_t_0_slice_xy.vti");
+        TS_ASSERT_EQUALS(slice.GetFilename("out.d/test_vessel"), "out.d/test_vessel_slice_xy");
+    }
+};
+
+#endif /*TESTOUTPUTREGION_HPP_*/
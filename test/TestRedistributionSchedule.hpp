@@ -0,0 +1,148 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTREDISTRIBUTIONSCHEDULE_HPP_
+#define TESTREDISTRIBUTIONSCHEDULE_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include "GridDecomposition.hpp"
+#include "RedistributionSchedule.hpp"
+
+class TestRedistributionSchedule : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestGridDecomposition()
+    {
+        // Split as PETSc splits vectors, the first processes take the remainder
+        GridDecomposition block = GridDecomposition::Block(11, 4);
+        TS_ASSERT(!block.IsReplicated());
+        TS_ASSERT_EQUALS(block.GetNumberOfPoints(), 11u);
+        TS_ASSERT_EQUALS(block.GetNumberOfProcesses(), 4u);
+        TS_ASSERT_EQUALS(block.GetStart(0), 0u);
+        TS_ASSERT_EQUALS(block.GetEnd(0), 3u);
+        TS_ASSERT_EQUALS(block.GetStart(2), 6u);
+        TS_ASSERT_EQUALS(block.GetEnd(2), 9u);
+        TS_ASSERT_EQUALS(block.GetEnd(3), 11u);
+
+        // More processes than points leaves some empty
+        GridDecomposition sparse = GridDecomposition::Block(2, 3);
+        TS_ASSERT_EQUALS(sparse.GetStart(2), sparse.GetEnd(2));
+
+        GridDecomposition replicated = GridDecomposition::Replicated(11, 3);
+        TS_ASSERT(replicated.IsReplicated());
+        TS_ASSERT_EQUALS(replicated.GetNumberOfProcesses(), 3u);
+        TS_ASSERT_EQUALS(replicated.GetStart(2), 0u);
+        TS_ASSERT_EQUALS(replicated.GetEnd(2), 11u);
+
+        TS_ASSERT_THROWS_THIS(GridDecomposition::Block(11, 0), "A grid decomposition needs at least one process");
+    }
+
+    void TestBlocksToBlocks()
+    {
+        // 4 processes sending to 3, each receiver gets only the points it holds
+        GridDecomposition sender = GridDecomposition::Block(12, 4);
+        GridDecomposition receiver = GridDecomposition::Block(12, 3);
+        RedistributionSchedule schedule(sender, receiver);
+        TS_ASSERT(!schedule.ReceiverBroadcasts());
+
+        // Sender 1 holds 3-5, receiver 0 holds 0-3 and receiver 1 holds 4-7
+        const std::vector<RedistributionSchedule::Transfer>& r_sends = schedule.rGetSends(1);
+        TS_ASSERT_EQUALS(r_sends.size(), 2u);
+        TS_ASSERT_EQUALS(r_sends[0].mProcess, 0u);
+        TS_ASSERT_EQUALS(r_sends[0].mStart, 3u);
+        TS_ASSERT_EQUALS(r_sends[0].mCount, 1u);
+        TS_ASSERT_EQUALS(r_sends[1].mProcess, 1u);
+        TS_ASSERT_EQUALS(r_sends[1].mStart, 4u);
+        TS_ASSERT_EQUALS(r_sends[1].mCount, 2u);
+
+        const std::vector<RedistributionSchedule::Transfer>& r_receives = schedule.rGetReceives(1);
+        TS_ASSERT_EQUALS(r_receives.size(), 2u);
+        TS_ASSERT_EQUALS(r_receives[0].mProcess, 1u);
+        TS_ASSERT_EQUALS(r_receives[1].mProcess, 2u);
+        TS_ASSERT_EQUALS(r_receives[1].mStart, 6u);
+        TS_ASSERT_EQUALS(r_receives[1].mCount, 2u);
+
+        // Every point is received exactly once
+        std::vector<unsigned> times_received(12, 0);
+        for(unsigned process=0; process<3; process++)
+        {
+            const std::vector<RedistributionSchedule::Transfer>& r_transfers = schedule.rGetReceives(process);
+            for(unsigned idx=0; idx<r_transfers.size(); idx++)
+            {
+                TS_ASSERT(r_transfers[idx].mStart >= receiver.GetStart(process));
+                TS_ASSERT(r_transfers[idx].mStart + r_transfers[idx].mCount <= receiver.GetEnd(process));
+                for(unsigned point=r_transfers[idx].mStart; point<r_transfers[idx].mStart + r_transfers[idx].mCount; point++)
+                {
+                    times_received[point]++;
+                }
+            }
+        }
+        for(unsigned point=0; point<12; point++)
+        {
+            TS_ASSERT_EQUALS(times_received[point], 1u);
+        }
+    }
+
+    void TestWholeFields()
+    {
+        // A component holding whole fields sends from its first process
+        RedistributionSchedule from_whole(GridDecomposition::Replicated(10, 2), GridDecomposition::Block(10, 3));
+        TS_ASSERT_EQUALS(from_whole.rGetSends(0).size(), 3u);
+        TS_ASSERT(from_whole.rGetSends(1).empty());
+        TS_ASSERT_EQUALS(from_whole.rGetReceives(2).size(), 1u);
+        TS_ASSERT_EQUALS(from_whole.rGetReceives(2)[0].mProcess, 0u);
+        TS_ASSERT_EQUALS(from_whole.rGetReceives(2)[0].mStart, 7u);
+        TS_ASSERT(!from_whole.ReceiverBroadcasts());
+
+        // and receives on its first process, which broadcasts
+        RedistributionSchedule to_whole(GridDecomposition::Block(10, 3), GridDecomposition::Replicated(10, 2));
+        TS_ASSERT_EQUALS(to_whole.rGetReceives(0).size(), 3u);
+        TS_ASSERT(to_whole.rGetReceives(1).empty());
+        TS_ASSERT(to_whole.ReceiverBroadcasts());
+
+        RedistributionSchedule single(GridDecomposition::Replicated(10, 1), GridDecomposition::Replicated(10, 1));
+        TS_ASSERT_EQUALS(single.rGetSends(0).size(), 1u);
+        TS_ASSERT_EQUALS(single.rGetSends(0)[0].mCount, 10u);
+        TS_ASSERT(!single.ReceiverBroadcasts());
+
+        TS_ASSERT_THROWS_THIS(RedistributionSchedule(GridDecomposition::Block(10, 2), GridDecomposition::Block(9, 2)),
+                "Number of points in incoming vector does not match number of points in grid");
+    }
+};
+
+#endif /*TESTREDISTRIBUTIONSCHEDULE_HPP_*/
@@ -0,0 +1,156 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTREGRIDDINGOPERATOR_HPP_
+#define TESTREGRIDDINGOPERATOR_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include "UblasVectorInclude.hpp"
+#include "RegriddingOperator.hpp"
+
+class TestRegriddingOperator : public CxxTest::TestSuite
+{
+    c_vector<unsigned, 3> Size(unsigned x, unsigned y, unsigned z)
+    {
+        c_vector<unsigned, 3> size;
+        size[0] = x;
+        size[1] = y;
+        size[2] = z;
+        return size;
+    }
+
+public:
+
+    void TestConservative()
+    {
+        // Each coarse voxel covers 2x2x2 fine voxels
+        c_vector<unsigned, 3> fine_size = Size(4, 4, 2);
+        c_vector<double, 3> fine_origin = zero_vector<double>(3);
+        c_vector<unsigned, 3> coarse_size = Size(2, 2, 1);
+        c_vector<double, 3> coarse_origin = scalar_vector<double>(3, 0.5);
+
+        RegriddingOperator restriction(CONSERVATIVE_REGRIDDING, fine_size, 1.0, fine_origin,
+                coarse_size, 2.0, coarse_origin);
+        TS_ASSERT_EQUALS(restriction.GetNumberOfSourcePoints(), 32u);
+        TS_ASSERT_EQUALS(restriction.GetNumberOfTargetPoints(), 4u);
+        TS_ASSERT_EQUALS(restriction.GetNumberOfWeights(), 32u);
+
+        std::vector<double> fine(32);
+        double fine_total = 0.0;
+        for(unsigned idx=0; idx<32; idx++)
+        {
+            fine[idx] = double((7 * idx) % 5);
+            fine_total += fine[idx];
+        }
+        std::vector<double> coarse(4);
+        restriction.Apply(&fine[0], &coarse[0]);
+
+        // The population over the grid is kept
+        double coarse_total = 0.0;
+        for(unsigned idx=0; idx<4; idx++)
+        {
+            coarse_total += 8.0 * coarse[idx];
+        }
+        TS_ASSERT_DELTA(coarse_total, fine_total, 1.e-10);
+        double first_block = fine[0] + fine[1] + fine[4] + fine[5] + fine[16] + fine[17] + fine[20] + fine[21];
+        TS_ASSERT_DELTA(coarse[0], first_block / 8.0, 1.e-12);
+
+        // Back to the fine grid each fine voxel takes the value of the coarse voxel holding it
+        RegriddingOperator prolongation(CONSERVATIVE_REGRIDDING, coarse_size, 2.0, coarse_origin,
+                fine_size, 1.0, fine_origin);
+        std::vector<double> back(32);
+        prolongation.Apply(&coarse[0], &back[0]);
+        TS_ASSERT_DELTA(back[0], coarse[0], 1.e-12);
+        TS_ASSERT_DELTA(back[21], coarse[0], 1.e-12);
+        TS_ASSERT_DELTA(back[31], coarse[3], 1.e-12);
+
+        // Voxels off the source grid are empty
+        c_vector<double, 3> shifted_origin = scalar_vector<double>(3, 100.0);
+        RegriddingOperator outside(CONSERVATIVE_REGRIDDING, fine_size, 1.0, fine_origin,
+                coarse_size, 2.0, shifted_origin);
+        TS_ASSERT_EQUALS(outside.GetNumberOfWeights(), 0u);
+        outside.Apply(&fine[0], &coarse[0]);
+        TS_ASSERT_DELTA(coarse[3], 0.0, 1.e-12);
+    }
+
+    void TestTrilinear()
+    {
+        // A linear field is reproduced exactly inside the coarse grid
+        c_vector<unsigned, 3> coarse_size = Size(3, 3, 3);
+        c_vector<double, 3> coarse_origin = zero_vector<double>(3);
+        c_vector<unsigned, 3> fine_size = Size(5, 5, 5);
+        c_vector<double, 3> fine_origin = scalar_vector<double>(3, -1.0);
+
+        std::vector<double> coarse(27);
+        for(unsigned k=0; k<3; k++)
+        {
+            for(unsigned j=0; j<3; j++)
+            {
+                for(unsigned i=0; i<3; i++)
+                {
+                    coarse[i + 3 * (j + 3 * k)] = 2.0 * i + 4.0 * j + 6.0 * k;
+                }
+            }
+        }
+
+        RegriddingOperator prolongation(TRILINEAR_REGRIDDING, coarse_size, 2.0, coarse_origin,
+                fine_size, 1.5, fine_origin);
+        TS_ASSERT(prolongation.GetNumberOfWeights() <= 8u * 125u);
+        std::vector<double> fine(125);
+        prolongation.Apply(&coarse[0], &fine[0]);
+
+        // (0.5, 2, 3.5) and the point off the grid at (-1, -1, -1), which takes the corner value
+        TS_ASSERT_DELTA(fine[1 + 5 * (2 + 5 * 3)], 0.5 + 4.0 + 10.5, 1.e-12);
+        TS_ASSERT_DELTA(fine[0], 0.0, 1.e-12);
+        TS_ASSERT_DELTA(fine[124], 2.0 * 2 + 4.0 * 2 + 6.0 * 2, 1.e-12);
+
+        // Points on source points have a single weight
+        RegriddingOperator identity(TRILINEAR_REGRIDDING, coarse_size, 2.0, coarse_origin,
+                coarse_size, 2.0, coarse_origin);
+        TS_ASSERT_EQUALS(identity.GetNumberOfWeights(), 27u);
+
+        // A flat grid is interpolated in its plane
+        RegriddingOperator flat(TRILINEAR_REGRIDDING, Size(3, 3, 1), 2.0, coarse_origin,
+                Size(5, 5, 1), 1.0, coarse_origin);
+        flat.Apply(&coarse[0], &fine[0]);
+        TS_ASSERT_DELTA(fine[1 + 5 * 3], 1.0 + 6.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(RegriddingOperator(TRILINEAR_REGRIDDING, coarse_size, 0.0, coarse_origin,
+                fine_size, 1.0, fine_origin), "Grids must have a positive spacing to be regridded");
+    }
+};
+
+#endif /*TESTREGRIDDINGOPERATOR_HPP_*/
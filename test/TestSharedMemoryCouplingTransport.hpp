@@ -0,0 +1,184 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTSHAREDMEMORYCOUPLINGTRANSPORT_HPP_
+#define TESTSHAREDMEMORYCOUPLINGTRANSPORT_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <boost/lexical_cast.hpp>
+#include "Exception.hpp"
+#include "SharedMemoryRing.hpp"
+#include "SharedMemoryCouplingTransport.hpp"
+
+class TestSharedMemoryCouplingTransport : public CxxTest::TestSuite
+{
+    /**
+     * @return a session name no other run is using
+     */
+    std::string GetSession()
+    {
+        return "chic_test_" + boost::lexical_cast<std::string>(getpid());
+    }
+
+public:
+
+    void TestRingStreamsLargeMessages()
+    {
+        std::string name = "/" + GetSession() + "_ring";
+
+        // Much more than the ring holds goes through in order
+        std::vector<char> sent(100000);
+        for(unsigned idx=0; idx<sent.size(); idx++)
+        {
+            sent[idx] = char(idx % 251);
+        }
+        std::vector<char> received(sent.size());
+        {
+            SharedMemoryRing reader(name, SharedMemoryRing::READER_END, 4096);
+            std::thread writer_thread([&name, &sent]
+            {
+                SharedMemoryRing writer(name, SharedMemoryRing::WRITER_END, 4096);
+                writer.Write(&sent[0], sent.size());
+            });
+            reader.Read(&received[0], received.size());
+            writer_thread.join();
+            TS_ASSERT(received == sent);
+
+            // The writer has gone
+            TS_ASSERT(!reader.WaitForData());
+            TS_ASSERT_THROWS_THIS(reader.Read(&received[0], 1),
+                    "Shared memory conduit " + name + " was closed before a message arrived");
+            TS_ASSERT_THROWS_THIS(SharedMemoryRing(name, SharedMemoryRing::READER_END, 4096),
+                    "Shared memory conduit " + name + " already has a receiver, remove /dev/shm" + name +
+                    " if it is left over from an earlier run");
+            TS_ASSERT_THROWS_THIS(SharedMemoryRing(name, SharedMemoryRing::WRITER_END, 8192),
+                    "Shared memory conduit " + name + " was created with a different capacity");
+        }
+
+        {
+            // Data for a receiver that has gone would be lost, so the sender is told
+            SharedMemoryRing writer(name, SharedMemoryRing::WRITER_END, 4096);
+            {
+                SharedMemoryRing reader(name, SharedMemoryRing::READER_END, 4096);
+            }
+            TS_ASSERT_THROWS_THIS(writer.Write(&sent[0], 1),
+                    "The receiver on shared memory conduit " + name + " has closed");
+        }
+
+        // Removed once both ends are done with it
+        TS_ASSERT_EQUALS(access(("/dev/shm" + name).c_str(), F_OK), -1);
+    }
+
+    void TestChannels()
+    {
+        SharedMemoryCouplingTransport transport(GetSession());
+        TS_ASSERT_EQUALS(transport.GetChannel("proliferating_out"), "proliferating");
+        TS_ASSERT_EQUALS(transport.GetChannel("proliferating_in"), "proliferating");
+        transport.SetChannel("fields_out", "cell_to_vessel");
+        TS_ASSERT_EQUALS(transport.GetChannel("fields_out"), "cell_to_vessel");
+        TS_ASSERT_THROWS_THIS(transport.GetChannel("fields"), "Conduit fields should end in _out or _in");
+
+        std::string conduit;
+        std::string channel;
+        SharedMemoryCouplingTransport::ParseChannel("fields_in:metabolic_to_cell", conduit, channel);
+        TS_ASSERT_EQUALS(conduit, "fields_in");
+        TS_ASSERT_EQUALS(channel, "metabolic_to_cell");
+        TS_ASSERT_THROWS_THIS(SharedMemoryCouplingTransport::ParseChannel("fields_in", conduit, channel),
+                "Shared memory channel fields_in should be given as conduit:channel");
+    }
+
+    void TestBetweenProcesses()
+    {
+        std::string session = GetSession();
+        pid_t child = fork();
+        TS_ASSERT(child >= 0);
+        if(child == 0)
+        {
+            // The sending component
+            int status = 0;
+            try
+            {
+                SharedMemoryCouplingTransport transport(session, 4096);
+                transport.SetChannel("fields_out", "batch");
+                std::vector<double> ramp(1000);
+                for(unsigned step=0; step<5; step++)
+                {
+                    ramp.assign(ramp.size(), double(step));
+                    transport.SendField("ramp_out", &ramp[0], ramp.size());
+                }
+                transport.SendMessage("fields_out", std::vector<char>(10, 'z'));
+            }
+            catch(const Exception&)
+            {
+                status = 1;
+            }
+            _exit(status);
+        }
+
+        std::vector<double> received;
+        std::vector<char> message;
+        {
+            SharedMemoryCouplingTransport transport(session, 4096);
+            transport.SetChannel("fields_in", "batch");
+            std::vector<double> ramp(1000);
+            while(transport.HasNext("ramp_in"))
+            {
+                transport.ReceiveField("ramp_in", &ramp[0], ramp.size());
+                received.push_back(ramp[999]);
+            }
+            transport.ReceiveMessage("fields_in", message);
+        }
+
+        int status = -1;
+        waitpid(child, &status, 0);
+        TS_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        TS_ASSERT_EQUALS(received.size(), 5u);
+        for(unsigned idx=0; idx<received.size(); idx++)
+        {
+            TS_ASSERT_DELTA(received[idx], double(idx), 1.e-12);
+        }
+        TS_ASSERT_EQUALS(message.size(), 10u);
+        TS_ASSERT_EQUALS(message[9], 'z');
+        TS_ASSERT_EQUALS(access(("/dev/shm/" + session + "_ramp").c_str(), F_OK), -1);
+        TS_ASSERT_EQUALS(access(("/dev/shm/" + session + "_batch").c_str(), F_OK), -1);
+    }
+};
+
+#endif /*TESTSHAREDMEMORYCOUPLINGTRANSPORT_HPP_*/
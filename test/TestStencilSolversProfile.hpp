@@ -0,0 +1,163 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTSTENCILSOLVERSPROFILE_HPP_
+#define TESTSTENCILSOLVERSPROFILE_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <math.h>
+#include "UblasVectorInclude.hpp"
+#include "ReplicatableVector.hpp"
+#include "PetscTools.hpp"
+#include "DiffusionReactionSystem.hpp"
+#include "MatrixFreeSolver.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Compares the assembled and matrix-free vessel solves on nutrient-like systems: a
+ * spherical tumour of free points with uptake, inside healthy Dirichlet points. Reports
+ * the time to apply the operator, the time and iterations to solve, and the bytes held
+ * per grid point.
+ */
+class TestStencilSolversProfile : public CxxTest::TestSuite
+{
+    /**
+     * @param start when timing started
+     * @return the seconds since
+     */
+    double Elapsed(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+public:
+
+    void TestAssembledAgainstMatrixFree()
+    {
+        EXIT_IF_PARALLEL;
+
+        unsigned sizes[3] = {32, 64, 96};
+        unsigned num_applies = 20;
+        std::cout << std::endl << std::setw(6) << "size" << std::setw(22) << "solver" << std::setw(14) << "apply ms"
+                  << std::setw(14) << "solve ms" << std::setw(12) << "iterations" << std::setw(14) << "bytes/point" << std::endl;
+        for(unsigned size_index=0; size_index<3; size_index++)
+        {
+            unsigned size = sizes[size_index];
+            c_vector<unsigned, 3> grid_size = scalar_vector<unsigned>(3, size);
+            unsigned num_points = size * size * size;
+            std::vector<double> reaction(num_points);
+            std::vector<double> source(num_points);
+            std::vector<bool> healthy(num_points);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                double x = double(idx % size) - 0.5 * size;
+                double y = double((idx / size) % size) - 0.5 * size;
+                double z = double(idx / (size * size)) - 0.5 * size;
+                healthy[idx] = sqrt(x*x + y*y + z*z) > 0.4 * size;
+                reaction[idx] = -(0.25 + 0.01 * double(idx % 7));
+                source[idx] = 10.0;
+            }
+
+            DiffusionReactionSystem assembled(grid_size, 1.0, 1.0);
+            assembled.Update(&reaction[0], &source[0], healthy, 40.0);
+            Vec x = PetscTools::CreateAndSetVec(num_points, 1.0);
+            Vec y = PetscTools::CreateVec(num_points);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(unsigned apply=0; apply<num_applies; apply++)
+            {
+                MatMult(assembled.rGetMatrix(), x, y);
+            }
+            double apply_time = Elapsed(start) / num_applies;
+            start = std::chrono::steady_clock::now();
+            Vec solution = assembled.Solve();
+            double solve_time = Elapsed(start);
+            ReplicatableVector assembled_solution(solution);
+
+            // Values, column indices and row offsets
+            double assembled_bytes = 7.0 * (sizeof(double) + sizeof(PetscInt)) + sizeof(PetscInt);
+            std::cout << std::setw(6) << size << std::setw(22) << "assembled" << std::setw(14) << std::setprecision(4)
+                      << 1.e3 * apply_time << std::setw(14) << 1.e3 * solve_time
+                      << std::setw(12) << assembled.GetNumIterations()
+                      << std::setw(14) << assembled_bytes << std::endl;
+
+            StencilPreconditioner preconditioners[3] = {JACOBI_PRECONDITIONER, CHEBYSHEV_PRECONDITIONER,
+                                                        MULTIGRID_PRECONDITIONER};
+            const char* names[3] = {"matrix-free jacobi", "matrix-free chebyshev", "matrix-free multigrid"};
+            for(unsigned pc_index=0; pc_index<3; pc_index++)
+            {
+                MatrixFreeSolver matrix_free(grid_size, 1.0, 1.0, preconditioners[pc_index]);
+                matrix_free.Update(&reaction[0], &source[0], healthy, 40.0);
+                std::vector<double> ones(num_points, 1.0);
+                std::vector<double> product(num_points);
+                start = std::chrono::steady_clock::now();
+                for(unsigned apply=0; apply<num_applies; apply++)
+                {
+                    matrix_free.rGetOperator().Apply(&ones[0], &product[0]);
+                }
+                apply_time = Elapsed(start) / num_applies;
+                std::vector<double> matrix_free_solution(num_points, 0.0);
+                start = std::chrono::steady_clock::now();
+                matrix_free.Solve(&matrix_free_solution[0]);
+                solve_time = Elapsed(start);
+
+                // Same answer as the assembled solve, to the solver tolerance. Both stop on a
+                // relative residual of 1e-6 over the whole grid, so compare relative values,
+                // with a floor for values near zero.
+                for(unsigned idx=0; idx<num_points; idx += 101)
+                {
+                    TS_ASSERT_DELTA(matrix_free_solution[idx], assembled_solution[idx],
+                                    1.e-3 * (fabs(assembled_solution[idx]) + 1.0));
+                }
+
+                // Diagonal and coupling
+                double matrix_free_bytes = 2.0 * sizeof(double);
+                std::cout << std::setw(6) << size << std::setw(22) << names[pc_index] << std::setw(14)
+                          << 1.e3 * apply_time << std::setw(14) << 1.e3 * solve_time
+                          << std::setw(12) << matrix_free.GetNumIterations()
+                          << std::setw(14) << matrix_free_bytes << std::endl;
+            }
+
+            PetscTools::Destroy(solution);
+            PetscTools::Destroy(x);
+            PetscTools::Destroy(y);
+        }
+    }
+};
+
+#endif /*TESTSTENCILSOLVERSPROFILE_HPP_*/
@@ -0,0 +1,158 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTTEMPORALINTERPOLATOR_HPP_
+#define TESTTEMPORALINTERPOLATOR_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include "TemporalInterpolator.hpp"
+
+class TestTemporalInterpolator : public CxxTest::TestSuite
+{
+
+public:
+
+    void TestOrders()
+    {
+        // Snapshots of a quadratic at t = 0, 2, 4 and 6
+        std::vector<double> values(3);
+        std::vector<double> result(3);
+        TemporalInterpolator hold(0);
+        TemporalInterpolator linear(1);
+        TemporalInterpolator quadratic(2);
+        for(unsigned step=0; step<4; step++)
+        {
+            double time = 2.0 * step;
+            values[0] = 1.0;
+            values[1] = 3.0 * time;
+            values[2] = time * time;
+            hold.AddSnapshot(time, &values[0], 3);
+            linear.AddSnapshot(time, &values[0], 3);
+            quadratic.AddSnapshot(time, &values[0], 3);
+        }
+        TS_ASSERT_EQUALS(hold.GetNumberOfSnapshots(), 1u);
+        TS_ASSERT_EQUALS(linear.GetNumberOfSnapshots(), 2u);
+        TS_ASSERT_EQUALS(quadratic.GetNumberOfSnapshots(), 3u);
+        TS_ASSERT_EQUALS(quadratic.GetOrder(), 2u);
+
+        // Between snapshots
+        linear.Interpolate(5.0, &result[0]);
+        TS_ASSERT_DELTA(result[0], 1.0, 1.e-12);
+        TS_ASSERT_DELTA(result[1], 15.0, 1.e-12);
+        TS_ASSERT_DELTA(result[2], 26.0, 1.e-12);
+
+        quadratic.Interpolate(3.0, &result[0]);
+        TS_ASSERT_DELTA(result[2], 9.0, 1.e-12);
+        quadratic.Interpolate(6.0, &result[0]);
+        TS_ASSERT_DELTA(result[2], 36.0, 1.e-12);
+
+        // Past the last snapshot the growing fields are clamped to it
+        hold.Interpolate(7.0, &result[0]);
+        TS_ASSERT_DELTA(result[1], 18.0, 1.e-12);
+        TS_ASSERT_DELTA(result[2], 36.0, 1.e-12);
+
+        linear.Interpolate(7.0, &result[0]);
+        TS_ASSERT_DELTA(result[0], 1.0, 1.e-12);
+        TS_ASSERT_DELTA(result[1], 18.0, 1.e-12);
+        TS_ASSERT_DELTA(result[2], 36.0, 1.e-12);
+
+        quadratic.Interpolate(7.0, &result[0]);
+        TS_ASSERT_DELTA(result[1], 18.0, 1.e-12);
+        TS_ASSERT_DELTA(result[2], 36.0, 1.e-12);
+    }
+
+    void TestValuesStayWithinTheSnapshots()
+    {
+        // A population falling to zero and a mask switching off
+        std::vector<double> values(2);
+        std::vector<double> result(2);
+        TemporalInterpolator linear(1);
+        TemporalInterpolator quadratic(2);
+        double populations[3] = {4.0, 1.0, 0.0};
+        double masks[3] = {1.0, 1.0, 0.0};
+        for(unsigned step=0; step<3; step++)
+        {
+            values[0] = populations[step];
+            values[1] = masks[step];
+            linear.AddSnapshot(double(step), &values[0], 2);
+            quadratic.AddSnapshot(double(step), &values[0], 2);
+        }
+
+        // Unclamped these would be -1 and -1 for linear, 1 and -2 for quadratic
+        linear.Interpolate(3.0, &result[0]);
+        TS_ASSERT_DELTA(result[0], 0.0, 1.e-12);
+        TS_ASSERT_DELTA(result[1], 0.0, 1.e-12);
+        quadratic.Interpolate(3.0, &result[0]);
+        TS_ASSERT_DELTA(result[0], 1.0, 1.e-12);
+        TS_ASSERT_DELTA(result[1], 0.0, 1.e-12);
+
+        // The default holds the last snapshot
+        TS_ASSERT_EQUALS(TemporalInterpolator().GetOrder(), 0u);
+    }
+
+    void TestFewerSnapshotsThanTheOrder()
+    {
+        TemporalInterpolator quadratic(2);
+        std::vector<double> result(2);
+        TS_ASSERT_THROWS_THIS(quadratic.Interpolate(1.0, &result[0]),
+                "There are no snapshots of the coupled field to interpolate");
+
+        std::vector<double> values(2, 4.0);
+        quadratic.AddSnapshot(1.0, &values[0], 2);
+        quadratic.Interpolate(3.0, &result[0]);
+        TS_ASSERT_DELTA(result[1], 4.0, 1.e-12);
+
+        values[1] = 6.0;
+        quadratic.AddSnapshot(2.0, &values[0], 2);
+        quadratic.Interpolate(1.5, &result[0]);
+        TS_ASSERT_DELTA(result[0], 4.0, 1.e-12);
+        TS_ASSERT_DELTA(result[1], 5.0, 1.e-12);
+
+        TS_ASSERT_THROWS_THIS(quadratic.AddSnapshot(2.0, &values[0], 2),
+                "Snapshots of a coupled field must be added in time order");
+        TS_ASSERT_THROWS_THIS(quadratic.AddSnapshot(3.0, &values[0], 1),
+                "Snapshots of a coupled field must all have the same number of values");
+
+        quadratic.Clear();
+        TS_ASSERT_EQUALS(quadratic.GetNumberOfSnapshots(), 0u);
+        quadratic.AddSnapshot(0.5, &values[0], 1);
+        TS_ASSERT_EQUALS(quadratic.GetNumberOfSnapshots(), 1u);
+
+        TS_ASSERT_THROWS_THIS(TemporalInterpolator(3), "Coupled fields can only be interpolated with order 0, 1 or 2");
+    }
+};
+
+#endif /*TESTTEMPORALINTERPOLATOR_HPP_*/
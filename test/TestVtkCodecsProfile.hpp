@@ -0,0 +1,191 @@
+/*
+
+ Copyright (c) 2005-2017, University of Oxford.
+ All rights reserved.
+
+ University of Oxford means the Chancellor, Masters and Scholars of the
+ University of Oxford, having an administrative office at Wellington
+ Square, Oxford OX1 2JD, UK.
+
+ This file is part of Chaste.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#ifndef TESTVTKCODECSPROFILE_HPP_
+#define TESTVTKCODECSPROFILE_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <math.h>
+#include <boost/lexical_cast.hpp>
+#define _BACKWARD_BACKWARD_WARNING_H 1 //Cut out the strstream deprecated warning for now (gcc4.3)
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkXMLImageDataReader.h>
+#include "OutputFileHandler.hpp"
+#include "VtkImageWriter.hpp"
+
+/**
+ * Reports write and read throughput and compression ratio for each VTK codec on
+ * output the size of the clinical_image_3d.vti example, 50^3 points with the nine
+ * vessel component fields.
+ */
+class TestVtkCodecsProfile : public CxxTest::TestSuite
+{
+    /**
+     * @return an image with fields shaped like vessel component output
+     */
+    vtkSmartPointer<vtkImageData> MakeImage()
+    {
+        unsigned size = 50;
+        unsigned num_points = size * size * size;
+        vtkSmartPointer<vtkImageData> p_image = vtkSmartPointer<vtkImageData>::New();
+        p_image->SetDimensions(size, size, size);
+        p_image->SetSpacing(2.0, 2.0, 2.0);
+
+        const char* names[9] = {"proliferating", "quiescent", "differentiated", "apoptotic", "necrotic",
+                                "tumour", "vessel", "stimulus", "nutrient"};
+        for(unsigned field=0; field<9; field++)
+        {
+            vtkSmartPointer<vtkDoubleArray> p_array = vtkSmartPointer<vtkDoubleArray>::New();
+            p_array->SetName(names[field]);
+            p_array->SetNumberOfTuples(num_points);
+            for(unsigned idx=0; idx<num_points; idx++)
+            {
+                double x = double(idx % size) - 25.0;
+                double y = double((idx / size) % size) - 25.0;
+                double z = double(idx / (size * size)) - 25.0;
+                double radius = sqrt(x*x + y*y + z*z);
+                double value = 0.0;
+                if(field < 6)
+                {
+                    // Cell masks inside a spherical tumour
+                    value = radius < 10.0 + field ? 1.0 : 0.0;
+                }
+                else if(field == 6)
+                {
+                    value = 0.25;
+                }
+                else
+                {
+                    // Smoothly varying diffusing species
+                    value = exp(-radius / (5.0 * (field - 5)));
+                }
+                p_array->SetValue(idx, value);
+            }
+            p_image->GetPointData()->AddArray(p_array);
+        }
+        return p_image;
+    }
+
+public:
+
+    void TestCodecThroughputAndRatio()
+    {
+        OutputFileHandler output_file_handler("TestVtkCodecsProfile");
+        vtkSmartPointer<vtkImageData> p_image = MakeImage();
+        double raw_megabytes = 9.0 * double(p_image->GetNumberOfPoints()) * sizeof(double) / 1.e6;
+
+        VtkCodec codecs[5] = {ZLIB_BASE64_CODEC, RAW_CODEC, ZLIB_CODEC, LZ4_CODEC, LZMA_CODEC};
+        int levels[3] = {-1, 1, 9};
+        std::cout << std::endl << std::setw(12) << "codec" << std::setw(8) << "level"
+                  << std::setw(14) << "write MB/s" << std::setw(14) << "read MB/s" << std::setw(10) << "ratio" << std::endl;
+        for(unsigned codec_index=0; codec_index<5; codec_index++)
+        {
+            for(unsigned level_index=0; level_index<3; level_index++)
+            {
+                // The level only matters for compressing codecs
+                if(codecs[codec_index] == RAW_CODEC && level_index > 0)
+                {
+                    continue;
+                }
+                std::string name = VtkImageWriter::GetCodecName(codecs[codec_index]);
+                std::string filename = output_file_handler.GetOutputDirectoryFullPath() + "/" + name
+                        + "_" + boost::lexical_cast<std::string>(levels[level_index]) + ".vti";
+                VtkImageWriter writer(codecs[codec_index], levels[level_index]);
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                writer.Write(p_image, filename);
+                double write_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                start = std::chrono::steady_clock::now();
+                vtkSmartPointer<vtkXMLImageDataReader> p_reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
+                p_reader->SetFileName(filename.c_str());
+                p_reader->Update();
+                double read_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                // Every codec is lossless, so the fields read back are the ones written
+                vtkImageData* p_read = p_reader->GetOutput();
+                TS_ASSERT(p_read != NULL);
+                if(p_read != NULL)
+                {
+                    TS_ASSERT_EQUALS(p_read->GetNumberOfPoints(), p_image->GetNumberOfPoints());
+                    for(int field=0; field<p_image->GetPointData()->GetNumberOfArrays(); field++)
+                    {
+                        vtkDataArray* p_written = p_image->GetPointData()->GetArray(field);
+                        vtkDataArray* p_array = p_read->GetPointData()->GetArray(p_written->GetName());
+                        TS_ASSERT(p_array != NULL);
+                        if(p_array != NULL)
+                        {
+                            TS_ASSERT_EQUALS(p_array->GetNumberOfTuples(), p_written->GetNumberOfTuples());
+                            double max_difference = 0.0;
+                            for(vtkIdType idx=0; idx<p_written->GetNumberOfTuples(); idx++)
+                            {
+                                max_difference = std::max(max_difference,
+                                        fabs(p_array->GetTuple1(idx) - p_written->GetTuple1(idx)));
+                            }
+                            TS_ASSERT_DELTA(max_difference, 0.0, 1.e-12);
+                        }
+                    }
+                }
+
+                // and the compressing ones write less than the raw data
+                std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+                double file_megabytes = double(file.tellg()) / 1.e6;
+                TS_ASSERT(file_megabytes > 0.0);
+                if(codecs[codec_index] != RAW_CODEC)
+                {
+                    TS_ASSERT_LESS_THAN(file_megabytes, raw_megabytes);
+                }
+
+                std::cout << std::setw(12) << name << std::setw(8) << levels[level_index]
+                          << std::setw(14) << std::setprecision(4) << raw_megabytes / write_time
+                          << std::setw(14) << raw_megabytes / read_time
+                          << std::setw(10) << raw_megabytes / file_megabytes << std::endl;
+            }
+        }
+    }
+};
+
+#endif /*TESTVTKCODECSPROFILE_HPP_*/